@@ -1257,6 +1257,15 @@ BRIDGE_IMPEXP void GuiReferenceSetCellContent(int row, int col, const char* str)
     _gui_sendmessage(GUI_REF_SETCELLCONTENT, &info, 0);
 }
 
+BRIDGE_IMPEXP void GuiReferenceAddRows(int rows, int cols, const char* cells)
+{
+    REFROWSINFO info;
+    info.rows = rows;
+    info.cols = cols;
+    info.cells = cells;
+    _gui_sendmessage(GUI_REF_ADDROWS, &info, 0);
+}
+
 BRIDGE_IMPEXP char* GuiReferenceGetCellContent(int row, int col)
 {
     return (char*)_gui_sendmessage(GUI_REF_GETCELLCONTENT, (void*)(duint)row, (void*)(duint)col);
@@ -1132,7 +1132,8 @@ typedef enum
     GUI_MENU_REMOVE,                // param1=int hEntryMenu,       param2=unused
     GUI_REF_ADDCOMMAND,             // param1=const char* title,    param2=const char* command
     GUI_OPEN_TRACE_FILE,            // param1=const char* file name,param2=unused
-    GUI_UPDATE_TRACE_BROWSER        // param1=unused,               param2=unused
+    GUI_UPDATE_TRACE_BROWSER,       // param1=unused,               param2=unused
+    GUI_REF_ADDROWS                 // param1=(REFROWSINFO*)info,   param2=unused
 } GUIMSG;
 
 //GUI Typedefs
@@ -1151,6 +1152,13 @@ typedef struct
     const char* str;
 } CELLINFO;
 
+typedef struct
+{
+    int rows; //number of rows to append
+    int cols; //number of cells per row
+    const char* cells; //rows * cols zero-terminated strings, packed column by column (all cells of column 0, then column 1, ...)
+} REFROWSINFO;
+
 typedef struct
 {
     duint start;
@@ -1228,6 +1236,7 @@ BRIDGE_IMPEXP int GuiReferenceSearchGetRowCount();
 BRIDGE_IMPEXP void GuiReferenceDeleteAllColumns();
 BRIDGE_IMPEXP void GuiReferenceInitialize(const char* name);
 BRIDGE_IMPEXP void GuiReferenceSetCellContent(int row, int col, const char* str);
+BRIDGE_IMPEXP void GuiReferenceAddRows(int rows, int cols, const char* cells);
 BRIDGE_IMPEXP char* GuiReferenceGetCellContent(int row, int col);
 BRIDGE_IMPEXP char* GuiReferenceSearchGetCellContent(int row, int col);
 BRIDGE_IMPEXP void GuiReferenceReloadData();
@@ -0,0 +1,51 @@
+#ifndef TRACEFILEFORMAT_H
+#define TRACEFILEFORMAT_H
+
+#include <stdint.h>
+
+/*
+Run trace file layout, shared between the debugger (writer) and the GUI (reader).
+
+Version 1: 'TRAC', uint32 header size, JSON header ("compression": ""), raw records.
+
+Version 2: 'TRAC', uint32 header size, JSON header ("compression": "lz4"), followed by frames.
+Every frame is a TraceFrameHeader followed by the LZ4 compressed records of one page (version 1 record encoding).
+The first record of a frame is always a full register dump, so every frame can be decoded on its own.
+When the trace is closed an index (TraceIndexEntry per frame) and a TraceFooter are appended. A file without
+footer (the trace is still being recorded or the debugger crashed) can still be opened by walking the frame headers.
+While recording, the last frame can be rewritten in place with more records when the debugger pauses.
+A continued trace file is never shrunk (the trace browser can have it mapped): the old index is zeroed and
+overwritten by the new frames, a zero frame header ends the frames and the index is placed so that the footer
+stays at the end of the file.
+*/
+
+#define TRACE_FILE_VERSION_RAW 1
+#define TRACE_FILE_VERSION_LZ4 2
+#define TRACE_FOOTER_MAGIC 0x58495254 //'TRIX'
+#define TRACE_MAX_FRAME_SIZE (16 * 1024 * 1024) //sanity limit for corrupted files
+
+#pragma pack(push, 1)
+struct TraceFrameHeader
+{
+    uint32_t compressedSize;
+    uint32_t uncompressedSize;
+    uint32_t recordCount;
+};
+
+struct TraceIndexEntry
+{
+    uint64_t firstRecord; //index of the first record in the frame
+    uint64_t fileOffset; //offset of the TraceFrameHeader
+    uint32_t compressedSize; //compressed size of the frame (excluding the header)
+    uint32_t recordCount;
+};
+
+struct TraceFooter
+{
+    uint64_t indexOffset; //offset of the first TraceIndexEntry
+    uint32_t entryCount;
+    uint32_t magic; //TRACE_FOOTER_MAGIC
+};
+#pragma pack(pop)
+
+#endif //TRACEFILEFORMAT_H
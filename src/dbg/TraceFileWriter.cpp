@@ -0,0 +1,512 @@
+#include "TraceFileWriter.h"
+#include "jansson/jansson_x64dbg.h"
+#include "lz4/lz4.h"
+
+#define TRACE_RING_SIZE (16 * 1024 * 1024) //must be a power of 2
+#define TRACE_WRITE_THRESHOLD (1024 * 1024) //wake the writer thread when this much data is pending
+#define TRACE_WRITE_INTERVAL 50 //maximum time in ms data stays in the ring buffer (raw files)
+#define TRACE_WRITE_ALIGNMENT 4096 //compressed output is written up to file offsets aligned to this (page/sector size)
+#define TRACE_BLOCK_FRAMESTART 0x80000000 //flag in the ring entry header
+
+TraceFileWriter::TraceFileWriter()
+    : mRingMask(TRACE_RING_SIZE - 1),
+      mHead(0),
+      mTail(0),
+      mFile(INVALID_HANDLE_VALUE),
+      mThread(nullptr),
+      mWakeWriter(nullptr),
+      mSpaceAvailable(nullptr),
+      mStop(false),
+      mFailed(false),
+      mFlushRequest(0),
+      mFlushDone(0),
+      mLastError(ERROR_SUCCESS),
+      mWritten(0),
+      mStalled(0),
+      mDropped(0),
+      mBytesWritten(0),
+      mCompressed(false),
+      mFileOffset(0),
+      mFileEnd(0),
+      mRecordCount(0),
+      mFrameRecords(0),
+      mFramePartial(false)
+{
+}
+
+TraceFileWriter::~TraceFileWriter()
+{
+    Close();
+}
+
+bool TraceFileWriter::Open(HANDLE hFile, const char* headerInfo)
+{
+    Close();
+    mFile = hFile;
+    mHead = 0;
+    mTail = 0;
+    mStop = false;
+    mFailed = false;
+    mFlushRequest = 0;
+    mFlushDone = 0;
+    mLastError = ERROR_SUCCESS;
+    mWritten = 0;
+    mStalled = 0;
+    mDropped = 0;
+    mBytesWritten = 0;
+    mFileEnd = 0;
+    mRecordCount = 0;
+    mFrame.clear();
+    mFrameRecords = 0;
+    mFramePartial = false;
+    mOutput.clear();
+    mIndex.clear();
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(mFile, &size))
+    {
+        Close();
+        return false;
+    }
+    if(size.QuadPart == 0)
+    {
+        //TRAC, SIZE, JSON header
+        size_t headerInfoSize = strlen(headerInfo);
+        LARGE_INTEGER header;
+        header.LowPart = MAKEFOURCC('T', 'R', 'A', 'C');
+        header.HighPart = LONG(headerInfoSize);
+        mFileOffset = 0;
+        if(!writeFile(&header, 8) || !writeFile(headerInfo, headerInfoSize)) //read-only or disk full?
+        {
+            Close();
+            return false;
+        }
+        mCompressed = true;
+    }
+    else if(!openExisting())
+    {
+        Close();
+        return false;
+    }
+
+    if(mRing.size() != TRACE_RING_SIZE)
+        mRing.resize(TRACE_RING_SIZE);
+    mWakeWriter = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    mSpaceAvailable = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    mThread = CreateThread(nullptr, 0, writerThread, this, 0, nullptr);
+    if(!mWakeWriter || !mSpaceAvailable || !mThread)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+//continue an existing trace file in its own format
+bool TraceFileWriter::openExisting()
+{
+    LARGE_INTEGER size, zero;
+    zero.QuadPart = 0;
+    if(!GetFileSizeEx(mFile, &size) || !SetFilePointerEx(mFile, zero, nullptr, FILE_BEGIN))
+        return false;
+    LARGE_INTEGER header;
+    DWORD read = 0;
+    if(!ReadFile(mFile, &header, 8, &read, nullptr) || read != 8 || header.LowPart != MAKEFOURCC('T', 'R', 'A', 'C') || header.HighPart > 16384)
+        return false;
+    std::vector<char> headerInfo(header.HighPart);
+    if(!ReadFile(mFile, headerInfo.data(), DWORD(headerInfo.size()), &read, nullptr) || read != headerInfo.size())
+        return false;
+    JSON root = json_loadb(headerInfo.data(), headerInfo.size(), 0, nullptr);
+    if(!root)
+        return false;
+    auto version = json_integer_value(json_object_get(root, "ver"));
+    json_decref(root);
+
+    unsigned long long dataEnd = 8 + headerInfo.size();
+    if(version == TRACE_FILE_VERSION_RAW)
+    {
+        mCompressed = false;
+        dataEnd = size.QuadPart;
+    }
+    else if(version == TRACE_FILE_VERSION_LZ4)
+    {
+        //walk the frame headers, this also drops the old index and a partially written frame
+        mCompressed = true;
+        while(dataEnd + sizeof(TraceFrameHeader) <= (unsigned long long)size.QuadPart)
+        {
+            TraceFrameHeader frame;
+            if(!ReadFile(mFile, &frame, sizeof(frame), &read, nullptr) || read != sizeof(frame))
+                return false;
+            auto frameEnd = dataEnd + sizeof(frame) + frame.compressedSize;
+            if(!frame.recordCount || frame.compressedSize > TRACE_MAX_FRAME_SIZE || frameEnd > (unsigned long long)size.QuadPart)
+                break;
+            TraceIndexEntry entry;
+            entry.firstRecord = mRecordCount;
+            entry.fileOffset = dataEnd;
+            entry.compressedSize = frame.compressedSize;
+            entry.recordCount = frame.recordCount;
+            mIndex.push_back(entry);
+            mRecordCount += frame.recordCount;
+            dataEnd = frameEnd;
+            LARGE_INTEGER next;
+            next.QuadPart = dataEnd;
+            if(!SetFilePointerEx(mFile, next, nullptr, FILE_BEGIN))
+                return false;
+        }
+    }
+    else
+        return false;
+
+    //the file is not truncated because the trace browser can have it mapped. The old index and a partially
+    //written frame are zeroed instead, new frames overwrite them and a zero frame header ends the frames.
+    LARGE_INTEGER end;
+    end.QuadPart = dataEnd;
+    if(!SetFilePointerEx(mFile, end, nullptr, FILE_BEGIN))
+        return false;
+    mFileEnd = size.QuadPart;
+    if(dataEnd < mFileEnd)
+    {
+        std::vector<unsigned char> zero(size_t(min(mFileEnd - dataEnd, 64 * 1024)));
+        for(auto offset = dataEnd; offset < mFileEnd;)
+        {
+            DWORD written = 0;
+            if(!WriteFile(mFile, zero.data(), DWORD(min(mFileEnd - offset, zero.size())), &written, nullptr) || !written)
+                return false;
+            offset += written;
+        }
+        if(!SetFilePointerEx(mFile, end, nullptr, FILE_BEGIN))
+            return false;
+    }
+    mFileOffset = dataEnd;
+    return true;
+}
+
+bool TraceFileWriter::Write(const void* data, size_t size, bool frameStart)
+{
+    size_t entrySize = sizeof(uint32_t) + size;
+    if(mFailed.load(std::memory_order_relaxed) || entrySize > TRACE_RING_SIZE)
+    {
+        mDropped++;
+        return false;
+    }
+    auto head = mHead.load(std::memory_order_relaxed);
+    if(TRACE_RING_SIZE - (head - mTail.load(std::memory_order_acquire)) < entrySize)
+    {
+        //back-pressure: the writer thread cannot keep up with the disk
+        mStalled++;
+        SetEvent(mWakeWriter);
+        while(TRACE_RING_SIZE - (head - mTail.load(std::memory_order_acquire)) < entrySize)
+        {
+            if(mFailed.load(std::memory_order_relaxed))
+            {
+                mDropped++;
+                return false;
+            }
+            WaitForSingleObject(mSpaceAvailable, 10);
+        }
+    }
+    uint32_t entryHeader = uint32_t(size) | (frameStart ? TRACE_BLOCK_FRAMESTART : 0);
+    auto copy = [this](size_t position, const void* src, size_t count)
+    {
+        auto offset = position & mRingMask;
+        auto first = min(count, TRACE_RING_SIZE - offset);
+        memcpy(mRing.data() + offset, src, first);
+        if(first < count)
+            memcpy(mRing.data(), (const unsigned char*)src + first, count - first);
+    };
+    copy(head, &entryHeader, sizeof(entryHeader));
+    copy(head + sizeof(entryHeader), data, size);
+    mHead.store(head + entrySize, std::memory_order_release);
+    mWritten++;
+    //only signal when the threshold is crossed to avoid a syscall per block
+    auto pending = head + entrySize - mTail.load(std::memory_order_relaxed);
+    if(pending >= TRACE_WRITE_THRESHOLD && pending - entrySize < TRACE_WRITE_THRESHOLD)
+        SetEvent(mWakeWriter);
+    return true;
+}
+
+void TraceFileWriter::Flush()
+{
+    if(!mThread)
+        return;
+    auto request = ++mFlushRequest;
+    while(int(mFlushDone.load(std::memory_order_acquire) - request) < 0 && !mFailed.load(std::memory_order_relaxed))
+    {
+        SetEvent(mWakeWriter);
+        WaitForSingleObject(mSpaceAvailable, 10);
+    }
+}
+
+void TraceFileWriter::Close()
+{
+    if(mThread)
+    {
+        mStop = true;
+        SetEvent(mWakeWriter);
+        WaitForSingleObject(mThread, INFINITE);
+        CloseHandle(mThread);
+        mThread = nullptr;
+
+        //append the seek index so the reader does not have to walk the frames
+        if(mCompressed && !mFailed && mIndex.size())
+        {
+            //the footer must be at the end of the file, a continued trace can be shorter than the old file
+            auto indexSize = mIndex.size() * sizeof(TraceIndexEntry);
+            if(mFileOffset + indexSize + sizeof(TraceFooter) < mFileEnd)
+            {
+                LARGE_INTEGER offset;
+                offset.QuadPart = mFileEnd - indexSize - sizeof(TraceFooter);
+                if(SetFilePointerEx(mFile, offset, nullptr, FILE_BEGIN))
+                    mFileOffset = offset.QuadPart;
+            }
+            TraceFooter footer;
+            footer.indexOffset = mFileOffset;
+            footer.entryCount = uint32_t(mIndex.size());
+            footer.magic = TRACE_FOOTER_MAGIC;
+            if(writeFile(mIndex.data(), indexSize))
+                writeFile(&footer, sizeof(footer));
+        }
+    }
+    if(mWakeWriter)
+    {
+        CloseHandle(mWakeWriter);
+        mWakeWriter = nullptr;
+    }
+    if(mSpaceAvailable)
+    {
+        CloseHandle(mSpaceAvailable);
+        mSpaceAvailable = nullptr;
+    }
+    if(mFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(mFile);
+        mFile = INVALID_HANDLE_VALUE;
+    }
+}
+
+bool TraceFileWriter::IsOpen() const
+{
+    return mThread != nullptr;
+}
+
+bool TraceFileWriter::IsFailed() const
+{
+    return mFailed.load(std::memory_order_relaxed);
+}
+
+bool TraceFileWriter::IsCompressed() const
+{
+    return mCompressed;
+}
+
+DWORD TraceFileWriter::LastError() const
+{
+    return mLastError.load();
+}
+
+unsigned long long TraceFileWriter::BlocksWritten() const
+{
+    return mWritten.load(std::memory_order_relaxed);
+}
+
+unsigned long long TraceFileWriter::BlocksStalled() const
+{
+    return mStalled.load(std::memory_order_relaxed);
+}
+
+unsigned long long TraceFileWriter::BlocksDropped() const
+{
+    return mDropped.load(std::memory_order_relaxed);
+}
+
+unsigned long long TraceFileWriter::BytesWritten() const
+{
+    return mBytesWritten.load(std::memory_order_relaxed);
+}
+
+DWORD WINAPI TraceFileWriter::writerThread(void* parameter)
+{
+    ((TraceFileWriter*)parameter)->writerLoop();
+    return 0;
+}
+
+void TraceFileWriter::writerLoop()
+{
+    while(true)
+    {
+        WaitForSingleObject(mWakeWriter, TRACE_WRITE_INTERVAL);
+        bool stop = mStop.load();
+        auto flushRequest = mFlushRequest.load();
+        consumePending();
+        //a flush writes the open frame without closing it, so stepping does not cut a frame (and a full register dump) per pause
+        bool flush = flushRequest != mFlushDone.load(std::memory_order_relaxed);
+        if(stop)
+            emitFrame(false);
+        else if(flush)
+            emitFrame(true);
+        writeOutput(stop || flush);
+        mFlushDone.store(flushRequest, std::memory_order_release);
+        SetEvent(mSpaceAvailable);
+        if(stop)
+            break;
+    }
+}
+
+void TraceFileWriter::readRing(size_t position, void* data, size_t size)
+{
+    auto offset = position & mRingMask;
+    auto first = min(size, TRACE_RING_SIZE - offset);
+    memcpy(data, mRing.data() + offset, first);
+    if(first < size)
+        memcpy((unsigned char*)data + first, mRing.data(), size - first);
+}
+
+void TraceFileWriter::consumePending()
+{
+    auto tail = mTail.load(std::memory_order_relaxed);
+    auto head = mHead.load(std::memory_order_acquire);
+    while(tail != head)
+    {
+        uint32_t entryHeader;
+        readRing(tail, &entryHeader, sizeof(entryHeader));
+        size_t size = entryHeader & ~TRACE_BLOCK_FRAMESTART;
+        if(!mFailed.load(std::memory_order_relaxed))
+        {
+            if(mCompressed)
+            {
+                if((entryHeader & TRACE_BLOCK_FRAMESTART) && mFrameRecords)
+                    emitFrame(false);
+                auto frameSize = mFrame.size();
+                mFrame.resize(frameSize + size);
+                readRing(tail + sizeof(entryHeader), mFrame.data() + frameSize, size);
+                mFrameRecords++;
+            }
+            else
+            {
+                //the producer only publishes complete blocks, so a reader of the file never sees a partial block
+                auto outputSize = mOutput.size();
+                mOutput.resize(outputSize + size);
+                readRing(tail + sizeof(entryHeader), mOutput.data() + outputSize, size);
+            }
+        }
+        tail += sizeof(entryHeader) + size;
+        mTail.store(tail, std::memory_order_release);
+        if(mOutput.size() >= TRACE_WRITE_THRESHOLD)
+            writeOutput(false);
+    }
+    if(mFailed.load(std::memory_order_relaxed))
+    {
+        mFrame.clear();
+        mFrameRecords = 0;
+        mFramePartial = false;
+        mOutput.clear();
+    }
+}
+
+//Stores data as a single run of literals, a valid LZ4 block that is never smaller than the compressed data
+static int lz4StoreLiterals(const char* source, int size, char* dest)
+{
+    auto ptr = dest;
+    *ptr++ = char(min(size, 15) << 4);
+    if(size >= 15)
+    {
+        auto remaining = size - 15;
+        for(; remaining >= 255; remaining -= 255)
+            *ptr++ = char(255);
+        *ptr++ = char(remaining);
+    }
+    memcpy(ptr, source, size);
+    return int(ptr - dest) + size;
+}
+
+//Compresses the open frame into the output, a partial frame stays open and is replaced when it is emitted again
+void TraceFileWriter::emitFrame(bool partial)
+{
+    if(!mFrameRecords || mFailed.load(std::memory_order_relaxed))
+        return;
+    uint32_t previousSize = 0;
+    if(mFramePartial)
+    {
+        //the frame is the last thing in the file, overwrite it with the grown frame.
+        //the file is not truncated because the trace browser can have it mapped.
+        writeOutput(true);
+        LARGE_INTEGER offset;
+        offset.QuadPart = mIndex.back().fileOffset;
+        if(!SetFilePointerEx(mFile, offset, nullptr, FILE_BEGIN))
+        {
+            mLastError = GetLastError();
+            mFailed = true;
+            return;
+        }
+        mFileOffset = offset.QuadPart;
+        previousSize = mIndex.back().compressedSize;
+        mRecordCount -= mIndex.back().recordCount;
+        mIndex.pop_back();
+        mFramePartial = false;
+    }
+    int bound = LZ4_compressBound(int(mFrame.size()));
+    mCompressBuffer.resize(bound);
+    int compressedSize = LZ4_compress((const char*)mFrame.data(), mCompressBuffer.data(), int(mFrame.size()));
+    //more records can compress to fewer bytes, the old frame must be covered or a stale tail would follow it
+    if(uint32_t(compressedSize) < previousSize)
+        compressedSize = lz4StoreLiterals((const char*)mFrame.data(), int(mFrame.size()), mCompressBuffer.data());
+    TraceFrameHeader header;
+    header.compressedSize = uint32_t(compressedSize);
+    header.uncompressedSize = uint32_t(mFrame.size());
+    header.recordCount = mFrameRecords;
+
+    TraceIndexEntry entry;
+    entry.firstRecord = mRecordCount;
+    entry.fileOffset = mFileOffset + mOutput.size();
+    entry.compressedSize = header.compressedSize;
+    entry.recordCount = header.recordCount;
+    mIndex.push_back(entry);
+    mRecordCount += mFrameRecords;
+
+    auto outputSize = mOutput.size();
+    mOutput.resize(outputSize + sizeof(header) + compressedSize);
+    memcpy(mOutput.data() + outputSize, &header, sizeof(header));
+    memcpy(mOutput.data() + outputSize + sizeof(header), mCompressBuffer.data(), compressedSize);
+    if(partial)
+    {
+        mFramePartial = true;
+        return;
+    }
+    mFrame.clear();
+    mFrameRecords = 0;
+}
+
+void TraceFileWriter::writeOutput(bool all)
+{
+    if(mOutput.empty())
+        return;
+    size_t size = mOutput.size();
+    //raw files are always written up to a block boundary, a reader of the file must not see a partial block
+    if(!all && mCompressed)
+    {
+        auto end = (mFileOffset + size) & ~(unsigned long long)(TRACE_WRITE_ALIGNMENT - 1);
+        if(end <= mFileOffset)
+            return;
+        size = size_t(end - mFileOffset);
+    }
+    writeFile(mOutput.data(), size);
+    mOutput.erase(mOutput.begin(), mOutput.begin() + size);
+}
+
+bool TraceFileWriter::writeFile(const void* data, size_t size)
+{
+    if(mFailed.load(std::memory_order_relaxed))
+        return false;
+    DWORD written = 0;
+    if(!WriteFile(mFile, data, DWORD(size), &written, nullptr) || written < size) //disk full?
+    {
+        mLastError = GetLastError();
+        mFailed = true;
+        return false;
+    }
+    mFileOffset += size;
+    if(mFileOffset > mFileEnd)
+        mFileEnd = mFileOffset;
+    mBytesWritten += size;
+    return true;
+}
@@ -0,0 +1,73 @@
+#ifndef TRACEFILEWRITER_H
+#define TRACEFILEWRITER_H
+
+#include "_global.h"
+#include "TraceFileFormat.h"
+#include <atomic>
+
+//Single-producer/single-consumer ring buffer that writes run trace blocks on a background thread.
+//The tracing thread appends complete blocks, the writer thread compresses them into frames (version 2 files)
+//and flushes them to the file in large writes that end on a TRACE_WRITE_ALIGNMENT boundary.
+class TraceFileWriter
+{
+public:
+    TraceFileWriter();
+    ~TraceFileWriter();
+
+    bool Open(HANDLE hFile, const char* headerInfo); //takes ownership of the file handle, headerInfo is the JSON header for new files
+    bool Write(const void* data, size_t size, bool frameStart); //returns false if the block was dropped, frameStart must be set for full register dumps
+    void Flush(); //blocks until everything appended so far is on disk, the open frame is rewritten when it grows
+    void Close(); //flushes, stops the writer thread, writes the index and closes the file
+
+    bool IsOpen() const;
+    bool IsFailed() const; //set when a write failed (disk full?)
+    bool IsCompressed() const;
+    DWORD LastError() const;
+
+    unsigned long long BlocksWritten() const;
+    unsigned long long BlocksStalled() const; //appends that had to wait for the writer thread
+    unsigned long long BlocksDropped() const; //appends that were discarded after a write failure
+    unsigned long long BytesWritten() const; //bytes written to the file (after compression)
+
+private:
+    static DWORD WINAPI writerThread(void* parameter);
+    bool openExisting();
+    void writerLoop();
+    void consumePending();
+    void readRing(size_t position, void* data, size_t size);
+    void emitFrame(bool partial);
+    void writeOutput(bool all); //without all, the part of the output after the last aligned file offset stays buffered
+    bool writeFile(const void* data, size_t size);
+
+    std::vector<unsigned char> mRing;
+    size_t mRingMask;
+    std::atomic<size_t> mHead; //total bytes appended by the producer
+    std::atomic<size_t> mTail; //total bytes consumed by the writer thread
+    HANDLE mFile;
+    HANDLE mThread;
+    HANDLE mWakeWriter;
+    HANDLE mSpaceAvailable;
+    std::atomic<bool> mStop;
+    std::atomic<bool> mFailed;
+    std::atomic<unsigned int> mFlushRequest;
+    std::atomic<unsigned int> mFlushDone;
+    std::atomic<DWORD> mLastError; //written by the writer thread before mFailed is set
+    std::atomic<unsigned long long> mWritten;
+    std::atomic<unsigned long long> mStalled;
+    std::atomic<unsigned long long> mDropped;
+    std::atomic<unsigned long long> mBytesWritten;
+
+    //writer thread state
+    bool mCompressed;
+    unsigned long long mFileOffset;
+    unsigned long long mFileEnd; //the file is never shrunk, a continued trace can end before the old file did
+    unsigned long long mRecordCount;
+    std::vector<unsigned char> mFrame;
+    uint32_t mFrameRecords;
+    bool mFramePartial; //mFrame was written by a flush and is the last entry in mIndex
+    std::vector<char> mCompressBuffer;
+    std::vector<unsigned char> mOutput;
+    std::vector<TraceIndexEntry> mIndex;
+};
+
+#endif //TRACEFILEWRITER_H
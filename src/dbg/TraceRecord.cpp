@@ -8,12 +8,28 @@
 #include "disasm_fast.h"
 #include "plugin_loader.h"
 #include "value.h"
+#include <atomic>
 
 #define MAX_INSTRUCTIONS_TRACED_FULL_REG_DUMP 512
 
 TraceRecordManager TraceRecord;
+static DWORD executeReaderTls = TlsAlloc();
 
-TraceRecordManager::TraceRecordManager() : instructionCounter(0)
+//The counters can be updated by several threads (TraceExecute is also reached from commands and scripts) while the GUI reads them,
+//relaxed atomics keep the accesses race free and the updates use compare-exchange so no hits are lost.
+template<typename T>
+static T loadCounter(void* rawPtr, duint index)
+{
+    return ((std::atomic<T>*)rawPtr)[index].load(std::memory_order_relaxed);
+}
+
+template<typename T>
+static void orCounter(void* rawPtr, duint index, T value)
+{
+    ((std::atomic<T>*)rawPtr)[index].fetch_or(value, std::memory_order_relaxed);
+}
+
+TraceRecordManager::TraceRecordManager() : generation(0), executeTable(nullptr), executeTableDirty(false), instructionCounter(0)
 {
     ModuleNames.emplace_back("");
 }
@@ -21,16 +37,25 @@ TraceRecordManager::TraceRecordManager() : instructionCounter(0)
 TraceRecordManager::~TraceRecordManager()
 {
     clear();
+    //no thread is tracing anymore when the global is destroyed
+    delete executeTable.load();
+    for(auto table : retiredTables)
+        delete table;
+    for(auto & buffer : retiredBuffers)
+        efree(buffer.second, "TraceRecordManager");
+    for(auto reader : executeReaders)
+        delete reader;
 }
 
 void TraceRecordManager::clear()
 {
     EXCLUSIVE_ACQUIRE(LockTraceRecord);
     for(auto i = TraceRecord.begin(); i != TraceRecord.end(); ++i)
-        efree(i->second.rawPtr, "TraceRecordManager");
+        retireBuffer(i->second.rawPtr);
     TraceRecord.clear();
     ModuleNames.clear();
     ModuleNames.emplace_back("");
+    publishTable();
 }
 
 bool TraceRecordManager::setTraceRecordType(duint pageAddress, TraceRecordType type)
@@ -76,6 +101,7 @@ bool TraceRecordManager::setTraceRecordType(duint pageAddress, TraceRecordType t
                 efree(newPage.rawPtr);
                 return false;
             }
+            executeTableDirty = true;
             return true;
         }
         else
@@ -87,8 +113,9 @@ bool TraceRecordManager::setTraceRecordType(duint pageAddress, TraceRecordType t
         {
             if(pageInfo != TraceRecord.end())
             {
-                efree(pageInfo->second.rawPtr, "TraceRecordManager");
+                retireBuffer(pageInfo->second.rawPtr);
                 TraceRecord.erase(pageInfo);
+                executeTableDirty = true;
             }
             return true;
         }
@@ -108,32 +135,52 @@ TraceRecordManager::TraceRecordType TraceRecordManager::getTraceRecordType(duint
         return pageInfo->second.dataType;
 }
 
+TraceRecordManager::TraceRecordType TraceRecordManager::getExecuteRecordType(duint address)
+{
+    auto reader = getExecuteReader();
+    auto table = acquireExecuteTable(reader);
+    if(table == nullptr)
+        return TraceRecordNone;
+    TraceExecuteCache localCache;
+    memset(&localCache, 0, sizeof(localCache));
+    auto pageInfo = findExecutePage(*table, reader ? reader->cache : localCache, address & ~((duint)4096 - 1));
+    return pageInfo ? pageInfo->dataType : TraceRecordNone;
+}
+
+//Works on the published table without taking LockTraceRecord
 void TraceRecordManager::TraceExecute(duint address, duint size)
 {
-    SHARED_ACQUIRE(LockTraceRecord);
     if(size == 0)
         return;
-    duint base = address & ~((duint)4096 - 1);
-    auto pageInfoIterator = TraceRecord.find(ModHashFromAddr(base));
-    if(pageInfoIterator == TraceRecord.end())
-        return;
-    TraceRecordPage pageInfo;
-    pageInfo = pageInfoIterator->second;
-    duint offset = address - base;
-    bool isMixed;
-    if((offset + size) > 4096) // execution crossed page boundary, splitting into 2 sub calls. Noting that byte type may be mislabelled.
-    {
-        SHARED_RELEASE();
-        TraceExecute(address, 4096 - offset);
-        TraceExecute(base + 4096, size + offset - 4096);
+    auto reader = getExecuteReader();
+    auto table = acquireExecuteTable(reader);
+    if(table == nullptr)
         return;
+    TraceExecuteCache localCache;
+    memset(&localCache, 0, sizeof(localCache));
+    auto & cache = reader ? reader->cache : localCache;
+    while(size)
+    {
+        // execution can cross a page boundary, each page is updated separately. Noting that byte type may be mislabelled.
+        duint base = address & ~((duint)4096 - 1);
+        duint offset = address - base;
+        duint pageSize = min(size, 4096 - offset);
+        auto pageInfo = findExecutePage(*table, cache, base);
+        if(pageInfo)
+            traceExecutePage(*pageInfo, offset, pageSize);
+        address += pageSize;
+        size -= pageSize;
     }
-    isMixed = false;
+}
+
+void TraceRecordManager::traceExecutePage(const TraceRecordPage & pageInfo, duint offset, duint size)
+{
+    bool isMixed = false;
     switch(pageInfo.dataType)
     {
     case TraceRecordType::TraceRecordBitExec:
         for(unsigned char i = 0; i < size; i++)
-            *((char*)pageInfo.rawPtr + (i + offset) / 8) |= 1 << ((i + offset) % 8);
+            ((std::atomic<unsigned char>*)pageInfo.rawPtr)[(i + offset) / 8].fetch_or(1 << ((i + offset) % 8), std::memory_order_relaxed);
         break;
 
     case TraceRecordType::TraceRecordByteWithExecTypeAndCounter:
@@ -149,20 +196,23 @@ void TraceRecordManager::TraceExecute(duint address, duint size)
             else
                 currentByteType = TraceRecordByteType_2bit::_InstructionBody;
 
-            char* data = (char*)pageInfo.rawPtr + offset + i;
-            if(*data == 0)
-            {
-                *data = (char)currentByteType << 6 | 1;
-            }
-            else
+            auto & counter = ((std::atomic<unsigned char>*)pageInfo.rawPtr)[offset + i];
+            unsigned char data = counter.load(std::memory_order_relaxed);
+            unsigned char newData;
+            do
             {
-                isMixed |= (*data & 0xC0) >> 6 == currentByteType;
-                *data = ((char)currentByteType << 6) | ((*data & 0x3F) == 0x3F ? 0x3F : (*data & 0x3F) + 1);
+                if(data == 0)
+                    newData = (char)currentByteType << 6 | 1;
+                else
+                    newData = ((char)currentByteType << 6) | ((data & 0x3F) == 0x3F ? 0x3F : (data & 0x3F) + 1);
             }
+            while(!counter.compare_exchange_weak(data, newData, std::memory_order_relaxed));
+            if(data != 0)
+                isMixed |= (data & 0xC0) >> 6 == currentByteType;
         }
         if(isMixed)
             for(unsigned char i = 0; i < size; i++)
-                *((char*)pageInfo.rawPtr + i + offset) |= 0xC0;
+                orCounter<unsigned char>(pageInfo.rawPtr, offset + i, 0xC0);
         break;
 
     case TraceRecordType::TraceRecordWordWithExecTypeAndCounter:
@@ -178,20 +228,23 @@ void TraceRecordManager::TraceExecute(duint address, duint size)
             else
                 currentByteType = TraceRecordByteType_2bit::_InstructionBody;
 
-            short* data = (short*)pageInfo.rawPtr + offset + i;
-            if(*data == 0)
+            auto & counter = ((std::atomic<unsigned short>*)pageInfo.rawPtr)[offset + i];
+            unsigned short data = counter.load(std::memory_order_relaxed);
+            unsigned short newData;
+            do
             {
-                *data = (char)currentByteType << 14 | 1;
-            }
-            else
-            {
-                isMixed |= (*data & 0xC0) >> 6 == currentByteType;
-                *data = ((char)currentByteType << 14) | ((*data & 0x3FFF) == 0x3FFF ? 0x3FFF : (*data & 0x3FFF) + 1);
+                if(data == 0)
+                    newData = (char)currentByteType << 14 | 1;
+                else
+                    newData = ((char)currentByteType << 14) | ((data & 0x3FFF) == 0x3FFF ? 0x3FFF : (data & 0x3FFF) + 1);
             }
+            while(!counter.compare_exchange_weak(data, newData, std::memory_order_relaxed));
+            if(data != 0)
+                isMixed |= (data & 0xC0) >> 6 == currentByteType;
         }
         if(isMixed)
             for(unsigned char i = 0; i < size; i++)
-                *((short*)pageInfo.rawPtr + i + offset) |= 0xC000;
+                orCounter<unsigned short>(pageInfo.rawPtr, offset + i, 0xC000);
         break;
 
     default:
@@ -307,6 +360,8 @@ void TraceRecordManager::TraceExecuteRecord(const Capstone & newInstruction)
         //TODO: PUSHAD/POPAD
         assert(newMemoryArrayCount < 32);
     }
+    //A full register dump starts a new page (frame), every page has to be decodable on its own
+    bool fullDump = rtNeedFullDump || ((rtRecordedInstructions - 1) % MAX_INSTRUCTIONS_TRACED_FULL_REG_DUMP == 0);
     if(rtPrevInstAvailable)
     {
         for(unsigned char i = 0; i < rtOldMemoryArrayCount; i++)
@@ -323,11 +378,11 @@ void TraceRecordManager::TraceExecuteRecord(const Capstone & newInstruction)
         {
             //rtRecordedInstructions - 1 hack: always record full registers dump at first instruction (recorded at 2nd instruction execution time)
             //prints ASCII table in run trace at first instruction :)
-            if(rtOldContext.regword[i] != newContext.regword[i] || rtOldContextChanged[i] || ((rtRecordedInstructions - 1) % MAX_INSTRUCTIONS_TRACED_FULL_REG_DUMP == 0))
+            if(rtOldContext.regword[i] != newContext.regword[i] || rtOldContextChanged[i] || fullDump)
                 changed++;
         }
         unsigned char blockFlags = 0;
-        if(newThreadId != rtOldThreadId || ((rtRecordedInstructions - 1) % MAX_INSTRUCTIONS_TRACED_FULL_REG_DUMP == 0))
+        if(newThreadId != rtOldThreadId || fullDump)
             blockFlags = 0x80;
         blockFlags |= rtOldOpcodeSize;
 
@@ -336,7 +391,7 @@ void TraceRecordManager::TraceExecuteRecord(const Capstone & newInstruction)
         WriteBufferPtr[2] = rtOldMemoryArrayCount; //1byte: memory accesses count
         WriteBufferPtr[3] = blockFlags; //1byte: flags and opcode size
         WriteBufferPtr += 4;
-        if(newThreadId != rtOldThreadId || rtNeedThreadId || ((rtRecordedInstructions - 1) % MAX_INSTRUCTIONS_TRACED_FULL_REG_DUMP == 0))
+        if(newThreadId != rtOldThreadId || rtNeedThreadId || fullDump)
         {
             memcpy(WriteBufferPtr, &rtOldThreadId, sizeof(rtOldThreadId));
             WriteBufferPtr += sizeof(rtOldThreadId);
@@ -347,7 +402,7 @@ void TraceRecordManager::TraceExecuteRecord(const Capstone & newInstruction)
         int lastChangedPosition = -1; //-1
         for(int i = 0; i < _countof(rtOldContext.regword); i++) //1byte: position
         {
-            if(rtOldContext.regword[i] != newContext.regword[i] || rtOldContextChanged[i] || ((rtRecordedInstructions - 1) % MAX_INSTRUCTIONS_TRACED_FULL_REG_DUMP == 0))
+            if(rtOldContext.regword[i] != newContext.regword[i] || rtOldContextChanged[i] || fullDump)
             {
                 WriteBufferPtr[0] = (unsigned char)(i - lastChangedPosition - 1);
                 WriteBufferPtr++;
@@ -356,7 +411,7 @@ void TraceRecordManager::TraceExecuteRecord(const Capstone & newInstruction)
         }
         for(unsigned char i = 0; i < _countof(rtOldContext.regword); i++) //ptrbyte: newvalue
         {
-            if(rtOldContext.regword[i] != newContext.regword[i] || rtOldContextChanged[i] || ((rtRecordedInstructions - 1) % MAX_INSTRUCTIONS_TRACED_FULL_REG_DUMP == 0))
+            if(rtOldContext.regword[i] != newContext.regword[i] || rtOldContextChanged[i] || fullDump)
             {
                 memcpy(WriteBufferPtr, &rtOldContext.regword[i], sizeof(duint));
                 WriteBufferPtr += sizeof(duint);
@@ -405,14 +460,14 @@ void TraceRecordManager::TraceExecuteRecord(const Capstone & newInstruction)
     {
         if(WriteBufferPtr - WriteBuffer <= sizeof(WriteBuffer))
         {
-            DWORD written;
-            WriteFile(rtFile, WriteBuffer, WriteBufferPtr - WriteBuffer, &written, NULL);
-            if(written < DWORD(WriteBufferPtr - WriteBuffer)) //Disk full?
+            //the block is written to disk asynchronously, write errors are reported by the writer thread
+            if(!rtFile.Write(WriteBuffer, WriteBufferPtr - WriteBuffer, fullDump) && rtFile.IsFailed()) //Disk full?
             {
-                CloseHandle(rtFile);
-                dprintf(QT_TRANSLATE_NOOP("DBG", "Run trace has stopped unexpectedly because WriteFile() failed. GetLastError()= %X .\r\n"), GetLastError());
+                dprintf(QT_TRANSLATE_NOOP("DBG", "Run trace has stopped unexpectedly because WriteFile() failed. GetLastError()= %X .\r\n"), rtFile.LastError());
+                rtFile.Close();
                 rtEnabled = false;
             }
+            rtNeedFullDump = false;
         }
         else
             __debugbreak(); // Buffer overrun?
@@ -437,11 +492,11 @@ unsigned int TraceRecordManager::getHitCount(duint address)
         switch(pageInfo.dataType)
         {
         case TraceRecordType::TraceRecordBitExec:
-            return ((char*)pageInfo.rawPtr)[offset / 8] & (1 << (offset % 8)) ? 1 : 0;
+            return loadCounter<unsigned char>(pageInfo.rawPtr, offset / 8) & (1 << (offset % 8)) ? 1 : 0;
         case TraceRecordType::TraceRecordByteWithExecTypeAndCounter:
-            return ((char*)pageInfo.rawPtr)[offset] & 0x3F;
+            return loadCounter<unsigned char>(pageInfo.rawPtr, offset) & 0x3F;
         case TraceRecordType::TraceRecordWordWithExecTypeAndCounter:
-            return ((short*)pageInfo.rawPtr)[offset] & 0x3FFF;
+            return loadCounter<unsigned short>(pageInfo.rawPtr, offset) & 0x3FFF;
         default:
             return 0;
         }
@@ -465,9 +520,9 @@ TraceRecordManager::TraceRecordByteType TraceRecordManager::getByteType(duint ad
         default:
             return TraceRecordByteType::InstructionHeading;
         case TraceRecordType::TraceRecordByteWithExecTypeAndCounter:
-            return (TraceRecordByteType)((((char*)pageInfo.rawPtr)[offset] & 0xC0) >> 6);
+            return (TraceRecordByteType)((loadCounter<unsigned char>(pageInfo.rawPtr, offset) & 0xC0) >> 6);
         case TraceRecordType::TraceRecordWordWithExecTypeAndCounter:
-            return (TraceRecordByteType)((((short*)pageInfo.rawPtr)[offset] & 0xC000) >> 14);
+            return (TraceRecordByteType)((loadCounter<unsigned short>(pageInfo.rawPtr, offset) & 0xC000) >> 14);
         }
     }
 }
@@ -485,59 +540,34 @@ bool TraceRecordManager::enableRunTrace(bool enabled, const char* fileName)
     {
         if(rtEnabled)
             enableRunTrace(false, NULL); //re-enable run trace
-        rtFile = CreateFileW(StringUtils::Utf8ToUtf16(fileName).c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-        if(rtFile != INVALID_HANDLE_VALUE)
+        HANDLE hFile = CreateFileW(StringUtils::Utf8ToUtf16(fileName).c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if(hFile != INVALID_HANDLE_VALUE)
         {
-            LARGE_INTEGER size;
-            if(GetFileSizeEx(rtFile, &size))
+            //JSON header, only written if the file is empty (existing files are continued in their own format)
+            json_t* root = json_object();
+            json_object_set_new(root, "ver", json_integer(TRACE_FILE_VERSION_LZ4));
+            json_object_set_new(root, "arch", json_string(ArchValue("x86", "x64")));
+            json_object_set_new(root, "hashAlgorithm", json_string("murmurhash"));
+            json_object_set_new(root, "hash", json_hex(dbgfunctionsget()->DbGetHash()));
+            json_object_set_new(root, "compression", json_string("lz4"));
+            char path[MAX_PATH];
+            ModPathFromAddr(dbgdebuggedbase(), path, MAX_PATH);
+            json_object_set_new(root, "path", json_string(path));
+            char* headerinfo;
+            headerinfo = json_dumps(root, JSON_COMPACT);
+            bool opened = rtFile.Open(hFile, headerinfo);
+            json_free(headerinfo);
+            json_decref(root);
+            if(!opened) //read-only, disk-full or unknown file format?
             {
-                if(size.QuadPart != 0)
-                {
-                    SetFilePointer(rtFile, 0, 0, FILE_END);
-                }
-                else //file is empty, write some file header
-                {
-                    //TRAC, SIZE, JSON header
-                    json_t* root = json_object();
-                    json_object_set_new(root, "ver", json_integer(1));
-                    json_object_set_new(root, "arch", json_string(ArchValue("x86", "x64")));
-                    json_object_set_new(root, "hashAlgorithm", json_string("murmurhash"));
-                    json_object_set_new(root, "hash", json_hex(dbgfunctionsget()->DbGetHash()));
-                    json_object_set_new(root, "compression", json_string(""));
-                    char path[MAX_PATH];
-                    ModPathFromAddr(dbgdebuggedbase(), path, MAX_PATH);
-                    json_object_set_new(root, "path", json_string(path));
-                    char* headerinfo;
-                    headerinfo = json_dumps(root, JSON_COMPACT);
-                    size_t headerinfosize = strlen(headerinfo);
-                    LARGE_INTEGER header;
-                    DWORD written;
-                    header.LowPart = MAKEFOURCC('T', 'R', 'A', 'C');
-                    header.HighPart = headerinfosize;
-                    WriteFile(rtFile, &header, 8, &written, nullptr);
-                    if(written < 8) //read-only?
-                    {
-                        CloseHandle(rtFile);
-                        json_free(headerinfo);
-                        json_decref(root);
-                        dputs(QT_TRANSLATE_NOOP("DBG", "Run trace failed to start because file header cannot be written."));
-                        return false;
-                    }
-                    WriteFile(rtFile, headerinfo, headerinfosize, &written, nullptr);
-                    json_free(headerinfo);
-                    json_decref(root);
-                    if(written < headerinfosize) //disk-full?
-                    {
-                        CloseHandle(rtFile);
-                        dputs(QT_TRANSLATE_NOOP("DBG", "Run trace failed to start because file header cannot be written."));
-                        return false;
-                    }
-                }
+                dputs(QT_TRANSLATE_NOOP("DBG", "Run trace failed to start because file header cannot be written."));
+                return false;
             }
             rtPrevInstAvailable = false;
             rtEnabled = true;
             rtRecordedInstructions = 0;
             rtNeedThreadId = true;
+            rtNeedFullDump = true;
             for(size_t i = 0; i < _countof(rtOldContextChanged); i++)
                 rtOldContextChanged[i] = true;
             dprintf(QT_TRANSLATE_NOOP("DBG", "Run trace started. File: %s\r\n"), fileName);
@@ -563,15 +593,28 @@ bool TraceRecordManager::enableRunTrace(bool enabled, const char* fileName)
     {
         if(rtEnabled)
         {
-            CloseHandle(rtFile);
+            rtFile.Close();
             rtPrevInstAvailable = false;
             rtEnabled = false;
             dputs(QT_TRANSLATE_NOOP("DBG", "Run trace stopped."));
+            if(rtFile.IsCompressed() && rtFile.BlocksWritten())
+                dprintf(QT_TRANSLATE_NOOP("DBG", "Run trace: %llu records, %llu bytes written.\n"), rtFile.BlocksWritten(), rtFile.BytesWritten());
+            if(rtFile.BlocksStalled() || rtFile.BlocksDropped())
+                dprintf(QT_TRANSLATE_NOOP("DBG", "Run trace: %llu blocks written, %llu stalled, %llu dropped.\n"), rtFile.BlocksWritten(), rtFile.BlocksStalled(), rtFile.BlocksDropped());
         }
         return true;
     }
 }
 
+void TraceRecordManager::flushRunTrace()
+{
+    if(rtEnabled)
+    {
+        //the open frame is written without being closed, the next record does not need a full register dump
+        rtFile.Flush();
+    }
+}
+
 void TraceRecordManager::saveToDb(JSON root)
 {
     EXCLUSIVE_ACQUIRE(LockTraceRecord);
@@ -671,12 +714,15 @@ void TraceRecordManager::loadFromDb(JSON root)
                     currentPage.moduleIndex = ~0;
                     key = currentPage.rva;
                 }
-                TraceRecord.insert(std::make_pair(key, currentPage));
+                auto inserted = TraceRecord.insert(std::make_pair(key, currentPage));
+                if(!inserted.second)
+                    efree(currentPage.rawPtr, "TraceRecordManager");
             }
             else
                 efree(currentPage.rawPtr, "TraceRecordManager");
         }
     }
+    publishTable();
 }
 
 unsigned int TraceRecordManager::getModuleIndex(const String & moduleName)
@@ -691,6 +737,195 @@ unsigned int TraceRecordManager::getModuleIndex(const String & moduleName)
     }
 }
 
+//Call with LockTraceRecord held exclusively, the buffer is freed once no published table uses it anymore
+void TraceRecordManager::retireBuffer(void* rawPtr)
+{
+    std::lock_guard<std::mutex> lock(executeReadersLock);
+    retiredBuffers.push_back(std::make_pair(generation, rawPtr));
+}
+
+//Call with LockTraceRecord held exclusively after changing TraceRecord
+void TraceRecordManager::publishTable()
+{
+    auto table = new TraceRecordTable();
+    table->generation = ++generation;
+    table->moduleNames = ModuleNames;
+    table->modulePages.resize(ModuleNames.size());
+    table->pages.reserve(TraceRecord.size());
+    for(const auto & page : TraceRecord)
+    {
+        table->pages.push_back(page.second);
+        auto entry = &table->pages.back();
+        if(entry->moduleIndex == ~0)
+        {
+            //outside of modules the key is the page address
+            table->otherPages.insert(std::make_pair(page.first, entry));
+            continue;
+        }
+        auto & pages = table->modulePages[entry->moduleIndex];
+        duint pageNumber = entry->rva / 4096;
+        if(pages.size() <= pageNumber)
+            pages.resize(pageNumber + 1);
+        pages[pageNumber] = entry;
+    }
+    executeTableDirty = false;
+    auto old = executeTable.exchange(table);
+
+    // Free the old tables once no reader can be using them anymore
+    std::lock_guard<std::mutex> lock(executeReadersLock);
+    if(old)
+        retiredTables.push_back(old);
+    if(executeReaderTls == TLS_OUT_OF_INDEXES)
+        return;
+    freeRetired();
+}
+
+//Call with executeReadersLock held
+void TraceRecordManager::freeRetired()
+{
+    for(auto itr = retiredTables.begin(); itr != retiredTables.end();)
+    {
+        auto used = std::any_of(executeReaders.begin(), executeReaders.end(), [itr](const TraceExecuteReader * reader)
+        {
+            return reader->hazard.load() == *itr;
+        });
+        if(used)
+            ++itr;
+        else
+        {
+            delete *itr;
+            itr = retiredTables.erase(itr);
+        }
+    }
+
+    //A retired buffer is still used by the tables up to the generation it was retired with
+    auto current = executeTable.load();
+    auto oldest = current ? current->generation : 0;
+    for(auto table : retiredTables)
+        oldest = min(oldest, table->generation);
+    for(auto itr = retiredBuffers.begin(); itr != retiredBuffers.end();)
+    {
+        if(itr->first < oldest)
+        {
+            efree(itr->second, "TraceRecordManager");
+            itr = retiredBuffers.erase(itr);
+        }
+        else
+            ++itr;
+    }
+}
+
+//Returns nullptr if there is no TLS slot for the reader state
+TraceRecordManager::TraceExecuteReader* TraceRecordManager::getExecuteReader()
+{
+    if(executeReaderTls == TLS_OUT_OF_INDEXES)
+        return nullptr;
+    auto reader = (TraceExecuteReader*)TlsGetValue(executeReaderTls);
+    if(!reader)
+    {
+        reader = new TraceExecuteReader();
+        reader->hazard.store(nullptr);
+        memset(&reader->cache, 0, sizeof(reader->cache));
+        TlsSetValue(executeReaderTls, reader);
+        std::lock_guard<std::mutex> lock(executeReadersLock);
+        executeReaders.push_back(reader);
+    }
+    return reader;
+}
+
+void TraceRecordManager::releaseExecuteReader()
+{
+    if(executeReaderTls == TLS_OUT_OF_INDEXES)
+        return;
+    auto reader = (TraceExecuteReader*)TlsGetValue(executeReaderTls);
+    if(!reader)
+        return;
+    TlsSetValue(executeReaderTls, nullptr);
+    reader->hazard.store(nullptr);
+    {
+        // The table this thread was pinning can be freed now
+        std::lock_guard<std::mutex> lock(executeReadersLock);
+        executeReaders.erase(std::find(executeReaders.begin(), executeReaders.end(), reader));
+        freeRetired();
+    }
+    delete reader;
+}
+
+//Returns the published table, it stays valid until the next call on the calling thread
+const TraceRecordManager::TraceRecordTable* TraceRecordManager::acquireExecuteTable(TraceExecuteReader* reader)
+{
+    //pages were added or removed since the last lookup, this is the only time the lock is needed
+    if(executeTableDirty.load())
+    {
+        EXCLUSIVE_ACQUIRE(LockTraceRecord);
+        if(executeTableDirty.load())
+            publishTable();
+    }
+    auto table = executeTable.load();
+    if(!reader)
+        return table; //without reader state the old tables are never freed
+
+    // Announce the table before using it and make sure it was not replaced in the meantime
+    while(reader->hazard.load(std::memory_order_relaxed) != table)
+    {
+        reader->hazard.store(table);
+        table = executeTable.load();
+    }
+    return table;
+}
+
+//The cache belongs to the calling thread and is only valid for the table and module list it was filled with.
+const TraceRecordManager::TraceRecordPage* TraceRecordManager::findExecutePage(const TraceRecordTable & table, TraceExecuteCache & cache, duint base)
+{
+    auto modGeneration = ModGeneration();
+    if(cache.generation == table.generation && cache.modGeneration == modGeneration)
+    {
+        if(cache.pageBase == base)
+            return cache.page;
+    }
+    else
+    {
+        //pages or modules changed, the cached pointers might be stale
+        cache.generation = table.generation;
+        cache.modGeneration = modGeneration;
+        cache.moduleBase = 0;
+        cache.moduleSize = 0;
+    }
+    if(base - cache.moduleBase >= cache.moduleSize)
+    {
+        char modName[MAX_MODULE_SIZE];
+        cache.moduleBase = ModBaseFromAddr(base);
+        if(cache.moduleBase && ModNameFromAddr(base, modName, true))
+        {
+            cache.moduleSize = ModSizeFromAddr(base);
+            auto found = std::find(table.moduleNames.begin(), table.moduleNames.end(), modName);
+            cache.moduleIndex = found != table.moduleNames.end() ? (unsigned int)(found - table.moduleNames.begin()) : ~0;
+        }
+        else
+        {
+            cache.moduleBase = 0;
+            cache.moduleSize = 0;
+            cache.moduleIndex = ~0;
+        }
+    }
+    const TraceRecordPage* page = nullptr;
+    if(cache.moduleSize)
+    {
+        duint pageNumber = (base - cache.moduleBase) / 4096;
+        if(cache.moduleIndex < table.modulePages.size() && pageNumber < table.modulePages[cache.moduleIndex].size())
+            page = table.modulePages[cache.moduleIndex][pageNumber];
+    }
+    else
+    {
+        auto found = table.otherPages.find(base);
+        if(found != table.otherPages.end())
+            page = found->second;
+    }
+    cache.pageBase = base;
+    cache.page = page;
+    return page;
+}
+
 bool TraceRecordManager::isRunTraceEnabled()
 {
     return rtEnabled;
@@ -698,7 +933,7 @@ bool TraceRecordManager::isRunTraceEnabled()
 
 void _dbg_dbgtraceexecute(duint CIP)
 {
-    if(TraceRecord.getTraceRecordType(CIP) != TraceRecordManager::TraceRecordType::TraceRecordNone)
+    if(TraceRecord.getExecuteRecordType(CIP) != TraceRecordManager::TraceRecordType::TraceRecordNone)
     {
         Capstone instruction;
         unsigned char data[MAX_DISASM_BUFFER];
@@ -761,4 +996,17 @@ bool _dbg_dbgenableRunTrace(bool enabled, const char* fileName)
 bool _dbg_dbgisRunTraceEnabled()
 {
     return TraceRecord.isRunTraceEnabled();
-}
\ No newline at end of file
+}
+
+void TraceRecordThreadDetach()
+{
+    TraceRecord.releaseExecuteReader();
+}
+
+void TraceRecordProcessDetach()
+{
+    if(executeReaderTls == TLS_OUT_OF_INDEXES)
+        return;
+    TlsFree(executeReaderTls);
+    executeReaderTls = TLS_OUT_OF_INDEXES;
+}
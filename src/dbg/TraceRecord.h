@@ -4,6 +4,9 @@
 #include "_dbgfunctions.h"
 #include "debugger.h"
 #include "jansson/jansson_x64dbg.h"
+#include "TraceFileWriter.h"
+#include <atomic>
+#include <mutex>
 
 class Capstone;
 
@@ -53,6 +56,7 @@ public:
     bool setTraceRecordType(duint pageAddress, TraceRecordType type);
     TraceRecordType getTraceRecordType(duint pageAddress);
 
+    TraceRecordType getExecuteRecordType(duint address); //getTraceRecordType for the debug loop thread, uses the TraceExecute lookup cache
     void TraceExecute(duint address, duint size);
     //void TraceAccess(duint address, unsigned char size, TraceRecordByteType accessType);
     void TraceExecuteRecord(const Capstone & newInstruction);
@@ -63,6 +67,7 @@ public:
 
     bool isRunTraceEnabled();
     bool enableRunTrace(bool enabled, const char* fileName);
+    void flushRunTrace();
 
     void saveToDb(JSON root);
     void loadFromDb(JSON root);
@@ -77,12 +82,42 @@ private:
 
     struct TraceRecordPage
     {
-        void* rawPtr;
+        void* rawPtr; //counters are accessed with relaxed atomics, TraceExecute updates them with compare-exchange
         duint rva;
         TraceRecordType dataType;
         unsigned int moduleIndex;
     };
 
+    //Immutable copy of the pages for TraceExecute, published again by the first lookup after pages were added or removed
+    struct TraceRecordTable
+    {
+        unsigned int generation;
+        std::vector<TraceRecordPage> pages;
+        std::vector<std::string> moduleNames;
+        //Page table for module pages: [module index][rva / 4096] := entry in pages (nullptr if the page is not recorded)
+        std::vector<std::vector<const TraceRecordPage*>> modulePages;
+        std::unordered_map<duint, const TraceRecordPage*> otherPages; //pages outside of modules by address
+    };
+
+    //Last page and module seen by findExecutePage, one per thread
+    struct TraceExecuteCache
+    {
+        unsigned int generation;
+        unsigned int modGeneration;
+        duint pageBase;
+        const TraceRecordPage* page;
+        duint moduleBase;
+        duint moduleSize; //0 when pageBase is not in a module
+        unsigned int moduleIndex;
+    };
+
+    //Per-thread reader state. The table a reader points to is not freed until the reader moves on to a newer one.
+    struct TraceExecuteReader
+    {
+        std::atomic<const TraceRecordTable*> hazard;
+        TraceExecuteCache cache;
+    };
+
     typedef union _REGDUMPWORD
     {
         REGDUMP registers;
@@ -94,17 +129,35 @@ private:
     //Key := page base, value := trace record raw data
     std::unordered_map<duint, TraceRecordPage> TraceRecord;
     std::vector<std::string> ModuleNames;
+    unsigned int generation; //generation of the last published table
+    std::atomic<const TraceRecordTable*> executeTable;
+    std::atomic<bool> executeTableDirty; //TraceRecord changed since executeTable was published
+    std::mutex executeReadersLock; //guards executeReaders, retiredTables and retiredBuffers
+    std::vector<TraceExecuteReader*> executeReaders;
+    std::vector<const TraceRecordTable*> retiredTables;
+    //Buffers of removed pages with the generation of the last table using them
+    std::vector<std::pair<unsigned int, void*>> retiredBuffers;
     unsigned int getModuleIndex(const String & moduleName);
+    void retireBuffer(void* rawPtr);
+    void publishTable();
+    void freeRetired();
+    TraceExecuteReader* getExecuteReader();
+    void releaseExecuteReader();
+    friend void TraceRecordThreadDetach();
+    const TraceRecordTable* acquireExecuteTable(TraceExecuteReader* reader);
+    const TraceRecordPage* findExecutePage(const TraceRecordTable & table, TraceExecuteCache & cache, duint base);
+    void traceExecutePage(const TraceRecordPage & pageInfo, duint offset, duint size);
     unsigned int instructionCounter;
 
     bool rtEnabled;
     bool rtPrevInstAvailable;
-    HANDLE rtFile;
+    TraceFileWriter rtFile;
 
     REGDUMPWORD rtOldContext;
     bool rtOldContextChanged[(sizeof(REGDUMP) - 128) / sizeof(duint)];
     DWORD rtOldThreadId;
     bool rtNeedThreadId;
+    bool rtNeedFullDump;
     duint rtOldMemory[32];
     duint rtOldMemoryAddress[32];
     char rtOldOpcode[16];
@@ -114,6 +167,8 @@ private:
 };
 
 extern TraceRecordManager TraceRecord;
+void TraceRecordThreadDetach(); //releases the execute cache of the calling thread
+void TraceRecordProcessDetach();
 void _dbg_dbgtraceexecute(duint CIP);
 
 //exported to bridge
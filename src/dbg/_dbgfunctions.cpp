@@ -441,4 +441,6 @@ void dbgfunctionsinit()
     _dbgfunctions.ModRelocationAtAddr = (MODRELOCATIONATADDR)ModRelocationAtAddr;
     _dbgfunctions.ModRelocationsInRange = _modrelocationsinrange;
     _dbgfunctions.DbGetHash = DbGetHash;
+    _dbgfunctions.SymAutoComplete = SymAutoComplete;
+    _dbgfunctions.SymSearch = SymSearch;
 }
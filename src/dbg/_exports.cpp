@@ -35,6 +35,7 @@
 #include "TraceRecord.h"
 #include "recursiveanalysis.h"
 #include "dbghelp_safe.h"
+#include "contextsnapshot.h"
 
 static bool bOnlyCipAutoComments = false;
 static bool bNoSourceLineAutoComments = false;
@@ -634,7 +635,7 @@ extern "C" DLL_EXPORT bool _dbg_getregdump(REGDUMP* regdump)
         return true;
     }
 
-    if(!GetFullContextDataEx(hActiveThread, &titcontext))
+    if(!ContextSnapshotGet(titcontext))
         return false;
     TranslateTitanContextToRegContext(&titcontext, &regdump->regcontext);
 
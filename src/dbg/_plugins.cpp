@@ -35,20 +35,22 @@ PLUG_IMPEXP bool _plugin_unregistercommand(int pluginHandle, const char* command
 PLUG_IMPEXP void _plugin_logprintf(const char* format, ...)
 {
     va_list args;
+    char buffer[16384];
 
     va_start(args, format);
-    dprintf_args_untranslated(format, args);
+    vsnprintf_s(buffer, _TRUNCATE, format, args);
     va_end(args);
+    dlog(LogSourcePlugin, buffer);
 }
 
 PLUG_IMPEXP void _plugin_logputs(const char* text)
 {
-    dputs_untranslated(text);
+    dlog(LogSourcePlugin, text, true);
 }
 
 PLUG_IMPEXP void _plugin_logprint(const char* text)
 {
-    dprintf_untranslated("%s", text);
+    dlog(LogSourcePlugin, text);
 }
 
 PLUG_IMPEXP void _plugin_debugpause()
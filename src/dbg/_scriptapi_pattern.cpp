@@ -16,6 +16,27 @@ SCRIPT_EXPORT duint Script::Pattern::FindMem(duint start, duint size, const char
     return found == -1 ? 0 : found + start;
 }
 
+SCRIPT_EXPORT bool Script::Pattern::FindMemMulti(duint start, duint size, const char** patterns, duint count, ListOf(MultiHit) hits, duint maxhits)
+{
+    std::vector<std::vector<PatternByte>> searchpatterns(count);
+    for(duint i = 0; i < count; i++)
+        if(!patterntransform(patterns[i], searchpatterns[i]))
+            return false;
+    PatternSet patternset;
+    if(!patternsetcompile(searchpatterns, patternset))
+        return false;
+    Memory<unsigned char*> data(size, "Script::Pattern::FindMemMulti::data");
+    if(!MemRead(start, data(), size))
+        return false;
+    std::vector<PatternSetHit> found;
+    patternsetfind(data(), data.size(), patternset, found, maxhits);
+    std::vector<MultiHit> multiHits;
+    multiHits.reserve(found.size());
+    for(const auto & hit : found)
+        multiHits.push_back({ hit.id, start + hit.offset });
+    return BridgeList<MultiHit>::CopyData(hits, multiHits);
+}
+
 SCRIPT_EXPORT void Script::Pattern::Write(unsigned char* data, duint datasize, const char* pattern)
 {
     patternwrite(data, datasize, pattern);
@@ -7,8 +7,15 @@ namespace Script
 {
     namespace Pattern
     {
+        struct MultiHit
+        {
+            duint index; //index of the pattern
+            duint addr;
+        };
+
         SCRIPT_EXPORT duint Find(unsigned char* data, duint datasize, const char* pattern);
         SCRIPT_EXPORT duint FindMem(duint start, duint size, const char* pattern);
+        SCRIPT_EXPORT bool FindMemMulti(duint start, duint size, const char** patterns, duint count, ListOf(MultiHit) hits, duint maxhits = -1); //caller has the responsibility to free the list
         SCRIPT_EXPORT void Write(unsigned char* data, duint datasize, const char* pattern);
         SCRIPT_EXPORT void WriteMem(duint start, duint size, const char* pattern);
         SCRIPT_EXPORT bool SearchAndReplace(unsigned char* data, duint datasize, const char* searchpattern, const char* replacepattern);
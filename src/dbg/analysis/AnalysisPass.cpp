@@ -1,5 +1,4 @@
 #include <assert.h>
-#include <thread>
 #include "AnalysisPass.h"
 #include "memory.h"
 
@@ -10,7 +9,6 @@ AnalysisPass::AnalysisPass(duint VirtualStart, duint VirtualEnd, BBlockArray & M
     // Internal class data
     m_VirtualStart = VirtualStart;
     m_VirtualEnd = VirtualEnd;
-    m_InternalMaxThreads = 0;
 
     // Read remote instruction data to local memory
     m_DataSize = VirtualEnd - VirtualStart;
@@ -23,6 +21,22 @@ AnalysisPass::AnalysisPass(duint VirtualStart, duint VirtualEnd, BBlockArray & M
     }
 }
 
+AnalysisPass::AnalysisPass(duint VirtualStart, duint VirtualEnd, const unsigned char* Data, BBlockArray & MainBlocks) : m_MainBlocks(MainBlocks)
+{
+    assert(VirtualEnd > VirtualStart);
+
+    // Internal class data
+    m_VirtualStart = VirtualStart;
+    m_VirtualEnd = VirtualEnd;
+
+    // Copy the instruction data to local memory
+    m_DataSize = VirtualEnd - VirtualStart;
+    m_Data = (unsigned char*)VirtualAlloc(nullptr, m_DataSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+    if(m_Data)
+        memcpy(m_Data, Data, m_DataSize);
+}
+
 AnalysisPass::~AnalysisPass()
 {
     if(m_Data)
@@ -70,26 +84,4 @@ duint AnalysisPass::FindBBlockIndex(BasicBlock* Block)
 {
     // Fast pointer arithmetic to find index
     return ((duint)Block - (duint)m_MainBlocks.data()) / sizeof(BasicBlock);
-}
-
-duint AnalysisPass::IdealThreadCount()
-{
-    if(m_InternalMaxThreads == 0)
-    {
-        // Determine the maximum hardware thread count at once
-        duint maximumThreads = max(std::thread::hardware_concurrency(), 1);
-
-        // Don't consume 100% of the CPU, adjust accordingly
-        if(maximumThreads > 1)
-            maximumThreads -= 1;
-
-        SetIdealThreadCount(maximumThreads);
-    }
-
-    return m_InternalMaxThreads;
-}
-
-void AnalysisPass::SetIdealThreadCount(duint Count)
-{
-    m_InternalMaxThreads = (BYTE)min(Count, 255);
 }
\ No newline at end of file
@@ -7,6 +7,7 @@ class AnalysisPass
 {
 public:
     AnalysisPass(duint VirtualStart, duint VirtualEnd, BBlockArray & MainBlocks);
+    AnalysisPass(duint VirtualStart, duint VirtualEnd, const unsigned char* Data, BBlockArray & MainBlocks); // Analyze a local copy of Data instead of the debuggee memory
     virtual ~AnalysisPass();
 
     virtual const char* GetName() = 0;
@@ -33,9 +34,4 @@ protected:
 
     BasicBlock* FindBBlockInRange(duint Address);
     duint FindBBlockIndex(BasicBlock* Block);
-    duint IdealThreadCount();
-    void SetIdealThreadCount(duint Count);
-
-private:
-    BYTE m_InternalMaxThreads;
 };
\ No newline at end of file
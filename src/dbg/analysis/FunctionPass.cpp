@@ -1,11 +1,14 @@
 #include "FunctionPass.h"
-#include <ppl.h>
+#include "taskpool.h"
 #include "memory.h"
 #include "console.h"
 #include "debugger.h"
 #include "module.h"
 #include "function.h"
 
+// Basic blocks analyzed per task
+static const duint FunctionChunkSize = 0x1000;
+
 FunctionPass::FunctionPass(duint VirtualStart, duint VirtualEnd, BBlockArray & MainBlocks)
     : AnalysisPass(VirtualStart, VirtualEnd, MainBlocks)
 {
@@ -69,30 +72,27 @@ const char* FunctionPass::GetName()
 
 bool FunctionPass::Analyse()
 {
-    // THREAD_WORK = ceil(TOTAL / # THREADS)
-    duint workAmount = (m_MainBlocks.size() + (IdealThreadCount() - 1)) / IdealThreadCount();
+    // CHUNK_WORK = FunctionChunkSize blocks
+    duint workTotal = m_MainBlocks.size();
+    duint chunkCount = (workTotal + FunctionChunkSize - 1) / FunctionChunkSize;
 
-    // Initialize thread vector
-    auto threadFunctions = new std::vector<FunctionDef>[IdealThreadCount()];
+    // Initialize chunk vectors
+    std::vector<std::vector<FunctionDef>> chunkFunctions(chunkCount);
 
-    concurrency::parallel_for(duint(0), IdealThreadCount(), [&](duint i)
+    TaskParallelFor(0, chunkCount, [&](size_t i)
     {
-        // Memory allocation optimization
-        // TODO: Option to conserve memory
-        threadFunctions[i].reserve(30000);
-
         // Execute
-        duint threadWorkStart = (workAmount * i);
-        duint threadWorkStop = min((threadWorkStart + workAmount), m_MainBlocks.size());
+        duint chunkStart = FunctionChunkSize * i;
+        duint chunkStop = min((chunkStart + FunctionChunkSize), workTotal);
 
-        AnalysisWorker(threadWorkStart, threadWorkStop, &threadFunctions[i]);
+        AnalysisWorker(chunkStart, chunkStop, &chunkFunctions[i]);
     });
 
-    // Merge thread vectors into single local
+    // Merge chunk vectors into single local
     std::vector<FunctionDef> funcs;
 
-    for(duint i = 0; i < IdealThreadCount(); i++)
-        std::move(threadFunctions[i].begin(), threadFunctions[i].end(), std::back_inserter(funcs));
+    for(auto & functions : chunkFunctions)
+        std::move(functions.begin(), functions.end(), std::back_inserter(funcs));
 
     // Sort and remove duplicates
     std::sort(funcs.begin(), funcs.end());
@@ -106,8 +106,6 @@ bool FunctionPass::Analyse()
         FunctionAdd(func.VirtualStart, func.VirtualEnd, false, func.InstrCount);
     }
     GuiUpdateAllViews();
-
-    delete[] threadFunctions;
     return true;
 }
 
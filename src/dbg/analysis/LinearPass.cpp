@@ -1,18 +1,22 @@
-#include <thread>
-#include <ppl.h>
 #include "AnalysisPass.h"
 #include "LinearPass.h"
+#include "taskpool.h"
 #include <zydis_wrapper.h>
 
+// Bytes of code scanned per task, small enough for the pool to balance sparse and dense code
+static const duint LinearChunkSize = 0x10000;
+
+// Basic blocks checked for overlaps per task
+static const duint LinearOverlapChunkSize = 0x1000;
+
 LinearPass::LinearPass(duint VirtualStart, duint VirtualEnd, BBlockArray & MainBlocks)
     : AnalysisPass(VirtualStart, VirtualEnd, MainBlocks)
 {
-    // This is a fix for when the total data analysis size is less
-    // than what parallelization can support. The minimum size requirement
-    // is ((# THREADS) * (512)) bytes. If the requirement isn't met,
-    // scale to use a single thread.
-    if((512 * IdealThreadCount()) >= m_DataSize)
-        SetIdealThreadCount(1);
+}
+
+LinearPass::LinearPass(duint VirtualStart, duint VirtualEnd, const unsigned char* Data, BBlockArray & MainBlocks)
+    : AnalysisPass(VirtualStart, VirtualEnd, Data, MainBlocks)
+{
 }
 
 LinearPass::~LinearPass()
@@ -26,48 +30,43 @@ const char* LinearPass::GetName()
 
 bool LinearPass::Analyse()
 {
-    // Divide the work up between each thread
-    // THREAD_WORK = (TOTAL / # THREADS)
-    duint workAmount = m_DataSize / IdealThreadCount();
+    // Divide the work up in fixed chunks, idle threads steal the remaining ones
+    duint chunkCount = (m_DataSize + LinearChunkSize - 1) / LinearChunkSize;
+    std::vector<BBlockArray> chunkBlocks(chunkCount);
 
-    // Initialize thread vector
-    auto threadBlocks = new std::vector<BasicBlock>[IdealThreadCount()];
-
-    concurrency::parallel_for(duint(0), IdealThreadCount(), [&](duint i)
+    TaskParallelFor(0, chunkCount, [&](size_t i)
     {
-        duint threadWorkStart = m_VirtualStart + (workAmount * i);
-        duint threadWorkStop = min((threadWorkStart + workAmount), m_VirtualEnd);
+        duint chunkStart = m_VirtualStart + LinearChunkSize * i;
+        duint chunkStop = min((chunkStart + LinearChunkSize), m_VirtualEnd);
 
         // Allow a 256-byte variance of scanning because of
-        // integer rounding errors and instruction overlap
-        if(threadWorkStart > m_VirtualStart)
+        // instruction overlap at the chunk boundaries
+        if(chunkStart > m_VirtualStart)
         {
-            threadWorkStart = max((threadWorkStart - 256), m_VirtualStart);
-            threadWorkStop = min((threadWorkStop + 256), m_VirtualEnd);
+            chunkStart = max((chunkStart - 256), m_VirtualStart);
+            chunkStop = min((chunkStop + 256), m_VirtualEnd);
         }
 
-        // Memory allocation optimization
-        // TODO: Option to conserve memory
-        threadBlocks[i].reserve(100000);
-
         // Execute
-        AnalysisWorker(threadWorkStart, threadWorkStop, &threadBlocks[i]);
+        AnalysisWorker(chunkStart, chunkStop, &chunkBlocks[i]);
     });
 
     // Clear old data and combine vectors
     m_MainBlocks.clear();
 
-    for(duint i = 0; i < IdealThreadCount(); i++)
+    duint blockCount = 0;
+    for(const auto & blocks : chunkBlocks)
+        blockCount += blocks.size();
+    m_MainBlocks.reserve(blockCount);
+
+    for(auto & blocks : chunkBlocks)
     {
-        std::move(threadBlocks[i].begin(), threadBlocks[i].end(), std::back_inserter(m_MainBlocks));
+        std::move(blocks.begin(), blocks.end(), std::back_inserter(m_MainBlocks));
 
         // Free old elements to conserve memory further
-        BBlockArray().swap(threadBlocks[i]);
+        BBlockArray().swap(blocks);
     }
 
-    // Free memory ASAP
-    delete[] threadBlocks;
-
     // Sort and remove duplicates
     std::sort(m_MainBlocks.begin(), m_MainBlocks.end());
     m_MainBlocks.erase(std::unique(m_MainBlocks.begin(), m_MainBlocks.end()), m_MainBlocks.end());
@@ -88,40 +87,38 @@ void LinearPass::AnalyseOverlaps()
     // This also checks for basic block targets jumping into
     // the middle of other basic blocks.
     //
-    // THREAD_WORK = ceil(TOTAL / # THREADS)
+    // CHUNK_WORK = LinearOverlapChunkSize blocks
     duint workTotal = m_MainBlocks.size();
-    duint workAmount = (workTotal + (IdealThreadCount() - 1)) / IdealThreadCount();
+    duint chunkCount = (workTotal + LinearOverlapChunkSize - 1) / LinearOverlapChunkSize;
 
-    // Initialize thread vectors
-    auto threadInserts = new std::vector<BasicBlock>[IdealThreadCount()];
+    // Initialize chunk vectors
+    std::vector<BBlockArray> chunkInserts(chunkCount);
 
-    concurrency::parallel_for(duint(0), IdealThreadCount(), [&](duint i)
+    TaskParallelFor(0, chunkCount, [&](size_t i)
     {
-        duint threadWorkStart = (workAmount * i);
-        duint threadWorkStop = min((threadWorkStart + workAmount), workTotal);
+        duint chunkStart = LinearOverlapChunkSize * i;
+        duint chunkStop = min((chunkStart + LinearOverlapChunkSize), workTotal);
 
         // Again, allow an overlap of +/- 1 entry
-        if(threadWorkStart > 0)
+        if(chunkStart > 0)
         {
-            threadWorkStart = max((threadWorkStart - 1), 0);
-            threadWorkStop = min((threadWorkStop + 1), workTotal);
+            chunkStart = chunkStart - 1;
+            chunkStop = min((chunkStop + 1), workTotal);
         }
 
         // Execute
-        AnalysisOverlapWorker(threadWorkStart, threadWorkStop, &threadInserts[i]);
+        AnalysisOverlapWorker(chunkStart, chunkStop, &chunkInserts[i]);
     });
 
-    // THREAD VECTOR
+    // CHUNK VECTORS
     std::vector<BasicBlock> overlapInserts;
     {
-        for(duint i = 0; i < IdealThreadCount(); i++)
-            std::move(threadInserts[i].begin(), threadInserts[i].end(), std::back_inserter(overlapInserts));
+        for(auto & inserts : chunkInserts)
+            std::move(inserts.begin(), inserts.end(), std::back_inserter(overlapInserts));
 
         // Sort and remove duplicates
         std::sort(overlapInserts.begin(), overlapInserts.end());
         overlapInserts.erase(std::unique(overlapInserts.begin(), overlapInserts.end()), overlapInserts.end());
-
-        delete[] threadInserts;
     }
 
     // GLOBAL VECTOR
@@ -7,6 +7,7 @@ class LinearPass : public AnalysisPass
 {
 public:
     LinearPass(duint VirtualStart, duint VirtualEnd, BBlockArray & MainBlocks);
+    LinearPass(duint VirtualStart, duint VirtualEnd, const unsigned char* Data, BBlockArray & MainBlocks);
     virtual ~LinearPass();
 
     virtual const char* GetName() override;
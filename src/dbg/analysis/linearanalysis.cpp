@@ -2,6 +2,7 @@
 #include "console.h"
 #include "memory.h"
 #include "function.h"
+#include "disasm_index.h"
 #include <algorithm>
 
 LinearAnalysis::LinearAnalysis(duint base, duint size) : Analysis(base, size)
@@ -42,19 +43,13 @@ void LinearAnalysis::sortCleanup()
 void LinearAnalysis::populateReferences()
 {
     //linear immediate reference scan (call <addr>, push <addr>, mov [somewhere], <addr>)
-    for(duint i = 0; i < mSize;)
+    auto index = DisasmIndexGet(mBase, mSize, mData);
+    index->ForEach([this](duint addr, ZydisMnemonic, const BASIC_INSTRUCTION_INFO & basicinfo)
     {
-        auto addr = mBase + i;
-        if(mCp.Disassemble(addr, translateAddr(addr), MAX_DISASM_BUFFER))
-        {
-            auto ref = getReferenceOperand();
-            if(ref)
-                mFunctions.push_back({ ref, 0 });
-            i += mCp.Size();
-        }
-        else
-            i++;
-    }
+        auto ref = getReferenceOperand(basicinfo);
+        if(ref)
+            mFunctions.push_back({ ref, 0 });
+    });
     sortCleanup();
 }
 
@@ -132,19 +127,15 @@ duint LinearAnalysis::findFunctionEnd(duint start, duint maxaddr)
     return end < jumpback ? jumpback : end;
 }
 
-duint LinearAnalysis::getReferenceOperand() const
+duint LinearAnalysis::getReferenceOperand(const BASIC_INSTRUCTION_INFO & basicinfo) const
 {
-    for(auto i = 0; i < mCp.OpCount(); i++)
+    if(basicinfo.branch && !basicinfo.call) //skip jumps/loops
+        return 0;
+    if(basicinfo.type & (TYPE_VALUE | TYPE_ADDR)) //we are looking for immediate references
     {
-        const auto & op = mCp[i];
-        if(mCp.IsJump() || mCp.IsLoop()) //skip jumps/loops
-            continue;
-        if(op.type == ZYDIS_OPERAND_TYPE_IMMEDIATE) //we are looking for immediate references
-        {
-            auto dest = duint(op.imm.value.u);
-            if(inRange(dest))
-                return dest;
-        }
+        auto dest = basicinfo.value.value;
+        if(inRange(dest))
+            return dest;
     }
     return 0;
 }
\ No newline at end of file
@@ -34,7 +34,7 @@ private:
     void populateReferences();
     void analyseFunctions();
     duint findFunctionEnd(duint start, duint maxaddr);
-    duint getReferenceOperand() const;
+    duint getReferenceOperand(const BASIC_INSTRUCTION_INFO & basicinfo) const;
 };
 
 #endif //_LINEARANALYSIS_H
\ No newline at end of file
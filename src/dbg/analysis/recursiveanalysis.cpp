@@ -1,11 +1,21 @@
 #include "recursiveanalysis.h"
 #include <queue>
+#include <atomic>
+#include <algorithm>
+#include "taskpool.h"
 #include "console.h"
 #include "filehelper.h"
 #include "function.h"
 #include "xrefs.h"
 #include "plugin_loader.h"
 
+struct RecursiveAnalysis::Worker
+{
+    Zydis cp;
+    std::vector<bool> visited; //block starts visited in the current function (one bit per byte of the range)
+    std::vector<duint> touched; //bits to clear before the next function
+};
+
 RecursiveAnalysis::RecursiveAnalysis(duint base, duint size, duint entryPoint, duint maxDepth, bool usePlugins, bool dump)
     : Analysis(base, size),
       mEntryPoint(entryPoint),
@@ -17,8 +27,19 @@ RecursiveAnalysis::RecursiveAnalysis(duint base, duint size, duint entryPoint, d
 
 void RecursiveAnalysis::Analyse()
 {
-    //TODO: implement queue to analyze multiple functions
-    analyzeFunction(mEntryPoint);
+    analyzeQueue({ mEntryPoint }, mMaxDepth);
+}
+
+void RecursiveAnalysis::AnalyseModule()
+{
+    auto ticks = GetTickCount();
+    std::vector<duint> seeds;
+    if(mEntryPoint)
+        seeds.push_back(mEntryPoint);
+    getModuleSeeds(seeds);
+    std::sort(seeds.begin(), seeds.end());
+    analyzeQueue(std::move(seeds), duint(-1));
+    dprintf(QT_TRANSLATE_NOOP("DBG", "%u function(s) analyzed in %ums\n"), DWORD(mFunctions.size()), GetTickCount() - DWORD(ticks));
 }
 
 void RecursiveAnalysis::SetMarkers()
@@ -57,20 +78,174 @@ void RecursiveAnalysis::SetMarkers()
     GuiUpdateAllViews();
 }
 
-void RecursiveAnalysis::analyzeFunction(duint entryPoint)
+void RecursiveAnalysis::analyzeQueue(std::vector<duint> queue, duint maxDepth)
+{
+    //one bit per byte of the range, set by whichever worker first queues a function there
+    std::vector<std::atomic<unsigned int>> queued((mSize + 31) / 32);
+    auto markQueued = [&](duint addr)
+    {
+        if(!inRange(addr))
+            return true;
+        auto offset = addr - mBase;
+        auto mask = 1u << (offset % 32);
+        return (queued[offset / 32].fetch_or(mask) & mask) == 0;
+    };
+    queue.erase(std::remove_if(queue.begin(), queue.end(), [&](duint addr)
+    {
+        return !markQueued(addr);
+    }), queue.end());
+
+    //breadth-first over the call graph: every function of a level is analyzed in parallel
+    TaskLocal<Worker> workers;
+    for(duint depth = 0; !queue.empty(); depth++)
+    {
+        std::vector<FunctionInfo> functions;
+        functions.reserve(queue.size());
+        for(auto entryPoint : queue)
+            functions.emplace_back(entryPoint);
+        auto followCalls = depth < maxDepth;
+        TaskParallelFor(0, functions.size(), [&](size_t i)
+        {
+            auto & function = functions[i];
+            analyzeFunction(workers.Local(), function);
+            //only keep the calls this function is the first to discover
+            auto & calls = function.calls;
+            if(!followCalls)
+                calls.clear();
+            calls.erase(std::remove_if(calls.begin(), calls.end(), [&](duint addr)
+            {
+                return !markQueued(addr);
+            }), calls.end());
+        });
+
+        //merge in queue order so the results do not depend on the scheduling
+        queue.clear();
+        for(auto & function : functions)
+        {
+            //allow plugins to manipulate the graph (plugins are not called concurrently)
+            if(mUsePlugins && !plugincbempty(CB_ANALYZE))
+            {
+                PLUG_CB_ANALYZE info;
+                info.graph = function.graph.ToGraphList();
+                plugincbcall(CB_ANALYZE, &info);
+                function.graph = BridgeCFGraph(&info.graph, true);
+            }
+            mXrefs.insert(mXrefs.end(), function.xrefs.begin(), function.xrefs.end());
+            queue.insert(queue.end(), function.calls.begin(), function.calls.end());
+            mFunctions.push_back(std::move(function.graph));
+        }
+        std::sort(queue.begin(), queue.end());
+    }
+}
+
+void RecursiveAnalysis::getModuleSeeds(std::vector<duint> & seeds) const
+{
+    //the range is expected to be a mapped image, everything is read from the in-memory headers
+    if(mSize < sizeof(IMAGE_DOS_HEADER))
+        return;
+    auto dosHeader = (const IMAGE_DOS_HEADER*)translateAddr(mBase);
+    if(dosHeader->e_magic != IMAGE_DOS_SIGNATURE || dosHeader->e_lfanew < 0 || duint(dosHeader->e_lfanew) + sizeof(IMAGE_NT_HEADERS) > mSize)
+        return;
+    auto ntHeaders = (const IMAGE_NT_HEADERS*)translateAddr(mBase + dosHeader->e_lfanew);
+    if(ntHeaders->Signature != IMAGE_NT_SIGNATURE || ntHeaders->OptionalHeader.Magic != IMAGE_NT_OPTIONAL_HDR_MAGIC)
+        return;
+    const auto & optionalHeader = ntHeaders->OptionalHeader;
+
+    //only seed addresses in executable sections (exports can be data)
+    auto sectionOffset = duint(dosHeader->e_lfanew) + FIELD_OFFSET(IMAGE_NT_HEADERS, OptionalHeader) + ntHeaders->FileHeader.SizeOfOptionalHeader;
+    auto sectionCount = ntHeaders->FileHeader.NumberOfSections;
+    if(sectionOffset + sectionCount * sizeof(IMAGE_SECTION_HEADER) > mSize)
+        return;
+    auto sections = (const IMAGE_SECTION_HEADER*)translateAddr(mBase + sectionOffset);
+    auto addSeed = [&](DWORD rva)
+    {
+        if(!rva || rva >= mSize)
+            return;
+        for(WORD i = 0; i < sectionCount; i++)
+        {
+            const auto & section = sections[i];
+            if(rva >= section.VirtualAddress && rva < section.VirtualAddress + max(section.Misc.VirtualSize, section.SizeOfRawData))
+            {
+                if(section.Characteristics & IMAGE_SCN_MEM_EXECUTE)
+                    seeds.push_back(mBase + rva);
+                return;
+            }
+        }
+    };
+    auto getDirectory = [&](DWORD index, DWORD & size) -> const unsigned char*
+    {
+        if(index >= optionalHeader.NumberOfRvaAndSizes)
+            return nullptr;
+        const auto & directory = optionalHeader.DataDirectory[index];
+        if(!directory.VirtualAddress || !directory.Size || directory.VirtualAddress >= mSize || directory.Size > mSize - directory.VirtualAddress)
+            return nullptr;
+        size = directory.Size;
+        return translateAddr(mBase + directory.VirtualAddress);
+    };
+
+    //entry point
+    addSeed(optionalHeader.AddressOfEntryPoint);
+
+    //exports
+    DWORD exportSize = 0;
+    auto exportDirectory = (const IMAGE_EXPORT_DIRECTORY*)getDirectory(IMAGE_DIRECTORY_ENTRY_EXPORT, exportSize);
+    if(exportDirectory && exportSize >= sizeof(IMAGE_EXPORT_DIRECTORY))
+    {
+        auto exportStart = optionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress;
+        auto functionsRva = exportDirectory->AddressOfFunctions;
+        auto functionCount = exportDirectory->NumberOfFunctions;
+        if(functionsRva < mSize && functionCount <= (mSize - functionsRva) / sizeof(DWORD))
+        {
+            auto functions = (const DWORD*)translateAddr(mBase + functionsRva);
+            for(DWORD i = 0; i < functionCount; i++)
+            {
+                if(functions[i] >= exportStart && functions[i] < exportStart + exportSize) //forwarded export
+                    continue;
+                addSeed(functions[i]);
+            }
+        }
+    }
+
+#ifdef _WIN64
+    //exception directory
+    DWORD exceptionSize = 0;
+    auto functionTable = (const RUNTIME_FUNCTION*)getDirectory(IMAGE_DIRECTORY_ENTRY_EXCEPTION, exceptionSize);
+    if(functionTable)
+    {
+        for(DWORD i = 0; i < exceptionSize / sizeof(RUNTIME_FUNCTION); i++)
+            addSeed(functionTable[i].BeginAddress);
+    }
+#endif //_WIN64
+}
+
+void RecursiveAnalysis::analyzeFunction(Worker & worker, FunctionInfo & info) const
 {
+    auto & cp = worker.cp;
+    auto & graph = info.graph;
+    auto & visited = worker.visited;
+    if(visited.size() != mSize)
+        visited.assign(mSize, false);
+    auto markVisited = [&](duint start)
+    {
+        if(!inRange(start)) //out of range nodes are terminal and only added once
+            return graph.nodes.count(start) == 0;
+        auto offset = start - mBase;
+        if(visited[offset])
+            return false;
+        visited[offset] = true;
+        worker.touched.push_back(offset);
+        return true;
+    };
+
     //first pass: BFS through the disassembly starting at entryPoint
-    CFGraph graph(entryPoint);
-    UintSet visited;
     std::queue<duint> queue;
     queue.push(graph.entryPoint);
     while(!queue.empty())
     {
         auto start = queue.front();
         queue.pop();
-        if(visited.count(start)) //already visited
+        if(!markVisited(start)) //already visited
             continue;
-        visited.insert(start);
 
         CFNode node(graph.entryPoint, start, start);
 
@@ -84,14 +259,14 @@ void RecursiveAnalysis::analyzeFunction(duint entryPoint)
         {
             if(!inRange(node.end))
             {
-                node.end = mCp.Address();
+                node.end = cp.Address();
                 node.terminal = true;
                 graph.AddNode(node);
                 break;
             }
 
             node.icount++;
-            if(!mCp.Disassemble(node.end, translateAddr(node.end)))
+            if(!cp.Disassemble(node.end, translateAddr(node.end)))
             {
                 node.end++;
                 continue;
@@ -100,10 +275,10 @@ void RecursiveAnalysis::analyzeFunction(duint entryPoint)
             //do xref analysis on the instruction
             XREF xref;
             xref.addr = 0;
-            xref.from = mCp.Address();
-            for(auto i = 0; i < mCp.OpCount(); i++)
+            xref.from = cp.Address();
+            for(auto i = 0; i < cp.OpCount(); i++)
             {
-                duint dest = mCp.ResolveOpValue(i, [](ZydisRegister)->size_t
+                duint dest = cp.ResolveOpValue(i, [](ZydisRegister)->size_t
                 {
                     return 0;
                 });
@@ -114,25 +289,25 @@ void RecursiveAnalysis::analyzeFunction(duint entryPoint)
                 }
             }
             if(xref.addr)
-                mXrefs.push_back(xref);
+                info.xrefs.push_back(xref);
 
-            if(!mCp.IsNop() && (mCp.IsJump() || mCp.IsLoop())) //non-nop jump
+            if(!cp.IsNop() && (cp.IsJump() || cp.IsLoop())) //non-nop jump
             {
                 //set the branch destinations
-                node.brtrue = mCp.BranchDestination();
-                if(mCp.GetId() != ZYDIS_MNEMONIC_JMP) //unconditional jumps dont have a brfalse
-                    node.brfalse = node.end + mCp.Size();
+                node.brtrue = cp.BranchDestination();
+                if(cp.GetId() != ZYDIS_MNEMONIC_JMP) //unconditional jumps dont have a brfalse
+                    node.brfalse = node.end + cp.Size();
 
                 //consider register/memory branches as terminal nodes
-                if(mCp.OpCount() && mCp[0].type != ZYDIS_OPERAND_TYPE_IMMEDIATE)
+                if(cp.OpCount() && cp[0].type != ZYDIS_OPERAND_TYPE_IMMEDIATE)
                 {
                     //jmp ptr [index * sizeof(duint) + switchTable]
-                    if(mCp[0].type == ZYDIS_OPERAND_TYPE_MEMORY && mCp[0].mem.base == ZYDIS_REGISTER_NONE && mCp[0].mem.index != ZYDIS_REGISTER_NONE
-                            && mCp[0].mem.scale == sizeof(duint) && MemIsValidReadPtr(duint(mCp[0].mem.disp.value)))
+                    if(cp[0].type == ZYDIS_OPERAND_TYPE_MEMORY && cp[0].mem.base == ZYDIS_REGISTER_NONE && cp[0].mem.index != ZYDIS_REGISTER_NONE
+                            && cp[0].mem.scale == sizeof(duint) && MemIsValidReadPtr(duint(cp[0].mem.disp.value)))
                     {
                         Memory<duint*> switchTable(512 * sizeof(duint));
                         duint actualSize, index;
-                        MemRead(duint(mCp[0].mem.disp.value), switchTable(), 512 * sizeof(duint), &actualSize);
+                        MemRead(duint(cp[0].mem.disp.value), switchTable(), 512 * sizeof(duint), &actualSize);
                         actualSize /= sizeof(duint);
                         for(index = 0; index < actualSize; index++)
                             if(MemIsCodePage(switchTable()[index], false) == false)
@@ -147,7 +322,7 @@ void RecursiveAnalysis::analyzeFunction(duint entryPoint)
                                 node.exits.push_back(switchTable()[index]);
                                 queue.emplace(switchTable()[index]);
                                 xref.addr = switchTable()[index];
-                                mXrefs.push_back(xref);
+                                info.xrefs.push_back(xref);
                             }
                         }
                         else
@@ -168,17 +343,20 @@ void RecursiveAnalysis::analyzeFunction(duint entryPoint)
 
                 break;
             }
-            if(mCp.IsCall())
+            if(cp.IsCall() && cp.OpCount() && cp[0].type == ZYDIS_OPERAND_TYPE_IMMEDIATE)
             {
-                //TODO: add this to a queue to be analyzed later
+                //queue the destination to be analyzed as a function
+                auto dest = cp.BranchDestination();
+                if(inRange(dest))
+                    info.calls.push_back(dest);
             }
-            if(mCp.IsRet())
+            if(cp.IsRet())
             {
                 node.terminal = true;
                 graph.AddNode(node);
                 break;
             }
-            node.end += mCp.Size();
+            node.end += cp.Size();
         }
     }
     //second pass: split overlapping blocks introduced by backedges
@@ -190,7 +368,7 @@ void RecursiveAnalysis::analyzeFunction(duint entryPoint)
         while(addr < node.end)
         {
             icount++;
-            auto size = mCp.Disassemble(addr, translateAddr(addr)) ? mCp.Size() : 1;
+            auto size = cp.Disassemble(addr, translateAddr(addr)) ? cp.Size() : 1;
             if(graph.nodes.count(addr + size))
             {
                 node.end = addr;
@@ -223,10 +401,10 @@ void RecursiveAnalysis::analyzeFunction(duint entryPoint)
         auto addr = node.start;
         while(addr <= node.end) //disassemble all instructions
         {
-            auto size = mCp.Disassemble(addr, translateAddr(addr)) ? mCp.Size() : 1;
-            if(mCp.IsCall() && mCp.OpCount()) //call reg / call [reg+X]
+            auto size = cp.Disassemble(addr, translateAddr(addr)) ? cp.Size() : 1;
+            if(cp.IsCall() && cp.OpCount()) //call reg / call [reg+X]
             {
-                auto & op = mCp[0];
+                auto & op = cp[0];
                 switch(op.type)
                 {
                 case ZYDIS_OPERAND_TYPE_REGISTER:
@@ -248,13 +426,8 @@ void RecursiveAnalysis::analyzeFunction(duint entryPoint)
             addr += size;
         }
     }
-    //fourth pass: allow plugins to manipulate the graph
-    if(mUsePlugins && !plugincbempty(CB_ANALYZE))
-    {
-        PLUG_CB_ANALYZE info;
-        info.graph = graph.ToGraphList();
-        plugincbcall(CB_ANALYZE, &info);
-        graph = BridgeCFGraph(&info.graph, true);
-    }
-    mFunctions.push_back(graph);
+    //reset the visited bits for the next function of this worker
+    for(auto offset : worker.touched)
+        visited[offset] = false;
+    worker.touched.clear();
 }
@@ -7,6 +7,7 @@ class RecursiveAnalysis : public Analysis
 public:
     explicit RecursiveAnalysis(duint base, duint size, duint entryPoint, duint maxDepth, bool usePlugins, bool dump = false);
     void Analyse() override;
+    void AnalyseModule();
     void SetMarkers() override;
 
     using UintSet = std::unordered_set<duint>;
@@ -94,5 +95,21 @@ private:
 
     std::vector<XREF> mXrefs;
 
-    void analyzeFunction(duint entryPoint);
+    struct FunctionInfo
+    {
+        CFGraph graph;
+        std::vector<XREF> xrefs;
+        std::vector<duint> calls; //direct call destinations inside the range
+
+        explicit FunctionInfo(duint entryPoint)
+            : graph(entryPoint)
+        {
+        }
+    };
+
+    struct Worker;
+
+    void analyzeQueue(std::vector<duint> queue, duint maxDepth);
+    void getModuleSeeds(std::vector<duint> & seeds) const;
+    void analyzeFunction(Worker & worker, FunctionInfo & info) const;
 };
\ No newline at end of file
@@ -1,39 +1,27 @@
 #include "xrefsanalysis.h"
 #include "xrefs.h"
 #include "console.h"
+#include "disasm_index.h"
 
 void XrefsAnalysis::Analyse()
 {
     dputs("Starting xref analysis...");
     auto ticks = GetTickCount();
 
-    for(auto addr = mBase; addr < mBase + mSize;)
+    auto index = DisasmIndexGet(mBase, mSize, mData);
+    index->ForEach([this](duint addr, ZydisMnemonic, const BASIC_INSTRUCTION_INFO & basicinfo)
     {
-        if(!mCp.Disassemble(addr, translateAddr(addr)))
-        {
-            addr++;
-            continue;
-        }
-        addr += mCp.Size();
-
         XREF xref;
         xref.addr = 0;
-        xref.from = mCp.Address();
-        for(auto i = 0; i < mCp.OpCount(); i++)
-        {
-            duint dest = mCp.ResolveOpValue(i, [](ZydisRegister)->size_t
-            {
-                return 0;
-            });
-            if(inRange(dest))
-            {
-                xref.addr = dest;
-                break;
-            }
-        }
+        xref.from = addr;
+        //the memory operand comes first in the operand order (mov [dest], imm)
+        if((basicinfo.type & TYPE_MEMORY) && inRange(basicinfo.memory.value))
+            xref.addr = basicinfo.memory.value;
+        else if((basicinfo.type & (TYPE_VALUE | TYPE_ADDR)) && inRange(basicinfo.value.value))
+            xref.addr = basicinfo.value.value;
         if(xref.addr)
             mXrefs.push_back(xref);
-    }
+    });
 
     dprintf("%u xrefs found in %ums!\n", DWORD(mXrefs.size()), GetTickCount() - ticks);
 }
@@ -145,6 +145,11 @@ void ArgumentCacheLoad(JSON Root)
     arguments.CacheLoad(Root);
 }
 
+duint ArgumentCacheGeneration()
+{
+    return arguments.Generation();
+}
+
 void ArgumentClear()
 {
     arguments.Clear();
@@ -24,6 +24,7 @@ bool ArgumentDelete(duint Address);
 void ArgumentDelRange(duint Start, duint End, bool DeleteManual = false);
 void ArgumentCacheSave(JSON Root);
 void ArgumentCacheLoad(JSON Root);
+duint ArgumentCacheGeneration();
 void ArgumentClear();
 void ArgumentGetList(std::vector<ARGUMENTSINFO> & list);
 bool ArgumentGetInfo(duint Address, ARGUMENTSINFO & info);
@@ -51,6 +51,11 @@ void BookmarkCacheLoad(JSON Root)
     bookmarks.CacheLoad(Root, "auto"); //legacy support
 }
 
+duint BookmarkCacheGeneration()
+{
+    return bookmarks.Generation();
+}
+
 bool BookmarkEnum(BOOKMARKSINFO* List, size_t* Size)
 {
     return bookmarks.Enum(List, Size);
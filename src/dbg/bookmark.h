@@ -14,6 +14,7 @@ bool BookmarkDelete(duint Address);
 void BookmarkDelRange(duint Start, duint End, bool Manual);
 void BookmarkCacheSave(JSON Root);
 void BookmarkCacheLoad(JSON Root);
+duint BookmarkCacheGeneration();
 bool BookmarkEnum(BOOKMARKSINFO* List, size_t* Size);
 void BookmarkClear();
 void BookmarkGetList(std::vector<BOOKMARKSINFO> & list);
@@ -11,10 +11,15 @@
 #include "value.h"
 #include "debugger.h"
 #include "exception.h"
+#include "expressionparser.h"
+#include "stringformat.h"
+#include "command.h"
 #include <algorithm>
 
 typedef std::pair<BP_TYPE, duint> BreakpointKey;
 std::map<BreakpointKey, BREAKPOINT> breakpoints;
+static std::unordered_map<const BREAKPOINT*, std::shared_ptr<BpProgram>> bpPrograms;
+static uint32 bpVersion = 0;
 
 static void setBpActive(BREAKPOINT & bp)
 {
@@ -113,6 +118,7 @@ bool BpNew(duint Address, bool Enable, bool Singleshot, short OldBytes, BP_TYPE
 
     // Insert new entry to the global list
     EXCLUSIVE_ACQUIRE(LockBreakpoints);
+    bp.version = ++bpVersion;
 
     if(Type != BPDLL && Type != BPEXCEPTION)
     {
@@ -143,6 +149,7 @@ bool BpNewDll(const char* module, bool Enable, bool Singleshot, DWORD TitanType,
 
     // Insert new entry to the global list
     EXCLUSIVE_ACQUIRE(LockBreakpoints);
+    bp.version = ++bpVersion;
 
     return breakpoints.insert(std::make_pair(BreakpointKey(BPDLL, bp.addr), bp)).second;
 }
@@ -236,6 +243,7 @@ bool BpUpdateDllPath(const char* module1, BREAKPOINT** newBpInfo)
                 temp = i.second;
                 strcpy_s(temp.mod, module1);
                 temp.addr = ModHashFromName(module1);
+                bpPrograms.erase(&i.second);
                 breakpoints.erase(i.first);
                 auto newItem = breakpoints.insert(std::make_pair(BreakpointKey(BPDLL, temp.addr), temp));
                 *newBpInfo = &newItem.first->second;
@@ -252,6 +260,7 @@ bool BpUpdateDllPath(const char* module1, BREAKPOINT** newBpInfo)
                 temp = i.second;
                 strcpy_s(temp.mod, dashPos1 + 1);
                 temp.addr = ModHashFromName(dashPos1 + 1);
+                bpPrograms.erase(&i.second);
                 breakpoints.erase(i.first);
                 auto newItem = breakpoints.insert(std::make_pair(BreakpointKey(BPDLL, temp.addr), temp));
                 *newBpInfo = &newItem.first->second;
@@ -279,10 +288,12 @@ bool BpDelete(duint Address, BP_TYPE Type)
     EXCLUSIVE_ACQUIRE(LockBreakpoints);
 
     // Erase the index from the global list
-    if(Type != BPDLL)
-        return (breakpoints.erase(BreakpointKey(Type, ModHashFromAddr(Address))) > 0);
-    else
-        return (breakpoints.erase(BreakpointKey(BPDLL, Address)) > 0);
+    auto found = breakpoints.find(Type != BPDLL ? BreakpointKey(Type, ModHashFromAddr(Address)) : BreakpointKey(BPDLL, Address));
+    if(found == breakpoints.end())
+        return false;
+    bpPrograms.erase(&found->second);
+    breakpoints.erase(found);
+    return true;
 }
 
 bool BpEnable(duint Address, BP_TYPE Type, bool Enable)
@@ -353,6 +364,7 @@ bool BpSetBreakCondition(duint Address, BP_TYPE Type, const char* Condition)
         return false;
 
     strncpy_s(bpInfo->breakCondition, Condition, _TRUNCATE);
+    bpInfo->version = ++bpVersion;
     return true;
 }
 
@@ -368,6 +380,7 @@ bool BpSetLogText(duint Address, BP_TYPE Type, const char* Log)
         return false;
 
     strncpy_s(bpInfo->logText, Log, _TRUNCATE);
+    bpInfo->version = ++bpVersion;
 
     // Make log breakpoints silent (meaning they don't output the default log).
     bpInfo->silent = *Log != '\0';
@@ -386,6 +399,7 @@ bool BpSetLogCondition(duint Address, BP_TYPE Type, const char* Condition)
         return false;
 
     strncpy_s(bpInfo->logCondition, Condition, _TRUNCATE);
+    bpInfo->version = ++bpVersion;
     return true;
 }
 
@@ -401,6 +415,7 @@ bool BpSetCommandText(duint Address, BP_TYPE Type, const char* Cmd)
         return false;
 
     strncpy_s(bpInfo->commandText, Cmd, _TRUNCATE);
+    bpInfo->version = ++bpVersion;
     return true;
 }
 
@@ -416,6 +431,7 @@ bool BpSetCommandCondition(duint Address, BP_TYPE Type, const char* Condition)
         return false;
 
     strncpy_s(bpInfo->commandCondition, Condition, _TRUNCATE);
+    bpInfo->version = ++bpVersion;
     return true;
 }
 
@@ -774,6 +790,7 @@ void BpCacheLoad(JSON Root)
         // Fast resume
         breakpoint.fastResume = json_boolean_value(json_object_get(value, "fastResume"));
         breakpoint.silent = json_boolean_value(json_object_get(value, "silent"));
+        breakpoint.version = ++bpVersion;
 
         // Build the hash map key: MOD_HASH + ADDRESS
         duint key;
@@ -792,5 +809,105 @@ void BpCacheLoad(JSON Root)
 void BpClear()
 {
     EXCLUSIVE_ACQUIRE(LockBreakpoints);
+    bpPrograms.clear();
     breakpoints.clear();
 }
+
+BpProgram::Condition::Condition(const char* Text)
+{
+    auto word = *(uint16*)Text;
+    if(!*Text)
+        mKind = None;
+    else if(word == '0') // short circuit for condition "0\0"
+        mKind = False;
+    else if(word == '1') //short circuit for condition "1\0"
+        mKind = True;
+    else
+    {
+        mKind = Expression;
+        mParser = std::make_shared<ExpressionParser>(Text);
+    }
+}
+
+bool BpProgram::Condition::Evaluate(bool Default) const
+{
+    switch(mKind)
+    {
+    case False:
+        return false;
+    case True:
+        return true;
+    case Expression:
+    {
+        duint value;
+        if(mParser->Calculate(value, valuesignedcalc(), false))
+            return value != 0;
+        return true;
+    }
+    default:
+        return Default;
+    }
+}
+
+BpProgram::BpProgram(const BREAKPOINT & Bp)
+    : mVersion(Bp.version),
+      mBreakCondition(Bp.breakCondition),
+      mLogCondition(Bp.logCondition),
+      mCommandCondition(Bp.commandCondition)
+{
+    if(*Bp.logText)
+        mLog = std::make_shared<StringFormatInline>(Bp.logText);
+    if(*Bp.commandText)
+        mCommand = std::make_shared<CommandProgram>(Bp.commandText);
+}
+
+uint32 BpProgram::Version() const
+{
+    return mVersion;
+}
+
+bool BpProgram::BreakCondition() const
+{
+    return mBreakCondition.Evaluate(true); //break if no condition is set
+}
+
+bool BpProgram::LogCondition() const
+{
+    return mLogCondition.Evaluate(true); //log if no condition is set
+}
+
+bool BpProgram::CommandCondition(bool BreakCondition) const
+{
+    return mCommandCondition.Evaluate(BreakCondition); //if no condition is set, execute the command when the debugger would break
+}
+
+bool BpProgram::HasLog() const
+{
+    return !!mLog;
+}
+
+String BpProgram::Log() const
+{
+    return mLog ? mLog->Format() : String();
+}
+
+bool BpProgram::HasCommand() const
+{
+    return !!mCommand;
+}
+
+bool BpProgram::ExecuteCommand() const
+{
+    return mCommand ? mCommand->Execute() : true;
+}
+
+std::shared_ptr<BpProgram> BpGetProgram(const BREAKPOINT* bpInfo)
+{
+    //
+    // NOTE: THIS DOES _NOT_ USE LOCKS
+    //
+    auto & program = bpPrograms[bpInfo];
+    if(!program || program->Version() != bpInfo->version)
+        program = std::make_shared<BpProgram>(*bpInfo);
+    return program;
+}
@@ -3,6 +3,7 @@
 
 #include "_global.h"
 #include "jansson/jansson_x64dbg.h"
+#include <memory>
 
 #define TITANSETDRX(titantype, drx) titantype &= 0x0FF; titantype |= (drx<<8)
 #define TITANGETDRX(titantype) (titantype >> 8) & 0xF
@@ -40,6 +41,53 @@ struct BREAKPOINT
     uint32 hitcount;                                  // hit counter
     bool fastResume;                                  // if true, debugger resumes without any GUI/Script/Plugin interaction.
     duint memsize;                                    // memory breakpoint size (not implemented)
+    uint32 version;                                   // changes with the conditions, log text or command text (see BpGetProgram)
+};
+
+class ExpressionParser;
+class StringFormatInline;
+class CommandProgram;
+
+/**
+\brief The conditions, log text and command text of a breakpoint parsed once for the hit path.
+*/
+class BpProgram
+{
+public:
+    explicit BpProgram(const BREAKPOINT & Bp);
+    uint32 Version() const;
+    bool BreakCondition() const; // true if no condition is set
+    bool LogCondition() const; // true if no condition is set
+    bool CommandCondition(bool BreakCondition) const; // the break condition if no condition is set
+    bool HasLog() const;
+    String Log() const;
+    bool HasCommand() const;
+    bool ExecuteCommand() const;
+
+private:
+    class Condition
+    {
+    public:
+        explicit Condition(const char* Text);
+        bool Evaluate(bool Default) const;
+
+    private:
+        enum
+        {
+            None,
+            False,
+            True,
+            Expression
+        } mKind;
+        std::shared_ptr<ExpressionParser> mParser;
+    };
+
+    uint32 mVersion;
+    Condition mBreakCondition;
+    Condition mLogCondition;
+    Condition mCommandCondition;
+    std::shared_ptr<StringFormatInline> mLog;
+    std::shared_ptr<CommandProgram> mCommand;
 };
 
 // Breakpoint enumeration callback
@@ -74,5 +122,6 @@ void BpCacheSave(JSON Root);
 void BpCacheLoad(JSON Root);
 void BpClear();
 bool BpUpdateDllPath(const char* module1, BREAKPOINT** newBpInfo);
+std::shared_ptr<BpProgram> BpGetProgram(const BREAKPOINT* bpInfo);
 
 #endif // _BREAKPOINT_H
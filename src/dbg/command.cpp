@@ -11,8 +11,40 @@
 #include "expressionparser.h"
 #include "variable.h"
 #include "cmd-undocumented.h"
+#include "threading.h"
 
 COMMAND* cmd_list = 0;
+static duint cmdgeneration = 0; //changes when a command is added, replaced or removed
+
+struct CMDSLOT
+{
+    unsigned int hash;
+    const String* name; //points into COMMAND::names
+    COMMAND* cmd;
+};
+
+static std::vector<CMDSLOT> cmdtable; //command names, open addressing with linear probing (the size is a power of two)
+static size_t cmdtablecount = 0;
+
+/**
+\brief Reusable memory for the arguments of the commands executed by a thread. It is used like a
+       stack (nested commands allocate above the arguments of the outer command) and the blocks
+       are never moved, so the arguments stay valid while nested commands execute.
+*/
+struct CMDARENA
+{
+    std::vector<std::vector<char>> blocks;
+    size_t block;
+    size_t used;
+
+    CMDARENA()
+        : block(0),
+          used(0)
+    {
+    }
+};
+
+static DWORD cmdArenaTls = TlsAlloc();
 
 static bool vecContains(std::vector<String>* names, const char* name)
 {
@@ -22,6 +54,153 @@ static bool vecContains(std::vector<String>* names, const char* name)
     return false;
 }
 
+static unsigned int cmdhash(const char* name, size_t len)
+{
+    //case-insensitive FNV-1a
+    unsigned int hash = 2166136261;
+    for(size_t i = 0; i < len; i++)
+    {
+        hash ^= (unsigned char)tolower((unsigned char)name[i]);
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+static COMMAND* cmdtablefind(const char* name, size_t len)
+{
+    if(cmdtable.empty())
+        return nullptr;
+    auto hash = cmdhash(name, len);
+    auto mask = cmdtable.size() - 1;
+    for(auto i = hash & mask; cmdtable[i].cmd; i = (i + 1) & mask)
+    {
+        const auto & slot = cmdtable[i];
+        if(slot.hash == hash && slot.name->length() == len && !_strnicmp(slot.name->c_str(), name, len))
+            return slot.cmd;
+    }
+    return nullptr;
+}
+
+static void cmdtableadd(COMMAND* cmd)
+{
+    auto mask = cmdtable.size() - 1;
+    for(const auto & name : *cmd->names)
+    {
+        if(cmdtablefind(name.c_str(), name.length())) //the first command with a name wins, like in the list
+            continue;
+        CMDSLOT slot;
+        slot.hash = cmdhash(name.c_str(), name.length());
+        slot.name = &name;
+        slot.cmd = cmd;
+        auto i = slot.hash & mask;
+        while(cmdtable[i].cmd)
+            i = (i + 1) & mask;
+        cmdtable[i] = slot;
+        cmdtablecount++;
+    }
+}
+
+static void cmdtablebuild()
+{
+    size_t count = 0;
+    for(auto cur = cmd_list; cur && cur->names; cur = cur->next)
+        count += cur->names->size();
+    size_t size = 256;
+    while(size < count * 2)
+        size *= 2;
+    cmdtable.assign(size, CMDSLOT());
+    cmdtablecount = 0;
+    for(auto cur = cmd_list; cur && cur->names; cur = cur->next)
+        cmdtableadd(cur);
+}
+
+static CMDARENA* cmdarena()
+{
+    if(cmdArenaTls == TLS_OUT_OF_INDEXES)
+        return nullptr;
+    auto arena = (CMDARENA*)TlsGetValue(cmdArenaTls);
+    if(!arena)
+    {
+        arena = new CMDARENA();
+        TlsSetValue(cmdArenaTls, arena);
+    }
+    return arena;
+}
+
+static void* cmdarenaalloc(CMDARENA & arena, size_t size)
+{
+    size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    while(arena.block < arena.blocks.size() && arena.blocks[arena.block].size() - arena.used < size)
+    {
+        arena.block++;
+        arena.used = 0;
+    }
+    if(arena.block == arena.blocks.size())
+        arena.blocks.emplace_back(max(size, size_t(0x1000)));
+    auto result = arena.blocks[arena.block].data() + arena.used;
+    arena.used += size;
+    return result;
+}
+
+//Command callbacks (plugin commands included) have always been given writable arguments of at least deflen bytes.
+static size_t cmdargcapacity(size_t length)
+{
+    return max(size_t(deflen), length + 1);
+}
+
+/**
+\brief Builds the argv of a command callback in the arena of the calling thread (or on the heap
+       without one) and releases it when the command returns.
+*/
+class CmdArgs
+{
+public:
+    CmdArgs(size_t pointers, size_t bytes)
+        : mArena(cmdarena())
+    {
+        if(mArena)
+        {
+            mBlock = mArena->block;
+            mUsed = mArena->used;
+            mArgv = (char**)cmdarenaalloc(*mArena, pointers * sizeof(char*));
+            mData = (char*)cmdarenaalloc(*mArena, bytes);
+        }
+        else
+        {
+            mHeap.resize(pointers * sizeof(char*) + bytes);
+            mArgv = (char**)mHeap.data();
+            mData = mHeap.data() + pointers * sizeof(char*);
+        }
+    }
+
+    ~CmdArgs()
+    {
+        if(mArena)
+        {
+            mArena->block = mBlock;
+            mArena->used = mUsed;
+        }
+    }
+
+    char** Argv()
+    {
+        return mArgv;
+    }
+
+    char* Data()
+    {
+        return mData;
+    }
+
+private:
+    CMDARENA* mArena;
+    size_t mBlock;
+    size_t mUsed;
+    char** mArgv;
+    char* mData;
+    std::vector<char> mHeap;
+};
+
 /**
 \brief Finds a ::COMMAND in a command list.
 \param [in] command list.
@@ -31,6 +210,11 @@ static bool vecContains(std::vector<String>* names, const char* name)
 */
 COMMAND* cmdfind(const char* name, COMMAND** link)
 {
+    if(!link)
+    {
+        SHARED_ACQUIRE(LockCommands);
+        return cmdtablefind(name, strlen(name));
+    }
     COMMAND* cur = cmd_list;
     if(!cur->names)
         return 0;
@@ -65,8 +249,10 @@ bool IsArgumentsLessThan(int argc, int minimumCount)
 */
 COMMAND* cmdinit()
 {
+    EXCLUSIVE_ACQUIRE(LockCommands);
     cmd_list = (COMMAND*)emalloc(sizeof(COMMAND), "cmdinit:cmd");
     memset(cmd_list, 0, sizeof(COMMAND));
+    cmdtablebuild();
     return cmd_list;
 }
 
@@ -76,6 +262,9 @@ COMMAND* cmdinit()
 */
 void cmdfree()
 {
+    EXCLUSIVE_ACQUIRE(LockCommands);
+    cmdtable.clear();
+    cmdtablecount = 0;
     COMMAND* cur = cmd_list;
     while(cur)
     {
@@ -96,7 +285,10 @@ void cmdfree()
 */
 bool cmdnew(const char* name, CBCOMMAND cbCommand, bool debugonly)
 {
-    if(!cmd_list || !cbCommand || !name || !*name || cmdfind(name, 0))
+    if(!cmd_list || !cbCommand || !name || !*name)
+        return false;
+    EXCLUSIVE_ACQUIRE(LockCommands);
+    if(cmdfind(name, 0))
         return false;
     COMMAND* cmd;
     bool nonext = false;
@@ -125,6 +317,11 @@ bool cmdnew(const char* name, CBCOMMAND cbCommand, bool debugonly)
             cur = cur->next;
         cur->next = cmd;
     }
+    if((cmdtablecount + cmd->names->size()) * 2 > cmdtable.size())
+        cmdtablebuild();
+    else
+        cmdtableadd(cmd);
+    cmdgeneration++;
     return true;
 }
 
@@ -136,17 +333,9 @@ bool cmdnew(const char* name, CBCOMMAND cbCommand, bool debugonly)
 */
 COMMAND* cmdget(const char* cmd)
 {
-    char new_cmd[deflen] = "";
-    strcpy_s(new_cmd, deflen, cmd);
-    int len = (int)strlen(new_cmd);
-    int start = 0;
-    while(start < len && new_cmd[start] != ' ')
-        start++;
-    new_cmd[start] = 0;
-    COMMAND* found = cmdfind(new_cmd, 0);
-    if(!found)
-        return 0;
-    return found;
+    auto len = strcspn(cmd, " ");
+    SHARED_ACQUIRE(LockCommands);
+    return cmdtablefind(cmd, len);
 }
 
 /**
@@ -167,6 +356,7 @@ CBCOMMAND cmdset(const char* name, CBCOMMAND cbCommand, bool debugonly)
     CBCOMMAND old = found->cbCommand;
     found->cbCommand = cbCommand;
     found->debugonly = debugonly;
+    cmdgeneration++;
     return old;
 }
 
@@ -178,11 +368,13 @@ CBCOMMAND cmdset(const char* name, CBCOMMAND cbCommand, bool debugonly)
 */
 bool cmddel(const char* name)
 {
+    EXCLUSIVE_ACQUIRE(LockCommands);
     COMMAND* prev = 0;
     COMMAND* found = cmdfind(name, &prev);
     if(!found)
         return false;
     delete found->names;
+    cmdgeneration++;
     if(found == cmd_list)
     {
         COMMAND* next = cmd_list->next;
@@ -200,6 +392,7 @@ bool cmddel(const char* name)
         prev->next = found->next;
         efree(found, "cmddel:found");
     }
+    cmdtablebuild();
     return true;
 }
 
@@ -244,21 +437,37 @@ void cmdsplit(const char* cmd, StringList & commands)
 
 bool cmdexeccallback(COMMAND* cmd, const std::string & command)
 {
-    Command commandParsed(command);
-    int argcount = commandParsed.GetArgCount();
-    char** argv = (char**)emalloc((argcount + 1) * sizeof(char*), "cmdloop:argv");
+    //the arguments are split into the arena first and then copied to buffers with the deflen capacity
+    auto len = command.length();
+    CmdArgs split(len + 2, len * 2 + 1);
+    auto tokens = split.Argv();
+    auto argc = CommandSplit(command.c_str(), len, split.Data(), tokens);
+    size_t argsize = 0;
+    for(int i = 1; i < argc; i++)
+        argsize += cmdargcapacity(strlen(tokens[i]));
+
+    //argv[0] is the whole command
+    CmdArgs args(argc + 1, argsize);
+    auto argv = args.Argv();
+    auto data = args.Data();
     argv[0] = (char*)command.c_str();
-    for(int i = 0; i < argcount; i++)
+    for(int i = 1; i < argc; i++)
     {
-        argv[i + 1] = (char*)emalloc(deflen, "cmdloop:argv[i+1]");
-        *argv[i + 1] = 0;
-        strcpy_s(argv[i + 1], deflen, commandParsed.GetArg(i).c_str());
+        auto length = strlen(tokens[i]);
+        memcpy(data, tokens[i], length + 1);
+        argv[i] = data;
+        data += cmdargcapacity(length);
     }
-    auto res = cmd->cbCommand(argcount + 1, argv);
-    for(int i = 0; i < argcount; i++)
-        efree(argv[i + 1], "cmdloop:argv[i+1]");
-    efree(argv, "cmdloop:argv");
-    return res;
+    return cmd->cbCommand(argc, argv);
+}
+
+void cmdthreaddetach()
+{
+    if(cmdArenaTls == TLS_OUT_OF_INDEXES)
+        return;
+    auto arena = (CMDARENA*)TlsGetValue(cmdArenaTls);
+    TlsSetValue(cmdArenaTls, nullptr);
+    delete arena;
 }
 
 /**
@@ -347,3 +556,84 @@ bool cmddirectexec(const char* cmd)
     }
     return true;
 }
+
+CommandProgram::CommandProgram(const char* cmd)
+    : mGeneration(cmdgeneration - 1)
+{
+    StringList commands;
+    cmdsplit(cmd, commands);
+    for(auto & command : commands)
+    {
+        command = StringUtils::Trim(command);
+        if(command.empty()) //skip empty commands
+            continue;
+
+        Step step;
+        step.command = command;
+        step.argsize = 0;
+        Command commandParsed(command);
+        for(int i = 0; i < commandParsed.GetArgCount(); i++)
+        {
+            step.args.push_back(commandParsed.GetArg(i));
+            step.argsize += cmdargcapacity(step.args.back().length());
+        }
+        step.cmd = nullptr;
+        mSteps.push_back(step);
+    }
+}
+
+void CommandProgram::resolve()
+{
+    for(auto & step : mSteps)
+    {
+        step.cmd = cmdget(step.command.c_str());
+        if(!step.cmd || !step.cmd->cbCommand) //unknown command
+        {
+            step.cmd = nullptr;
+            if(!step.expression)
+                step.expression = std::make_shared<ExpressionParser>(step.command);
+        }
+    }
+    mGeneration = cmdgeneration;
+}
+
+bool CommandProgram::Execute()
+{
+    if(mGeneration != cmdgeneration)
+        resolve();
+
+    for(const auto & step : mSteps)
+    {
+        if(!step.cmd)
+        {
+            duint result;
+            if(!step.expression->Calculate(result, valuesignedcalc(), true, false)) //stop processing on non-value commands
+                return false;
+            varset("$ans", result, true);
+            continue;
+        }
+
+        if(step.cmd->debugonly && !DbgIsDebugging()) //stop processing on debug-only commands
+        {
+            dprintf(QT_TRANSLATE_NOOP("DBG", "The command \"%s\" is debug-only\n"), step.command.c_str());
+            return false;
+        }
+
+        //the callbacks get writable copies of the arguments, like in cmdexeccallback
+        auto argcount = step.args.size();
+        CmdArgs args(argcount + 1, step.argsize);
+        auto argv = args.Argv();
+        auto data = args.Data();
+        argv[0] = (char*)step.command.c_str();
+        for(size_t i = 0; i < argcount; i++)
+        {
+            const auto & arg = step.args[i];
+            memcpy(data, arg.c_str(), arg.length() + 1);
+            argv[i + 1] = data;
+            data += cmdargcapacity(arg.length());
+        }
+        if(!step.cmd->cbCommand(int(argcount + 1), argv))
+            return false;
+    }
+    return true;
+}
@@ -3,6 +3,7 @@
 
 #include "_global.h"
 #include "console.h"
+#include <memory>
 
 bool IsArgumentsLessThan(int argc, int minimumCount);
 
@@ -32,5 +33,35 @@ CBCOMMAND cmdset(const char* name, CBCOMMAND cbCommand, bool debugonly);
 bool cmddel(const char* name);
 void cmdloop();
 bool cmddirectexec(const char* cmd);
+void cmdthreaddetach(); //releases the argument memory of the calling thread
+
+class ExpressionParser;
+
+/**
+\brief A command line split and parsed once, for command text that is executed over and over
+       (breakpoint commands). Execute behaves like cmddirectexec, the commands are looked up
+       again after the command list changed.
+*/
+class CommandProgram
+{
+public:
+    explicit CommandProgram(const char* cmd);
+    bool Execute();
+
+private:
+    struct Step
+    {
+        String command;
+        StringList args;
+        size_t argsize; //bytes needed for the argument copies
+        COMMAND* cmd; //null for expressions
+        std::shared_ptr<ExpressionParser> expression;
+    };
+
+    void resolve();
+
+    std::vector<Step> mSteps;
+    duint mGeneration;
+};
 
 #endif // _COMMAND_H
@@ -1,10 +1,19 @@
 #include "commandparser.h"
 
-Command::Command(const String & command)
+// Splits a command into the command name and the arguments, append(ch) adds a character to the current token and finish() ends it
+template<typename TAppend, typename TFinish>
+static void commandParse(const char* command, size_t len, TAppend append, TFinish finish)
 {
+    enum ParseState
+    {
+        Default,
+        Escaped,
+        Text,
+        TextEscaped
+    };
     ParseState state = Default;
-    int len = (int)command.length();
-    for(int i = 0; i < len; i++)
+    size_t tokens = 0;
+    for(size_t i = 0; i < len; i++)
     {
         char ch = command[i];
         switch(state)
@@ -14,11 +23,15 @@ Command::Command(const String & command)
             {
             case '\t':
             case ' ':
-                if(!_tokens.size())
-                    dataFinish();
+                if(!tokens)
+                {
+                    finish();
+                    tokens++;
+                }
                 break;
             case ',':
-                dataFinish();
+                finish();
+                tokens++;
                 break;
             case '\\':
                 state = Escaped;
@@ -27,7 +40,7 @@ Command::Command(const String & command)
                 state = Text;
                 break;
             default:
-                dataAppend(ch);
+                append(ch);
                 break;
             }
             break;
@@ -36,17 +49,17 @@ Command::Command(const String & command)
             {
             case '\t':
             case ' ':
-                dataAppend(' ');
+                append(' ');
                 break;
             case ',':
-                dataAppend(ch);
+                append(ch);
                 break;
             case '\"':
-                dataAppend(ch);
+                append(ch);
                 break;
             default:
-                dataAppend('\\');
-                dataAppend(ch);
+                append('\\');
+                append(ch);
                 break;
             }
             state = Default;
@@ -61,7 +74,7 @@ Command::Command(const String & command)
                 state = Default;
                 break;
             default:
-                dataAppend(ch);
+                append(ch);
                 break;
             }
             break;
@@ -69,11 +82,11 @@ Command::Command(const String & command)
             switch(ch)
             {
             case '\"':
-                dataAppend(ch);
+                append(ch);
                 break;
             default:
-                dataAppend('\\');
-                dataAppend(ch);
+                append('\\');
+                append(ch);
                 break;
             }
             state = Text;
@@ -81,8 +94,19 @@ Command::Command(const String & command)
         }
     }
     if(state == Escaped || state == TextEscaped)
-        dataAppend('\\');
-    dataFinish();
+        append('\\');
+    finish();
+}
+
+Command::Command(const String & command)
+{
+    commandParse(command.c_str(), command.length(), [this](char ch)
+    {
+        dataAppend(ch);
+    }, [this]
+    {
+        dataFinish();
+    });
 }
 
 const String Command::GetText()
@@ -110,3 +134,18 @@ void Command::dataFinish()
     _tokens.push_back(_data);
     _data.clear();
 }
+
+int CommandSplit(const char* command, size_t length, char* buffer, char** tokens)
+{
+    int count = 0;
+    tokens[0] = buffer;
+    commandParse(command, length, [&buffer](char ch)
+    {
+        *buffer++ = ch;
+    }, [&]
+    {
+        *buffer++ = '\0';
+        tokens[++count] = buffer;
+    });
+    return count;
+}
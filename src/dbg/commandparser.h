@@ -15,16 +15,18 @@ private:
     String _data;
     std::vector<String> _tokens;
 
-    enum ParseState
-    {
-        Default,
-        Escaped,
-        Text,
-        TextEscaped
-    };
-
     void dataFinish();
     void dataAppend(const char ch);
 };
 
+/**
+\brief Splits a command into the command name and the arguments like Command, without allocating.
+\param command The command to split (does not have to be zero-terminated).
+\param length The length of the command.
+\param [out] buffer Receives the zero-terminated tokens, at least 2 * length + 1 bytes.
+\param [out] tokens Receives pointers to the tokens in buffer, at least length + 2 entries.
+\return The number of tokens (the command name included).
+*/
+int CommandSplit(const char* command, size_t length, char* buffer, char** tokens);
+
 #endif // _COMMANDPARSER_H
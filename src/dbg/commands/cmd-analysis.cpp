@@ -2,6 +2,7 @@
 #include "ntdll/ntdll.h"
 #include "linearanalysis.h"
 #include "memory.h"
+#include "module.h"
 #include "exceptiondirectoryanalysis.h"
 #include "controlflowanalysis.h"
 #include "analysis_nukem.h"
@@ -100,6 +101,23 @@ bool cbInstrAnalrecur(int argc, char* argv[])
     return true;
 }
 
+bool cbInstrAnalmod(int argc, char* argv[])
+{
+    duint addr;
+    if(argc < 2 || !valfromstring(argv[1], &addr, false))
+        addr = GetContextDataEx(hActiveThread, UE_CIP);
+    auto base = ModBaseFromAddr(addr);
+    if(!base)
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Invalid module address %p!\n"), addr);
+        return false;
+    }
+    RecursiveAnalysis analysis(base, ModSizeFromAddr(base), 0, 0, true);
+    analysis.AnalyseModule();
+    analysis.SetMarkers();
+    return true;
+}
+
 bool cbInstrAnalyseadv(int argc, char* argv[])
 {
     SELECTIONDATA sel;
@@ -8,6 +8,7 @@ bool cbInstrCfanalyse(int argc, char* argv[]);
 bool cbInstrAnalyseNukem(int argc, char* argv[]);
 bool cbInstrAnalxrefs(int argc, char* argv[]);
 bool cbInstrAnalrecur(int argc, char* argv[]);
+bool cbInstrAnalmod(int argc, char* argv[]);
 bool cbInstrAnalyseadv(int argc, char* argv[]);
 
 bool cbInstrVirtualmod(int argc, char* argv[]);
@@ -13,6 +13,7 @@
 #include "handle.h"
 #include "thread.h"
 #include "GetPeArch.h"
+#include "contextsnapshot.h"
 
 static bool skipInt3Stepping(int argc, char* argv[])
 {
@@ -405,7 +406,7 @@ bool cbDebugSkip(int argc, char* argv[])
         cip += basicinfo.size;
         _dbg_dbgtraceexecute(cip);
     }
-    SetContextDataEx(hActiveThread, UE_CIP, cip);
+    ContextSnapshotSetRegister(UE_CIP, cip);
     DebugUpdateGuiAsync(cip, false); //update GUI
     return true;
 }
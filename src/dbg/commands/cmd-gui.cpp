@@ -225,6 +225,38 @@ bool cbInstrDisableLog(int argc, char* argv[])
     return true;
 }
 
+bool cbInstrLogRedirect(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        dlogredirect(nullptr);
+        dputs(QT_TRANSLATE_NOOP("DBG", "Log redirection stopped."));
+        return true;
+    }
+    if(!dlogredirect(StringUtils::Utf8ToUtf16(argv[1]).c_str()))
+    {
+        dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to open \"%s\" for log redirection!\n"), argv[1]);
+        return false;
+    }
+    dprintf(QT_TRANSLATE_NOOP("DBG", "Log will be redirected to \"%s\".\n"), argv[1]);
+    return true;
+}
+
+bool cbInstrLogStats(int argc, char* argv[])
+{
+    static const char* sourceNames[LogSourceLast] = { "debugger", "plugin", "breakpoint", "trace" };
+    LOGSTATS stats;
+    dlogstats(&stats);
+    dprintf(QT_TRANSLATE_NOOP("DBG", "Log: %llu records (%llu bytes) delivered, %llu records (%llu bytes) dropped, %u bytes pending\n"),
+            stats.records, stats.bytes, stats.dropped, stats.droppedBytes, stats.pendingBytes);
+    dprintf(QT_TRANSLATE_NOOP("DBG", "Log rate: %u records/s, %u bytes/s, maximum latency %ums\n"),
+            stats.recordsPerSecond, stats.bytesPerSecond, stats.maxLatency);
+    for(int i = 0; i < LogSourceLast; i++)
+        dprintf_untranslated("  %s: %llu records (%llu bytes)\n", sourceNames[i], stats.sourceRecords[i], stats.sourceBytes[i]);
+    varset("$result", stats.dropped, false);
+    return true;
+}
+
 bool cbInstrAddFavTool(int argc, char* argv[])
 {
     // filename, description
@@ -15,6 +15,8 @@ bool cbInstrRefadd(int argc, char* argv[]);
 bool cbInstrRefGet(int argc, char* argv[]);
 bool cbInstrEnableLog(int argc, char* argv[]);
 bool cbInstrDisableLog(int argc, char* argv[]);
+bool cbInstrLogRedirect(int argc, char* argv[]);
+bool cbInstrLogStats(int argc, char* argv[]);
 bool cbInstrAddFavTool(int argc, char* argv[]);
 bool cbInstrAddFavCmd(int argc, char* argv[]);
 bool cbInstrSetFavToolShortcut(int argc, char* argv[]);
@@ -12,6 +12,7 @@
 #include "mnemonichelp.h"
 #include "commandline.h"
 #include "stringformat.h"
+#include "contextsnapshot.h"
 
 bool cbInstrChd(int argc, char* argv[])
 {
@@ -66,6 +67,7 @@ static void cbDebugLoadLibBPX()
     varset("$result", LibAddr, false);
     backupctx.eflags &= ~0x100;
     SetFullContextDataEx(LoadLibThread, &backupctx);
+    ContextSnapshotInvalidate();
     MemFreeRemote(DLLNameMem);
     MemFreeRemote(ASMAddr);
     ThreadResumeAll();
@@ -167,6 +169,7 @@ static void cbDebugFreeLibBPX()
     varset("$result", LibAddr, false);
     backupctx.eflags &= ~0x100;
     SetFullContextDataEx(FreeLibThread, &backupctx);
+    ContextSnapshotInvalidate();
     MemFreeRemote(ASMAddr);
     ThreadResumeAll();
     //update GUI
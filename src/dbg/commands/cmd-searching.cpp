@@ -11,6 +11,8 @@
 #include "stringformat.h"
 #include "disasm_helper.h"
 #include "symbolinfo.h"
+#include "stringutils.h"
+#include <mutex>
 
 static int maxFindResults = 5000;
 
@@ -136,8 +138,8 @@ bool cbInstrFindAll(int argc, char* argv[])
     int refCount = 0;
     duint i = 0;
     duint result = 0;
-    std::vector<PatternByte> searchpattern;
-    if(!patterntransform(pattern, searchpattern))
+    PatternCompiled searchpattern;
+    if(!patterncompile(pattern, searchpattern))
     {
         dputs(QT_TRANSLATE_NOOP("DBG", "Failed to transform pattern!"));
         return false;
@@ -284,9 +286,116 @@ bool cbInstrFindAllMem(int argc, char* argv[])
     return true;
 }
 
-static bool cbFindAsm(Zydis* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO* refinfo)
+bool cbInstrFindAllMemMulti(int argc, char* argv[])
+{
+    if(IsArgumentsLessThan(argc, 3))
+        return false;
+    duint addr = 0;
+    if(!valfromstring(argv[1], &addr, false))
+        return false;
+
+    //the patterns are either read from a file (one [name=]pattern per line) or separated by '|'
+    std::vector<String> lines;
+    if(FileExists(argv[2]))
+    {
+        if(!FileHelper::ReadAllLines(argv[2], lines))
+        {
+            dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to read file \"%s\"!\n"), argv[2]);
+            return false;
+        }
+    }
+    else
+        lines = StringUtils::Split(argv[2], '|');
+    std::vector<String> names;
+    std::vector<std::vector<PatternByte>> searchpatterns;
+    for(const auto & line : lines)
+    {
+        auto trimmed = StringUtils::Trim(line);
+        if(trimmed.empty() || trimmed[0] == ';')
+            continue;
+        auto name = trimmed;
+        auto pattern = trimmed;
+        auto equals = trimmed.find('=');
+        if(equals != String::npos)
+        {
+            name = StringUtils::Trim(trimmed.substr(0, equals));
+            pattern = trimmed.substr(equals + 1);
+        }
+        std::vector<PatternByte> searchpattern;
+        if(!patterntransform(pattern, searchpattern))
+        {
+            dprintf(QT_TRANSLATE_NOOP("DBG", "Failed to transform pattern \"%s\"!\n"), pattern.c_str());
+            return false;
+        }
+        names.push_back(name);
+        searchpatterns.push_back(std::move(searchpattern));
+    }
+    PatternSet patternset;
+    if(!patternsetcompile(searchpatterns, patternset))
+    {
+        dputs(QT_TRANSLATE_NOOP("DBG", "Failed to transform pattern!"));
+        return false;
+    }
+
+    duint find_size = -1;
+    if(argc >= 4 && !valfromstring(argv[3], &find_size))
+        find_size = -1;
+
+    SHARED_ACQUIRE(LockMemoryPages);
+    std::vector<SimplePage> searchPages;
+    for(auto & itr : memoryPages)
+    {
+        if(itr.second.mbi.State != MEM_COMMIT)
+            continue;
+        SimplePage page(duint(itr.second.mbi.BaseAddress), itr.second.mbi.RegionSize);
+        if(page.address >= addr && (find_size == -1 || page.address + page.size <= addr + find_size))
+            searchPages.push_back(page);
+    }
+    SHARED_RELEASE();
+
+    DWORD ticks = GetTickCount();
+
+    std::vector<PatternSetHit> results;
+    if(!MemFindPatternsInMap(searchPages, patternset, results, maxFindResults))
+    {
+        dputs(QT_TRANSLATE_NOOP("DBG", "MemFindPatternsInMap failed!"));
+        return false;
+    }
+
+    //setup reference view
+    char patterntitle[256] = "";
+    sprintf_s(patterntitle, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Patterns: %d")), int(names.size()));
+    GuiReferenceInitialize(patterntitle);
+    GuiReferenceAddColumn(2 * sizeof(duint), GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Address")));
+    GuiReferenceAddColumn(20, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Pattern")));
+    GuiReferenceAddColumn(0, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Disassembly")));
+    GuiReferenceSetRowCount(0);
+    GuiReferenceReloadData();
+
+    int refCount = 0;
+    for(const auto & result : results)
+    {
+        char msg[deflen] = "";
+        sprintf_s(msg, "%p", result.offset);
+        GuiReferenceSetRowCount(refCount + 1);
+        GuiReferenceSetCellContent(refCount, 0, msg);
+        GuiReferenceSetCellContent(refCount, 1, names[result.id].c_str());
+        if(!GuiGetDisassembly(result.offset, msg))
+            strcpy_s(msg, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "[Error disassembling]")));
+        GuiReferenceSetCellContent(refCount, 2, msg);
+        refCount++;
+    }
+
+    GuiReferenceReloadData();
+    dprintf(QT_TRANSLATE_NOOP("DBG", "%d occurrences of %d patterns found in %ums\n"), refCount, int(names.size()), GetTickCount() - ticks);
+    varset("$result", refCount, false);
+
+    return true;
+}
+
+static bool cbFindAsm(duint addr, ZydisMnemonic mnemonic, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO* refinfo)
 {
-    if(!disasm || !basicinfo) //initialize
+    if(!basicinfo) //initialize
     {
         GuiReferenceInitialize(refinfo->name);
         GuiReferenceAddColumn(2 * sizeof(duint), GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Address")));
@@ -298,17 +407,7 @@ static bool cbFindAsm(Zydis* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO*
     const char* instruction = (const char*)refinfo->userinfo;
     bool found = !_stricmp(instruction, basicinfo->instruction);
     if(found)
-    {
-        char addrText[20] = "";
-        sprintf_s(addrText, "%p", disasm->Address());
-        GuiReferenceSetRowCount(refinfo->refcount + 1);
-        GuiReferenceSetCellContent(refinfo->refcount, 0, addrText);
-        char disassembly[GUI_MAX_DISASSEMBLY_SIZE] = "";
-        if(GuiGetDisassembly((duint)disasm->Address(), disassembly))
-            GuiReferenceSetCellContent(refinfo->refcount, 1, disassembly);
-        else
-            GuiReferenceSetCellContent(refinfo->refcount, 1, disasm->InstructionText().c_str());
-    }
+        RefAddRow(refinfo, addr);
     return found;
 }
 
@@ -372,9 +471,9 @@ struct VALUERANGE
     duint end;
 };
 
-static bool cbRefFind(Zydis* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO* refinfo)
+static bool cbRefFind(duint addr, ZydisMnemonic mnemonic, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO* refinfo)
 {
-    if(!disasm || !basicinfo) //initialize
+    if(!basicinfo) //initialize
     {
         GuiReferenceInitialize(refinfo->name);
         GuiReferenceAddColumn(sizeof(duint) * 2, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Address")));
@@ -406,17 +505,7 @@ static bool cbRefFind(Zydis* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO*
             found = true;
     }
     if(found)
-    {
-        char addrText[20] = "";
-        sprintf_s(addrText, "%p", disasm->Address());
-        GuiReferenceSetRowCount(refinfo->refcount + 1);
-        GuiReferenceSetCellContent(refinfo->refcount, 0, addrText);
-        char disassembly[GUI_MAX_DISASSEMBLY_SIZE] = "";
-        if(GuiGetDisassembly((duint)disasm->Address(), disassembly))
-            GuiReferenceSetCellContent(refinfo->refcount, 1, disassembly);
-        else
-            GuiReferenceSetCellContent(refinfo->refcount, 1, disasm->InstructionText().c_str());
-    }
+        RefAddRow(refinfo, addr);
     return found;
 }
 
@@ -454,9 +543,9 @@ bool cbInstrRefFindRange(int argc, char* argv[])
     return true;
 }
 
-static bool cbRefStr(Zydis* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO* refinfo)
+static bool cbRefStr(duint addr, ZydisMnemonic mnemonic, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO* refinfo)
 {
-    if(!disasm || !basicinfo) //initialize
+    if(!basicinfo) //initialize
     {
         GuiReferenceInitialize(refinfo->name);
         GuiReferenceAddColumn(2 * sizeof(duint), GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Address")));
@@ -473,17 +562,7 @@ static bool cbRefStr(Zydis* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO*
         return false;
     auto addRef = [&]()
     {
-        char addrText[20] = "";
-        sprintf_s(addrText, "%p", disasm->Address());
-        GuiReferenceSetRowCount(refinfo->refcount + 1);
-        GuiReferenceSetCellContent(refinfo->refcount, 0, addrText);
-        char disassembly[4096] = "";
-        if(GuiGetDisassembly((duint)disasm->Address(), disassembly))
-            GuiReferenceSetCellContent(refinfo->refcount, 1, disassembly);
-        else
-            GuiReferenceSetCellContent(refinfo->refcount, 1, disasm->InstructionText().c_str());
-        GuiReferenceSetCellContent(refinfo->refcount, 2, string);
-        refinfo->refcount++;
+        RefAddRow(refinfo, addr, { string });
     };
     if((basicinfo->type & TYPE_VALUE) == TYPE_VALUE)
     {
@@ -524,9 +603,9 @@ bool cbInstrRefStr(int argc, char* argv[])
     return true;
 }
 
-static bool cbModCallFind(Zydis* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO* refinfo)
+static bool cbModCallFind(duint addr, ZydisMnemonic mnemonic, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO* refinfo)
 {
-    if(!disasm || !basicinfo) //initialize
+    if(!basicinfo) //initialize
     {
         GuiReferenceInitialize(refinfo->name);
         GuiReferenceAddColumn(2 * sizeof(duint), GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Address")));
@@ -539,9 +618,9 @@ static bool cbModCallFind(Zydis* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFI
     duint foundaddr = 0;
     char label[MAX_LABEL_SIZE] = "";
     char module[MAX_MODULE_SIZE] = "";
-    duint base = ModBaseFromAddr(disasm->Address()), size = 0;
+    duint base = ModBaseFromAddr(addr), size = 0;
     if(!base)
-        base = MemFindBaseAddr(disasm->Address(), &size);
+        base = MemFindBaseAddr(addr, &size);
     else
         size = ModSizeFromAddr(base);
     if(!base || !size)
@@ -568,7 +647,7 @@ static bool cbModCallFind(Zydis* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFI
             }
         }
     }
-    switch(disasm->GetId())
+    switch(mnemonic)
     {
     case ZYDIS_MNEMONIC_CALL: //call dword ptr: [&api]
     case ZYDIS_MNEMONIC_MOV: //mov reg, dword ptr:[&api]
@@ -588,21 +667,7 @@ static bool cbModCallFind(Zydis* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFI
         auto symbolic = SymGetSymbolicName(foundaddr);
         if(!symbolic.length())
             symbolic = StringUtils::sprintf("%p", foundaddr);
-        char addrText[20] = "";
-        sprintf_s(addrText, "%p", disasm->Address());
-        GuiReferenceSetRowCount(refinfo->refcount + 1);
-        GuiReferenceSetCellContent(refinfo->refcount, 0, addrText);
-        char disassembly[GUI_MAX_DISASSEMBLY_SIZE] = "";
-        if(GuiGetDisassembly((duint)disasm->Address(), disassembly))
-        {
-            GuiReferenceSetCellContent(refinfo->refcount, 1, disassembly);
-            GuiReferenceSetCellContent(refinfo->refcount, 2, symbolic.c_str());
-        }
-        else
-        {
-            GuiReferenceSetCellContent(refinfo->refcount, 1, disasm->InstructionText().c_str());
-            GuiReferenceSetCellContent(refinfo->refcount, 2, symbolic.c_str());
-        }
+        RefAddRow(refinfo, addr, { symbolic });
     }
     return foundaddr != 0;
 }
@@ -712,11 +777,12 @@ struct GUIDRefInfo
     std::unordered_map<GUID, size_t, GUIDHashObject, GUIDEqualObject>* allRegisteredGUIDs;
     std::vector<GUIDInfo>* allQueriedGUIDs;
     HKEY CLSID;
+    std::mutex lock; //the callback runs on several workers at once
 };
 
-static bool cbGUIDFind(Zydis* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO* refinfo)
+static bool cbGUIDFind(duint addr, ZydisMnemonic mnemonic, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO* refinfo)
 {
-    if(!disasm || !basicinfo) //initialize
+    if(!basicinfo) //initialize
     {
         GuiReferenceInitialize(refinfo->name);
         GuiReferenceAddColumn(2 * sizeof(duint), GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Address")));
@@ -783,18 +849,9 @@ static bool cbGUIDFind(Zydis* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO
         }
         if(found)
         {
-            char addrText[20] = "";
-            sprintf_s(addrText, "%p", disasm->Address());
-            GuiReferenceSetRowCount(refinfo->refcount + 1);
-            GuiReferenceSetCellContent(refinfo->refcount, 0, addrText);
-            char disassembly[4096] = "";
-            if(GuiGetDisassembly((duint)disasm->Address(), disassembly))
-                GuiReferenceSetCellContent(refinfo->refcount, 1, disassembly);
-            else
-                GuiReferenceSetCellContent(refinfo->refcount, 1, disasm->InstructionText().c_str());
             wchar_t guidText[40];
             StringFromGUID2(guid, guidText, 40);
-            GuiReferenceSetCellContent(refinfo->refcount, 2, StringUtils::Utf16ToUtf8(guidText).c_str());
+            std::lock_guard<std::mutex> guard(refInfo->lock);
             size_t infoIndex = iterator->second;
             if(infoIndex == 0)
             {
@@ -803,9 +860,8 @@ static bool cbGUIDFind(Zydis* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO
                 refInfo->allRegisteredGUIDs->at(guid) = infoIndex;
             }
             infoIndex--;
-            GuiReferenceSetCellContent(refinfo->refcount, 3, refInfo->allQueriedGUIDs->at(infoIndex).ProgId.c_str());
-            GuiReferenceSetCellContent(refinfo->refcount, 4, refInfo->allQueriedGUIDs->at(infoIndex).Path.c_str());
-            GuiReferenceSetCellContent(refinfo->refcount, 5, refInfo->allQueriedGUIDs->at(infoIndex).Description.c_str());
+            const auto & info = refInfo->allQueriedGUIDs->at(infoIndex);
+            RefAddRow(refinfo, addr, { StringUtils::Utf16ToUtf8(guidText), info.ProgId, info.Path, info.Description });
         }
     }
     return found;
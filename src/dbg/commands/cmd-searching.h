@@ -5,6 +5,7 @@
 bool cbInstrFind(int argc, char* argv[]);
 bool cbInstrFindAll(int argc, char* argv[]);
 bool cbInstrFindAllMem(int argc, char* argv[]);
+bool cbInstrFindAllMemMulti(int argc, char* argv[]);
 bool cbInstrFindAsm(int argc, char* argv[]);
 bool cbInstrRefFind(int argc, char* argv[]);
 bool cbInstrRefFindRange(int argc, char* argv[]);
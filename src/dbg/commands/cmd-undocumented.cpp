@@ -12,6 +12,13 @@
 #include "value.h"
 #include "symbolinfo.h"
 #include "argument.h"
+#include "patternfind.h"
+#include "contextsnapshot.h"
+#include "module.h"
+#include "taskpool.h"
+#include "LinearPass.h"
+#include "breakpoint.h"
+#include "stringformat.h"
 
 bool cbBadCmd(int argc, char* argv[])
 {
@@ -113,6 +120,345 @@ bool cbDebugBenchmark(int argc, char* argv[])
     return true;
 }
 
+bool cbDebugBenchmarkPattern(int argc, char* argv[])
+{
+    //benchpattern [pattern], [size in MB], [iterations]
+    const char* patterntext = argc > 1 ? argv[1] : "48 8B ?? 24 ?8 E8";
+    duint sizemb = 64;
+    duint iterations = 4;
+    if(argc > 2 && (!valfromstring(argv[2], &sizemb, false) || !sizemb))
+        return false;
+    if(argc > 3 && (!valfromstring(argv[3], &iterations, false) || !iterations))
+        return false;
+    PatternCompiled compiled;
+    if(!patterncompile(patterntext, compiled))
+    {
+        dputs_untranslated("Failed to transform pattern!");
+        return false;
+    }
+
+    //synthetic buffers: random bytes and a zero-filled heap with sparse pointers, both with the pattern planted at the end
+    duint size = sizemb * 1024 * 1024;
+    if(size < compiled.size())
+        return false;
+    Memory<unsigned char*> random(size, "cbDebugBenchmarkPattern:random");
+    Memory<unsigned char*> heap(size, "cbDebugBenchmarkPattern:heap");
+    unsigned int seed = 0x1337;
+    for(duint i = 0; i < size; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        random()[i] = (unsigned char)(seed >> 16);
+        if(i % sizeof(duint) == 0 && (seed & 0xF00) == 0)
+            *(duint*)(heap() + (i & ~(sizeof(duint) - 1))) = duint(seed) << 12;
+    }
+    for(size_t i = 0; i < compiled.size(); i++)
+    {
+        random()[size - compiled.size() + i] = compiled.value[i];
+        heap()[size - compiled.size() + i] = compiled.value[i];
+    }
+
+    struct
+    {
+        PATTERNENGINE engine;
+        const char* name;
+    } engines[] =
+    {
+        { PATTERN_ENGINE_NAIVE, "naive" },
+        { PATTERN_ENGINE_SCALAR, "scalar" },
+        { PATTERN_ENGINE_SSE2, "sse2" },
+        { PATTERN_ENGINE_AVX2, "avx2" },
+    };
+    dprintf_untranslated("pattern: \"%s\", size: %uMB, anchor: %u/%u, auto engine: %s\n", patterntext, unsigned(sizemb), unsigned(compiled.anchor), unsigned(compiled.anchor2), patternengine() == PATTERN_ENGINE_AVX2 ? "avx2" : "sse2");
+    for(const auto & e : engines)
+    {
+        if(e.engine == PATTERN_ENGINE_AVX2 && patternengine() != PATTERN_ENGINE_AVX2)
+            continue;
+        size_t foundrandom = -1, foundheap = -1;
+        DWORD ticks = GetTickCount();
+        for(duint i = 0; i < iterations; i++)
+        {
+            foundrandom = patternfind(random(), size, compiled, e.engine);
+            foundheap = patternfind(heap(), size, compiled, e.engine);
+        }
+        DWORD elapsed = GetTickCount() - ticks;
+        double mbs = elapsed ? double(2 * sizemb * iterations) * 1000.0 / elapsed : 0.0;
+        dprintf_untranslated("%-7s %6ums (%.0f MB/s) random: %p, heap: %p\n", e.name, elapsed, mbs, foundrandom, foundheap);
+    }
+    return true;
+}
+
+template<class TInfo>
+static void benchmarkMapChanges(const char* name, duint addr, duint count, duint iterations, duint changes,
+                                bool(*set)(duint, const char*, bool),
+                                void(*getList)(std::vector<TInfo> &),
+                                bool(*getChanges)(duint, std::vector<TInfo> &, std::vector<duint> &),
+                                duint(*getGeneration)())
+{
+    char text[64] = "";
+    for(duint i = 0; i < count; i++)
+    {
+        sprintf_s(text, "%s_%p", name, addr + i);
+        set(addr + i, text, false);
+    }
+
+    //a view that polls the whole list every time against one that only fetches the changes
+    std::vector<TInfo> list, changed;
+    std::vector<duint> deleted;
+    unsigned long long listCopied = 0, changesCopied = 0;
+    DWORD listTicks = 0, changesTicks = 0;
+    auto generation = getGeneration();
+    for(duint i = 0; i < iterations; i++)
+    {
+        for(duint j = 0; j < changes; j++)
+        {
+            auto address = addr + (i * changes + j) % count;
+            sprintf_s(text, "%s_%p_%u", name, address, unsigned(i));
+            set(address, text, false);
+        }
+
+        DWORD ticks = GetTickCount();
+        getList(list);
+        listTicks += GetTickCount() - ticks;
+        listCopied += list.size();
+
+        ticks = GetTickCount();
+        auto next = getGeneration();
+        if(!getChanges(generation, changed, deleted))
+            getList(changed);
+        generation = next;
+        changesTicks += GetTickCount() - ticks;
+        changesCopied += changed.size() + deleted.size();
+    }
+    dprintf_untranslated("%-8s GetList: %6ums (%llu values), GetChangesSince: %6ums (%llu values)\n", name, listTicks, listCopied, changesTicks, changesCopied);
+}
+
+bool cbDebugBenchmarkMapChanges(int argc, char* argv[])
+{
+    //benchmapchanges [count], [iterations], [changes per iteration]
+    duint count = 100000;
+    duint iterations = 100;
+    duint changes = 16;
+    if(argc > 1 && (!valfromstring(argv[1], &count, false) || !count))
+        return false;
+    if(argc > 2 && (!valfromstring(argv[2], &iterations, false) || !iterations))
+        return false;
+    if(argc > 3 && (!valfromstring(argv[3], &changes, false) || !changes))
+        return false;
+    duint size = 0;
+    duint addr = MemFindBaseAddr(GetContextDataEx(hActiveThread, UE_CIP), &size);
+    if(!addr)
+        return false;
+    count = min(count, size);
+
+    dprintf_untranslated("count: %u, iterations: %u, changes per iteration: %u\n", unsigned(count), unsigned(iterations), unsigned(changes));
+    benchmarkMapChanges<COMMENTSINFO>("comments", addr, count, iterations, changes, CommentSet, CommentGetList, CommentGetChangesSince, CommentCacheGeneration);
+    benchmarkMapChanges<LABELSINFO>("labels", addr, count, iterations, changes, [](duint addr, const char* text, bool manual)
+    {
+        return LabelSet(addr, text, manual);
+    }, LabelGetList, LabelGetChangesSince, LabelCacheGeneration);
+    CommentDelRange(addr, addr + count, false);
+    LabelDelRange(addr, addr + count, false);
+    GuiUpdateAllViews();
+    return true;
+}
+
+bool cbDebugBenchmarkLinear(int argc, char* argv[])
+{
+    //benchlinear [size in MB], [iterations]
+    duint sizemb = 32;
+    duint iterations = 2;
+    if(argc > 1 && (!valfromstring(argv[1], &sizemb, false) || !sizemb))
+        return false;
+    if(argc > 2 && (!valfromstring(argv[2], &iterations, false) || !iterations))
+        return false;
+
+    //synthetic code: functions of random length separated by int3 padding, with int3-filled regions to vary the code density
+    static const struct
+    {
+        unsigned char bytes[5];
+        unsigned char size;
+    } instructions[] =
+    {
+        { { 0x55 }, 1 }, //push ebp
+        { { 0x8B, 0xEC }, 2 }, //mov ebp, esp
+        { { 0x89, 0x45, 0xF8 }, 3 }, //mov [ebp-8], eax
+        { { 0x83, 0xEC, 0x20 }, 3 }, //sub esp, 0x20
+        { { 0x33, 0xC0 }, 2 }, //xor eax, eax
+        { { 0xE8 }, 5 }, //call rel32
+        { { 0x74 }, 2 }, //je rel8
+        { { 0xEB }, 2 }, //jmp rel8
+    };
+    duint size = sizemb * 1024 * 1024;
+    Memory<unsigned char*> code(size, "cbDebugBenchmarkLinear:code");
+    memset(code(), 0xCC, size);
+    unsigned int seed = 0x1337;
+    auto random = [&seed]()
+    {
+        seed = seed * 1103515245 + 12345;
+        return seed >> 16;
+    };
+    for(duint i = 0; i + 0x400 < size;)
+    {
+        if(random() % 256 == 0)
+        {
+            i += 0x10000;
+            continue;
+        }
+        auto count = 5 + random() % 60;
+        for(unsigned int j = 0; j < count; j++)
+        {
+            const auto & instruction = instructions[random() % _countof(instructions)];
+            memcpy(code() + i, instruction.bytes, instruction.size);
+            for(unsigned char k = 1; k < instruction.size && !instruction.bytes[k]; k++)
+                code()[i + k] = (unsigned char)random();
+            i += instruction.size;
+        }
+        code()[i] = 0xC3; //ret
+        i += 1 + random() % 16;
+    }
+
+    const duint base = 0x10000000;
+    size_t maximum = TaskWorkerCount() + 1;
+    dprintf_untranslated("size: %uMB, iterations: %u, threads: %u\n", unsigned(sizemb), unsigned(iterations), unsigned(maximum));
+    DWORD single = 0;
+    for(size_t threads = 1; ; threads = min(threads * 2, maximum))
+    {
+        TaskSetConcurrency(threads);
+        BBlockArray blocks;
+        DWORD ticks = GetTickCount();
+        for(duint i = 0; i < iterations; i++)
+        {
+            LinearPass pass(base, base + size, code(), blocks);
+            pass.Analyse();
+        }
+        DWORD elapsed = GetTickCount() - ticks;
+        if(threads == 1)
+            single = elapsed;
+        dprintf_untranslated("%2u thread(s) %6ums (%.2fx) blocks: %u\n", unsigned(threads), elapsed, elapsed ? double(single) / elapsed : 0.0, unsigned(blocks.size()));
+        if(threads == maximum)
+            break;
+    }
+    TaskSetConcurrency(0);
+    return true;
+}
+
+bool cbDebugBenchmarkModuleLookup(int argc, char* argv[])
+{
+    //benchmodlookup [modules], [lookups]
+    duint count = 300;
+    duint lookups = 10000000;
+    if(argc > 1 && (!valfromstring(argv[1], &count, false) || !count))
+        return false;
+    if(argc > 2 && (!valfromstring(argv[2], &lookups, false) || !lookups))
+        return false;
+    ModBenchmarkLookup(count, lookups);
+    return true;
+}
+
+bool cbDebugBenchmarkBreakpointHit(int argc, char* argv[])
+{
+    //benchbphit [hits]
+    duint hits = 100000;
+    if(argc > 1 && (!valfromstring(argv[1], &hits, false) || !hits))
+        return false;
+
+    //a logging breakpoint with conditions and a command, like the ones that are hit in a loop
+    BREAKPOINT bp;
+    memset(&bp, 0, sizeof(bp));
+    strcpy_s(bp.breakCondition, "cip == 0 && csp != 0");
+    strcpy_s(bp.logText, "hit {p:cip} sp={x:csp} ax={d:cax} count={u:$breakpointcounter}");
+    strcpy_s(bp.logCondition, "($breakpointcounter & 1) == 0");
+    strcpy_s(bp.commandText, "$result = cax + 1");
+    strcpy_s(bp.commandCondition, "1");
+    dprintf_untranslated("hits: %u\n", unsigned(hits));
+
+    //the way the hit path worked before: everything is parsed on every hit
+    auto parsed = [](const char* expression)
+    {
+        duint value;
+        return !valfromstring(expression, &value) || value != 0;
+    };
+    size_t logged = 0;
+    auto ticks = GetTickCount();
+    for(duint i = 0; i < hits; i++)
+    {
+        varset("$breakpointcounter", i, true);
+        auto breakCondition = parsed(bp.breakCondition);
+        if(parsed(bp.logCondition))
+            logged += stringformatinline(bp.logText).length();
+        if(*bp.commandCondition ? parsed(bp.commandCondition) : breakCondition)
+            cmddirectexec(bp.commandText);
+    }
+    auto parsedTicks = GetTickCount() - ticks;
+
+    //the compiled program
+    bp.version = 1;
+    BpProgram program(bp);
+    ticks = GetTickCount();
+    for(duint i = 0; i < hits; i++)
+    {
+        varset("$breakpointcounter", i, true);
+        auto breakCondition = program.BreakCondition();
+        if(program.LogCondition())
+            logged -= program.Log().length();
+        if(program.CommandCondition(breakCondition))
+            program.ExecuteCommand();
+    }
+    auto compiledTicks = GetTickCount() - ticks;
+
+    auto perHit = [hits](DWORD ticks)
+    {
+        return double(ticks) * 1000000.0 / double(hits);
+    };
+    dprintf_untranslated("parsed on every hit: %ums (%.0fns per hit)\n", parsedTicks, perHit(parsedTicks));
+    dprintf_untranslated("compiled program: %ums (%.0fns per hit)\n", compiledTicks, perHit(compiledTicks));
+    if(logged)
+        dputs_untranslated("log text mismatch!");
+    varset("$result", compiledTicks, false);
+    return true;
+}
+
+bool cbDebugBenchmarkCommands(int argc, char* argv[])
+{
+    //benchcmd [iterations]
+    duint iterations = 100000;
+    if(argc > 1 && (!valfromstring(argv[1], &iterations, false) || !iterations))
+        return false;
+
+    //a scripted loop body: command lookup, argument splitting and dispatch for every command
+    const char* body = "mov $result, 1;test $result, 1;inc $result;add $result, 2";
+    const duint commands = 4;
+    auto ticks = GetTickCount();
+    for(duint i = 0; i < iterations; i++)
+        cmddirectexec(body);
+    ticks = GetTickCount() - ticks;
+
+    auto lookups = iterations * 16;
+    auto lookupTicks = GetTickCount();
+    size_t found = 0;
+    for(duint i = 0; i < lookups; i++)
+        found += cmdget(i & 1 ? "add $result, 2" : "unknowncommand 1") != nullptr;
+    lookupTicks = GetTickCount() - lookupTicks;
+
+    dprintf_untranslated("%u commands: %ums (%.0fns per command)\n", unsigned(iterations * commands), ticks, double(ticks) * 1000000.0 / double(iterations * commands));
+    dprintf_untranslated("%u lookups: %ums (%.0fns per lookup, %u found)\n", unsigned(lookups), lookupTicks, double(lookupTicks) * 1000000.0 / double(lookups), unsigned(found));
+    varset("$result", ticks, false);
+    return true;
+}
+
+bool cbDebugContextStats(int argc, char* argv[])
+{
+    CONTEXTSNAPSHOTSTATS stats;
+    ContextSnapshotGetStats(stats);
+    auto perEvent = stats.events ? double(stats.fetches) / stats.events : 0.0;
+    dprintf_untranslated("debug events: %llu, context fetches: %llu (%.2f per event), register reads served: %llu\n",
+                         (unsigned long long)stats.events, (unsigned long long)stats.fetches, perEvent, (unsigned long long)stats.reads);
+    varset("$result", stats.fetches, false);
+    if(argc > 1 && scmp(argv[1], "reset"))
+        ContextSnapshotResetStats();
+    return true;
+}
+
 bool cbInstrSetstr(int argc, char* argv[])
 {
     if(IsArgumentsLessThan(argc, 3))
@@ -319,6 +665,7 @@ bool cbInstrVisualize(int argc, char* argv[])
             BookmarkClear();
             LabelClear();
             SetContextDataEx(fdProcessInfo->hThread, UE_CIP, addr);
+            ContextSnapshotInvalidate();
             if(end)
                 BpNew(end, true, false, 0, BPNORMAL, 0, nullptr);
             if(jumpback)
@@ -371,6 +718,7 @@ bool cbInstrVisualize(int argc, char* argv[])
         BpClear();
         BookmarkClear();
         SetContextDataEx(fdProcessInfo->hThread, UE_CIP, start);
+        ContextSnapshotInvalidate();
         DebugUpdateGuiAsync(start, false);
     }
     return true;
@@ -4,6 +4,13 @@
 
 bool cbBadCmd(int argc, char* argv[]);
 bool cbDebugBenchmark(int argc, char* argv[]);
+bool cbDebugBenchmarkPattern(int argc, char* argv[]);
+bool cbDebugBenchmarkMapChanges(int argc, char* argv[]);
+bool cbDebugBenchmarkLinear(int argc, char* argv[]);
+bool cbDebugBenchmarkModuleLookup(int argc, char* argv[]);
+bool cbDebugBenchmarkBreakpointHit(int argc, char* argv[]);
+bool cbDebugBenchmarkCommands(int argc, char* argv[]);
+bool cbDebugContextStats(int argc, char* argv[]);
 bool cbInstrSetstr(int argc, char* argv[]);
 bool cbInstrGetstr(int argc, char* argv[]);
 bool cbInstrCopystr(int argc, char* argv[]);
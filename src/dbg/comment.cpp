@@ -78,6 +78,11 @@ void CommentCacheLoad(JSON Root)
     comments.CacheLoad(Root, "auto"); //legacy support
 }
 
+duint CommentCacheGeneration()
+{
+    return comments.Generation();
+}
+
 bool CommentEnum(COMMENTSINFO* List, size_t* Size)
 {
     return comments.Enum(List, Size);
@@ -93,6 +98,11 @@ void CommentGetList(std::vector<COMMENTSINFO> & list)
     comments.GetList(list);
 }
 
+bool CommentGetChangesSince(duint Generation, std::vector<COMMENTSINFO> & changed, std::vector<duint> & deleted)
+{
+    return comments.GetChangesSince(Generation, changed, deleted);
+}
+
 bool CommentGetInfo(duint Address, COMMENTSINFO* info)
 {
     return comments.GetInfo(Comments::VaKey(Address), info);
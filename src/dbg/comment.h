@@ -15,9 +15,11 @@ bool CommentDelete(duint Address);
 void CommentDelRange(duint Start, duint End, bool Manual);
 void CommentCacheSave(JSON Root);
 void CommentCacheLoad(JSON Root);
+duint CommentCacheGeneration();
 bool CommentEnum(COMMENTSINFO* List, size_t* Size);
 void CommentClear();
 void CommentGetList(std::vector<COMMENTSINFO> & list);
+bool CommentGetChangesSince(duint Generation, std::vector<COMMENTSINFO> & changed, std::vector<duint> & deleted);
 bool CommentGetInfo(duint Address, COMMENTSINFO* info);
 
 #endif // _COMMENT_H
\ No newline at end of file
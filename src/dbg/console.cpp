@@ -4,15 +4,291 @@
 */
 
 #include "console.h"
-#include "taskthread.h"
+#include <mutex>
 
-static void GuiAddLogMessageAsync(_In_z_ const char* msg)
+/**
+\brief A log record, allocated together with its text. Any thread can queue records on a lock-free
+       multiple producer single consumer queue, the log thread delivers them in batches to the sinks.
+*/
+struct LOGRECORD
+{
+    LOGRECORD* volatile next;
+    DWORD timestamp;
+    DWORD thread; //id of the thread that logged the record
+    LOGSOURCE source;
+    size_t length;
+    char text[1];
+};
+
+const size_t LOG_MAX_PENDING = 16 * 1024 * 1024; //bytes queued before the producers are throttled
+const DWORD LOG_THROTTLE_TIME = 50; //ms a throttled producer waits for the log thread before its record is dropped
+const DWORD LOG_BATCH_INTERVAL = 100; //ms between batches while there is a continuous stream of records
+
+static LOGRECORD logStub;
+static LOGRECORD* volatile logHead = &logStub; //written by the producers
+static LOGRECORD* logTail = &logStub; //only used by the log thread
+static volatile LONG logPending = 0; //bytes queued
+static volatile LONG logSleeping = 0; //the log thread waits for a record
+static volatile bool logStarted = false;
+static std::once_flag logOnce;
+static HANDLE logWakeup = nullptr;
+static HANDLE logFile = nullptr; //file sink
+static CRITICAL_SECTION logSinkLock;
+static CRITICAL_SECTION logStatsLock;
+static LOGSTATS logStats;
+static DWORD logWindowStart = 0;
+static unsigned long long logWindowRecords = 0;
+static unsigned long long logWindowBytes = 0;
+static DWORD logWindowLatency = 0;
+
+static void logpush(LOGRECORD* record)
+{
+    record->next = nullptr;
+    auto prev = (LOGRECORD*)InterlockedExchangePointer((PVOID volatile*)&logHead, record);
+    prev->next = record;
+}
+
+static LOGRECORD* logpop()
 {
-    static StringConcatTaskThread_<void(*)(const std::string &)> task([](const std::string & msg)
+    auto tail = logTail;
+    auto next = tail->next;
+    if(tail == &logStub)
     {
-        GuiAddLogMessage(msg.c_str());
+        if(!next)
+            return nullptr;
+        logTail = next;
+        tail = next;
+        next = next->next;
+    }
+    if(next)
+    {
+        logTail = next;
+        return tail;
+    }
+    if(tail != logHead) //a producer did not link its record yet
+        return nullptr;
+    logpush(&logStub);
+    next = tail->next;
+    if(next)
+    {
+        logTail = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+static bool logempty()
+{
+    return logHead == logTail && !logTail->next;
+}
+
+static void logdeliver(const std::string & batch)
+{
+    GuiAddLogMessage(batch.c_str());
+
+    auto failed = false;
+    EnterCriticalSection(&logSinkLock);
+    if(logFile)
+    {
+        DWORD written;
+        if(!WriteFile(logFile, batch.c_str(), DWORD(batch.size()), &written, nullptr))
+        {
+            CloseHandle(logFile);
+            logFile = nullptr;
+            failed = true;
+        }
+    }
+    LeaveCriticalSection(&logSinkLock);
+    if(failed)
+        dputs(QT_TRANSLATE_NOOP("DBG", "Failed to write to the log file, log redirection stopped."));
+}
+
+static DWORD WINAPI logThread(void*)
+{
+    std::string batch;
+    while(true)
+    {
+        batch.clear();
+        unsigned long long records = 0;
+        unsigned long long sourceRecords[LogSourceLast] = {};
+        unsigned long long sourceBytes[LogSourceLast] = {};
+        DWORD latency = 0;
+        while(auto record = logpop())
+        {
+            batch.append(record->text, record->length);
+            records++;
+            sourceRecords[record->source]++;
+            sourceBytes[record->source] += record->length;
+            //the timestamp is taken before the record is queued, so the current tick is never older
+            latency = max(latency, GetTickCount() - record->timestamp);
+            InterlockedExchangeAdd(&logPending, -LONG(record->length));
+            free(record);
+        }
+
+        if(!batch.empty())
+        {
+            logdeliver(batch);
+
+            EnterCriticalSection(&logStatsLock);
+            logStats.records += records;
+            logStats.bytes += batch.size();
+            for(int i = 0; i < LogSourceLast; i++)
+            {
+                logStats.sourceRecords[i] += sourceRecords[i];
+                logStats.sourceBytes[i] += sourceBytes[i];
+            }
+            auto now = GetTickCount();
+            if(!logWindowRecords) //the first batch after being idle starts a new window
+                logWindowStart = now;
+            logWindowRecords += records;
+            logWindowBytes += batch.size();
+            logWindowLatency = max(logWindowLatency, latency);
+            auto elapsed = now - logWindowStart;
+            if(elapsed >= 1000)
+            {
+                logStats.recordsPerSecond = (unsigned int)(logWindowRecords * 1000 / elapsed);
+                logStats.bytesPerSecond = (unsigned int)(logWindowBytes * 1000 / elapsed);
+                logStats.maxLatency = logWindowLatency;
+                logWindowStart += elapsed;
+                logWindowRecords = 0;
+                logWindowBytes = 0;
+                logWindowLatency = 0;
+            }
+            LeaveCriticalSection(&logStatsLock);
+
+            //give the producers some time to fill the next batch, throttled producers wake us up early
+            WaitForSingleObject(logWakeup, LOG_BATCH_INTERVAL);
+            continue;
+        }
+
+        if(!logempty()) //a producer is queueing a record
+        {
+            SwitchToThread();
+            continue;
+        }
+        InterlockedExchange(&logSleeping, 1);
+        if(!logempty())
+        {
+            InterlockedExchange(&logSleeping, 0);
+            continue;
+        }
+        WaitForSingleObject(logWakeup, INFINITE);
+    }
+    return 0;
+}
+
+static void logstart()
+{
+    std::call_once(logOnce, []
+    {
+        InitializeCriticalSection(&logSinkLock);
+        InitializeCriticalSection(&logStatsLock);
+        memset(&logStats, 0, sizeof(logStats));
+        logWakeup = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+        CloseHandle(CreateThread(nullptr, 0, logThread, nullptr, 0, nullptr));
+        logStarted = true;
     });
-    task.WakeUp(msg);
+}
+
+/**
+\brief Throttle a producer while the log thread is behind.
+\param size The size of the record that will be queued.
+\return false if the record has to be dropped.
+*/
+static bool logthrottle(size_t size)
+{
+    auto start = GetTickCount();
+    while(logPending && size_t(logPending) + size > LOG_MAX_PENDING)
+    {
+        if(GetTickCount() - start >= LOG_THROTTLE_TIME)
+        {
+            EnterCriticalSection(&logStatsLock);
+            logStats.dropped++;
+            logStats.droppedBytes += size;
+            LeaveCriticalSection(&logStatsLock);
+            return false;
+        }
+        SetEvent(logWakeup);
+        Sleep(1);
+    }
+    return true;
+}
+
+/**
+\brief Queue text for the log, it is delivered to the GUI (and the log file) by the log thread.
+\param Source Where the text comes from (for the statistics).
+\param Text The text to log.
+\param Line Append a newline if the text doesn't end with one.
+*/
+void dlog(LOGSOURCE Source, _In_z_ const char* Text, bool Line)
+{
+    auto length = strlen(Text);
+    auto newline = Line && (!length || Text[length - 1] != '\n');
+    auto size = length + (newline ? 1 : 0);
+    if(!size)
+        return;
+    if(!logStarted)
+        logstart();
+    if(logPending && size_t(logPending) + size > LOG_MAX_PENDING && !logthrottle(size))
+        return;
+
+    auto record = (LOGRECORD*)malloc(sizeof(LOGRECORD) + size);
+    if(!record)
+        return;
+    record->timestamp = GetTickCount();
+    record->thread = GetCurrentThreadId();
+    record->source = Source;
+    record->length = size;
+    memcpy(record->text, Text, length);
+    if(newline)
+        record->text[length] = '\n';
+    record->text[size] = '\0';
+    InterlockedExchangeAdd(&logPending, LONG(size));
+    logpush(record);
+    if(logSleeping && InterlockedExchange(&logSleeping, 0))
+        SetEvent(logWakeup);
+}
+
+/**
+\brief Redirect the log to a file (in addition to the GUI).
+\param FileName The file to append the log to, nullptr to stop the redirection.
+\return false if the file could not be opened.
+*/
+bool dlogredirect(_In_opt_z_ const wchar_t* FileName)
+{
+    if(!logStarted)
+        logstart();
+    HANDLE hFile = nullptr;
+    if(FileName)
+    {
+        hFile = CreateFileW(FileName, FILE_APPEND_DATA, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(hFile == INVALID_HANDLE_VALUE)
+            return false;
+    }
+    EnterCriticalSection(&logSinkLock);
+    auto hOld = logFile;
+    logFile = hFile;
+    LeaveCriticalSection(&logSinkLock);
+    if(hOld)
+        CloseHandle(hOld);
+    return true;
+}
+
+void dlogstats(LOGSTATS* Stats)
+{
+    if(!logStarted)
+        logstart();
+    EnterCriticalSection(&logStatsLock);
+    *Stats = logStats;
+    auto stale = GetTickCount() - logWindowStart >= 2000; //nothing was delivered for a while
+    LeaveCriticalSection(&logStatsLock);
+    if(stale)
+    {
+        Stats->recordsPerSecond = 0;
+        Stats->bytesPerSecond = 0;
+        Stats->maxLatency = 0;
+    }
+    Stats->pendingBytes = (unsigned int)logPending;
 }
 
 /**
@@ -22,18 +298,7 @@ static void GuiAddLogMessageAsync(_In_z_ const char* msg)
 void dputs(_In_z_ const char* Text)
 {
     // Only append the newline if the caller didn't
-    const char* TranslatedText = GuiTranslateText(Text);
-    size_t textlen = strlen(TranslatedText);
-    if(TranslatedText[textlen - 1] != '\n')
-    {
-        Memory<char*> buffer(textlen + 2, "dputs");
-        memcpy(buffer(), TranslatedText, textlen);
-        buffer()[textlen] = '\n';
-        buffer()[textlen + 1] = '\0';
-        GuiAddLogMessageAsync(buffer());
-    }
-    else
-        GuiAddLogMessageAsync(TranslatedText);
+    dlog(LogSourceDebugger, GuiTranslateText(Text), true);
 }
 
 /**
@@ -68,7 +333,7 @@ void dprintf_args(_In_z_ _Printf_format_string_ const char* Format, va_list Args
     char buffer[16384];
     vsnprintf_s(buffer, _TRUNCATE, GuiTranslateText(Format), Args);
 
-    GuiAddLogMessageAsync(buffer);
+    dlog(LogSourceDebugger, buffer);
 }
 
 /**
@@ -78,17 +343,7 @@ void dprintf_args(_In_z_ _Printf_format_string_ const char* Format, va_list Args
 void dputs_untranslated(_In_z_ const char* Text)
 {
     // Only append the newline if the caller didn't
-    size_t textlen = strlen(Text);
-    if(Text[textlen - 1] != '\n')
-    {
-        Memory<char*> buffer(textlen + 2, "dputs");
-        memcpy(buffer(), Text, textlen);
-        buffer()[textlen] = '\n';
-        buffer()[textlen + 1] = '\0';
-        GuiAddLogMessageAsync(buffer());
-    }
-    else
-        GuiAddLogMessageAsync(Text);
+    dlog(LogSourceDebugger, Text, true);
 }
 /**
 \brief Print a formatted string to the console.
@@ -100,5 +355,5 @@ void dprintf_args_untranslated(_In_z_ _Printf_format_string_ const char* Format,
     char buffer[16384];
     vsnprintf_s(buffer, _TRUNCATE, Format, Args);
 
-    GuiAddLogMessageAsync(buffer);
+    dlog(LogSourceDebugger, buffer);
 }
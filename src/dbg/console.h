@@ -3,6 +3,32 @@
 
 #include "_global.h"
 
+enum LOGSOURCE
+{
+    LogSourceDebugger, //dputs/dprintf
+    LogSourcePlugin,
+    LogSourceBreakpoint, //breakpoint log text
+    LogSourceTrace, //trace log text
+    LogSourceLast
+};
+
+struct LOGSTATS
+{
+    unsigned long long records; //delivered to the sinks
+    unsigned long long bytes;
+    unsigned long long dropped; //records dropped because the sinks could not keep up
+    unsigned long long droppedBytes;
+    unsigned long long sourceRecords[LogSourceLast];
+    unsigned long long sourceBytes[LogSourceLast];
+    unsigned int recordsPerSecond; //over the last measured second
+    unsigned int bytesPerSecond;
+    unsigned int pendingBytes; //queued, not delivered yet
+    unsigned int maxLatency; //ms between queueing and delivering a record, over the last measured second
+};
+
+void dlog(LOGSOURCE Source, _In_z_ const char* Text, bool Line = false); //Line: append a newline if the text doesn't end with one
+bool dlogredirect(_In_opt_z_ const wchar_t* FileName); //nullptr stops the redirection
+void dlogstats(LOGSTATS* Stats);
 void dputs(_In_z_ const char* Text);
 void dprintf(_In_z_ _Printf_format_string_ const char* Format, ...);
 void dprintf_args(_In_z_ _Printf_format_string_ const char* Format, va_list Args);
@@ -0,0 +1,253 @@
+/**
+ @file contextsnapshot.cpp
+
+ @brief Caches the context of the active thread for the duration of a debug event.
+ */
+
+#include "contextsnapshot.h"
+#include "debugger.h"
+#include "threading.h"
+
+static TITAN_ENGINE_CONTEXT_t snapshot;
+static HANDLE snapshotThread = nullptr;
+static bool snapshotValid = false;
+static CONTEXTSNAPSHOTSTATS snapshotStats;
+
+static bool fetchSnapshot()
+{
+    if(snapshotValid && snapshotThread == hActiveThread)
+        return true;
+    snapshotStats.fetches++;
+    snapshotValid = GetFullContextDataEx(hActiveThread, &snapshot);
+    snapshotThread = hActiveThread;
+    return snapshotValid;
+}
+
+static bool readSnapshot(DWORD index, duint & value)
+{
+    switch(index)
+    {
+    case UE_EAX:
+        value = snapshot.cax & 0xFFFFFFFF;
+        break;
+    case UE_EBX:
+        value = snapshot.cbx & 0xFFFFFFFF;
+        break;
+    case UE_ECX:
+        value = snapshot.ccx & 0xFFFFFFFF;
+        break;
+    case UE_EDX:
+        value = snapshot.cdx & 0xFFFFFFFF;
+        break;
+    case UE_EDI:
+        value = snapshot.cdi & 0xFFFFFFFF;
+        break;
+    case UE_ESI:
+        value = snapshot.csi & 0xFFFFFFFF;
+        break;
+    case UE_EBP:
+        value = snapshot.cbp & 0xFFFFFFFF;
+        break;
+    case UE_ESP:
+        value = snapshot.csp & 0xFFFFFFFF;
+        break;
+    case UE_EIP:
+        value = snapshot.cip & 0xFFFFFFFF;
+        break;
+    case UE_EFLAGS:
+        value = snapshot.eflags & 0xFFFFFFFF;
+        break;
+    case UE_DR0:
+        value = snapshot.dr0;
+        break;
+    case UE_DR1:
+        value = snapshot.dr1;
+        break;
+    case UE_DR2:
+        value = snapshot.dr2;
+        break;
+    case UE_DR3:
+        value = snapshot.dr3;
+        break;
+    case UE_DR6:
+        value = snapshot.dr6;
+        break;
+    case UE_DR7:
+        value = snapshot.dr7;
+        break;
+#ifdef _WIN64
+    case UE_RAX:
+        value = snapshot.cax;
+        break;
+    case UE_RBX:
+        value = snapshot.cbx;
+        break;
+    case UE_RCX:
+        value = snapshot.ccx;
+        break;
+    case UE_RDX:
+        value = snapshot.cdx;
+        break;
+    case UE_RDI:
+        value = snapshot.cdi;
+        break;
+    case UE_RSI:
+        value = snapshot.csi;
+        break;
+    case UE_RBP:
+        value = snapshot.cbp;
+        break;
+    case UE_RSP:
+        value = snapshot.csp;
+        break;
+    case UE_RIP:
+        value = snapshot.cip;
+        break;
+    case UE_RFLAGS:
+        value = snapshot.eflags;
+        break;
+    case UE_R8:
+        value = snapshot.r8;
+        break;
+    case UE_R9:
+        value = snapshot.r9;
+        break;
+    case UE_R10:
+        value = snapshot.r10;
+        break;
+    case UE_R11:
+        value = snapshot.r11;
+        break;
+    case UE_R12:
+        value = snapshot.r12;
+        break;
+    case UE_R13:
+        value = snapshot.r13;
+        break;
+    case UE_R14:
+        value = snapshot.r14;
+        break;
+    case UE_R15:
+        value = snapshot.r15;
+        break;
+#endif //_WIN64
+    case UE_CIP:
+        value = snapshot.cip;
+        break;
+    case UE_CSP:
+        value = snapshot.csp;
+        break;
+    case UE_SEG_GS:
+        value = snapshot.gs;
+        break;
+    case UE_SEG_FS:
+        value = snapshot.fs;
+        break;
+    case UE_SEG_ES:
+        value = snapshot.es;
+        break;
+    case UE_SEG_DS:
+        value = snapshot.ds;
+        break;
+    case UE_SEG_CS:
+        value = snapshot.cs;
+        break;
+    case UE_SEG_SS:
+        value = snapshot.ss;
+        break;
+    case UE_X87_STATUSWORD:
+        value = snapshot.x87fpu.StatusWord;
+        break;
+    case UE_X87_CONTROLWORD:
+        value = snapshot.x87fpu.ControlWord;
+        break;
+    case UE_X87_TAGWORD:
+        value = snapshot.x87fpu.TagWord;
+        break;
+    case UE_MXCSR:
+        value = snapshot.MxCsr;
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+/**
+\brief Gets the context of the active thread. The context is read from the debuggee at most once per debug event.
+\param [out] context The context of the active thread.
+\return true if the context is available, false otherwise.
+*/
+bool ContextSnapshotGet(TITAN_ENGINE_CONTEXT_t & context)
+{
+    EXCLUSIVE_ACQUIRE(LockContextSnapshot);
+    if(!fetchSnapshot())
+        return false;
+    snapshotStats.reads++;
+    context = snapshot;
+    return true;
+}
+
+/**
+\brief Drop-in replacement for GetContextDataEx(hActiveThread, index) that is served from the snapshot.
+\param index The UE_xxx register index.
+\return The register value, 0 when the context could not be read.
+*/
+duint ContextSnapshotGetRegister(DWORD index)
+{
+    EXCLUSIVE_ACQUIRE(LockContextSnapshot);
+    duint value = 0;
+    if(fetchSnapshot() && readSnapshot(index, value))
+    {
+        snapshotStats.reads++;
+        return value;
+    }
+    //registers that are not part of the snapshot (or a failed fetch) go to the debuggee directly
+    snapshotStats.fetches++;
+    return GetContextDataEx(hActiveThread, index);
+}
+
+/**
+\brief Writes a register of the active thread and marks the snapshot dirty.
+\param index The UE_xxx register index.
+\param value The new value.
+\return true if the register was written, false otherwise.
+*/
+bool ContextSnapshotSetRegister(DWORD index, duint value)
+{
+    EXCLUSIVE_ACQUIRE(LockContextSnapshot);
+    snapshotValid = false;
+    return SetContextDataEx(hActiveThread, index, value);
+}
+
+/**
+\brief Marks the snapshot dirty. Call this after the context of the active thread was changed behind its back,
+       and when entering a debugger callback (the engine adjusts cip and the debug registers between the debug event and the callback).
+*/
+void ContextSnapshotInvalidate()
+{
+    EXCLUSIVE_ACQUIRE(LockContextSnapshot);
+    snapshotValid = false;
+}
+
+/**
+\brief Called for every debug event, the next register read will fetch the context again.
+*/
+void ContextSnapshotNewEvent()
+{
+    EXCLUSIVE_ACQUIRE(LockContextSnapshot);
+    snapshotValid = false;
+    snapshotStats.events++;
+}
+
+void ContextSnapshotGetStats(CONTEXTSNAPSHOTSTATS & stats)
+{
+    EXCLUSIVE_ACQUIRE(LockContextSnapshot);
+    stats = snapshotStats;
+}
+
+void ContextSnapshotResetStats()
+{
+    EXCLUSIVE_ACQUIRE(LockContextSnapshot);
+    memset(&snapshotStats, 0, sizeof(snapshotStats));
+}
@@ -0,0 +1,22 @@
+#ifndef _CONTEXTSNAPSHOT_H
+#define _CONTEXTSNAPSHOT_H
+
+#include "_global.h"
+#include "TitanEngine/TitanEngine.h"
+
+struct CONTEXTSNAPSHOTSTATS
+{
+    duint events; //debug events seen since the last reset
+    duint fetches; //thread contexts read from the debuggee
+    duint reads; //register reads served from the snapshot
+};
+
+bool ContextSnapshotGet(TITAN_ENGINE_CONTEXT_t & context);
+duint ContextSnapshotGetRegister(DWORD index);
+bool ContextSnapshotSetRegister(DWORD index, duint value);
+void ContextSnapshotInvalidate();
+void ContextSnapshotNewEvent();
+void ContextSnapshotGetStats(CONTEXTSNAPSHOTSTATS & stats);
+void ContextSnapshotResetStats();
+
+#endif // _CONTEXTSNAPSHOT_H
@@ -25,6 +25,8 @@
 #include "argument.h"
 #include "filemap.h"
 #include "debugger.h"
+#include "lz4/lz4.h"
+#include "taskpool.h"
 
 /**
 \brief Directory where program databases are stored (usually in \db). UTF-8 encoding.
@@ -41,17 +43,134 @@ duint dbhash = 0;
 */
 char dbpath[deflen];
 
-void DbSave(DbLoadSaveType saveType, const char* dbfile, bool disablecompression)
+/**
+\brief Magic of the sectioned database file. Files without it are loaded as (LZ4 compressed) JSON.
+*/
+#define DB_FILE_MAGIC "XDB1"
+#define DB_FILE_VERSION 1
+#define DB_SECTION_LZ4 1
+
+#pragma pack(push, 1)
+struct DbFileHeader
 {
-    EXCLUSIVE_ACQUIRE(LockDatabase);
+    char magic[4];
+    unsigned int version;
+    unsigned int sectionCount;
+};
 
-    auto file = dbfile ? dbfile : dbpath;
-    auto filename = strrchr(file, '\\');
-    auto cmdlinepath = filename ? StringUtils::sprintf("%s%s.cmdline", dbbasepath, filename) : file + String(".cmdline");
-    dprintf(QT_TRANSLATE_NOOP("DBG", "Saving database to %s "), file);
-    DWORD ticks = GetTickCount();
-    JSON root = json_object();
+struct DbSectionEntry
+{
+    char name[20];
+    unsigned int flags; // DB_SECTION_*
+    unsigned long long offset; // from the start of the file
+    unsigned int storedSize; // size in the file
+    unsigned int size; // size of the JSON text
+};
+#pragma pack(pop)
+
+/**
+\brief A database section, each one is stored as a separate JSON object.
+*/
+struct DbSection
+{
+    const char* name;
+    void(*save)(JSON root);
+    void(*load)(JSON root);
+    duint(*generation)(); // nullptr if the data has no change tracking, the section is serialized on every save
+};
+
+static DbSection dbsections[] =
+{
+    { "comments", CommentCacheSave, CommentCacheLoad, CommentCacheGeneration },
+    { "labels", LabelCacheSave, LabelCacheLoad, LabelCacheGeneration },
+    { "bookmarks", BookmarkCacheSave, BookmarkCacheLoad, BookmarkCacheGeneration },
+    { "functions", FunctionCacheSave, FunctionCacheLoad, FunctionCacheGeneration },
+    { "arguments", ArgumentCacheSave, ArgumentCacheLoad, ArgumentCacheGeneration },
+    { "loops", LoopCacheSave, LoopCacheLoad, nullptr },
+    { "xrefs", XrefCacheSave, XrefCacheLoad, XrefCacheGeneration },
+    { "encodemap", EncodeMapCacheSave, EncodeMapCacheLoad, EncodeMapCacheGeneration },
+    { "tracerecord", [](JSON root) { TraceRecord.saveToDb(root); }, [](JSON root) { TraceRecord.loadFromDb(root); }, nullptr },
+    { "breakpoints", BpCacheSave, BpCacheLoad, nullptr },
+    { "watch", WatchCacheSave, WatchCacheLoad, nullptr },
+};
+
+/**
+\brief Name of the section with the command line, hash, notes, initialization script and plugin data.
+*/
+static const char* dbmiscsection = "misc";
+
+/**
+\brief A serialized section. Sections that did not change since the last save are written from here.
+*/
+struct DbSectionBlob
+{
+    bool valid = false;
+    duint generation = 0;
+    unsigned int flags = 0;
+    unsigned int size = 0;
+    std::vector<char> data;
+};
+
+static DbSectionBlob dbsectionblobs[_countof(dbsections)];
+
+/**
+\brief The database file the section blobs belong to.
+*/
+static String dbsectionblobfile;
+
+static void DbResetSectionBlobs()
+{
+    for(auto & blob : dbsectionblobs)
+        blob = DbSectionBlob();
+    dbsectionblobfile.clear();
+}
+
+static bool DbSerializeSection(JSON root, bool compress, DbSectionBlob & blob)
+{
+    blob.flags = 0;
+    blob.size = 0;
+    blob.data.clear();
+    if(!json_object_size(root)) //empty sections are not stored
+        return true;
+    auto text = json_dumps(root, JSON_COMPACT);
+    if(!text)
+        return false;
+    auto size = strlen(text);
+    blob.size = (unsigned int)size;
+    if(compress)
+    {
+        blob.data.resize(LZ4_compressBound(int(size)));
+        auto compressedSize = LZ4_compress(text, blob.data.data(), int(size));
+        if(compressedSize > 0 && size_t(compressedSize) < size)
+        {
+            blob.data.resize(compressedSize);
+            blob.flags |= DB_SECTION_LZ4;
+        }
+        else
+            blob.data.assign(text, text + size);
+    }
+    else
+        blob.data.assign(text, text + size);
+    json_free(text);
+    return true;
+}
 
+static JSON DbDeserializeSection(const char* data, const DbSectionEntry & entry)
+{
+    if(entry.flags & DB_SECTION_LZ4)
+    {
+        std::vector<char> text(entry.size);
+        if(LZ4_decompress_safe(data, text.data(), int(entry.storedSize), int(entry.size)) != int(entry.size))
+            return nullptr;
+        return json_loadb(text.data(), text.size(), 0, 0);
+    }
+    if(entry.storedSize != entry.size)
+        return nullptr;
+    return json_loadb(data, entry.size, 0, 0);
+}
+
+static void DbSaveMisc(JSON root, DbLoadSaveType saveType, const String & cmdlinepath)
+{
     // Save only command line
     if(saveType == DbLoadSaveType::CommandLine || saveType == DbLoadSaveType::All)
     {
@@ -60,17 +179,6 @@ void DbSave(DbLoadSaveType saveType, const char* dbfile, bool disablecompression
 
     if(saveType == DbLoadSaveType::DebugData || saveType == DbLoadSaveType::All)
     {
-        CommentCacheSave(root);
-        LabelCacheSave(root);
-        BookmarkCacheSave(root);
-        FunctionCacheSave(root);
-        ArgumentCacheSave(root);
-        LoopCacheSave(root);
-        XrefCacheSave(root);
-        EncodeMapCacheSave(root);
-        TraceRecord.saveToDb(root);
-        BpCacheSave(root);
-        WatchCacheSave(root);
         if(dbhash != 0)
         {
             json_object_set_new(root, "hashAlgorithm", json_string("murmurhash"));
@@ -116,10 +224,22 @@ void DbSave(DbLoadSaveType saveType, const char* dbfile, bool disablecompression
             json_object_set(root, "plugins", pluginRoot);
         json_decref(pluginRoot);
     }
+}
+
+/**
+\brief Exports the database as a single JSON document (dbsave with a file name).
+*/
+static bool DbSaveJson(DbLoadSaveType saveType, const char* file, const String & cmdlinepath, bool disablecompression)
+{
+    JSON root = json_object();
+    DbSaveMisc(root, saveType, cmdlinepath);
+    if(saveType == DbLoadSaveType::DebugData || saveType == DbLoadSaveType::All)
+    {
+        for(const auto & section : dbsections)
+            section.save(root);
+    }
 
     auto wdbpath = StringUtils::Utf8ToUtf16(file);
-    if(!dbfile)
-        CopyFileW(wdbpath.c_str(), (wdbpath + L".bak").c_str(), FALSE); //make a backup
     if(json_object_size(root))
     {
         auto dumpSuccess = false;
@@ -135,9 +255,8 @@ void DbSave(DbLoadSaveType saveType, const char* dbfile, bool disablecompression
 
         if(!dumpSuccess)
         {
-            dputs(QT_TRANSLATE_NOOP("DBG", "\nFailed to write database file!"));
             json_decref(root);
-            return;
+            return false;
         }
 
         if(!disablecompression && !settingboolget("Engine", "DisableDatabaseCompression"))
@@ -148,9 +267,222 @@ void DbSave(DbLoadSaveType saveType, const char* dbfile, bool disablecompression
         DeleteFileW(wdbpath.c_str());
         DeleteFileW(StringUtils::Utf8ToUtf16(cmdlinepath).c_str());
     }
+    json_decref(root);
+    return true;
+}
+
+/**
+\brief Saves the database as a sectioned binary file. Only the sections that changed since the last save are serialized again.
+*/
+static bool DbSaveSections(DbLoadSaveType saveType, const char* file, const String & cmdlinepath)
+{
+    auto compress = !settingboolget("Engine", "DisableDatabaseCompression");
+    if(dbsectionblobfile != file)
+    {
+        DbResetSectionBlobs();
+        dbsectionblobfile = file;
+    }
+
+    // The data sections do not call into plugins or the GUI, serialize the changed ones in parallel
+    auto saveData = saveType == DbLoadSaveType::DebugData || saveType == DbLoadSaveType::All;
+    std::vector<size_t> dirty;
+    std::vector<duint> generations(_countof(dbsections));
+    if(saveData)
+    {
+        for(size_t i = 0; i < _countof(dbsections); i++)
+        {
+            auto & blob = dbsectionblobs[i];
+            if(dbsections[i].generation)
+            {
+                // Read the generation before serializing, a concurrent change will be saved next time
+                generations[i] = dbsections[i].generation();
+                if(blob.valid && blob.generation == generations[i])
+                    continue;
+            }
+            dirty.push_back(i);
+        }
+    }
+    std::vector<unsigned char> results(dirty.size(), 0);
+    TaskParallelFor(0, dirty.size(), [&](size_t j)
+    {
+        auto i = dirty[j];
+        auto & blob = dbsectionblobs[i];
+        JSON root = json_object();
+        dbsections[i].save(root);
+        results[j] = DbSerializeSection(root, compress, blob);
+        json_decref(root);
+        blob.generation = generations[i];
+        blob.valid = results[j] && dbsections[i].generation != nullptr;
+    });
+    for(auto result : results)
+        if(!result)
+            return false;
+
+    DbSectionBlob misc;
+    {
+        JSON root = json_object();
+        DbSaveMisc(root, saveType, cmdlinepath);
+        auto result = DbSerializeSection(root, compress, misc);
+        json_decref(root);
+        if(!result)
+            return false;
+    }
+
+    // Build the section table
+    std::vector<DbSectionEntry> entries;
+    std::vector<const DbSectionBlob*> blobs;
+    auto addEntry = [&](const char* name, const DbSectionBlob & blob)
+    {
+        if(!blob.size)
+            return;
+        DbSectionEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        strncpy_s(entry.name, name, _TRUNCATE);
+        entry.flags = blob.flags;
+        entry.storedSize = (unsigned int)blob.data.size();
+        entry.size = blob.size;
+        entries.push_back(entry);
+        blobs.push_back(&blob);
+    };
+    addEntry(dbmiscsection, misc);
+    if(saveData)
+    {
+        for(size_t i = 0; i < _countof(dbsections); i++)
+            addEntry(dbsections[i].name, dbsectionblobs[i]);
+    }
+
+    auto wdbpath = StringUtils::Utf8ToUtf16(file);
+    if(entries.empty()) //remove database when nothing is in there
+    {
+        DeleteFileW(wdbpath.c_str());
+        DeleteFileW(StringUtils::Utf8ToUtf16(cmdlinepath).c_str());
+        return true;
+    }
+
+    DbFileHeader header;
+    memcpy(header.magic, DB_FILE_MAGIC, sizeof(header.magic));
+    header.version = DB_FILE_VERSION;
+    header.sectionCount = (unsigned int)entries.size();
+    auto offset = (unsigned long long)(sizeof(header) + sizeof(DbSectionEntry) * entries.size());
+    for(auto & entry : entries)
+    {
+        entry.offset = offset;
+        offset += entry.storedSize;
+    }
+
+    auto hFile = CreateFileW(wdbpath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, 0, nullptr);
+    if(hFile == INVALID_HANDLE_VALUE)
+        return false;
+    BufferedWriter bufWriter(hFile, 1024 * 1024);
+    if(!bufWriter.Write(&header, sizeof(header)) || !bufWriter.Write(entries.data(), sizeof(DbSectionEntry) * entries.size()))
+        return false;
+    for(auto blob : blobs)
+        if(!bufWriter.Write(blob->data.data(), blob->data.size()))
+            return false;
+    return true;
+}
+
+void DbSave(DbLoadSaveType saveType, const char* dbfile, bool disablecompression)
+{
+    EXCLUSIVE_ACQUIRE(LockDatabase);
+
+    auto file = dbfile ? dbfile : dbpath;
+    auto filename = strrchr(file, '\\');
+    auto cmdlinepath = filename ? StringUtils::sprintf("%s%s.cmdline", dbbasepath, filename) : file + String(".cmdline");
+    dprintf(QT_TRANSLATE_NOOP("DBG", "Saving database to %s "), file);
+    DWORD ticks = GetTickCount();
+
+    // An explicit file is exported as JSON, the program database uses the sectioned format
+    bool success;
+    if(dbfile)
+        success = DbSaveJson(saveType, file, cmdlinepath, disablecompression);
+    else
+    {
+        auto wdbpath = StringUtils::Utf8ToUtf16(file);
+        CopyFileW(wdbpath.c_str(), (wdbpath + L".bak").c_str(), FALSE); //make a backup
+        success = DbSaveSections(saveType, file, cmdlinepath);
+    }
+
+    if(!success)
+    {
+        dputs(QT_TRANSLATE_NOOP("DBG", "\nFailed to write database file!"));
+        return;
+    }
 
     dprintf(QT_TRANSLATE_NOOP("DBG", "%ums\n"), GetTickCount() - ticks);
-    json_decref(root); //free root
+}
+
+/**
+\brief Reads a sectioned database file. Returns false if the file is not in the sectioned format.
+\param loadType The data to load, sections that are not needed are skipped.
+\param [out] roots The root of every section in dbsections, followed by the misc section. Missing sections are nullptr.
+\param [out] blobs The stored data of every section in dbsections.
+\param [out] valid Set to false if the file is corrupted.
+*/
+static bool DbLoadSections(const FileMap<char> & dbMap, DbLoadSaveType loadType, std::vector<JSON> & roots, std::vector<DbSectionBlob> & blobs, bool & valid)
+{
+    valid = true;
+    auto data = dbMap.Data();
+    auto size = duint(dbMap.Size());
+    if(size < sizeof(DbFileHeader) || memcmp(data, DB_FILE_MAGIC, 4) != 0)
+        return false;
+    auto header = (const DbFileHeader*)data;
+    if(header->version != DB_FILE_VERSION || header->sectionCount > (size - sizeof(DbFileHeader)) / sizeof(DbSectionEntry))
+    {
+        valid = false;
+        return true;
+    }
+    auto entries = (const DbSectionEntry*)(data + sizeof(DbFileHeader));
+
+    // Match the entries to the sections
+    roots.assign(_countof(dbsections) + 1, nullptr);
+    blobs.assign(_countof(dbsections), DbSectionBlob());
+    std::vector<std::pair<size_t, const DbSectionEntry*>> load;
+    for(unsigned int i = 0; i < header->sectionCount; i++)
+    {
+        const auto & entry = entries[i];
+        if(entry.offset > size || entry.storedSize > size - entry.offset)
+        {
+            valid = false;
+            return true;
+        }
+        char name[sizeof(entry.name) + 1] = "";
+        memcpy(name, entry.name, sizeof(entry.name));
+        if(strcmp(name, dbmiscsection) == 0)
+        {
+            load.push_back({ _countof(dbsections), &entry });
+            continue;
+        }
+        if(loadType == DbLoadSaveType::CommandLine)
+            continue;
+        for(size_t j = 0; j < _countof(dbsections); j++)
+        {
+            if(strcmp(name, dbsections[j].name) == 0)
+            {
+                load.push_back({ j, &entry });
+                break;
+            }
+        }
+    }
+
+    // Decompress and parse the sections in parallel
+    TaskParallelFor(0, load.size(), [&](size_t i)
+    {
+        auto index = load[i].first;
+        const auto & entry = *load[i].second;
+        roots[index] = DbDeserializeSection(data + entry.offset, entry);
+        if(index < blobs.size())
+        {
+            auto & blob = blobs[index];
+            blob.flags = entry.flags;
+            blob.size = entry.size;
+            blob.data.assign(data + entry.offset, data + entry.offset + entry.storedSize);
+        }
+    });
+    for(const auto & itr : load)
+        if(!roots[itr.first])
+            valid = false;
+    return true;
 }
 
 void DbLoad(DbLoadSaveType loadType, const char* dbfile)
@@ -179,44 +511,81 @@ void DbLoad(DbLoadSaveType loadType, const char* dbfile)
     // Multi-byte (UTF8) file path converted to UTF16
     WString databasePathW = StringUtils::Utf8ToUtf16(file);
 
-    // Decompress the file if compression was enabled
-    bool useCompression = !settingboolget("Engine", "DisableDatabaseCompression");
-    LZ4_STATUS lzmaStatus = LZ4_INVALID_ARCHIVE;
+    // The root of every section followed by the misc section, a JSON database uses the same root for all of them
+    std::vector<JSON> roots;
+    std::vector<DbSectionBlob> blobs;
+    bool sectioned;
     {
-        lzmaStatus = LZ4_decompress_fileW(databasePathW.c_str(), databasePathW.c_str());
-
-        // Check return code
-        if(useCompression && lzmaStatus != LZ4_SUCCESS && lzmaStatus != LZ4_INVALID_ARCHIVE)
+        FileMap<char> dbMap;
+        if(!dbMap.Map(databasePathW.c_str()))
+        {
+            dputs(QT_TRANSLATE_NOOP("DBG", "\nFailed to read database file!"));
+            return;
+        }
+        bool valid;
+        sectioned = DbLoadSections(dbMap, loadType, roots, blobs, valid);
+        if(sectioned && !valid)
         {
+            for(auto root : roots)
+                if(root)
+                    json_decref(root);
             dputs(QT_TRANSLATE_NOOP("DBG", "\nInvalid database file!"));
             return;
         }
     }
 
-    // Map the database file
-    FileMap<char> dbMap;
-    if(!dbMap.Map(databasePathW.c_str()))
+    if(!sectioned)
     {
-        dputs(QT_TRANSLATE_NOOP("DBG", "\nFailed to read database file!"));
-        return;
-    }
+        // Decompress the file if compression was enabled
+        bool useCompression = !settingboolget("Engine", "DisableDatabaseCompression");
+        LZ4_STATUS lzmaStatus = LZ4_INVALID_ARCHIVE;
+        {
+            lzmaStatus = LZ4_decompress_fileW(databasePathW.c_str(), databasePathW.c_str());
 
-    // Deserialize JSON and validate
-    JSON root = json_loadb(dbMap.Data(), dbMap.Size(), 0, 0);
+            // Check return code
+            if(useCompression && lzmaStatus != LZ4_SUCCESS && lzmaStatus != LZ4_INVALID_ARCHIVE)
+            {
+                dputs(QT_TRANSLATE_NOOP("DBG", "\nInvalid database file!"));
+                return;
+            }
+        }
 
-    // Unmap the database file
-    dbMap.Unmap();
+        // Map the database file
+        FileMap<char> dbMap;
+        if(!dbMap.Map(databasePathW.c_str()))
+        {
+            dputs(QT_TRANSLATE_NOOP("DBG", "\nFailed to read database file!"));
+            return;
+        }
 
-    // Restore the old, compressed file
-    if(lzmaStatus != LZ4_INVALID_ARCHIVE && useCompression)
-        LZ4_compress_fileW(databasePathW.c_str(), databasePathW.c_str());
+        // Deserialize JSON and validate
+        JSON root = json_loadb(dbMap.Data(), dbMap.Size(), 0, 0);
 
-    if(!root)
-    {
-        dputs(QT_TRANSLATE_NOOP("DBG", "\nInvalid database file (JSON)!"));
-        return;
+        // Unmap the database file
+        dbMap.Unmap();
+
+        // Restore the old, compressed file
+        if(lzmaStatus != LZ4_INVALID_ARCHIVE && useCompression)
+            LZ4_compress_fileW(databasePathW.c_str(), databasePathW.c_str());
+
+        if(!root)
+        {
+            dputs(QT_TRANSLATE_NOOP("DBG", "\nInvalid database file (JSON)!"));
+            return;
+        }
+
+        roots.assign(_countof(dbsections) + 1, nullptr);
+        for(auto & sectionRoot : roots)
+            sectionRoot = json_incref(root);
+        json_decref(root);
     }
 
+    // Missing sections are loaded from an empty object, so they behave like a missing key did in the JSON format
+    for(auto & root : roots)
+        if(!root)
+            root = json_object();
+    JSON root = roots.back();
+
     // Load only command line
     if(loadType == DbLoadSaveType::CommandLine || loadType == DbLoadSaveType::All)
     {
@@ -232,17 +601,8 @@ void DbLoad(DbLoadSaveType loadType, const char* dbfile)
             dbhash = 0;
 
         // Finally load all structures
-        CommentCacheLoad(root);
-        LabelCacheLoad(root);
-        BookmarkCacheLoad(root);
-        FunctionCacheLoad(root);
-        ArgumentCacheLoad(root);
-        LoopCacheLoad(root);
-        XrefCacheLoad(root);
-        EncodeMapCacheLoad(root);
-        TraceRecord.loadFromDb(root);
-        BpCacheLoad(root);
-        WatchCacheLoad(root);
+        for(size_t i = 0; i < _countof(dbsections); i++)
+            dbsections[i].load(roots[i]);
 
         // Load notes
         const char* text = json_string_value(json_object_get(root, "notes"));
@@ -272,10 +632,26 @@ void DbLoad(DbLoadSaveType loadType, const char* dbfile)
             }
             plugincbcall(CB_LOADDB, &pluginLoadDb);
         }
+
+        // The loaded sections match the program database, the next save only has to write the changes
+        if(!dbfile && sectioned)
+        {
+            DbResetSectionBlobs();
+            dbsectionblobfile = file;
+            for(size_t i = 0; i < _countof(dbsections); i++)
+            {
+                if(!dbsections[i].generation)
+                    continue;
+                dbsectionblobs[i] = std::move(blobs[i]);
+                dbsectionblobs[i].generation = dbsections[i].generation();
+                dbsectionblobs[i].valid = true;
+            }
+        }
     }
 
-    // Free root
-    json_decref(root);
+    // Free the roots
+    for(auto & sectionRoot : roots)
+        json_decref(sectionRoot);
 
     if(loadType != DbLoadSaveType::CommandLine)
         dprintf(QT_TRANSLATE_NOOP("DBG", "%ums\n"), GetTickCount() - ticks);
@@ -289,6 +665,10 @@ void DbClose()
 
 void DbClear(bool terminating)
 {
+    {
+        EXCLUSIVE_ACQUIRE(LockDatabase);
+        DbResetSectionBlobs();
+    }
     CommentClear();
     LabelClear();
     BookmarkClear();
@@ -36,6 +36,7 @@
 #include "exprfunc.h"
 #include "debugger_cookie.h"
 #include "debugger_tracing.h"
+#include "contextsnapshot.h"
 
 // Debugging variables
 static PROCESS_INFORMATION g_pi = {0, 0, 0, 0};
@@ -245,7 +246,8 @@ void cbDebuggerPaused()
     // Clear tracing conditions
     dbgcleartracestate();
     dbgClearRtuBreakpoints();
-    // Trace record is not handled by this function currently.
+    // Make sure the trace browser sees every instruction recorded so far.
+    TraceRecord.flushRunTrace();
     // Signal thread switch warning
     if(settingboolget("Engine", "HardcoreThreadSwitchWarning"))
     {
@@ -678,22 +680,10 @@ static void printExceptionBpInfo(const BREAKPOINT & bp, duint CIP)
         dprintf(QT_TRANSLATE_NOOP("DBG", "Exception Breakpoint %s (%p) at %p!\n"), ExceptionCodeToName((unsigned int)bp.addr).c_str(), bp.addr, CIP);
 }
 
-static bool getConditionValue(const char* expression)
-{
-    auto word = *(uint16*)expression;
-    if(word == '0') // short circuit for condition "0\0"
-        return false;
-    if(word == '1') //short circuit for condition "1\0"
-        return true;
-    duint value;
-    if(valfromstring(expression, &value))
-        return value != 0;
-    return true;
-}
-
 void cbPauseBreakpoint()
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
+    ContextSnapshotInvalidate();
     auto CIP = GetContextDataEx(hActiveThread, UE_CIP);
     DeleteBPX(CIP);
     DebugUpdateGuiSetStateAsync(CIP, true);
@@ -749,6 +739,7 @@ static void handleBreakCondition(const BREAKPOINT & bp, const void* ExceptionAdd
 static void cbGenericBreakpoint(BP_TYPE bptype, void* ExceptionAddress = nullptr)
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
+    ContextSnapshotInvalidate();
     auto CIP = GetContextDataEx(hActiveThread, UE_CIP);
 
     //handle process cookie retrieval
@@ -801,6 +792,9 @@ static void cbGenericBreakpoint(BP_TYPE bptype, void* ExceptionAddress = nullptr
     // increment hit count
     InterlockedIncrement((volatile long*)&bpPtr->hitcount);
 
+    // conditions, log and command parsed once (again after they changed)
+    auto program = BpGetProgram(bpPtr);
+
     // copy the breakpoint structure and release the breakpoint lock to prevent deadlocks during the wait
     auto bp = *bpPtr;
     EXCLUSIVE_RELEASE();
@@ -812,23 +806,11 @@ static void cbGenericBreakpoint(BP_TYPE bptype, void* ExceptionAddress = nullptr
     varset("$breakpointcounter", bp.hitcount, true); //save the breakpoint counter as a variable
 
     //get condition values
-    bool breakCondition;
-    bool logCondition;
-    bool commandCondition;
-    if(*bp.breakCondition)
-        breakCondition = getConditionValue(bp.breakCondition);
-    else
-        breakCondition = true; //break if no condition is set
+    bool breakCondition = program->BreakCondition();
     if(bp.fastResume && !breakCondition) // fast resume: ignore GUI/Script/Plugin/Other if the debugger would not break
         return;
-    if(*bp.logCondition)
-        logCondition = getConditionValue(bp.logCondition);
-    else
-        logCondition = true; //log if no condition is set
-    if(*bp.commandCondition)
-        commandCondition = getConditionValue(bp.commandCondition);
-    else
-        commandCondition = breakCondition; //if no condition is set, execute the command when the debugger would break
+    bool logCondition = program->LogCondition();
+    bool commandCondition = program->CommandCondition(breakCondition);
 
     lock(WAITID_RUN);
     handleBreakCondition(bp, ExceptionAddress, CIP, breakCondition);
@@ -849,16 +831,16 @@ static void cbGenericBreakpoint(BP_TYPE bptype, void* ExceptionAddress = nullptr
     // Update breakpoint view
     DebugUpdateBreakpointsViewAsync();
 
-    if(*bp.logText && logCondition) //log
+    if(program->HasLog() && logCondition) //log
     {
-        dprintf_untranslated("%s\n", stringformatinline(bp.logText).c_str());
+        dlog(LogSourceBreakpoint, program->Log().c_str(), true);
     }
-    if(*bp.commandText && commandCondition) //command
+    if(program->HasCommand() && commandCondition) //command
     {
         //TODO: commands like run/step etc will fuck up your shit
         varset("$breakpointcondition", breakCondition ? 1 : 0, false);
         varset("$breakpointlogcondition", logCondition ? 1 : 0, true);
-        cmddirectexec(bp.commandText);
+        program->ExecuteCommand();
         duint script_breakcondition;
         if(varget("$breakpointcondition", &script_breakcondition, nullptr, nullptr))
         {
@@ -901,6 +883,7 @@ void cbMemoryBreakpoint(void* ExceptionAddress)
 void cbRunToUserCodeBreakpoint(void* ExceptionAddress)
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
+    ContextSnapshotInvalidate();
     auto CIP = GetContextDataEx(hActiveThread, UE_CIP);
     auto symbolicname = SymGetSymbolicName(CIP);
     dprintf(QT_TRANSLATE_NOOP("DBG", "User code reached at %s (%p)!"), symbolicname.c_str(), CIP);
@@ -1105,6 +1088,7 @@ void DebugSetBreakpoints()
 void cbStep()
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
+    ContextSnapshotInvalidate();
     duint CIP = GetContextDataEx(hActiveThread, UE_CIP);
     if(!stepRepeat || !--stepRepeat)
     {
@@ -1138,6 +1122,7 @@ static void cbRtrFinalStep(bool checkRepeat = false)
     {
         dbgcleartracestate();
         hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
+        ContextSnapshotInvalidate();
         duint CIP = GetContextDataEx(hActiveThread, UE_CIP);
         // Trace record
         _dbg_dbgtraceexecute(CIP);
@@ -1158,6 +1143,7 @@ static void cbRtrFinalStep(bool checkRepeat = false)
 void cbRtrStep()
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
+    ContextSnapshotInvalidate();
     unsigned char ch = 0x90;
     duint cip = GetContextDataEx(hActiveThread, UE_CIP);
     MemRead(cip, &ch, 1);
@@ -1239,14 +1225,16 @@ static void cbTraceUniversalConditionalStep(duint cip, bool bStepInto, void(*cal
 static void cbTraceXConditionalStep(bool bStepInto, void (*callback)())
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
-    cbTraceUniversalConditionalStep(GetContextDataEx(hActiveThread, UE_CIP), bStepInto, callback, false);
+    ContextSnapshotInvalidate();
+    cbTraceUniversalConditionalStep(ContextSnapshotGetRegister(UE_CIP), bStepInto, callback, false);
 }
 
 static void cbTraceXXTraceRecordStep(bool bStepInto, bool bInto, void(*callback)())
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
-    auto cip = GetContextDataEx(hActiveThread, UE_CIP);
-    auto forceBreakTrace = TraceRecord.getTraceRecordType(cip) != TraceRecordManager::TraceRecordNone && (TraceRecord.getHitCount(cip) == 0) ^ bInto;
+    ContextSnapshotInvalidate();
+    auto cip = ContextSnapshotGetRegister(UE_CIP);
+    auto forceBreakTrace = TraceRecord.getExecuteRecordType(cip) != TraceRecordManager::TraceRecordNone && (TraceRecord.getHitCount(cip) == 0) ^ bInto;
     cbTraceUniversalConditionalStep(cip, bStepInto, callback, forceBreakTrace);
 }
 
@@ -1431,6 +1419,7 @@ static void cbCreateThread(CREATE_THREAD_DEBUG_INFO* CreateThread)
     ThreadCreate(CreateThread); //update thread list
     DWORD dwThreadId = ((DEBUG_EVENT*)GetDebugData())->dwThreadId;
     hActiveThread = ThreadGetHandle(dwThreadId);
+    ContextSnapshotInvalidate();
 
     PLUG_CB_CREATETHREAD callbackInfo;
     callbackInfo.CreateThread = CreateThread;
@@ -1493,6 +1482,7 @@ static void cbExitThread(EXIT_THREAD_DEBUG_INFO* ExitThread)
     // EXIT_PROCESS_DEBUG_EVENT is signalled.
     // Switch to the main thread (because the thread is terminated).
     hActiveThread = ThreadGetHandle(fdProcessInfo->dwThreadId);
+    ContextSnapshotInvalidate();
     if(!hActiveThread)
     {
         std::vector<THREADINFO> threads;
@@ -1548,6 +1538,7 @@ static DWORD WINAPI cbInitializationScriptThread(void*)
 static void cbSystemBreakpoint(void* ExceptionData) // TODO: System breakpoint event shouldn't be dropped
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
+    ContextSnapshotInvalidate();
 
     //Get on top of things
     SetForegroundWindow(GuiGetWindowHandle());
@@ -1594,6 +1585,7 @@ static void cbSystemBreakpoint(void* ExceptionData) // TODO: System breakpoint e
 static void cbLoadDll(LOAD_DLL_DEBUG_INFO* LoadDll)
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
+    ContextSnapshotInvalidate();
     void* base = LoadDll->lpBaseOfDll;
 
     char DLLDebugFileName[deflen] = "";
@@ -1736,6 +1728,7 @@ static void cbLoadDll(LOAD_DLL_DEBUG_INFO* LoadDll)
 static void cbUnloadDll(UNLOAD_DLL_DEBUG_INFO* UnloadDll)
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
+    ContextSnapshotInvalidate();
     PLUG_CB_UNLOADDLL callbackInfo;
     callbackInfo.UnloadDll = UnloadDll;
     plugincbcall(CB_UNLOADDLL, &callbackInfo);
@@ -1776,6 +1769,7 @@ static void cbOutputDebugString(OUTPUT_DEBUG_STRING_INFO* DebugString)
 {
 
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
+    ContextSnapshotInvalidate();
     PLUG_CB_OUTPUTDEBUGSTRING callbackInfo;
     callbackInfo.DebugString = DebugString;
     plugincbcall(CB_OUTPUTDEBUGSTRING, &callbackInfo);
@@ -1828,6 +1822,7 @@ static bool dbgdetachDisableAllBreakpoints(const BREAKPOINT* bp)
 static void cbException(EXCEPTION_DEBUG_INFO* ExceptionData)
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
+    ContextSnapshotInvalidate();
     PLUG_CB_EXCEPTION callbackInfo;
     callbackInfo.Exception = ExceptionData;
     unsigned int ExceptionCode = ExceptionData->ExceptionRecord.ExceptionCode;
@@ -1878,7 +1873,7 @@ static void cbException(EXCEPTION_DEBUG_INFO* ExceptionData)
             wait(WAITID_RUN);
             return;
         }
-        SetContextDataEx(hActiveThread, UE_CIP, (duint)ExceptionData->ExceptionRecord.ExceptionAddress);
+        ContextSnapshotSetRegister(UE_CIP, (duint)ExceptionData->ExceptionRecord.ExceptionAddress);
     }
     else if(ExceptionData->ExceptionRecord.ExceptionCode == MS_VC_EXCEPTION) //SetThreadName exception
     {
@@ -1936,6 +1931,7 @@ static void cbException(EXCEPTION_DEBUG_INFO* ExceptionData)
 static void cbDebugEvent(DEBUG_EVENT* DebugEvent)
 {
     InterlockedIncrement((volatile long*)&DbgEvents);
+    ContextSnapshotNewEvent();
     PLUG_CB_DEBUGEVENT debugEventInfo;
     debugEventInfo.DebugEvent = DebugEvent;
     plugincbcall(CB_DEBUGEVENT, &debugEventInfo);
@@ -79,7 +79,7 @@ struct TraceState
             }
         }
         else
-            dprintf_untranslated("%s\n", text.c_str());
+            dlog(LogSourceTrace, text.c_str(), true);
     }
 
     bool IsActive() const
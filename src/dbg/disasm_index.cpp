@@ -0,0 +1,281 @@
+/**
+ @file disasm_index.cpp
+
+ @brief Implements a cache of decoded instruction ranges shared by the reference searches and the analyses.
+ */
+
+#include "disasm_index.h"
+#include "disasm_fast.h"
+#include "threading.h"
+#include "murmurhash.h"
+#include <algorithm>
+#include "taskpool.h"
+
+struct DisasmIndexEntry
+{
+    std::shared_ptr<const DisasmIndex> index;
+    duint hash;
+    duint lastUse;
+};
+
+static const size_t DisasmIndexMaxCount = 8;
+static std::vector<DisasmIndexEntry> indexes;
+static duint indexUseCounter = 0;
+
+static const duint DisasmIndexChunkSize = 0x40000;
+static const duint DisasmIndexResync = 256;
+
+DisasmIndex::DisasmIndex(duint base, duint size)
+    : mBase(base),
+      mSize(size)
+{
+}
+
+DisasmIndex::DisasmIndex(duint base, duint size, const unsigned char* data)
+    : DisasmIndex(base, size)
+{
+    auto chunkCount = size_t((size + DisasmIndexChunkSize - 1) / DisasmIndexChunkSize);
+    if(chunkCount <= 1 || size > 0xFFFFFFFF)
+    {
+        decode(data, 0, size, nullptr);
+    }
+    else
+    {
+        // Decode the chunks in parallel. Every chunk starts a bit before its boundary, so its
+        // instruction stream has resynchronised with the one of the previous chunk by then.
+        std::vector<DisasmIndex> chunks(chunkCount, DisasmIndex(base, size));
+        std::vector<std::vector<unsigned int>> offsets(chunkCount);
+        std::vector<duint> ends(chunkCount);
+        TaskParallelFor(0, chunkCount, [&](size_t i)
+        {
+            auto start = i * DisasmIndexChunkSize;
+            auto end = min(start + DisasmIndexChunkSize, size);
+            start -= min(start, DisasmIndexResync);
+            ends[i] = chunks[i].decode(data, start, end, &offsets[i]);
+        });
+
+        // Stitch the chunks together where their instruction streams meet
+        duint position = 0;
+        for(size_t i = 0; i < chunkCount; i++)
+        {
+            auto chunkEnd = min((i + 1) * DisasmIndexChunkSize, size);
+            const auto & chunkOffsets = offsets[i];
+            while(position < chunkEnd)
+            {
+                auto found = std::lower_bound(chunkOffsets.begin(), chunkOffsets.end(), (unsigned int)position);
+                if(found != chunkOffsets.end() && *found == position)
+                {
+                    append(chunks[i], found - chunkOffsets.begin());
+                    position = ends[i];
+                    break;
+                }
+                // Not synchronised (yet), decode the next instruction of our own stream
+                position = decode(data, position, position + 1, nullptr);
+            }
+            // Free the chunk memory as soon as possible
+            chunks[i] = DisasmIndex(base, size);
+            std::vector<unsigned int>().swap(offsets[i]);
+        }
+    }
+
+    // Checkpoints to split the index between workers
+    auto cursor = Begin();
+    for(size_t i = 0; i < mLengths.size(); i++)
+    {
+        if(i % CheckpointInterval == 0)
+            mCheckpoints.push_back(cursor);
+        auto flags = mFlags[i];
+        if(flags & (FlagValue | FlagAddr))
+            cursor.value++;
+        if(flags & FlagMemory)
+            cursor.memory++;
+        cursor.addr += mLengths[i];
+        cursor.instruction++;
+    }
+}
+
+/**
+\brief Decodes the instructions that start in [start, end) and appends them to the arrays.
+\param data The bytes of the whole range.
+\param start Offset of the first instruction.
+\param end The offset where no more instructions are started.
+\param [out] offsets If not null, the offset of every instruction is appended here.
+\return The offset after the last instruction.
+*/
+duint DisasmIndex::decode(const unsigned char* data, duint start, duint end, std::vector<unsigned int>* offsets)
+{
+    Zydis cp;
+    BASIC_INSTRUCTION_INFO basicinfo;
+    duint i = start;
+    while(i < end)
+    {
+        if(offsets)
+            offsets->push_back((unsigned int)i);
+
+        // Prevent going past the boundary
+        auto disasmMaxSize = min(duint(MAX_DISASM_BUFFER), mSize - i);
+        if(!cp.Disassemble(mBase + i, data + i, int(disasmMaxSize)))
+        {
+            // Invalid instruction detected, so just skip the byte
+            mLengths.push_back(1);
+            mFlags.push_back(0);
+            mMnemonics.push_back(ZYDIS_MNEMONIC_INVALID);
+            i++;
+            continue;
+        }
+
+        fillbasicinfo(&cp, &basicinfo, false);
+        unsigned char flags = FlagDecoded;
+        if(basicinfo.branch)
+            flags |= FlagBranch;
+        if(basicinfo.call)
+            flags |= FlagCall;
+        if(basicinfo.type & TYPE_ADDR)
+        {
+            flags |= FlagAddr;
+            mValues.push_back(basicinfo.addr);
+            mValueSizes.push_back(0);
+        }
+        else if(basicinfo.type & TYPE_VALUE)
+        {
+            flags |= FlagValue;
+            mValues.push_back(basicinfo.value.value);
+            mValueSizes.push_back((unsigned char)basicinfo.value.size);
+        }
+        if(basicinfo.type & TYPE_MEMORY)
+        {
+            flags |= FlagMemory;
+            mMemoryValues.push_back(basicinfo.memory.value);
+            mMemorySizes.push_back((unsigned char)basicinfo.memory.size);
+        }
+        mLengths.push_back((unsigned char)cp.Size());
+        mFlags.push_back(flags);
+        mMnemonics.push_back((unsigned short)cp.GetId());
+        mInstructionCount++;
+        i += cp.Size();
+    }
+    return i;
+}
+
+void DisasmIndex::append(const DisasmIndex & chunk, size_t first)
+{
+    auto cursor = chunk.cursorAt(first);
+    mLengths.insert(mLengths.end(), chunk.mLengths.begin() + first, chunk.mLengths.end());
+    mFlags.insert(mFlags.end(), chunk.mFlags.begin() + first, chunk.mFlags.end());
+    mMnemonics.insert(mMnemonics.end(), chunk.mMnemonics.begin() + first, chunk.mMnemonics.end());
+    mValues.insert(mValues.end(), chunk.mValues.begin() + cursor.value, chunk.mValues.end());
+    mValueSizes.insert(mValueSizes.end(), chunk.mValueSizes.begin() + cursor.value, chunk.mValueSizes.end());
+    mMemoryValues.insert(mMemoryValues.end(), chunk.mMemoryValues.begin() + cursor.memory, chunk.mMemoryValues.end());
+    mMemorySizes.insert(mMemorySizes.end(), chunk.mMemorySizes.begin() + cursor.memory, chunk.mMemorySizes.end());
+    mInstructionCount += std::count_if(chunk.mFlags.begin() + first, chunk.mFlags.end(), [](unsigned char flags)
+    {
+        return (flags & FlagDecoded) != 0;
+    });
+}
+
+DisasmIndex::Cursor DisasmIndex::cursorAt(size_t instruction) const
+{
+    auto cursor = Begin();
+    if(!mCheckpoints.empty())
+        cursor = mCheckpoints[min(instruction / CheckpointInterval, mCheckpoints.size() - 1)];
+    for(; cursor.instruction < instruction; cursor.instruction++)
+    {
+        auto flags = mFlags[cursor.instruction];
+        if(flags & (FlagValue | FlagAddr))
+            cursor.value++;
+        if(flags & FlagMemory)
+            cursor.memory++;
+        cursor.addr += mLengths[cursor.instruction];
+    }
+    return cursor;
+}
+
+std::vector<DisasmIndex::Cursor> DisasmIndex::Split(size_t count) const
+{
+    std::vector<Cursor> parts;
+    count = max(size_t(1), min(count, mCheckpoints.size()));
+    for(size_t i = 0; i < count; i++)
+        parts.push_back(mCheckpoints.empty() ? Begin() : mCheckpoints[i * mCheckpoints.size() / count]);
+    parts.push_back(End());
+    return parts;
+}
+
+size_t DisasmIndex::MemoryUsage() const
+{
+    return mLengths.capacity() + mFlags.capacity() + mMnemonics.capacity() * sizeof(unsigned short) +
+           mValues.capacity() * sizeof(duint) + mValueSizes.capacity() +
+           mMemoryValues.capacity() * sizeof(duint) + mMemorySizes.capacity() +
+           mCheckpoints.capacity() * sizeof(Cursor);
+}
+
+/**
+\brief Gets the instruction index of a memory range, decoding it only when the range was not indexed before or its bytes changed.
+\param base The start of the range.
+\param size The size of the range.
+\param data The current bytes of the range (size bytes).
+\return The index of the range.
+*/
+std::shared_ptr<const DisasmIndex> DisasmIndexGet(duint base, duint size, const unsigned char* data)
+{
+    // Ranges that are too large to hash are never cached
+    if(size > 0x7FFFFFFF)
+        return std::make_shared<DisasmIndex>(base, size, data);
+    // The debuggee can change its own code, so the bytes are compared by hash every time
+    duint hash = duint(murmurhash(data, int(size)));
+    {
+        EXCLUSIVE_ACQUIRE(LockDisasmIndex);
+        for(auto & entry : indexes)
+        {
+            if(entry.index->Base() == base && entry.index->Size() == size && entry.hash == hash)
+            {
+                entry.lastUse = ++indexUseCounter;
+                return entry.index;
+            }
+        }
+    }
+
+    auto index = std::make_shared<const DisasmIndex>(base, size, data);
+
+    EXCLUSIVE_ACQUIRE(LockDisasmIndex);
+    // Replace a stale index of the same range, otherwise evict the least recently used one
+    auto found = std::find_if(indexes.begin(), indexes.end(), [base, size](const DisasmIndexEntry & entry)
+    {
+        return entry.index->Base() == base && entry.index->Size() == size;
+    });
+    if(found == indexes.end() && indexes.size() >= DisasmIndexMaxCount)
+    {
+        found = std::min_element(indexes.begin(), indexes.end(), [](const DisasmIndexEntry & a, const DisasmIndexEntry & b)
+        {
+            return a.lastUse < b.lastUse;
+        });
+    }
+    DisasmIndexEntry entry;
+    entry.index = index;
+    entry.hash = hash;
+    entry.lastUse = ++indexUseCounter;
+    if(found != indexes.end())
+        *found = entry;
+    else
+        indexes.push_back(entry);
+    return index;
+}
+
+/**
+\brief Drops the indexes that overlap a memory range, call this when the debugger writes to memory.
+\param addr The start of the range.
+\param size The size of the range.
+*/
+void DisasmIndexInvalidate(duint addr, duint size)
+{
+    EXCLUSIVE_ACQUIRE(LockDisasmIndex);
+    indexes.erase(std::remove_if(indexes.begin(), indexes.end(), [addr, size](const DisasmIndexEntry & entry)
+    {
+        return addr < entry.index->Base() + entry.index->Size() && entry.index->Base() < addr + size;
+    }), indexes.end());
+}
+
+void DisasmIndexClear()
+{
+    EXCLUSIVE_ACQUIRE(LockDisasmIndex);
+    indexes.clear();
+}
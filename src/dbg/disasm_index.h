@@ -0,0 +1,156 @@
+#ifndef _DISASM_INDEX_H
+#define _DISASM_INDEX_H
+
+#include "_global.h"
+#include <zydis_wrapper.h>
+#include <memory>
+
+/**
+\brief Linear sweep of a memory range (usually a module or one of its regions), decoded once.
+       The instructions are stored as a structure of arrays: one length, flags and mnemonic per
+       instruction, the immediate/branch target and memory operand values only for the
+       instructions that have them (in the order the instructions appear).
+*/
+class DisasmIndex
+{
+public:
+    enum
+    {
+        FlagDecoded = 1 << 0, //cleared for bytes that could not be decoded (length 1)
+        FlagValue = 1 << 1, //TYPE_VALUE
+        FlagMemory = 1 << 2, //TYPE_MEMORY
+        FlagAddr = 1 << 3, //TYPE_ADDR
+        FlagBranch = 1 << 4,
+        FlagCall = 1 << 5,
+    };
+
+    //position in the arrays, used to split the index between workers
+    struct Cursor
+    {
+        size_t instruction;
+        size_t value;
+        size_t memory;
+        duint addr;
+    };
+
+    DisasmIndex(duint base, duint size, const unsigned char* data);
+
+    duint Base() const
+    {
+        return mBase;
+    }
+
+    duint Size() const
+    {
+        return mSize;
+    }
+
+    size_t InstructionCount() const
+    {
+        return mInstructionCount;
+    }
+
+    size_t MemoryUsage() const;
+
+    Cursor Begin() const
+    {
+        return Cursor{ 0, 0, 0, mBase };
+    }
+
+    Cursor End() const
+    {
+        return Cursor{ mLengths.size(), mValues.size(), mMemoryValues.size(), mBase + mSize };
+    }
+
+    /**
+    \brief Splits the index in at most count parts of roughly the same number of instructions.
+    \return The part boundaries, the first one is Begin() and the last one is End().
+    */
+    std::vector<Cursor> Split(size_t count) const;
+
+    /**
+    \brief Calls cb(duint addr, ZydisMnemonic mnemonic, BASIC_INSTRUCTION_INFO & basicinfo) for every decoded instruction in [begin, end).
+           The instruction and memory.mnemonic text of basicinfo is always empty.
+    */
+    template<class Callback>
+    void ForEach(const Cursor & begin, const Cursor & end, Callback && cb) const
+    {
+        BASIC_INSTRUCTION_INFO basicinfo;
+        memset(&basicinfo, 0, sizeof(basicinfo));
+        auto valueIndex = begin.value, memoryIndex = begin.memory;
+        auto addr = begin.addr;
+        for(auto i = begin.instruction; i < end.instruction; i++)
+        {
+            auto length = mLengths[i];
+            auto flags = mFlags[i];
+            if(flags & FlagDecoded)
+            {
+                basicinfo.type = 0;
+                basicinfo.addr = 0;
+                basicinfo.value.value = 0;
+                basicinfo.value.size = VALUE_SIZE(0);
+                basicinfo.memory.value = 0;
+                basicinfo.memory.size = MEMORY_SIZE(0);
+                basicinfo.branch = (flags & FlagBranch) != 0;
+                basicinfo.call = (flags & FlagCall) != 0;
+                basicinfo.size = length;
+                if(flags & (FlagValue | FlagAddr))
+                {
+                    basicinfo.value.value = mValues[valueIndex];
+                    if(flags & FlagAddr)
+                    {
+                        basicinfo.type |= TYPE_ADDR;
+                        basicinfo.addr = mValues[valueIndex];
+                    }
+                    else
+                    {
+                        basicinfo.type |= TYPE_VALUE;
+                        basicinfo.value.size = VALUE_SIZE(mValueSizes[valueIndex]);
+                    }
+                    valueIndex++;
+                }
+                if(flags & FlagMemory)
+                {
+                    basicinfo.type |= TYPE_MEMORY;
+                    basicinfo.memory.value = mMemoryValues[memoryIndex];
+                    basicinfo.memory.size = MEMORY_SIZE(mMemorySizes[memoryIndex]);
+                    memoryIndex++;
+                }
+                cb(addr, ZydisMnemonic(mMnemonics[i]), basicinfo);
+            }
+            addr += length;
+        }
+    }
+
+    template<class Callback>
+    void ForEach(Callback && cb) const
+    {
+        ForEach(Begin(), End(), cb);
+    }
+
+private:
+    DisasmIndex(duint base, duint size);
+    duint decode(const unsigned char* data, duint start, duint end, std::vector<unsigned int>* offsets);
+    void append(const DisasmIndex & chunk, size_t first);
+    Cursor cursorAt(size_t instruction) const;
+
+    static const size_t CheckpointInterval = 0x1000;
+
+    duint mBase;
+    duint mSize;
+    size_t mInstructionCount = 0;
+    std::vector<unsigned char> mLengths;
+    std::vector<unsigned char> mFlags;
+    std::vector<unsigned short> mMnemonics;
+    std::vector<duint> mValues;
+    std::vector<unsigned char> mValueSizes;
+    std::vector<duint> mMemoryValues;
+    std::vector<unsigned char> mMemorySizes;
+    std::vector<Cursor> mCheckpoints; //one every CheckpointInterval instructions
+};
+
+std::shared_ptr<const DisasmIndex> DisasmIndexGet(duint base, duint size, const unsigned char* data);
+void DisasmIndexInvalidate(duint addr, duint size);
+void DisasmIndexClear();
+
+#endif // _DISASM_INDEX_H
@@ -1,46 +1,142 @@
 #include "encodemap.h"
-#include <unordered_map>
+#include <unordered_set>
 #include "addrinfo.h"
 #include <zydis_wrapper.h>
 
+// Elements of one type at start, start + stride, ... with enc_middle in between (the last element can be cut off)
+struct ENCODERUN
+{
+    duint start; //offset in the region
+    duint size;
+    duint stride;
+    ENCODETYPE type;
+};
+
+typedef std::vector<ENCODERUN> ENCODERUNS; //sorted by start and not overlapping, the gaps are enc_unknown
+
 struct ENCODEMAP : AddrInfo
 {
     duint size;
-    byte* data;
+    ENCODERUNS runs;
 };
 
-std::unordered_map<duint, duint> referenceCount;
+// Buffers handed out by EncodeMapGetBuffer that were not released yet
+static std::unordered_set<void*> encodeBuffers;
 
-void IncreaseReferenceCount(void* buffer, bool lock = true)
+static void encodeRunsAppend(ENCODERUNS & runs, duint start, duint size, ENCODETYPE type)
 {
-    if(lock)
+    if(!runs.empty())
     {
-        EXCLUSIVE_ACQUIRE(LockEncodeMaps);
+        auto & last = runs.back();
+        if(last.type == type && last.stride == size && last.start + last.size == start && last.size % last.stride == 0)
+        {
+            last.size += size;
+            return;
+        }
     }
-    auto iter = referenceCount.find((duint)buffer);
-    if(iter == referenceCount.end())
-        referenceCount[(duint)buffer] = 1;
-    else
-        referenceCount[(duint)buffer]++;
+    ENCODERUN run;
+    run.start = start;
+    run.size = size;
+    run.stride = size;
+    run.type = type;
+    runs.push_back(run);
 }
 
-duint DecreaseReferenceCount(void* buffer, bool lock = true)
+static void encodeRunsFromBytes(const byte* data, duint size, duint offset, ENCODERUNS & runs)
 {
-    if(lock)
+    for(duint i = 0; i < size;)
     {
-        EXCLUSIVE_ACQUIRE(LockEncodeMaps);
+        auto type = ENCODETYPE(data[i]);
+        if(type == enc_unknown || type == enc_middle) //orphaned middle bytes have no element to belong to
+        {
+            i++;
+            continue;
+        }
+        duint elementSize = 1;
+        while(i + elementSize < size && data[i + elementSize] == enc_middle)
+            elementSize++;
+        encodeRunsAppend(runs, offset + i, elementSize, type);
+        i += elementSize;
     }
-    auto iter = referenceCount.find((duint)buffer);
-    if(iter == referenceCount.end())
-        return -1;
-    if(iter->second == 1)
+}
+
+static void encodeRunsToBytes(const ENCODERUNS & runs, byte* data, duint size)
+{
+    for(const auto & run : runs)
     {
-        referenceCount.erase(iter->first);
-        return 0;
+        if(run.start >= size)
+            break;
+        auto runSize = min(run.size, size - run.start);
+        if(run.stride == 1)
+        {
+            memset(data + run.start, (byte)run.type, runSize);
+            continue;
+        }
+        memset(data + run.start, (byte)enc_middle, runSize);
+        for(duint i = 0; i < runSize; i += run.stride)
+            data[run.start + i] = (byte)run.type;
     }
-    else
-        referenceCount[iter->first]--;
-    return iter->second;
+}
+
+// Returns the run containing offset or runs.end()
+static ENCODERUNS::const_iterator encodeRunsFind(const ENCODERUNS & runs, duint offset)
+{
+    auto found = std::upper_bound(runs.begin(), runs.end(), offset, [](duint offset, const ENCODERUN & run)
+    {
+        return offset < run.start;
+    });
+    if(found == runs.begin())
+        return runs.end();
+    --found;
+    return offset - found->start < found->size ? found : runs.end();
+}
+
+static ENCODETYPE encodeRunsGetType(const ENCODERUNS & runs, duint offset)
+{
+    auto found = encodeRunsFind(runs, offset);
+    if(found == runs.end())
+        return enc_unknown;
+    return (offset - found->start) % found->stride ? enc_middle : found->type;
+}
+
+// Replaces [start, start + size) with the sorted runs in replacement, the elements cut at the end of the range become enc_unknown
+static void encodeRunsReplace(ENCODERUNS & runs, duint start, duint size, const ENCODERUNS & replacement)
+{
+    auto end = start + size;
+    auto first = std::upper_bound(runs.begin(), runs.end(), start, [](duint start, const ENCODERUN & run)
+    {
+        return start < run.start;
+    });
+    if(first != runs.begin() && std::prev(first)->start + std::prev(first)->size > start)
+        --first;
+    auto last = first;
+    while(last != runs.end() && last->start < end)
+        ++last;
+
+    ENCODERUNS merged;
+    merged.reserve(replacement.size() + 2);
+    if(first != last && first->start < start)
+    {
+        auto head = *first;
+        head.size = start - head.start;
+        merged.push_back(head);
+    }
+    merged.insert(merged.end(), replacement.begin(), replacement.end());
+    if(first != last)
+    {
+        auto tail = *std::prev(last);
+        auto tailEnd = tail.start + tail.size;
+        //the first element that starts at or after the end of the range
+        auto skip = (end - tail.start + tail.stride - 1) / tail.stride * tail.stride;
+        if(tail.start + skip < tailEnd)
+        {
+            tail.start += skip;
+            tail.size = tailEnd - tail.start;
+            merged.push_back(tail);
+        }
+    }
+    first = runs.erase(first, last);
+    runs.insert(first, merged.begin(), merged.end());
 }
 
 struct EncodeMapSerializer : AddrInfoSerializer<ENCODEMAP>
@@ -48,7 +144,18 @@ struct EncodeMapSerializer : AddrInfoSerializer<ENCODEMAP>
     bool Save(const ENCODEMAP & value) override
     {
         AddrInfoSerializer::Save(value);
-        setString("data", StringUtils::ToCompressedHex(value.data, value.size));
+        setHex("size", value.size);
+        auto jsonRuns = json_array();
+        for(const auto & run : value.runs)
+        {
+            auto jsonRun = json_array();
+            json_array_append_new(jsonRun, json_hex(run.start));
+            json_array_append_new(jsonRun, json_hex(run.size));
+            json_array_append_new(jsonRun, json_hex(run.stride));
+            json_array_append_new(jsonRun, json_integer(run.type));
+            json_array_append_new(jsonRuns, jsonRun);
+        }
+        set("runs", jsonRuns);
         return true;
     }
 
@@ -56,18 +163,38 @@ struct EncodeMapSerializer : AddrInfoSerializer<ENCODEMAP>
     {
         if(!AddrInfoSerializer::Load(value))
             return false;
+        value.runs.clear();
+
+        //legacy databases store one byte per byte of the region
         auto dataJson = get("data");
-        if(!dataJson)
-            return false;
-        std::vector<unsigned char> data;
-        if(!StringUtils::FromCompressedHex(json_string_value(dataJson), data))
-            return false;
-        value.size = data.size();
-        value.data = (byte*)VirtualAlloc(NULL, value.size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
-        if(!value.data)
+        if(dataJson)
+        {
+            std::vector<unsigned char> data;
+            if(!StringUtils::FromCompressedHex(json_string_value(dataJson), data))
+                return false;
+            value.size = data.size();
+            encodeRunsFromBytes(data.data(), data.size(), 0, value.runs);
+            return true;
+        }
+
+        auto runsJson = get("runs");
+        if(!runsJson || !getHex("size", value.size))
             return false;
-        memcpy(value.data, data.data(), data.size());
-        IncreaseReferenceCount(value.data, false);
+        size_t i;
+        JSON runJson;
+        json_array_foreach(runsJson, i, runJson)
+        {
+            ENCODERUN run;
+            run.start = duint(json_hex_value(json_array_get(runJson, 0)));
+            run.size = duint(json_hex_value(json_array_get(runJson, 1)));
+            run.stride = duint(json_hex_value(json_array_get(runJson, 2)));
+            run.type = ENCODETYPE(json_integer_value(json_array_get(runJson, 3)));
+            if(!run.size || !run.stride || run.start + run.size > value.size)
+                return false;
+            if(!value.runs.empty() && value.runs.back().start + value.runs.back().size > run.start)
+                return false;
+            value.runs.push_back(run);
+        }
         return true;
     }
 };
@@ -82,64 +209,95 @@ struct EncodeMap : AddrInfoHashMap<LockEncodeMaps, ENCODEMAP, EncodeMapSerialize
 
 static EncodeMap encmaps;
 
-static bool EncodeMapGetorCreate(duint addr, ENCODEMAP & map, bool* created = nullptr)
+// Call with LockEncodeMaps held
+static ENCODEMAP* EncodeMapFind(duint key)
 {
-    duint base, segsize;
+    auto & maps = encmaps.GetDataUnsafe();
+    auto found = maps.find(key);
+    return found == maps.end() ? nullptr : &found->second;
+}
 
+static bool EncodeMapGetorCreate(duint addr, duint & base, bool* created = nullptr)
+{
+    duint segsize;
     base = MemFindBaseAddr(addr, &segsize);
     if(!base)
         return false;
 
-    duint key = EncodeMap::VaKey(base);
-    if(!encmaps.Contains(key))
     {
-        if(created)
-            *created = true;
-        map.size = segsize;
-        map.data = (byte*)VirtualAlloc(NULL, segsize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
-        if(map.data == NULL) return false;
-        IncreaseReferenceCount(map.data);
-        encmaps.PrepareValue(map, base, false);
-        encmaps.Add(map);
+        auto key = EncodeMap::VaKey(base);
+        SHARED_ACQUIRE(LockEncodeMaps);
+        if(EncodeMapFind(key))
+            return true;
     }
-    else
-    {
-        if(!encmaps.Get(key, map))
-            return false;
-    }
-    return true;
+
+    if(created)
+        *created = true;
+    ENCODEMAP map;
+    map.size = segsize;
+    if(!encmaps.PrepareValue(map, base, false))
+        return false;
+    return encmaps.Add(map);
 }
 
 void* EncodeMapGetBuffer(duint addr, duint* size, bool create)
 {
-    auto base = MemFindBaseAddr(addr);
-
-    ENCODEMAP map;
-    if(create ? EncodeMapGetorCreate(addr, map) : encmaps.Get(EncodeMap::VaKey(base), map))
-    {
-        auto offset = addr - base;
-        if(offset < map.size)
-        {
-            IncreaseReferenceCount(map.data);
-            if(size)
-                *size = map.size;
-            return map.data;
-        }
-    }
     if(size)
         *size = 0;
-    return nullptr;
+    duint base = MemFindBaseAddr(addr);
+    if(!base || (create && !EncodeMapGetorCreate(addr, base)))
+        return nullptr;
+
+    auto key = EncodeMap::VaKey(base);
+    SHARED_ACQUIRE(LockEncodeMaps);
+    auto map = EncodeMapFind(key);
+    if(!map || addr - base >= map->size)
+        return nullptr;
+
+    //materialize the region on demand, pages without annotations are never touched
+    auto buffer = (byte*)VirtualAlloc(NULL, map->size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if(!buffer)
+        return nullptr;
+    encodeRunsToBytes(map->runs, buffer, map->size);
+    if(size)
+        *size = map->size;
+    SHARED_RELEASE();
+
+    EXCLUSIVE_ACQUIRE(LockEncodeMaps);
+    encodeBuffers.insert(buffer);
+    return buffer;
 }
 
-void EncodeMapReleaseBuffer(void* buffer, bool lock)
+void EncodeMapReleaseBuffer(void* buffer)
 {
-    if(DecreaseReferenceCount(buffer, lock) == 0)
-        VirtualFree(buffer, 0, MEM_RELEASE);
+    {
+        EXCLUSIVE_ACQUIRE(LockEncodeMaps);
+        if(!encodeBuffers.erase(buffer))
+            return;
+    }
+    VirtualFree(buffer, 0, MEM_RELEASE);
 }
 
-void EncodeMapReleaseBuffer(void* buffer)
+bool EncodeMapSetBuffer(duint addr, const void* buffer, duint size)
 {
-    EncodeMapReleaseBuffer(buffer, true);
+    duint base;
+    if(!EncodeMapGetorCreate(addr, base))
+        return false;
+
+    auto offset = addr - base;
+    auto key = EncodeMap::VaKey(base);
+    ENCODERUNS runs;
+    {
+        EXCLUSIVE_ACQUIRE(LockEncodeMaps);
+        auto map = EncodeMapFind(key);
+        if(!map || offset >= map->size)
+            return false;
+        size = min(map->size - offset, size);
+        encodeRunsFromBytes((const byte*)buffer, size, offset, runs);
+        encodeRunsReplace(map->runs, offset, size, runs);
+    }
+    encmaps.MarkChanged(key);
+    return true;
 }
 
 duint GetEncodeTypeSize(ENCODETYPE type)
@@ -188,16 +346,19 @@ static bool IsCodeType(ENCODETYPE type)
 
 ENCODETYPE EncodeMapGetType(duint addr, duint codesize)
 {
-    duint size;
-    auto base = MemFindBaseAddr(addr, &size);
+    auto base = MemFindBaseAddr(addr);
+    if(!base)
+        return enc_unknown;
 
-    ENCODEMAP map;
-    if(base && encmaps.Get(EncodeMap::VaKey(base), map))
+    auto key = EncodeMap::VaKey(base);
+    SHARED_ACQUIRE(LockEncodeMaps);
+    auto map = EncodeMapFind(key);
+    if(map)
     {
         auto offset = addr - base;
-        if(offset >= map.size)
+        if(offset >= map->size)
             return enc_unknown;
-        return ENCODETYPE(map.data[offset]);
+        return encodeRunsGetType(map->runs, offset);
     }
 
     return enc_unknown;
@@ -209,13 +370,15 @@ duint EncodeMapGetSize(duint addr, duint codesize)
     if(!base)
         return codesize;
 
-    ENCODEMAP map;
-    if(encmaps.Get(EncodeMap::VaKey(base), map))
+    auto key = EncodeMap::VaKey(base);
+    SHARED_ACQUIRE(LockEncodeMaps);
+    auto map = EncodeMapFind(key);
+    if(map)
     {
         auto offset = addr - base;
-        if(offset >= map.size)
+        if(offset >= map->size)
             return 1;
-        auto type = ENCODETYPE(map.data[offset]);
+        auto type = encodeRunsGetType(map->runs, offset);
 
         auto datasize = GetEncodeTypeSize(type);
         if(!IsCodeType(type))
@@ -227,58 +390,60 @@ duint EncodeMapGetSize(duint addr, duint codesize)
 
 bool EncodeMapSetType(duint addr, duint size, ENCODETYPE type, bool* created)
 {
-    auto base = MemFindBaseAddr(addr, nullptr);
+    duint segsize;
+    auto base = MemFindBaseAddr(addr, &segsize);
     if(!base)
         return false;
 
-    ENCODEMAP map;
-    if(created)
-        *created = false;
-    if(!EncodeMapGetorCreate(base, map, created))
-        return false;
     auto offset = addr - base;
-    size = min(map.size - offset, size);
+    size = min(segsize - offset, size);
+
+    //the new elements, code is split at the instruction boundaries
+    ENCODERUNS runs;
     auto datasize = GetEncodeTypeSize(type);
-    if(datasize == 1 && !IsCodeType(type))
+    if(type == enc_unknown || !size)
     {
-        memset(map.data + offset, (byte)type, size);
     }
-    else
+    else if(IsCodeType(type) && size > 1)
     {
-        memset(map.data + offset, (byte)enc_middle, size);
-        if(IsCodeType(type) && size > 1)
-        {
-            Zydis cp;
-            Memory<unsigned char*> buffer(size);
-            if(!MemRead(addr, buffer(), size))
-                return false;
+        Zydis cp;
+        Memory<unsigned char*> buffer(size);
+        if(!MemRead(addr, buffer(), size))
+            return false;
 
-            duint buffersize = size, bufferoffset = 0, cmdsize;
-            for(auto i = offset; i < offset + size;)
-            {
-                map.data[i] = (byte)type;
-                cp.Disassemble(base + i, buffer() + bufferoffset, int(buffersize - bufferoffset));
-                cmdsize = cp.Success() ? cp.Size() : 1;
-                i += cmdsize;
-                bufferoffset += cmdsize;
-                buffersize -= cmdsize;
-            }
-        }
-        else
+        duint cmdsize;
+        for(duint i = 0; i < size;)
         {
-            for(auto i = offset; i < offset + size; i += datasize)
-                map.data[i] = (byte)type;
+            cp.Disassemble(addr + i, buffer() + i, int(size - i));
+            cmdsize = cp.Success() ? cp.Size() : 1;
+            encodeRunsAppend(runs, offset + i, min(cmdsize, size - i), type);
+            i += cmdsize;
         }
-
+    }
+    else if(datasize == 1 || IsCodeType(type))
+    {
+        encodeRunsAppend(runs, offset, 1, type);
+        runs.back().size = size;
+    }
+    else
+    {
+        encodeRunsAppend(runs, offset, datasize, type);
+        runs.back().size = size;
     }
 
-    for(auto i = offset + size + 1; i < map.size; i++)
+    if(created)
+        *created = false;
+    if(!EncodeMapGetorCreate(base, base, created))
+        return false;
+    auto key = EncodeMap::VaKey(base);
     {
-        if(map.data[i] == enc_middle)
-            map.data[i] = (byte)enc_unknown;
-        else
-            break;
+        EXCLUSIVE_ACQUIRE(LockEncodeMaps);
+        auto map = EncodeMapFind(key);
+        if(!map)
+            return false;
+        encodeRunsReplace(map->runs, offset, size, runs);
     }
+    encmaps.MarkChanged(key);
     return true;
 }
 
@@ -287,14 +452,7 @@ void EncodeMapDelSegment(duint Start)
     duint base = MemFindBaseAddr(Start, 0);
     if(!base)
         return;
-    duint key = EncodeMap::VaKey(base);
-    ENCODEMAP map;
-    if(encmaps.Contains(key))
-    {
-        encmaps.Get(key, map);
-        EncodeMapReleaseBuffer(map.data);
-    }
-    encmaps.Delete(key);
+    encmaps.Delete(EncodeMap::VaKey(base));
 }
 
 void EncodeMapDelRange(duint Start, duint End)
@@ -312,11 +470,12 @@ void EncodeMapCacheLoad(JSON Root)
     encmaps.CacheLoad(Root);
 }
 
+duint EncodeMapCacheGeneration()
+{
+    return encmaps.Generation();
+}
+
 void EncodeMapClear()
 {
-    EXCLUSIVE_ACQUIRE(LockEncodeMaps);
-    for(auto & encmap : encmaps.GetDataUnsafe())
-        EncodeMapReleaseBuffer(encmap.second.data, false);
-    EXCLUSIVE_RELEASE();
     encmaps.Clear();
 }
@@ -5,6 +5,7 @@
 
 void* EncodeMapGetBuffer(duint addr, duint* size, bool create = false);
 void EncodeMapReleaseBuffer(void* buffer);
+bool EncodeMapSetBuffer(duint addr, const void* buffer, duint size);
 ENCODETYPE EncodeMapGetType(duint addr, duint codesize);
 duint EncodeMapGetSize(duint addr, duint codesize);
 void EncodeMapDelSegment(duint addr);
@@ -13,5 +14,6 @@ bool EncodeMapSetType(duint addr, duint size, ENCODETYPE type, bool* created = n
 void EncodeMapDelRange(duint Start, duint End);
 void EncodeMapCacheSave(JSON Root);
 void EncodeMapCacheLoad(JSON Root);
+duint EncodeMapCacheGeneration();
 void EncodeMapClear();
 duint GetEncodeTypeSize(ENCODETYPE type);
\ No newline at end of file
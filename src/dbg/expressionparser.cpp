@@ -3,6 +3,9 @@
 #include "console.h"
 #include "variable.h"
 #include "expressionfunctions.h"
+#include "debugger.h"
+#include "memory.h"
+#include "contextsnapshot.h"
 
 ExpressionParser::Token::Associativity ExpressionParser::Token::associativity() const
 {
@@ -134,13 +137,16 @@ bool ExpressionParser::Token::isOperator() const
 
 ExpressionParser::ExpressionParser(const String & expression)
     : mExpression(fixClosingBrackets(expression)),
-      mIsValidExpression(true)
+      mIsValidExpression(true),
+      mVarGeneration(0),
+      mShadowed(false)
 {
     const size_t r = 50;
     mTokens.reserve(r);
     mCurToken.reserve(r);
     tokenize();
     shuntingYard();
+    compile();
 }
 
 String ExpressionParser::fixClosingBrackets(const String & expression)
@@ -773,23 +779,294 @@ bool ExpressionParser::signedOperation(Token::Type type, const EvalValue & op1,
     return evalOperation<dsint>(type, op1, op2, result, true, silent, baseonly, allowassign);
 }
 
+static bool isdigitduint(char digit)
+{
+#ifdef _WIN64
+    return digit >= '1' && digit <= '8';
+#else //x86
+    return digit >= '1' && digit <= '4';
+#endif //_WIN64
+}
+
+void ExpressionParser::compile()
+{
+    mCode.clear();
+    if(!mIsValidExpression)
+        return;
+    mCode.resize(mPrefixTokens.size());
+    for(size_t i = 0; i < mPrefixTokens.size(); i++)
+    {
+        const auto & token = mPrefixTokens[i];
+        auto & instruction = mCode[i];
+        instruction.token = i;
+        if(token.isOperator())
+        {
+            instruction.opcode = Opcode::Operator;
+            continue;
+        }
+        if(token.type() == Token::Type::Function)
+        {
+            instruction.opcode = Opcode::Function;
+            continue;
+        }
+
+        //same order as valfromstring_noexpr, anything that cannot be resolved in advance stays Data
+        auto string = token.data().c_str();
+        if(string[0] == '['
+                || (isdigitduint(string[0]) && string[1] == ':' && string[2] == '[')
+                || (string[1] == 's' && (string[0] == 'c' || string[0] == 'd' || string[0] == 'e' || string[0] == 'f' || string[0] == 'g' || string[0] == 's') && string[2] == ':' && string[3] == '[')
+                || strstr(string, "byte:[")
+                || strstr(string, "word:["))
+        {
+            if(compileMemory(instruction))
+                instruction.opcode = Opcode::Memory;
+        }
+        else if(*string == '$')
+            instruction.opcode = Opcode::Variable;
+        else if(valregisterslot(string, instruction.reg))
+            instruction.opcode = Opcode::Register;
+        else if(*string == '_' && valflagmask(string + 1, instruction.value))
+            instruction.opcode = Opcode::Flag;
+        else if(valnumberfromstring(string, instruction.value))
+            instruction.opcode = Opcode::Number;
+    }
+    mVarGeneration = vargeneration();
+    mShadowed = isShadowed();
+}
+
+bool ExpressionParser::compileMemory(Instruction & instruction) const
+{
+    const auto & data = mPrefixTokens[instruction.token].data();
+    auto string = data.c_str();
+    int size = sizeof(duint);
+    size_t prefix = 1;
+    duint segment = 0;
+    if(string[1] == ':') //n:[
+    {
+        prefix = 3;
+        size = min(size, string[0] - '0');
+    }
+    else if(string[1] == 's' && string[2] == ':') //xs:[
+    {
+        prefix = 4;
+        if(string[0] == 'f' || string[0] == 'g')
+            segment = string[0];
+    }
+    else if(strncmp(string, "byte:", 5) == 0)
+    {
+        prefix = 6;
+        size = 1;
+    }
+    else if(strncmp(string, "word:", 5) == 0)
+    {
+        prefix = 6;
+        size = 2;
+    }
+    else if(strncmp(string, "dword:", 6) == 0)
+    {
+        prefix = 7;
+        size = 4;
+    }
+#ifdef _WIN64
+    else if(strncmp(string, "qword:", 6) == 0)
+    {
+        prefix = 7;
+        size = 8;
+    }
+#endif //_WIN64
+    if(data.length() <= prefix || string[prefix - 1] != '[')
+        return false;
+
+    //the closing bracket has to end the token, otherwise valfromstring_noexpr ignores the rest
+    size_t depth = 1;
+    auto end = prefix;
+    for(; end < data.length(); end++)
+    {
+        if(string[end] == '[')
+            depth++;
+        else if(string[end] == ']' && !--depth)
+            break;
+    }
+    if(end != data.length() - 1 || end == prefix)
+        return false;
+    instruction.address = std::make_shared<ExpressionParser>(data.substr(prefix, end - prefix));
+    instruction.size = size;
+    instruction.value = segment;
+    return true;
+}
+
+bool ExpressionParser::isShadowed() const
+{
+    for(const auto & instruction : mCode)
+    {
+        switch(instruction.opcode)
+        {
+        case Opcode::Number:
+        case Opcode::Register:
+        case Opcode::Flag:
+        {
+            duint value;
+            if(varget(mPrefixTokens[instruction.token].data().c_str(), &value, nullptr, nullptr))
+                return true;
+        }
+        break;
+        default:
+            break;
+        }
+    }
+    return false;
+}
+
+struct ExpressionParser::RunState
+{
+    TITAN_ENGINE_CONTEXT_t context;
+    bool hasContext = false;
+};
+
+bool ExpressionParser::evaluateData(const Instruction & instruction, duint & result, RunState & state, bool silent, bool baseonly, int* value_size, bool* isvar, bool* hexonly) const
+{
+    const auto & data = mPrefixTokens[instruction.token].data();
+    switch(mShadowed && instruction.opcode != Opcode::Memory ? Opcode::Data : instruction.opcode)
+    {
+    case Opcode::Number:
+        if(value_size)
+            *value_size = 0;
+        if(isvar)
+            *isvar = false;
+        result = instruction.value;
+        return true;
+
+    case Opcode::Variable:
+        if(!varget(data.c_str(), &result, value_size, nullptr))
+            break;
+        if(isvar)
+            *isvar = true;
+        return true;
+
+    case Opcode::Register:
+    case Opcode::Flag:
+    {
+        if(!DbgIsDebugging())
+            break;
+        if(!state.hasContext)
+        {
+            if(!ContextSnapshotGet(state.context))
+                break;
+            state.hasContext = true;
+        }
+        if(isvar)
+            *isvar = true;
+        if(instruction.opcode == Opcode::Flag)
+        {
+            if(value_size)
+                *value_size = 0;
+            result = (state.context.eflags & instruction.value) ? 1 : 0;
+            return true;
+        }
+        const auto & reg = instruction.reg;
+        auto field = (const char*)&state.context + reg.offset;
+        auto fieldValue = reg.fieldsize == sizeof(unsigned short) ? duint(*(const unsigned short*)field) : duint(*(const ULONG_PTR*)field);
+        if(value_size)
+            *value_size = reg.size;
+        result = (fieldValue >> reg.shift) & reg.mask;
+        return true;
+    }
+
+    case Opcode::Memory:
+    {
+        if(!DbgIsDebugging())
+            break;
+        duint addr;
+        if(!instruction.address->run(addr, valuesignedcalc(), false, silent, false, nullptr, nullptr, nullptr, state))
+        {
+            if(!silent)
+                dprintf(QT_TRANSLATE_NOOP("DBG", "valfromstring_noexpr failed on %s\n"), instruction.address->GetExpression().c_str());
+            return false;
+        }
+        duint segment = 0;
+#ifdef _WIN64
+        if(instruction.value == 'g')
+#else //x86
+        if(instruction.value == 'f')
+#endif //_WIN64
+            segment = (duint)GetTEBLocation(hActiveThread);
+        result = 0;
+        if(!MemRead(addr + segment, &result, instruction.size))
+        {
+            if(!silent)
+                dputs(QT_TRANSLATE_NOOP("DBG", "Failed to read memory"));
+            return false;
+        }
+        if(value_size)
+            *value_size = instruction.size;
+        if(isvar)
+            *isvar = true;
+        return true;
+    }
+
+    default:
+        break;
+    }
+    return valfromstring_noexpr(data.c_str(), &result, silent, baseonly, value_size, isvar, hexonly);
+}
+
+bool ExpressionParser::evaluate(const Operand & operand, duint & result, RunState & state, bool silent, bool baseonly, int* value_size, bool* isvar, bool* hexonly) const
+{
+    if(operand.data)
+        return evaluateData(*operand.data, result, state, silent, baseonly, value_size, isvar, hexonly);
+    if(value_size)
+        *value_size = sizeof(duint);
+    if(isvar)
+        *isvar = false;
+    if(hexonly)
+        *hexonly = false;
+    result = operand.value;
+    return true;
+}
+
 bool ExpressionParser::Calculate(duint & value, bool signedcalc, bool allowassign, bool silent, bool baseonly, int* value_size, bool* isvar, bool* hexonly) const
 {
     value = 0;
     if(!mPrefixTokens.size() || !mIsValidExpression)
         return false;
-    std::vector<EvalValue> stack;
-    stack.reserve(mPrefixTokens.size());
-    //calculate the result from the RPN queue
-    for(const auto & token : mPrefixTokens)
+    RunState state;
+    return run(value, signedcalc, allowassign, silent, baseonly, value_size, isvar, hexonly, state);
+}
+
+bool ExpressionParser::run(duint & value, bool signedcalc, bool allowassign, bool silent, bool baseonly, int* value_size, bool* isvar, bool* hexonly, RunState & state) const
+{
+    value = 0;
+    if(mCode.empty())
+        return false;
+    //a new variable might shadow a register, flag or number
+    auto generation = vargeneration();
+    if(generation != mVarGeneration)
     {
-        if(token.isOperator())
+        mShadowed = isShadowed();
+        mVarGeneration = generation;
+    }
+    Operand localStack[16];
+    std::vector<Operand> heapStack;
+    auto stack = localStack;
+    if(mCode.size() > _countof(localStack))
+    {
+        heapStack.resize(mCode.size());
+        stack = heapStack.data();
+    }
+    size_t stackSize = 0;
+    auto toEvalValue = [this](const Operand & operand)
+    {
+        return operand.data ? EvalValue(mPrefixTokens[operand.data->token].data()) : EvalValue(operand.value);
+    };
+    //run the compiled RPN queue
+    for(const auto & instruction : mCode)
+    {
+        switch(instruction.opcode)
+        {
+        case Opcode::Operator:
         {
-            EvalValue op1(0);
-            EvalValue op2(0);
-            EvalValue result(0);
-            bool operationSuccess;
-            auto type = token.type();
+            auto type = mPrefixTokens[instruction.token].type();
+            size_t argc;
             switch(type)
             {
             case Token::Type::OperatorUnarySub:
@@ -800,40 +1077,24 @@ bool ExpressionParser::Calculate(duint & value, bool signedcalc, bool allowassig
             case Token::Type::OperatorPrefixDec:
             case Token::Type::OperatorSuffixInc:
             case Token::Type::OperatorSuffixDec:
-                if(stack.size() < 1)
-                    return false;
-                op1 = stack[stack.size() - 1];
-                stack.pop_back();
-                if(signedcalc)
-                    operationSuccess = signedOperation(type, op1, op2, result, silent, baseonly, allowassign);
-                else
-                    operationSuccess = unsignedOperation(type, op1, op2, result, silent, baseonly, allowassign);
-                if(!operationSuccess)
-                    return false;
-                stack.push_back(result);
+                argc = 1;
+                break;
+            case Token::Type::Error:
+                return false;
+            default:
+                argc = 2;
                 break;
-            case Token::Type::OperatorMul:
-            case Token::Type::OperatorHiMul:
-            case Token::Type::OperatorDiv:
-            case Token::Type::OperatorMod:
-            case Token::Type::OperatorAdd:
-            case Token::Type::OperatorSub:
-            case Token::Type::OperatorShl:
-            case Token::Type::OperatorShr:
-            case Token::Type::OperatorRol:
-            case Token::Type::OperatorRor:
-            case Token::Type::OperatorAnd:
-            case Token::Type::OperatorXor:
-            case Token::Type::OperatorOr:
-            case Token::Type::OperatorEqual:
-            case Token::Type::OperatorNotEqual:
-            case Token::Type::OperatorBigger:
-            case Token::Type::OperatorSmaller:
-            case Token::Type::OperatorBiggerEqual:
-            case Token::Type::OperatorSmallerEqual:
-            case Token::Type::OperatorLogicalAnd:
-            case Token::Type::OperatorLogicalOr:
-            case Token::Type::OperatorLogicalImpl:
+            }
+            if(stackSize < argc)
+                return false;
+            stackSize -= argc;
+            const auto & op1 = stack[stackSize];
+            Operand op2 = { nullptr, 0 };
+            if(argc == 2)
+                op2 = stack[stackSize + 1];
+            Operand result = { nullptr, 0 };
+            switch(type)
+            {
             case Token::Type::OperatorAssign:
             case Token::Type::OperatorAssignMul:
             case Token::Type::OperatorAssignHiMul:
@@ -848,53 +1109,74 @@ bool ExpressionParser::Calculate(duint & value, bool signedcalc, bool allowassig
             case Token::Type::OperatorAssignAnd:
             case Token::Type::OperatorAssignXor:
             case Token::Type::OperatorAssignOr:
-                if(stack.size() < 2)
-                    return false;
-                op2 = stack[stack.size() - 1];
-                stack.pop_back();
-                op1 = stack[stack.size() - 1];
-                stack.pop_back();
+            case Token::Type::OperatorPrefixInc:
+            case Token::Type::OperatorPrefixDec:
+            case Token::Type::OperatorSuffixInc:
+            case Token::Type::OperatorSuffixDec:
+            {
+                //assignments need the name of the destination, they go through the uncompiled path
+                EvalValue evalResult(0);
+                bool operationSuccess;
                 if(signedcalc)
-                    operationSuccess = signedOperation(type, op1, op2, result, silent, baseonly, allowassign);
+                    operationSuccess = signedOperation(type, toEvalValue(op1), toEvalValue(op2), evalResult, silent, baseonly, allowassign);
                 else
-                    operationSuccess = unsignedOperation(type, op1, op2, result, silent, baseonly, allowassign);
-                if(!operationSuccess)
+                    operationSuccess = unsignedOperation(type, toEvalValue(op1), toEvalValue(op2), evalResult, silent, baseonly, allowassign);
+                if(!operationSuccess || !evalResult.DoEvaluate(result.value, silent, baseonly))
                     return false;
-                stack.push_back(result);
-                break;
-            case Token::Type::Error:
-                return false;
-            default: //do nothing
-                break;
+                state.hasContext = false; //a register might have been changed
+            }
+            break;
+
+            default:
+            {
+                duint op1v, op2v;
+                if(!evaluate(op1, op1v, state, silent, baseonly) || !evaluate(op2, op2v, state, silent, baseonly))
+                    return false;
+                if(signedcalc)
+                {
+                    dsint resultv;
+                    if(!operation<dsint>(type, dsint(op1v), dsint(op2v), resultv, true))
+                        return false;
+                    result.value = duint(resultv);
+                }
+                else if(!operation<duint>(type, op1v, op2v, result.value, false))
+                    return false;
+            }
+            break;
             }
+            stack[stackSize++] = result;
         }
-        else if(token.type() == Token::Type::Function)
+        break;
+
+        case Opcode::Function:
         {
-            const auto & name = token.data();
+            const auto & name = mPrefixTokens[instruction.token].data();
             int argc;
             if(!ExpressionFunctions::GetArgc(name, argc))
                 return false;
-            if(int(stack.size()) < argc)
+            if(int(stackSize) < argc)
                 return false;
             std::vector<duint> argv;
             argv.resize(argc);
             for(auto i = 0; i < argc; i++)
             {
-                duint arg;
-                if(!stack[stack.size() - 1].DoEvaluate(arg, silent, baseonly))
+                if(!evaluate(stack[stackSize - 1], argv[argc - i - 1], state, silent, baseonly))
                     return false;
-                stack.pop_back();
-                argv[argc - i - 1] = arg;
+                stackSize--;
             }
             duint result;
             if(!ExpressionFunctions::Call(name, argv, result))
                 return false;
-            stack.push_back(EvalValue(result));
+            stack[stackSize++] = { nullptr, result };
+        }
+        break;
+
+        default:
+            stack[stackSize++] = { &instruction, 0 };
+            break;
         }
-        else
-            stack.push_back(EvalValue(token.data()));
     }
-    if(stack.size() != 1) //there should only be one value left on the stack
+    if(stackSize != 1) //there should only be one value left on the stack
         return false;
-    return stack[stack.size() - 1].DoEvaluate(value, silent, baseonly, value_size, isvar, hexonly);
+    return evaluate(stack[0], value, state, silent, baseonly, value_size, isvar, hexonly);
 }
@@ -3,6 +3,7 @@
 
 #include "_global.h"
 #include "value.h"
+#include <memory>
 
 class ExpressionParser
 {
@@ -140,10 +141,48 @@ public:
     };
 
 private:
+    enum class Opcode : unsigned char
+    {
+        Data, //resolved with valfromstring_noexpr on every evaluation
+        Number,
+        Register,
+        Flag,
+        Variable,
+        Memory,
+        Function,
+        Operator
+    };
+
+    //compiled form of a token in mPrefixTokens
+    struct Instruction
+    {
+        Opcode opcode = Opcode::Data;
+        size_t token = 0; //index in mPrefixTokens
+        duint value = 0; //Number: value, Flag: EFLAGS bit, Memory: segment ('f' or 'g')
+        int size = 0; //Memory: read size
+        REGISTER_SLOT reg;
+        std::shared_ptr<ExpressionParser> address; //Memory: address expression
+    };
+
+    //stack entry of the interpreter, data is the instruction of an operand that is not evaluated yet
+    struct Operand
+    {
+        const Instruction* data;
+        duint value;
+    };
+
+    struct RunState;
+
     static String fixClosingBrackets(const String & expression);
     bool isUnaryOperator() const;
     void tokenize();
     void shuntingYard();
+    void compile();
+    bool compileMemory(Instruction & instruction) const;
+    bool isShadowed() const;
+    bool run(duint & value, bool signedcalc, bool allowassign, bool silent, bool baseonly, int* value_size, bool* isvar, bool* hexonly, RunState & state) const;
+    bool evaluate(const Operand & operand, duint & result, RunState & state, bool silent, bool baseonly, int* value_size = nullptr, bool* isvar = nullptr, bool* hexonly = nullptr) const;
+    bool evaluateData(const Instruction & instruction, duint & result, RunState & state, bool silent, bool baseonly, int* value_size, bool* isvar, bool* hexonly) const;
     void addOperatorToken(const String & data, Token::Type type);
     bool unsignedOperation(Token::Type type, const EvalValue & op1, const EvalValue & op2, EvalValue & result, bool silent, bool baseonly, bool allowassign) const;
     bool signedOperation(Token::Type type, const EvalValue & op1, const EvalValue & op2, EvalValue & result, bool silent, bool baseonly, bool allowassign) const;
@@ -168,6 +207,9 @@ private:
     std::vector<Token> mTokens;
     std::vector<Token> mPrefixTokens;
     String mCurToken;
+    std::vector<Instruction> mCode;
+    mutable duint mVarGeneration;
+    mutable bool mShadowed; //a variable has the name of a compiled register, flag or number
 };
 
 #endif //_EXPRESSION_PARSER_H
\ No newline at end of file
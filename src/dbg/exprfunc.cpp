@@ -11,6 +11,7 @@
 #include "value.h"
 #include "TraceRecord.h"
 #include "exhandlerinfo.h"
+#include "contextsnapshot.h"
 
 namespace Exprfunc
 {
@@ -388,7 +389,7 @@ namespace Exprfunc
     duint bpgoto(duint cip)
     {
         //This is a function to sets CIP without calling DebugUpdateGui. This is a workaround for "bpgoto".
-        SetContextDataEx(hActiveThread, UE_CIP, cip);
+        ContextSnapshotSetRegister(UE_CIP, cip);
         return cip;
     }
 }
@@ -148,6 +148,11 @@ void FunctionCacheLoad(JSON Root)
     functions.CacheLoad(Root, "auto"); //legacy support
 }
 
+duint FunctionCacheGeneration()
+{
+    return functions.Generation();
+}
+
 bool FunctionEnum(FUNCTIONSINFO* List, size_t* Size)
 {
     return functions.Enum(List, Size);
@@ -24,6 +24,7 @@ bool FunctionDelete(duint Address);
 void FunctionDelRange(duint Start, duint End, bool DeleteManual = false);
 void FunctionCacheSave(JSON Root);
 void FunctionCacheLoad(JSON Root);
+duint FunctionCacheGeneration();
 bool FunctionEnum(FUNCTIONSINFO* List, size_t* Size);
 void FunctionClear();
 void FunctionGetList(std::vector<FUNCTIONSINFO> & list);
@@ -6,6 +6,7 @@
 #include "threading.h"
 #include "cmd-watch-control.h"
 #include "debugger.h"
+#include "contextsnapshot.h"
 #include <deque>
 
 static const duint HistoryMaxCount = 4096;
@@ -15,7 +16,7 @@ static std::deque<HistoryContext> history;
 HistoryContext::HistoryContext()
 {
     DISASM_INSTR instruction;
-    if(GetFullContextDataEx(hActiveThread, &registers) && MemIsValidReadPtr(registers.cip))
+    if(ContextSnapshotGet(registers) && MemIsValidReadPtr(registers.cip))
     {
         disasmget(registers.cip, &instruction);
         if(!(memcmp(instruction.instruction, "nop ", 4) == 0 || memcmp(instruction.instruction, "lea ", 4) == 0))
@@ -56,6 +57,7 @@ void HistoryContext::restore()
         for(auto & i : ChangedLocation)
             MemWrite(i.addr, i.oldvalue, sizeof(duint));
         SetFullContextDataEx(hActiveThread, &registers);
+        ContextSnapshotInvalidate();
         cbCheckWatchdog(0, nullptr);
         DebugUpdateGui(GetContextDataEx(hActiveThread, UE_CIP), true);
     }
@@ -118,6 +118,11 @@ void LabelCacheLoad(JSON Root)
     labels.CacheLoad(Root, "auto"); //legacy support
 }
 
+duint LabelCacheGeneration()
+{
+    return labels.Generation();
+}
+
 void LabelClear()
 {
     labels.Clear();
@@ -139,6 +144,12 @@ void LabelGetList(std::vector<LABELSINFO> & list)
     }
 }
 
+// Temporary labels are not part of the change journal
+bool LabelGetChangesSince(duint Generation, std::vector<LABELSINFO> & changed, std::vector<duint> & deleted)
+{
+    return labels.GetChangesSince(Generation, changed, deleted);
+}
+
 bool LabelGetInfo(duint Address, LABELSINFO* info)
 {
     return labels.GetInfo(Address, info);
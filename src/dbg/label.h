@@ -16,8 +16,10 @@ bool LabelDelete(duint Address);
 void LabelDelRange(duint Start, duint End, bool Manual);
 void LabelCacheSave(JSON root);
 void LabelCacheLoad(JSON root);
+duint LabelCacheGeneration();
 void LabelClear();
 void LabelGetList(std::vector<LABELSINFO> & list);
+bool LabelGetChangesSince(duint Generation, std::vector<LABELSINFO> & changed, std::vector<duint> & deleted);
 bool LabelGetInfo(duint Address, LABELSINFO* info);
 
 #endif // _LABEL_H
\ No newline at end of file
@@ -5,10 +5,24 @@
  */
 
 #include "_global.h"
+#include "command.h"
+#include "module.h"
+#include "TraceRecord.h"
 
 extern "C" DLL_EXPORT BOOL APIENTRY DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
 {
     if(fdwReason == DLL_PROCESS_ATTACH)
         hInst = hinstDLL;
+    else if(fdwReason == DLL_THREAD_DETACH)
+    {
+        cmdthreaddetach();
+        ModThreadDetach();
+        TraceRecordThreadDetach();
+    }
+    else if(fdwReason == DLL_PROCESS_DETACH)
+    {
+        ModProcessDetach();
+        TraceRecordProcessDetach();
+    }
     return TRUE;
 }
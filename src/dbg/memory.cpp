@@ -12,6 +12,9 @@
 #include "module.h"
 #include "taskthread.h"
 #include "value.h"
+#include "disasm_index.h"
+#include "taskpool.h"
+#include <atomic>
 
 #define PAGE_SHIFT              (12)
 //#define PAGE_SIZE               (4096)
@@ -453,6 +456,9 @@ bool MemWrite(duint BaseAddress, const void* Buffer, duint Size, duint* NumberOf
             __debugbreak(); //TODO: remove when proven stable, this checks if (BaseAddress + offset) is aligned to PAGE_SIZE after the first call
     }
 
+    if(*NumberOfBytesWritten)
+        DisasmIndexInvalidate(BaseAddress, Size);
+
     auto success = *NumberOfBytesWritten == Size;
     SetLastError(success ? ERROR_SUCCESS : ERROR_PARTIAL_COPY);
     return success;
@@ -665,53 +671,182 @@ bool MemPageRightsFromString(DWORD* Protect, const char* Rights)
     return (*Protect != 0);
 }
 
-bool MemFindInPage(const SimplePage & page, duint startoffset, const std::vector<PatternByte> & pattern, std::vector<duint> & results, duint maxresults)
+//regions are searched in chunks of this size (plus the pattern overlap) so the read buffers stay small
+#define MEMSEARCH_CHUNK_SIZE (4 * 1024 * 1024)
+
+struct MemSearchChunk
 {
-    if(startoffset >= page.size || results.size() >= maxresults)
-        return false;
+    duint address; //start address of the chunk
+    duint size; //number of start positions that belong to this chunk
+    duint readsize; //number of bytes to read (size + overlap, clamped to the region)
+};
 
-    //TODO: memory read limit
-    Memory<unsigned char*> data(page.size);
-    if(!MemRead(page.address, data(), data.size()))
+/**
+\brief Searches pages in parallel chunks and merges the results in address order.
+\param pages The pages to search.
+\param overlap Number of bytes each chunk overlaps into the next one (pattern size - 1).
+\param [in,out] results The results are appended to this vector.
+\param maxresults The maximum number of results.
+\param progress Report the progress to the reference view (from the calling thread only).
+\param search Callback that searches a chunk: (data, datasize, chunk, results, maxresults), it must only report matches that start before chunk.size.
+\return false if the results were already full or none of the memory could be read.
+*/
+template<typename T, typename F>
+static bool MemSearchChunks(const std::vector<SimplePage> & pages, duint overlap, std::vector<T> & results, duint maxresults, bool progress, F search)
+{
+    if(results.size() >= maxresults)
         return false;
+    maxresults -= results.size();
 
-    duint maxFind = maxresults;
-    duint foundCount = results.size();
-    duint i = 0;
-    duint findSize = data.size() - startoffset;
-    while(foundCount < maxFind)
+    std::vector<MemSearchChunk> chunks;
+    duint totalBytes = 0;
+    for(const auto & page : pages)
     {
-        duint foundoffset = patternfind(data() + startoffset + i, findSize - i, pattern);
-        if(foundoffset == -1)
-            break;
-        i += foundoffset + 1;
-        duint result = page.address + startoffset + i - 1;
-        results.push_back(result);
-        foundCount++;
+        for(duint offset = 0; offset < page.size; offset += MEMSEARCH_CHUNK_SIZE)
+        {
+            MemSearchChunk chunk;
+            chunk.address = page.address + offset;
+            chunk.size = min(duint(MEMSEARCH_CHUNK_SIZE), page.size - offset);
+            chunk.readsize = min(chunk.size + overlap, page.size - offset);
+            chunks.push_back(chunk);
+        }
+        totalBytes += page.size;
     }
-    return true;
-}
 
-bool MemFindInMap(const std::vector<SimplePage> & pages, const std::vector<PatternByte> & pattern, std::vector<duint> & results, duint maxresults, bool progress)
-{
-    duint count = 0;
-    duint total = pages.size();
-    for(const auto page : pages)
+    //every worker reuses its own read buffer, so peak memory is bounded by the number of workers
+    TaskLocal<std::vector<unsigned char>> buffers;
+    std::vector<std::vector<T>> chunkResults(chunks.size());
+    std::atomic<size_t> cutoff(chunks.size()); //chunks after this one cannot contribute to the first maxresults results
+    std::atomic<size_t> unreadable(0);
+    std::atomic<duint> scannedBytes(0);
+    auto coordinator = GetCurrentThreadId(); //the calling thread takes part in the work and reports the progress
+    int lastPercent = 0;
+    TaskParallelFor(0, chunks.size(), [&](size_t i)
     {
-        if(!MemFindInPage(page, 0, pattern, results, maxresults))
-            continue;
+        const auto & chunk = chunks[i];
+        if(i <= cutoff.load(std::memory_order_relaxed))
+        {
+            auto & buffer = buffers.Local();
+            buffer.resize(MEMSEARCH_CHUNK_SIZE + overlap);
+            if(MemRead(chunk.address, buffer.data(), chunk.readsize))
+            {
+                auto & found = chunkResults[i];
+                search(buffer.data(), chunk.readsize, chunk, found, maxresults);
+                if(found.size() >= maxresults)
+                {
+                    auto current = cutoff.load();
+                    while(i < current && !cutoff.compare_exchange_weak(current, i))
+                        ;
+                }
+            }
+            else
+                unreadable++;
+        }
         if(progress)
-            GuiReferenceSetProgress(int(floor((float(count) / float(total)) * 100.0f)));
-        if(results.size() >= maxresults)
-            break;
-        count++;
+        {
+            auto scanned = scannedBytes += chunk.size;
+            if(GetCurrentThreadId() == coordinator)
+            {
+                auto percent = int(floor(float(scanned) / float(totalBytes) * 100.0f));
+                if(percent > lastPercent)
+                {
+                    lastPercent = percent;
+                    GuiReferenceSetProgress(percent);
+                }
+            }
+        }
+    });
+
+    //merge the results in address order
+    for(auto & found : chunkResults)
+    {
+        for(auto & result : found)
+        {
+            if(!maxresults)
+                break;
+            results.push_back(std::move(result));
+            maxresults--;
+        }
     }
     if(progress)
     {
         GuiReferenceSetProgress(100);
         GuiReferenceReloadData();
     }
-    return true;
+    return chunks.empty() || unreadable < chunks.size();
+}
+
+static bool MemFindInPagesCompiled(const std::vector<SimplePage> & pages, const PatternCompiled & pattern, std::vector<duint> & results, duint maxresults, bool progress)
+{
+    return MemSearchChunks(pages, pattern.size() - 1, results, maxresults, progress, [&pattern](const unsigned char* data, duint datasize, const MemSearchChunk & chunk, std::vector<duint> & found, duint maxfound)
+    {
+        for(duint i = 0; i < chunk.size && found.size() < maxfound;)
+        {
+            duint foundoffset = patternfind(data + i, datasize - i, pattern);
+            if(foundoffset == -1 || i + foundoffset >= chunk.size)
+                break;
+            found.push_back(chunk.address + i + foundoffset);
+            i += foundoffset + 1;
+        }
+    });
+}
+
+bool MemFindInPage(const SimplePage & page, duint startoffset, const std::vector<PatternByte> & pattern, std::vector<duint> & results, duint maxresults)
+{
+    if(startoffset >= page.size || results.size() >= maxresults)
+        return false;
+    PatternCompiled compiled;
+    if(!patterncompile(pattern, compiled))
+        return false;
+    std::vector<SimplePage> pages;
+    pages.push_back(SimplePage(page.address + startoffset, page.size - startoffset));
+    return MemFindInPagesCompiled(pages, compiled, results, maxresults, false);
+}
+
+bool MemFindInMap(const std::vector<SimplePage> & pages, const std::vector<PatternByte> & pattern, std::vector<duint> & results, duint maxresults, bool progress)
+{
+    PatternCompiled compiled;
+    if(!patterncompile(pattern, compiled))
+        return false;
+    //full results are not an error here, unreadable memory is
+    if(results.size() >= maxresults)
+        return true;
+    return MemFindInPagesCompiled(pages, compiled, results, maxresults, progress);
+}
+
+static bool MemFindPatternsInPages(const std::vector<SimplePage> & pages, const PatternSet & patterns, std::vector<PatternSetHit> & results, duint maxresults, bool progress)
+{
+    duint overlap = 0;
+    for(const auto & pattern : patterns.patterns)
+        overlap = max(overlap, duint(pattern.size() - 1));
+    return MemSearchChunks(pages, overlap, results, maxresults, progress, [&patterns](const unsigned char* data, duint datasize, const MemSearchChunk & chunk, std::vector<PatternSetHit> & found, duint maxfound)
+    {
+        //the offsets of the hits are turned into addresses, hits in the overlap belong to the next chunk
+        patternsetfind(data, datasize, patterns, found, maxfound);
+        size_t count = 0;
+        for(auto & hit : found)
+        {
+            if(hit.offset >= chunk.size)
+                break;
+            hit.offset += chunk.address;
+            count++;
+        }
+        found.resize(count);
+    });
+}
+
+bool MemFindPatternsInPage(const SimplePage & page, const PatternSet & patterns, std::vector<PatternSetHit> & results, duint maxresults)
+{
+    std::vector<SimplePage> pages;
+    pages.push_back(page);
+    return MemFindPatternsInPages(pages, patterns, results, maxresults, false);
+}
+
+bool MemFindPatternsInMap(const std::vector<SimplePage> & pages, const PatternSet & patterns, std::vector<PatternSetHit> & results, duint maxresults, bool progress)
+{
+    if(results.size() >= maxresults)
+        return true;
+    return MemFindPatternsInPages(pages, patterns, results, maxresults, progress);
 }
 
 template<class T>
@@ -27,6 +27,8 @@ bool MemPageRightsToString(DWORD Protect, char* Rights);
 bool MemPageRightsFromString(DWORD* Protect, const char* Rights);
 bool MemFindInPage(const SimplePage & page, duint startoffset, const std::vector<PatternByte> & pattern, std::vector<duint> & results, duint maxresults);
 bool MemFindInMap(const std::vector<SimplePage> & pages, const std::vector<PatternByte> & pattern, std::vector<duint> & results, duint maxresults, bool progress = true);
+bool MemFindPatternsInPage(const SimplePage & page, const PatternSet & patterns, std::vector<PatternSetHit> & results, duint maxresults);
+bool MemFindPatternsInMap(const std::vector<SimplePage> & pages, const PatternSet & patterns, std::vector<PatternSetHit> & results, duint maxresults, bool progress = true);
 bool MemDecodePointer(duint* Pointer, bool vistaPlus);
 void MemInitRemoteProcessCookie(ULONG cookie);
 void MemReadDumb(duint BaseAddress, void* Buffer, duint Size);
@@ -6,10 +6,184 @@
 #include "memory.h"
 #include "label.h"
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 #include "console.h"
+#include "disasm_index.h"
+#include "taskpool.h"
+#include "symcache.h"
 
 std::map<Range, MODINFO, RangeCompare> modinfo;
 std::unordered_map<duint, std::string> hashNameMap;
+static std::atomic<unsigned int> modgeneration(0);
+
+// Immutable copy of what the hot lookups need from modinfo, published again on every change
+struct ModTableEntry
+{
+    duint base;
+    duint end; //exclusive
+    duint hash;
+    std::string name;
+    std::string extension;
+};
+
+struct ModTable
+{
+    std::vector<ModTableEntry> entries; //sorted by base
+};
+
+// Per-thread reader state. The table a reader points to is not freed until the reader moves on to a newer one.
+struct ModReader
+{
+    std::atomic<const ModTable*> hazard;
+    const ModTableEntry* last; //last hit in hazard
+
+    ModReader()
+        : hazard(nullptr),
+          last(nullptr)
+    {
+    }
+};
+
+static std::atomic<const ModTable*> modtable(nullptr);
+static std::mutex modReadersLock; //guards modReaders and modtableRetired
+static std::vector<ModReader*> modReaders;
+static std::vector<const ModTable*> modtableRetired;
+static DWORD modReaderTls = TlsAlloc();
+
+static const ModTableEntry* modTableFind(const ModTable & table, duint Address)
+{
+    auto found = std::upper_bound(table.entries.begin(), table.entries.end(), Address, [](duint Address, const ModTableEntry & entry)
+    {
+        return Address < entry.base;
+    });
+    if(found == table.entries.begin())
+        return nullptr;
+    --found;
+    return Address < found->end ? &*found : nullptr;
+}
+
+static const ModTableEntry* modTableLookup(const std::atomic<const ModTable*> & published, ModReader & reader, duint Address)
+{
+    // Announce the table before using it and make sure it was not replaced in the meantime
+    auto table = published.load();
+    while(reader.hazard.load(std::memory_order_relaxed) != table)
+    {
+        reader.hazard.store(table);
+        reader.last = nullptr;
+        table = published.load();
+    }
+    if(!table)
+        return nullptr;
+
+    // Consecutive lookups usually hit the same module
+    auto last = reader.last;
+    if(last && Address >= last->base && Address < last->end)
+        return last;
+    auto found = modTableFind(*table, Address);
+    if(found)
+        reader.last = found;
+    return found;
+}
+
+// Returns nullptr if there is no TLS slot for the reader state
+static ModReader* modReaderGet()
+{
+    if(modReaderTls == TLS_OUT_OF_INDEXES)
+        return nullptr;
+    auto reader = (ModReader*)TlsGetValue(modReaderTls);
+    if(!reader)
+    {
+        reader = new ModReader();
+        TlsSetValue(modReaderTls, reader);
+        std::lock_guard<std::mutex> lock(modReadersLock);
+        modReaders.push_back(reader);
+    }
+    return reader;
+}
+
+// Returns the module containing Address, the entry stays valid until the next lookup of the calling thread
+static const ModTableEntry* modLookup(duint Address)
+{
+    auto reader = modReaderGet();
+    if(reader)
+        return modTableLookup(modtable, *reader, Address);
+
+    // Without reader state the old tables are never freed
+    auto table = modtable.load();
+    return table ? modTableFind(*table, Address) : nullptr;
+}
+
+// Call with modReadersLock held
+static void modTableFreeRetired()
+{
+    for(auto itr = modtableRetired.begin(); itr != modtableRetired.end();)
+    {
+        auto used = std::any_of(modReaders.begin(), modReaders.end(), [itr](const ModReader * reader)
+        {
+            return reader->hazard.load() == *itr;
+        });
+        if(used)
+            ++itr;
+        else
+        {
+            delete *itr;
+            itr = modtableRetired.erase(itr);
+        }
+    }
+}
+
+// Call with LockModules held exclusively after changing modinfo
+static void modTablePublish()
+{
+    auto table = new ModTable();
+    table->entries.reserve(modinfo.size());
+    for(const auto & mod : modinfo)
+    {
+        ModTableEntry entry;
+        entry.base = mod.second.base;
+        entry.end = mod.second.base + mod.second.size;
+        entry.hash = mod.second.hash;
+        entry.name = mod.second.name;
+        entry.extension = mod.second.extension;
+        table->entries.push_back(std::move(entry));
+    }
+    auto old = modtable.exchange(table);
+
+    // Free the old tables once no reader can be using them anymore
+    std::lock_guard<std::mutex> lock(modReadersLock);
+    if(old)
+        modtableRetired.push_back(old);
+    if(modReaderTls == TLS_OUT_OF_INDEXES)
+        return;
+    modTableFreeRetired();
+}
+
+void ModThreadDetach()
+{
+    if(modReaderTls == TLS_OUT_OF_INDEXES)
+        return;
+    auto reader = (ModReader*)TlsGetValue(modReaderTls);
+    if(!reader)
+        return;
+    TlsSetValue(modReaderTls, nullptr);
+    reader->hazard.store(nullptr);
+    {
+        // The table this thread was pinning can be freed now
+        std::lock_guard<std::mutex> lock(modReadersLock);
+        modReaders.erase(std::find(modReaders.begin(), modReaders.end(), reader));
+        modTableFreeRetired();
+    }
+    delete reader;
+}
+
+void ModProcessDetach()
+{
+    if(modReaderTls == TLS_OUT_OF_INDEXES)
+        return;
+    TlsFree(modReaderTls);
+    modReaderTls = TLS_OUT_OF_INDEXES;
+}
 
 bool MODRELOCATIONINFO::Contains(duint Address) const
 {
@@ -247,6 +421,8 @@ bool ModLoad(duint Base, duint Size, const char* FullPath)
     // Add module to list
     EXCLUSIVE_ACQUIRE(LockModules);
     modinfo.insert(std::make_pair(Range(Base, Base + Size - 1), info));
+    modTablePublish();
+    modgeneration++;
     EXCLUSIVE_RELEASE();
 
     // Put labels for virtual module exports
@@ -281,9 +457,16 @@ bool ModUnload(duint Base)
         StaticFileUnloadW(StringUtils::Utf8ToUtf16(info.path).c_str(), false, info.fileHandle, info.loadedSize, info.fileMap, info.fileMapVA);
 
     // Remove it from the list
+    auto size = info.size;
     modinfo.erase(found);
+    modTablePublish();
+    modgeneration++;
     EXCLUSIVE_RELEASE();
 
+    // Drop the decoded instructions and the cached symbols of the module
+    DisasmIndexInvalidate(Base, size);
+    SymbolDelRange(Base);
+
     // Update symbols
     SymUpdateModuleList();
     return true;
@@ -304,6 +487,8 @@ void ModClear()
         }
 
         modinfo.clear();
+        modTablePublish();
+        modgeneration++;
     }
 
     {
@@ -312,6 +497,9 @@ void ModClear()
         hashNameMap.clear();
     }
 
+    DisasmIndexClear();
+    SymbolClear();
+
     // Tell the symbol updater
     GuiSymbolUpdateModuleList(0, nullptr);
 }
@@ -333,10 +521,7 @@ MODINFO* ModInfoFromAddr(duint Address)
 bool ModNameFromAddr(duint Address, char* Name, bool Extension)
 {
     ASSERT_NONNULL(Name);
-    SHARED_ACQUIRE(LockModules);
-
-    // Get a pointer to module information
-    auto module = ModInfoFromAddr(Address);
+    auto module = modLookup(Address);
 
     if(!module)
     {
@@ -345,19 +530,17 @@ bool ModNameFromAddr(duint Address, char* Name, bool Extension)
     }
 
     // Copy initial module name
-    strcpy_s(Name, MAX_MODULE_SIZE, module->name);
+    strcpy_s(Name, MAX_MODULE_SIZE, module->name.c_str());
 
     if(Extension)
-        strcat_s(Name, MAX_MODULE_SIZE, module->extension);
+        strcat_s(Name, MAX_MODULE_SIZE, module->extension.c_str());
 
     return true;
 }
 
 duint ModBaseFromAddr(duint Address)
 {
-    SHARED_ACQUIRE(LockModules);
-
-    auto module = ModInfoFromAddr(Address);
+    auto module = modLookup(Address);
 
     if(!module)
         return 0;
@@ -365,12 +548,15 @@ duint ModBaseFromAddr(duint Address)
     return module->base;
 }
 
+unsigned int ModGeneration()
+{
+    return modgeneration.load(std::memory_order_acquire);
+}
+
 duint ModHashFromAddr(duint Address)
 {
     // Returns a unique hash from a virtual address
-    SHARED_ACQUIRE(LockModules);
-
-    auto module = ModInfoFromAddr(Address);
+    auto module = modLookup(Address);
 
     if(!module)
         return Address;
@@ -441,14 +627,12 @@ duint ModBaseFromName(const char* Module)
 
 duint ModSizeFromAddr(duint Address)
 {
-    SHARED_ACQUIRE(LockModules);
-
-    auto module = ModInfoFromAddr(Address);
+    auto module = modLookup(Address);
 
     if(!module)
         return 0;
 
-    return module->size;
+    return module->end - module->base;
 }
 
 std::string ModNameFromHash(duint Hash)
@@ -660,3 +844,98 @@ bool ModRelocationsInRange(duint Address, duint Size, std::vector<MODRELOCATIONI
 
     return !Relocations.empty();
 }
+
+template<class TChunk>
+static void modBenchmarkRun(const char* name, size_t threads, const std::vector<duint> & addresses, TChunk chunk)
+{
+    // Chunks of lookups are spread over the pool, the checksum has to be the same for every variant
+    static const size_t chunkSize = 0x10000;
+    TaskSetConcurrency(threads);
+    std::atomic<duint> checksum(0);
+    auto chunkCount = (addresses.size() + chunkSize - 1) / chunkSize;
+    DWORD ticks = GetTickCount();
+    TaskParallelFor(0, chunkCount, [&](size_t i)
+    {
+        checksum += chunk(addresses.data() + i * chunkSize, addresses.data() + min((i + 1) * chunkSize, addresses.size()));
+    });
+    DWORD elapsed = GetTickCount() - ticks;
+    double rate = elapsed ? double(addresses.size()) / elapsed / 1000.0 : 0.0;
+    dprintf_untranslated("%-12s %2u thread(s) %6ums (%.1fM lookups/s) checksum: %p\n", name, unsigned(threads), elapsed, rate, checksum.load());
+}
+
+void ModBenchmarkLookup(duint Count, duint Lookups)
+{
+    // Synthetic modules, in a map behind LockModules (the previous lookup path) and in a published table
+    std::map<Range, duint, RangeCompare> locked;
+    ModTable table;
+    unsigned int seed = 0x1337;
+    auto random = [&seed]()
+    {
+        seed = seed * 1103515245 + 12345;
+        return seed >> 16;
+    };
+    duint base = 0x10000000;
+    for(duint i = 0; i < Count; i++)
+    {
+        duint size = 0x1000 * (16 + random() % 0x1F0);
+        locked.insert(std::make_pair(Range(base, base + size - 1), base));
+        ModTableEntry entry;
+        entry.base = base;
+        entry.end = base + size;
+        entry.hash = base;
+        table.entries.push_back(entry);
+        base += size + 0x1000 * (random() % 16);
+    }
+    std::atomic<const ModTable*> published(&table);
+
+    // Short runs of lookups in the same module, like tracing or walking the references of a function
+    std::vector<duint> addresses(Lookups);
+    for(duint i = 0; i < Lookups; i++)
+    {
+        const auto & entry = table.entries[(i / 16 * 7919) % Count];
+        addresses[i] = entry.base + ((random() << 8) | (random() & 0xFF)) % (entry.end - entry.base);
+    }
+
+    dprintf_untranslated("modules: %u, lookups: %u\n", unsigned(Count), unsigned(Lookups));
+    size_t threadCounts[] = { 1, TaskWorkerCount() + 1 };
+    for(auto threads : threadCounts)
+    {
+        modBenchmarkRun("locked map", threads, addresses, [&locked](const duint * begin, const duint * end)
+        {
+            duint sum = 0;
+            for(auto itr = begin; itr != end; ++itr)
+            {
+                SHARED_ACQUIRE(LockModules);
+                auto found = locked.find(Range(*itr, *itr));
+                if(found != locked.end())
+                    sum += found->second;
+            }
+            return sum;
+        });
+        modBenchmarkRun("table", threads, addresses, [&table](const duint * begin, const duint * end)
+        {
+            duint sum = 0;
+            for(auto itr = begin; itr != end; ++itr)
+            {
+                auto found = modTableFind(table, *itr);
+                if(found)
+                    sum += found->base;
+            }
+            return sum;
+        });
+        TaskLocal<ModReader> readers;
+        modBenchmarkRun("table+cache", threads, addresses, [&published, &readers](const duint * begin, const duint * end)
+        {
+            duint sum = 0;
+            auto & reader = readers.Local();
+            for(auto itr = begin; itr != end; ++itr)
+            {
+                auto found = modTableLookup(published, reader, *itr);
+                if(found)
+                    sum += found->base;
+            }
+            return sum;
+        });
+    }
+    TaskSetConcurrency(0);
+}
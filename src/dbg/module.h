@@ -63,6 +63,7 @@ void ModClear();
 MODINFO* ModInfoFromAddr(duint Address);
 bool ModNameFromAddr(duint Address, char* Name, bool Extension);
 duint ModBaseFromAddr(duint Address);
+unsigned int ModGeneration(); // Incremented every time a module is loaded or unloaded
 duint ModHashFromAddr(duint Address);
 duint ModHashFromName(const char* Module);
 duint ModContentHashFromAddr(duint Address);
@@ -72,6 +73,8 @@ std::string ModNameFromHash(duint Hash);
 bool ModSectionsFromAddr(duint Address, std::vector<MODSECTIONINFO>* Sections);
 bool ModImportsFromAddr(duint Address, std::vector<MODIMPORTINFO>* Imports);
 duint ModEntryFromAddr(duint Address);
+void ModThreadDetach(); // Releases the module reader state of the calling thread
+void ModProcessDetach();
 int ModPathFromAddr(duint Address, char* Path, int Size);
 int ModPathFromName(const char* Module, char* Path, int Size);
 
@@ -88,5 +91,6 @@ bool ModAddImportToModule(duint Base, const MODIMPORTINFO & importInfo);
 bool ModRelocationsFromAddr(duint Address, std::vector<MODRELOCATIONINFO> & Relocations);
 bool ModRelocationAtAddr(duint Address, MODRELOCATIONINFO* Relocation);
 bool ModRelocationsInRange(duint Address, duint Size, std::vector<MODRELOCATIONINFO> & Relocations);
+void ModBenchmarkLookup(duint Count, duint Lookups); // Compares the locked module lookup with the published table on synthetic modules
 
 #endif // _MODULE_H
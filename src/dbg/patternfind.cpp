@@ -1,5 +1,18 @@
 #include "patternfind.h"
 #include <vector>
+#include <cstring>
+#include <climits>
+#include <queue>
+#include <algorithm>
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PATTERN_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define PATTERN_TARGET_AVX2 __attribute__((target("avx2")))
+#endif //_MSC_VER
 
 using namespace std;
 
@@ -98,21 +111,18 @@ size_t patternfind(const unsigned char* data, size_t datasize, unsigned char* pa
 {
     if(patternsize > datasize)
         patternsize = datasize;
-    for(size_t i = 0, pos = 0; i < datasize; i++)
+    PatternCompiled compiled;
+    compiled.pattern.resize(patternsize);
+    for(size_t i = 0; i < patternsize; i++)
     {
-        if(data[i] == pattern[pos])
-        {
-            pos++;
-            if(pos == patternsize)
-                return i - patternsize + 1;
-        }
-        else if(pos > 0)
-        {
-            i -= pos;
-            pos = 0; //reset current pattern position
-        }
+        auto & pbyte = compiled.pattern[i];
+        pbyte.nibble[0].wildcard = pbyte.nibble[1].wildcard = false;
+        pbyte.nibble[0].data = (pattern[i] >> 4) & 0xF;
+        pbyte.nibble[1].data = pattern[i] & 0xF;
     }
-    return -1;
+    if(!patterncompile(compiled.pattern, compiled))
+        return -1;
+    return patternfind(data, datasize, compiled);
 }
 
 static inline void patternwritebyte(unsigned char* byte, const PatternByte & pbyte)
@@ -148,9 +158,11 @@ bool patternsnr(unsigned char* data, size_t datasize, const char* searchpattern,
     return true;
 }
 
-size_t patternfind(const unsigned char* data, size_t datasize, const std::vector<PatternByte> & pattern)
+static size_t patternfindnaive(const unsigned char* data, size_t datasize, const std::vector<PatternByte> & pattern)
 {
     size_t searchpatternsize = pattern.size();
+    if(!searchpatternsize)
+        return -1;
     for(size_t i = 0, pos = 0; i < datasize; i++) //search for the pattern
     {
         if(patternmatchbyte(data[i], pattern.at(pos))) //check if our pattern matches the current byte
@@ -166,4 +178,450 @@ size_t patternfind(const unsigned char* data, size_t datasize, const std::vector
         }
     }
     return -1;
-}
\ No newline at end of file
+}
+
+//rough occurrence weight of a byte in typical process memory (code, heap, strings), used to select the anchor
+static int patternbyteweight(unsigned char ch)
+{
+    switch(ch)
+    {
+    case 0x00:
+        return 2000;
+    case 0xFF:
+        return 400;
+    case 0xCC:
+    case 0x90:
+        return 200;
+    case 0x8B:
+    case 0x48:
+    case 0x89:
+    case 0x01:
+    case 0x20:
+        return 150;
+    case 0x02:
+    case 0x04:
+    case 0x08:
+    case 0x10:
+    case 0x40:
+    case 0x80:
+    case 0x0F:
+    case 0xE8:
+    case 0x24:
+    case 0x4C:
+    case 0x8D:
+    case 0x83:
+    case 0x85:
+    case 0xC3:
+    case 0x74:
+    case 0x75:
+    case 0xEB:
+    case 0x33:
+    case 0xFE:
+        return 80;
+    }
+    if(ch >= 'a' && ch <= 'z')
+        return 40;
+    if((ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9'))
+        return 20;
+    return 8;
+}
+
+bool patterncompile(const std::vector<PatternByte> & pattern, PatternCompiled & compiled)
+{
+    if(&compiled.pattern != &pattern)
+        compiled.pattern = pattern;
+    size_t size = pattern.size();
+    compiled.value.resize(size);
+    compiled.mask.resize(size);
+    compiled.anchor = compiled.anchor2 = 0;
+    compiled.wildcard = true;
+    compiled.exact = true;
+    if(!size)
+        return false;
+
+    int bestweight = INT_MAX, secondweight = INT_MAX;
+    for(size_t i = 0; i < size; i++)
+    {
+        const auto & pbyte = pattern[i];
+        unsigned char mask = 0, value = 0;
+        if(!pbyte.nibble[0].wildcard)
+        {
+            mask |= 0xF0;
+            value |= (pbyte.nibble[0].data & 0xF) << 4;
+        }
+        if(!pbyte.nibble[1].wildcard)
+        {
+            mask |= 0x0F;
+            value |= pbyte.nibble[1].data & 0xF;
+        }
+        compiled.mask[i] = mask;
+        compiled.value[i] = value;
+        if(mask != 0xFF)
+            compiled.exact = false;
+        if(!mask)
+            continue;
+
+        //the weight of a (partially) wildcard byte is the sum of the weights of all bytes it matches
+        int weight = 0;
+        for(int ch = 0; ch < 256; ch++)
+            if((ch & mask) == value)
+                weight += patternbyteweight((unsigned char)ch);
+
+        if(compiled.wildcard || weight < bestweight)
+        {
+            if(!compiled.wildcard)
+            {
+                secondweight = bestweight;
+                compiled.anchor2 = compiled.anchor;
+            }
+            else
+                compiled.anchor2 = i;
+            bestweight = weight;
+            compiled.anchor = i;
+            compiled.wildcard = false;
+        }
+        else if(compiled.anchor2 == compiled.anchor || weight < secondweight)
+        {
+            secondweight = weight;
+            compiled.anchor2 = i;
+        }
+    }
+    return true;
+}
+
+bool patterncompile(const std::string & patterntext, PatternCompiled & compiled)
+{
+    if(!patterntransform(patterntext, compiled.pattern))
+        return false;
+    return patterncompile(compiled.pattern, compiled);
+}
+
+static inline bool patternverify(const unsigned char* data, const PatternCompiled & compiled)
+{
+    size_t size = compiled.size();
+    if(compiled.exact)
+        return memcmp(data, compiled.value.data(), size) == 0;
+    const unsigned char* mask = compiled.mask.data();
+    const unsigned char* value = compiled.value.data();
+    for(size_t i = 0; i < size; i++)
+        if((data[i] & mask[i]) != value[i])
+            return false;
+    return true;
+}
+
+//checks all start positions in [start, last] one at a time
+static size_t patternfindscalar(const unsigned char* data, size_t start, size_t last, const PatternCompiled & compiled)
+{
+    size_t anchor = compiled.anchor;
+    unsigned char amask = compiled.mask[anchor];
+    unsigned char avalue = compiled.value[anchor];
+    if(amask == 0xFF)
+    {
+        //memchr is vectorized by the CRT
+        for(size_t i = start; i <= last;)
+        {
+            auto found = (const unsigned char*)memchr(data + i + anchor, avalue, last - i + 1);
+            if(!found)
+                break;
+            i = size_t(found - data) - anchor;
+            if(patternverify(data + i, compiled))
+                return i;
+            i++;
+        }
+        return -1;
+    }
+    for(size_t i = start; i <= last; i++)
+        if((data[i + anchor] & amask) == avalue && patternverify(data + i, compiled))
+            return i;
+    return -1;
+}
+
+static inline unsigned long patternbitscan(unsigned int bits)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return index;
+#else
+    return __builtin_ctz(bits);
+#endif //_MSC_VER
+}
+
+static size_t patternfindsse2(const unsigned char* data, size_t last, const PatternCompiled & compiled)
+{
+    const size_t anchor = compiled.anchor, anchor2 = compiled.anchor2;
+    const __m128i mask1 = _mm_set1_epi8(char(compiled.mask[anchor]));
+    const __m128i value1 = _mm_set1_epi8(char(compiled.value[anchor]));
+    const __m128i mask2 = _mm_set1_epi8(char(compiled.mask[anchor2]));
+    const __m128i value2 = _mm_set1_epi8(char(compiled.value[anchor2]));
+    size_t i = 0;
+    //every load of 16 bytes has to stay inside the data (last + anchor < datasize)
+    for(; last >= 15 && i <= last - 15; i += 16)
+    {
+        __m128i block1 = _mm_loadu_si128((const __m128i*)(data + i + anchor));
+        __m128i block2 = _mm_loadu_si128((const __m128i*)(data + i + anchor2));
+        __m128i eq1 = _mm_cmpeq_epi8(_mm_and_si128(block1, mask1), value1);
+        __m128i eq2 = _mm_cmpeq_epi8(_mm_and_si128(block2, mask2), value2);
+        unsigned int bits = (unsigned int)_mm_movemask_epi8(_mm_and_si128(eq1, eq2));
+        while(bits)
+        {
+            size_t candidate = i + patternbitscan(bits);
+            if(patternverify(data + candidate, compiled))
+                return candidate;
+            bits &= bits - 1;
+        }
+    }
+    return i <= last ? patternfindscalar(data, i, last, compiled) : -1;
+}
+
+PATTERN_TARGET_AVX2 static size_t patternfindavx2(const unsigned char* data, size_t last, const PatternCompiled & compiled)
+{
+    const size_t anchor = compiled.anchor, anchor2 = compiled.anchor2;
+    const __m256i mask1 = _mm256_set1_epi8(char(compiled.mask[anchor]));
+    const __m256i value1 = _mm256_set1_epi8(char(compiled.value[anchor]));
+    const __m256i mask2 = _mm256_set1_epi8(char(compiled.mask[anchor2]));
+    const __m256i value2 = _mm256_set1_epi8(char(compiled.value[anchor2]));
+    size_t i = 0;
+    for(; last >= 31 && i <= last - 31; i += 32)
+    {
+        __m256i block1 = _mm256_loadu_si256((const __m256i*)(data + i + anchor));
+        __m256i block2 = _mm256_loadu_si256((const __m256i*)(data + i + anchor2));
+        __m256i eq1 = _mm256_cmpeq_epi8(_mm256_and_si256(block1, mask1), value1);
+        __m256i eq2 = _mm256_cmpeq_epi8(_mm256_and_si256(block2, mask2), value2);
+        unsigned int bits = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(eq1, eq2));
+        while(bits)
+        {
+            size_t candidate = i + patternbitscan(bits);
+            if(patternverify(data + candidate, compiled))
+                return candidate;
+            bits &= bits - 1;
+        }
+    }
+    _mm256_zeroupper();
+    if(i > last)
+        return -1;
+    size_t found = patternfindsse2(data + i, last - i, compiled);
+    return found == -1 ? found : found + i;
+}
+
+static bool patternhasavx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if(info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if(!osxsave || !avx || (_xgetbv(0) & 6) != 6) //the OS has to save the YMM registers
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif //_MSC_VER
+}
+
+PATTERNENGINE patternengine()
+{
+    static PATTERNENGINE engine = patternhasavx2() ? PATTERN_ENGINE_AVX2 : PATTERN_ENGINE_SSE2;
+    return engine;
+}
+
+size_t patternfind(const unsigned char* data, size_t datasize, const PatternCompiled & compiled, PATTERNENGINE engine)
+{
+    size_t size = compiled.size();
+    if(!size || size > datasize)
+        return -1;
+    if(engine == PATTERN_ENGINE_NAIVE)
+        return patternfindnaive(data, datasize, compiled.pattern);
+    if(compiled.wildcard)
+        return 0;
+    size_t last = datasize - size; //last possible start offset
+    if(engine == PATTERN_ENGINE_AUTO)
+        engine = patternengine();
+    switch(engine)
+    {
+    case PATTERN_ENGINE_AVX2:
+        if(patternengine() == PATTERN_ENGINE_AVX2)
+            return patternfindavx2(data, last, compiled);
+    //fallthrough
+    case PATTERN_ENGINE_SSE2:
+        return patternfindsse2(data, last, compiled);
+    default:
+        return patternfindscalar(data, 0, last, compiled);
+    }
+}
+
+size_t patternfind(const unsigned char* data, size_t datasize, const std::vector<PatternByte> & pattern)
+{
+    PatternCompiled compiled;
+    if(!patterncompile(pattern, compiled))
+        return -1;
+    return patternfind(data, datasize, compiled);
+}
+
+//keywords are capped to keep the automaton small, the full pattern is verified on every hit anyway
+#define PATTERN_MAX_KEYWORD 8
+
+bool patternsetcompile(const std::vector<std::vector<PatternByte>> & patterns, PatternSet & set)
+{
+    auto count = patterns.size();
+    set.patterns.resize(count);
+    set.keywordoffset.assign(count, 0);
+    set.keywordsize.assign(count, 0);
+    set.transitions.assign(256, 0);
+    set.unanchored.clear();
+    set.maxkeywordend = 0;
+    if(!count)
+        return false;
+
+    //build the trie, state 0 is the root
+    std::vector<std::vector<unsigned int>> stateoutputs(1);
+    for(size_t id = 0; id < count; id++)
+    {
+        auto & compiled = set.patterns[id];
+        if(!patterncompile(patterns[id], compiled))
+            return false;
+
+        //select the longest run of full bytes as keyword
+        size_t bestoffset = 0, bestsize = 0;
+        for(size_t i = 0; i < compiled.size();)
+        {
+            if(compiled.mask[i] != 0xFF)
+            {
+                i++;
+                continue;
+            }
+            size_t start = i;
+            while(i < compiled.size() && compiled.mask[i] == 0xFF)
+                i++;
+            if(i - start > bestsize)
+            {
+                bestoffset = start;
+                bestsize = i - start;
+            }
+        }
+        if(!bestsize)
+        {
+            set.unanchored.push_back(id);
+            continue;
+        }
+        bestsize = min(bestsize, size_t(PATTERN_MAX_KEYWORD));
+        set.keywordoffset[id] = bestoffset;
+        set.keywordsize[id] = bestsize;
+        set.maxkeywordend = max(set.maxkeywordend, bestoffset + bestsize);
+
+        unsigned int state = 0;
+        for(size_t i = 0; i < bestsize; i++)
+        {
+            auto & next = set.transitions[state * 256 + compiled.value[bestoffset + i]];
+            if(!next)
+            {
+                next = (unsigned int)stateoutputs.size();
+                stateoutputs.emplace_back();
+                set.transitions.resize(set.transitions.size() + 256, 0);
+            }
+            state = set.transitions[state * 256 + compiled.value[bestoffset + i]];
+        }
+        stateoutputs[state].push_back((unsigned int)id);
+    }
+
+    //breadth-first pass to turn the trie into a DFA (missing transitions follow the failure links)
+    auto states = stateoutputs.size();
+    std::vector<unsigned int> fail(states, 0);
+    std::queue<unsigned int> queue;
+    for(int ch = 0; ch < 256; ch++)
+        if(set.transitions[ch])
+            queue.push(set.transitions[ch]);
+    while(!queue.empty())
+    {
+        auto state = queue.front();
+        queue.pop();
+        //the failure state is closer to the root, so its outputs are complete already
+        const auto & failoutputs = stateoutputs[fail[state]];
+        stateoutputs[state].insert(stateoutputs[state].end(), failoutputs.begin(), failoutputs.end());
+        for(int ch = 0; ch < 256; ch++)
+        {
+            auto & next = set.transitions[state * 256 + ch];
+            auto failnext = set.transitions[fail[state] * 256 + ch];
+            if(next)
+            {
+                fail[next] = failnext;
+                queue.push(next);
+            }
+            else
+                next = failnext;
+        }
+    }
+
+    //flatten the outputs
+    set.outputstart.resize(states + 1);
+    set.outputs.clear();
+    for(size_t state = 0; state < states; state++)
+    {
+        set.outputstart[state] = (unsigned int)set.outputs.size();
+        set.outputs.insert(set.outputs.end(), stateoutputs[state].begin(), stateoutputs[state].end());
+    }
+    set.outputstart[states] = (unsigned int)set.outputs.size();
+    return true;
+}
+
+size_t patternsetfind(const unsigned char* data, size_t datasize, const PatternSet & set, std::vector<PatternSetHit> & hits, size_t maxhits)
+{
+    if(!set.size() || !maxhits)
+        return 0;
+    auto first = hits.size();
+
+    //single pass over the data for all patterns with a keyword
+    if(set.outputs.size())
+    {
+        const unsigned int* transitions = set.transitions.data();
+        const unsigned int* outputstart = set.outputstart.data();
+        unsigned int state = 0;
+        size_t stop = datasize;
+        for(size_t i = 0; i < stop; i++)
+        {
+            //hits are reported by keyword end, so keep scanning until no later hit can start before the ones we have
+            if(stop == datasize && hits.size() - first >= maxhits)
+                stop = min(datasize, i + set.maxkeywordend);
+            state = transitions[state * 256 + data[i]];
+            for(auto j = outputstart[state]; j < outputstart[state + 1]; j++)
+            {
+                auto id = set.outputs[j];
+                const auto & compiled = set.patterns[id];
+                size_t keywordend = set.keywordoffset[id] + set.keywordsize[id];
+                if(i + 1 < keywordend)
+                    continue;
+                size_t start = i + 1 - keywordend;
+                if(start + compiled.size() > datasize || !patternverify(data + start, compiled))
+                    continue;
+                hits.push_back({ id, start });
+            }
+        }
+    }
+
+    //patterns that consist of nibble wildcards only
+    for(auto id : set.unanchored)
+    {
+        const auto & compiled = set.patterns[id];
+        for(size_t i = 0, count = 0; i < datasize && count < maxhits; count++)
+        {
+            auto found = patternfind(data + i, datasize - i, compiled);
+            if(found == -1)
+                break;
+            hits.push_back({ id, i + found });
+            i += found + 1;
+        }
+    }
+
+    std::sort(hits.begin() + first, hits.end(), [](const PatternSetHit & a, const PatternSetHit & b)
+    {
+        return a.offset < b.offset || (a.offset == b.offset && a.id < b.id);
+    });
+    if(hits.size() - first > maxhits)
+        hits.resize(first + maxhits);
+    return hits.size() - first;
+}
@@ -2,6 +2,7 @@
 #define _PATTERNFIND_H
 
 #include <vector>
+#include <string>
 
 struct PatternByte
 {
@@ -55,4 +56,88 @@ size_t patternfind(
     const std::vector<PatternByte> & pattern //pattern to search
 );
 
+enum PATTERNENGINE
+{
+    PATTERN_ENGINE_AUTO, //best engine supported by the processor
+    PATTERN_ENGINE_NAIVE, //byte-by-byte matching with backtracking (reference implementation)
+    PATTERN_ENGINE_SCALAR, //anchor byte scan without SIMD
+    PATTERN_ENGINE_SSE2,
+    PATTERN_ENGINE_AVX2
+};
+
+struct PatternCompiled
+{
+    std::vector<PatternByte> pattern; //original pattern (used by PATTERN_ENGINE_NAIVE)
+    std::vector<unsigned char> value; //byte values with the wildcard nibbles cleared
+    std::vector<unsigned char> mask; //0xFF for a full byte, 0xF0/0x0F for a nibble wildcard, 0x00 for a full wildcard
+    size_t anchor = 0; //offset of the rarest non-wildcard byte
+    size_t anchor2 = 0; //offset of the second rarest non-wildcard byte (equal to anchor if there is only one)
+    bool wildcard = true; //true if the pattern consists only of wildcards
+    bool exact = false; //true if the pattern contains no wildcards at all
+
+    size_t size() const
+    {
+        return value.size();
+    }
+};
+
+//returns: true on success, false on failure
+bool patterncompile(const std::vector<PatternByte> & pattern, //pattern to compile
+                    PatternCompiled & compiled //compiled pattern to feed to patternfind
+                   );
+
+//returns: true on success, false on failure
+bool patterncompile(const std::string & patterntext, //pattern string
+                    PatternCompiled & compiled //compiled pattern to feed to patternfind
+                   );
+
+//returns: offset to data when found, -1 when not found
+size_t patternfind(
+    const unsigned char* data, //data
+    size_t datasize, //size of data
+    const PatternCompiled & compiled, //compiled pattern to search
+    PATTERNENGINE engine = PATTERN_ENGINE_AUTO //engine to use (mostly useful for benchmarking)
+);
+
+//returns: the engine PATTERN_ENGINE_AUTO resolves to on this processor
+PATTERNENGINE patternengine();
+
+struct PatternSetHit
+{
+    size_t id; //index of the pattern in the set
+    size_t offset; //offset to data where the pattern starts
+};
+
+//Aho-Corasick automaton over the longest wildcard-free keyword of every pattern in the set
+struct PatternSet
+{
+    std::vector<PatternCompiled> patterns; //compiled patterns (used to verify keyword hits)
+    std::vector<size_t> keywordoffset; //offset of the keyword in the pattern (per pattern)
+    std::vector<size_t> keywordsize; //size of the keyword, 0 if the pattern has no full bytes (per pattern)
+    std::vector<unsigned int> transitions; //dense DFA transition table (states * 256)
+    std::vector<unsigned int> outputstart; //index in outputs where the matches of a state start (states + 1)
+    std::vector<unsigned int> outputs; //pattern ids whose keyword ends in a state
+    std::vector<size_t> unanchored; //ids of patterns without a keyword, searched one by one
+    size_t maxkeywordend = 0; //maximum offset of a keyword end in a pattern
+
+    size_t size() const
+    {
+        return patterns.size();
+    }
+};
+
+//returns: true on success, false on failure
+bool patternsetcompile(const std::vector<std::vector<PatternByte>> & patterns, //patterns to search
+                       PatternSet & set //compiled set to feed to patternsetfind
+                      );
+
+//returns: number of hits appended to hits (sorted by offset, then by id)
+size_t patternsetfind(
+    const unsigned char* data, //data
+    size_t datasize, //size of data
+    const PatternSet & set, //compiled pattern set
+    std::vector<PatternSetHit> & hits, //receives the hits
+    size_t maxhits = -1 //maximum number of hits to append
+);
+
 #endif // _PATTERNFIND_H
@@ -9,12 +9,14 @@
 #include "console.h"
 #include "module.h"
 #include "threading.h"
+#include "disasm_index.h"
+#include "taskpool.h"
 
 /**
 @brief RefFind Find reference to the buffer by a given criterion.
 @param Address The base address of the buffer
 @param Size The size of the buffer
-@param Callback The callback that is invoked to identify whether an instruction satisfies the criterion. prototype: bool callback(Capstone* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO* refinfo)
+@param Callback The callback that is invoked to identify whether an instruction satisfies the criterion. prototype: bool callback(duint addr, ZydisMnemonic mnemonic, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO* refinfo)
 @param UserData The data that will be passed to Callback
 @param Silent If true, no log will be outputed.
 @param Name The name of the reference criterion. Not null.
@@ -62,15 +64,13 @@ int RefFind(duint Address, duint Size, CBREF Callback, void* UserData, bool Sile
         else
             sprintf_s(fullName, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "%s (Region %p)")), Name, scanStart);
 
-        // Initialize disassembler
-        Zydis cp;
-
         // Allow an "initialization" notice
         refInfo.refcount = 0;
         refInfo.userinfo = UserData;
         refInfo.name = fullName;
+        refInfo.rows = nullptr;
 
-        RefFindInRange(scanStart, scanSize, Callback, UserData, Silent, refInfo, cp, true, [](int percent)
+        RefFindInRange(scanStart, scanSize, Callback, UserData, Silent, refInfo, true, [](int percent)
         {
             GuiReferenceSetCurrentTaskProgress(percent, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Region Search")));
             GuiReferenceSetProgress(percent);
@@ -103,15 +103,13 @@ int RefFind(duint Address, duint Size, CBREF Callback, void* UserData, bool Sile
         else
             sprintf_s(fullName, "%s (%p)", Name, scanStart);
 
-        // Initialize disassembler
-        Zydis cp;
-
         // Allow an "initialization" notice
         refInfo.refcount = 0;
         refInfo.userinfo = UserData;
         refInfo.name = fullName;
+        refInfo.rows = nullptr;
 
-        RefFindInRange(scanStart, scanSize, Callback, UserData, Silent, refInfo, cp, true, [](int percent)
+        RefFindInRange(scanStart, scanSize, Callback, UserData, Silent, refInfo, true, [](int percent)
         {
             GuiReferenceSetCurrentTaskProgress(percent, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "Module Search")));
             GuiReferenceSetProgress(percent);
@@ -146,9 +144,6 @@ int RefFind(duint Address, duint Size, CBREF Callback, void* UserData, bool Sile
             return 0;
         }
 
-        // Initialize disassembler
-        Zydis cp;
-
         // Determine the full module
         sprintf_s(fullName, GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "All Modules (%s)")), Name);
 
@@ -156,6 +151,7 @@ int RefFind(duint Address, duint Size, CBREF Callback, void* UserData, bool Sile
         refInfo.refcount = 0;
         refInfo.userinfo = UserData;
         refInfo.name = fullName;
+        refInfo.rows = nullptr;
 
         for(duint i = 0; i < modList.size(); i++)
         {
@@ -165,7 +161,7 @@ int RefFind(duint Address, duint Size, CBREF Callback, void* UserData, bool Sile
             if(i != 0)
                 initCallBack = false;
 
-            RefFindInRange(scanStart, scanSize, Callback, UserData, Silent, refInfo, cp, initCallBack, [&i, &modList](int percent)
+            RefFindInRange(scanStart, scanSize, Callback, UserData, Silent, refInfo, initCallBack, [&i, &modList](int percent)
             {
                 float fPercent = (float)percent / 100.f;
                 float fTotalPercent = ((float)i + fPercent) / (float)modList.size();
@@ -185,7 +181,68 @@ int RefFind(duint Address, duint Size, CBREF Callback, void* UserData, bool Sile
     return refInfo.refcount;
 }
 
-int RefFindInRange(duint scanStart, duint scanSize, CBREF Callback, void* UserData, bool Silent, REFINFO & refInfo, Zydis & cp, bool initCallBack, const CBPROGRESS & cbUpdateProgress, bool disasmText)
+//fallback for the reference view when the GUI cannot provide the disassembly
+static String refInstructionText(duint addr)
+{
+    BASIC_INSTRUCTION_INFO basicinfo;
+    memset(&basicinfo, 0, sizeof(basicinfo));
+    disasmfast(addr, &basicinfo, true);
+    return basicinfo.instruction;
+}
+
+static const size_t RefPublishBatch = 4096;
+
+// Packs the rows column by column (address, disassembly, extra cells) and sends them to the reference view at once
+static void refPublishRows(const std::vector<const REFROW*> & batch)
+{
+    if(batch.empty())
+        return;
+    size_t cols = 2;
+    for(auto row : batch)
+        cols = max(cols, row->cells.size() + 2);
+    std::string cells;
+    cells.reserve(batch.size() * 64);
+    for(size_t column = 0; column < cols; column++)
+    {
+        for(auto row : batch)
+        {
+            if(column == 0)
+            {
+                char addrText[20] = "";
+                sprintf_s(addrText, "%p", row->addr);
+                cells.append(addrText);
+            }
+            else if(column == 1)
+            {
+                char disassembly[GUI_MAX_DISASSEMBLY_SIZE] = "";
+                if(GuiGetDisassembly(row->addr, disassembly))
+                    cells.append(disassembly);
+                else
+                    cells.append(refInstructionText(row->addr));
+            }
+            else if(column - 2 < row->cells.size())
+                cells.append(row->cells[column - 2]);
+            cells.push_back('\0');
+        }
+    }
+    GuiReferenceAddRows(int(batch.size()), int(cols), cells.c_str());
+}
+
+/**
+@brief Adds a row to the results of the worker the reference callback runs on.
+@param refinfo The REFINFO passed to the callback.
+@param addr The address of the instruction, it fills the Address and Disassembly columns.
+@param cells The remaining columns.
+*/
+void RefAddRow(REFINFO* refinfo, duint addr, std::vector<String> cells)
+{
+    REFROW row;
+    row.addr = addr;
+    row.cells = std::move(cells);
+    refinfo->rows->push_back(std::move(row));
+}
+
+int RefFindInRange(duint scanStart, duint scanSize, CBREF Callback, void* UserData, bool Silent, REFINFO & refInfo, bool initCallBack, const CBPROGRESS & cbUpdateProgress, bool disasmText)
 {
     // Allocate and read a buffer from the remote process
     Memory<unsigned char*> data(scanSize, "reffind:data");
@@ -194,43 +251,50 @@ int RefFindInRange(duint scanStart, duint scanSize, CBREF Callback, void* UserDa
     MemReadDumb(scanStart, data(), scanSize);
 
     if(initCallBack)
-        Callback(0, 0, &refInfo);
-
-    //concurrency::parallel_for(duint (0), scanSize, [&](duint i)
-    for(duint i = 0; i < scanSize;)
+        Callback(0, ZYDIS_MNEMONIC_INVALID, nullptr, &refInfo);
+
+    // Decoded at most once per range (until its bytes change), the text is decoded again on the workers when needed
+    auto index = DisasmIndexGet(scanStart, scanSize, data());
+    auto parts = index->Split(TaskConcurrency() * 4);
+    auto partCount = parts.size() - 1;
+    std::vector<std::vector<REFROW>> partRows(partCount);
+    TaskParallelFor(0, partCount, [&](size_t i)
     {
-        // Print the progress every 4096 bytes
-        if((i % 0x1000) == 0)
-        {
-            // Percent = (current / total) * 100
-            // Integer = floor(percent)
-            int percent = (int)floor(((float)i / (float)scanSize) * 100.0f);
-
-            cbUpdateProgress(percent);
-        }
-
-        // Disassemble the instruction
-        int disasmMaxSize = min(MAX_DISASM_BUFFER, (int)(scanSize - i)); // Prevent going past the boundary
-        int disasmLen = 1;
-
-        if(cp.Disassemble(scanStart, data() + i, disasmMaxSize))
+        REFINFO partInfo = refInfo;
+        partInfo.rows = &partRows[i];
+        Zydis cp;
+        index->ForEach(parts[i], parts[i + 1], [&](duint addr, ZydisMnemonic mnemonic, BASIC_INSTRUCTION_INFO & basicinfo)
         {
-            BASIC_INSTRUCTION_INFO basicinfo;
-            fillbasicinfo(&cp, &basicinfo, disasmText);
-
-            if(Callback(&cp, &basicinfo, &refInfo))
-                refInfo.refcount++;
+            if(disasmText)
+            {
+                auto offset = addr - scanStart;
+                int disasmMaxSize = min(MAX_DISASM_BUFFER, (int)(scanSize - offset)); // Prevent going past the boundary
+                if(!cp.Disassemble(addr, data() + offset, disasmMaxSize))
+                    return;
+                fillbasicinfo(&cp, &basicinfo, true);
+            }
+            Callback(addr, mnemonic, &basicinfo, &partInfo);
+        });
+    }, nullptr, cbUpdateProgress);
 
-            disasmLen = cp.Size();
-        }
-        else
+    // Publish the rows in address order, a batch at a time so the GUI appends them in bulk
+    std::vector<const REFROW*> batch;
+    batch.reserve(RefPublishBatch);
+    for(const auto & rows : partRows)
+    {
+        for(const auto & row : rows)
         {
-            // Invalid instruction detected, so just skip the byte
+            batch.push_back(&row);
+            if(batch.size() == RefPublishBatch)
+            {
+                refPublishRows(batch);
+                refInfo.refcount += int(batch.size());
+                batch.clear();
+            }
         }
-
-        scanStart += disasmLen;
-        i += disasmLen;
     }
+    refPublishRows(batch);
+    refInfo.refcount += int(batch.size());
 
     cbUpdateProgress(100);
     return refInfo.refcount;
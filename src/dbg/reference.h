@@ -5,11 +5,19 @@
 #include "disasm_fast.h"
 #include <functional>
 
+// Row found by a reference callback, the Address and Disassembly columns are filled in when the row is published
+struct REFROW
+{
+    duint addr;
+    std::vector<String> cells; //the columns after Disassembly
+};
+
 struct REFINFO
 {
     int refcount;
     void* userinfo;
     const char* name;
+    std::vector<REFROW>* rows; //rows found by the worker the callback runs on
 };
 
 typedef enum
@@ -19,11 +27,13 @@ typedef enum
     ALL_MODULES
 } REFFINDTYPE;
 
-// Reference callback typedef
-typedef bool (*CBREF)(Zydis* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO* refinfo);
+// Reference callback typedef, basicinfo is nullptr for the initialization call. The instruction text is only available with disasmText.
+// The callbacks (except the initialization call) run on worker threads: they must not use the GUI and report their results with RefAddRow.
+typedef bool (*CBREF)(duint addr, ZydisMnemonic mnemonic, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO* refinfo);
 typedef std::function<void(int)> CBPROGRESS;
 
 int RefFind(duint Address, duint Size, CBREF Callback, void* UserData, bool Silent, const char* Name, REFFINDTYPE type, bool disasmText);
-int RefFindInRange(duint scanStart, duint scanSize, CBREF Callback, void* UserData, bool Silent, REFINFO & refInfo, Zydis & cp, bool initCallBack, const CBPROGRESS & cbUpdateProgress, bool disasmText);
+int RefFindInRange(duint scanStart, duint scanSize, CBREF Callback, void* UserData, bool Silent, REFINFO & refInfo, bool initCallBack, const CBPROGRESS & cbUpdateProgress, bool disasmText);
+void RefAddRow(REFINFO* refinfo, duint addr, std::vector<String> cells = std::vector<String>());
 
 #endif // _REFERENCE_H
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include "module.h"
 #include "memory.h"
 #include "jansson/jansson_x64dbg.h"
+#include <atomic>
+#include <deque>
 
 template<class TValue>
 class JSONWrapper
@@ -99,12 +101,35 @@ protected:
     JSON mJson = nullptr;
 };
 
+enum class SerializableChangeType
+{
+    Set,
+    Delete,
+    Clear
+};
+
+template<class TKey>
+struct SerializableChange
+{
+    SerializableChangeType type;
+    duint generation; //generation after the change
+    TKey key; //unused for Clear
+};
+
 template<SectionLock TLock, class TKey, class TValue, class TMap, class TSerializer>
 class SerializableTMap
 {
     static_assert(std::is_base_of<JSONWrapper<TValue>, TSerializer>::value, "TSerializer is not derived from JSONWrapper<TValue>");
 public:
     using TValuePred = std::function<bool(const TValue & value)>;
+    using TChange = SerializableChange<TKey>;
+
+    // Maximum number of entries in the change journal, older changes are dropped
+    static const size_t JournalSize = 0x10000;
+
+    SerializableTMap() : mGeneration(0)
+    {
+    }
 
     virtual ~SerializableTMap()
     {
@@ -135,7 +160,10 @@ public:
     bool Delete(const TKey & key)
     {
         EXCLUSIVE_ACQUIRE(TLock);
-        return mMap.erase(key) > 0;
+        if(mMap.erase(key) == 0)
+            return false;
+        changedNoLock(SerializableChangeType::Delete, key);
+        return true;
     }
 
     void DeleteWhere(TValuePred predicate)
@@ -144,7 +172,10 @@ public:
         for(auto itr = mMap.begin(); itr != mMap.end();)
         {
             if(predicate(itr->second))
+            {
+                changedNoLock(SerializableChangeType::Delete, itr->first);
                 itr = mMap.erase(itr);
+            }
             else
                 ++itr;
         }
@@ -165,6 +196,7 @@ public:
         EXCLUSIVE_ACQUIRE(TLock);
         TMap empty;
         std::swap(mMap, empty);
+        changedNoLock(SerializableChangeType::Clear, TKey());
     }
 
     void CacheSave(JSON root) const
@@ -247,6 +279,59 @@ public:
         return mMap;
     }
 
+    // Incremented on every modification, the database only saves maps that changed since the last save
+    duint Generation() const
+    {
+        return mGeneration.load();
+    }
+
+    // Call after modifying the value of key through GetDataUnsafe or in place
+    void MarkChanged(const TKey & key)
+    {
+        EXCLUSIVE_ACQUIRE(TLock);
+        changedNoLock(SerializableChangeType::Set, key);
+    }
+
+    // Returns the changes made after generation, oldest first. Returns false if the journal does not go back that far.
+    bool GetChangesSince(duint generation, std::vector<TChange> & changes) const
+    {
+        SHARED_ACQUIRE(TLock);
+        changes.clear();
+        if(!journalCoversNoLock(generation))
+            return false;
+        auto first = std::upper_bound(mJournal.begin(), mJournal.end(), generation, [](duint generation, const TChange & change)
+        {
+            return generation < change.generation;
+        });
+        changes.assign(first, mJournal.end());
+        return true;
+    }
+
+    // Collects the current value of every key set and every key deleted after generation, one entry per key.
+    // Returns false if the journal does not go back that far or the map was cleared, use GetList instead.
+    bool GetChangesSince(duint generation, std::vector<TValue> & changed, std::vector<TKey> & deleted) const
+    {
+        SHARED_ACQUIRE(TLock);
+        changed.clear();
+        deleted.clear();
+        if(!journalCoversNoLock(generation))
+            return false;
+        TMap seen; //the newest change of a key wins
+        for(auto itr = mJournal.rbegin(); itr != mJournal.rend() && itr->generation > generation; ++itr)
+        {
+            if(itr->type == SerializableChangeType::Clear)
+                return false;
+            if(!seen.emplace(itr->key, TValue()).second)
+                continue;
+            auto found = itr->type == SerializableChangeType::Set ? mMap.find(itr->key) : mMap.end();
+            if(found != mMap.end())
+                changed.push_back(found->second);
+            else
+                deleted.push_back(itr->key);
+        }
+        return true;
+    }
+
     virtual void AdjustValue(TValue & value) const = 0;
 
 protected:
@@ -255,13 +340,35 @@ protected:
 
 private:
     TMap mMap;
+    std::atomic<duint> mGeneration;
+    std::deque<TChange> mJournal;
 
     bool addNoLock(const TValue & value)
     {
-        mMap[makeKey(value)] = value;
+        auto key = makeKey(value);
+        mMap[key] = value;
+        changedNoLock(SerializableChangeType::Set, key);
         return true;
     }
 
+    void changedNoLock(SerializableChangeType type, const TKey & key)
+    {
+        if(mJournal.size() == JournalSize)
+            mJournal.pop_front();
+        mJournal.push_back({ type, ++mGeneration, key });
+    }
+
+    bool journalCoversNoLock(duint generation) const
+    {
+        auto current = mGeneration.load();
+        if(generation > current)
+            return false;
+        if(generation == current)
+            return true;
+        // The change right after generation has to be in the journal
+        return !mJournal.empty() && mJournal.front().generation <= generation + 1;
+    }
+
     bool getWhere(TValuePred predicate, TValue* value)
     {
         SHARED_ACQUIRE(TLock);
@@ -12,8 +12,35 @@
 
 static std::vector<LINEMAPENTRY> linemap;
 
+enum SCRIPTOP
+{
+    scriptopnone, //empty line, comment or label
+    scriptopret,
+    scriptoperror,
+    scriptopinvalid,
+    scriptoppause,
+    scriptopnop,
+    scriptoplog,
+    scriptopcommand,
+    scriptopbranch
+};
+
+struct SCRIPTINSTR
+{
+    SCRIPTOP op;
+    SCRIPTBRANCHTYPE branch;
+    int dest; //label line of the branch target
+    std::shared_ptr<CommandProgram> program; //parsed command (scriptoplog and scriptopcommand)
+};
+
+static std::vector<SCRIPTINSTR> scriptcode; //compiled linemap (index = line - 1)
+
+static std::vector<int> scriptnext; //scriptinternalstep results of the compiled script (index = fromIp)
+
 static std::vector<SCRIPTBP> scriptbplist;
 
+static std::vector<bool> scriptbpmap; //lines with a (silent) breakpoint, kept in sync with scriptbplist
+
 static std::vector<int> scriptstack;
 
 static int scriptIp = 0;
@@ -73,6 +100,8 @@ static inline bool isEmptyLine(SCRIPTLINETYPE type)
 
 static int scriptinternalstep(int fromIp) //internal step routine
 {
+    if(size_t(fromIp) < scriptnext.size()) //compiled script
+        return scriptnext[fromIp];
     int maxIp = (int)linemap.size(); //maximum ip
     if(fromIp >= maxIp) //script end
         return fromIp;
@@ -96,6 +125,8 @@ static bool scriptcreatelinemap(const char* filename)
     LINEMAPENTRY entry;
     memset(&entry, 0, sizeof(entry));
     std::vector<LINEMAPENTRY>().swap(linemap);
+    std::vector<SCRIPTINSTR>().swap(scriptcode);
+    std::vector<int>().swap(scriptnext);
     for(size_t i = 0, j = 0; i < len; i++) //make raw line map
     {
         if(filedata[i] == '\r' && filedata[i + 1] == '\n') //windows file
@@ -286,13 +317,17 @@ static bool scriptcreatelinemap(const char* filename)
     return true;
 }
 
+static void scriptbpupdate()
+{
+    scriptbpmap.assign(linemap.size() + 1, false);
+    for(const auto & bp : scriptbplist)
+        if(size_t(bp.line) < scriptbpmap.size())
+            scriptbpmap[bp.line] = true;
+}
+
 static bool scriptinternalbpget(int line) //internal bpget routine
 {
-    int bpcount = (int)scriptbplist.size();
-    for(int i = 0; i < bpcount; i++)
-        if(scriptbplist.at(i).line == line)
-            return true;
-    return false;
+    return size_t(line) < scriptbpmap.size() && scriptbpmap[line];
 }
 
 static bool scriptinternalbptoggle(int line) //internal breakpoint
@@ -317,6 +352,7 @@ static bool scriptinternalbptoggle(int line) //internal breakpoint
         newbp.line = line;
         scriptbplist.push_back(newbp);
     }
+    scriptbpupdate();
     return true;
 }
 
@@ -333,10 +369,29 @@ static bool scriptisinternalcommand(const char* text, const char* cmd)
     return false;
 }
 
-static CMDRESULT scriptinternalcmdexec(const char* cmd)
+static SCRIPTOP scriptgetop(const char* cmd)
+{
+    if(scriptisinternalcommand(cmd, "ret"))
+        return scriptopret;
+    else if(scriptisinternalcommand(cmd, "error"))
+        return scriptoperror;
+    else if(scriptisinternalcommand(cmd, "invalid"))
+        return scriptopinvalid;
+    else if(scriptisinternalcommand(cmd, "pause"))
+        return scriptoppause;
+    else if(scriptisinternalcommand(cmd, "nop"))
+        return scriptopnop;
+    else if(scriptisinternalcommand(cmd, "log"))
+        return scriptoplog;
+    return scriptopcommand;
+}
+
+static CMDRESULT scriptinternalcmdexec(const char* cmd, SCRIPTOP op, CommandProgram* program)
 {
     scriptLogEnabled = false;
-    if(scriptisinternalcommand(cmd, "ret")) //script finished
+    switch(op)
+    {
+    case scriptopret: //script finished
     {
         if(!scriptstack.size()) //nothing on the stack
         {
@@ -348,20 +403,22 @@ static CMDRESULT scriptinternalcmdexec(const char* cmd)
         scriptstack.pop_back(); //remove last stack entry
         return STATUS_CONTINUE;
     }
-    else if(scriptisinternalcommand(cmd, "error")) //show an error and end the script
-    {
+    case scriptoperror: //show an error and end the script
         GuiScriptError(0, StringUtils::Trim(cmd + strlen("error"), " \"'").c_str());
         return STATUS_EXIT;
-    }
-    else if(scriptisinternalcommand(cmd, "invalid")) //invalid command for testing
+    case scriptopinvalid: //invalid command for testing
         return STATUS_ERROR;
-    else if(scriptisinternalcommand(cmd, "pause")) //pause the script
+    case scriptoppause: //pause the script
         return STATUS_PAUSE;
-    else if(scriptisinternalcommand(cmd, "nop")) //do nothing
+    case scriptopnop: //do nothing
         return STATUS_CONTINUE;
-    else if(scriptisinternalcommand(cmd, "log"))
+    case scriptoplog:
         scriptLogEnabled = true;
-    auto res = cmddirectexec(cmd);
+        break;
+    default:
+        break;
+    }
+    auto res = program ? program->Execute() : cmddirectexec(cmd);
     while(DbgIsDebugging() && dbgisrunning() && !bAbort) //while not locked (NOTE: possible deadlock)
     {
         Sleep(1);
@@ -370,6 +427,43 @@ static CMDRESULT scriptinternalcmdexec(const char* cmd)
     return res ? STATUS_CONTINUE : STATUS_ERROR;
 }
 
+static CMDRESULT scriptinternalcmdexec(const char* cmd)
+{
+    return scriptinternalcmdexec(cmd, scriptgetop(cmd), nullptr);
+}
+
+static void scriptcompile() //resolve the linemap into instructions once so the run loop doesn't need to look at the text
+{
+    auto count = linemap.size();
+    std::vector<SCRIPTINSTR> code(count);
+    for(size_t i = 0; i < count; i++)
+    {
+        const auto & line = linemap[i];
+        auto & instr = code[i];
+        instr.op = scriptopnone;
+        instr.branch = scriptnobranch;
+        instr.dest = 0;
+        if(line.type == linecommand)
+        {
+            instr.op = scriptgetop(line.u.command);
+            if(instr.op == scriptoplog || instr.op == scriptopcommand)
+                instr.program = std::make_shared<CommandProgram>(line.u.command);
+        }
+        else if(line.type == linebranch)
+        {
+            instr.op = scriptopbranch;
+            instr.branch = line.u.branch.type;
+            instr.dest = scriptlabelfind(line.u.branch.branchlabel);
+        }
+    }
+    std::vector<int> next(count + 1);
+    for(size_t i = 0; i <= count; i++)
+        next[i] = scriptinternalstep(int(i));
+    scriptcode.swap(code);
+    scriptnext.swap(next);
+    scriptbpupdate();
+}
+
 static bool scriptinternalbranch(SCRIPTBRANCHTYPE type) //determine if we should jump
 {
     duint ezflag = 0;
@@ -417,12 +511,21 @@ static bool scriptinternalbranch(SCRIPTBRANCHTYPE type) //determine if we should
 static bool scriptinternalcmd()
 {
     bool bContinue = true;
-    if(size_t(scriptIp - 1) >= linemap.size())
+    if(size_t(scriptIp - 1) >= scriptcode.size())
         return false;
-    LINEMAPENTRY cur = linemap.at(scriptIp - 1);
-    if(cur.type == linecommand)
+    const auto & cur = scriptcode[scriptIp - 1];
+    if(cur.op == scriptopbranch)
     {
-        switch(scriptinternalcmdexec(cur.u.command))
+        if(cur.branch == scriptcall) //calls have a special meaning
+            scriptstack.push_back(scriptIp);
+        if(scriptinternalbranch(cur.branch))
+            scriptIp = cur.dest;
+    }
+    else if(cur.op != scriptopnone)
+    {
+        //the command can load another script, so keep the program alive and don't touch cur afterwards
+        auto program = cur.program;
+        switch(scriptinternalcmdexec(linemap[scriptIp - 1].u.command, cur.op, program.get()))
         {
         case STATUS_CONTINUE:
             break;
@@ -442,13 +545,6 @@ static bool scriptinternalcmd()
             break;
         }
     }
-    else if(cur.type == linebranch)
-    {
-        if(cur.u.branch.type == scriptcall) //calls have a special meaning
-            scriptstack.push_back(scriptIp);
-        if(scriptinternalbranch(cur.u.branch.type))
-            scriptIp = scriptlabelfind(cur.u.branch.branchlabel);
-    }
     return bContinue;
 }
 
@@ -508,10 +604,12 @@ DWORD WINAPI scriptLoadSync(void* filename)
     GuiScriptEnableHighlighting(true); //enable default script syntax highlighting
     scriptIp = 0;
     std::vector<SCRIPTBP>().swap(scriptbplist); //clear breakpoints
+    std::vector<bool>().swap(scriptbpmap);
     std::vector<int>().swap(scriptstack); //clear script stack
     bAbort = false;
     if(!scriptcreatelinemap(reinterpret_cast<const char*>(filename)))
         return 1; // Script load failed
+    scriptcompile();
     int lines = (int)linemap.size();
     const char** script = reinterpret_cast<const char**>(BridgeAlloc(lines * sizeof(const char*)));
     for(int i = 0; i < lines; i++) //add script lines
@@ -537,6 +635,7 @@ void scriptunload()
     GuiScriptClear();
     scriptIp = 0;
     std::vector<SCRIPTBP>().swap(scriptbplist); //clear breakpoints
+    std::vector<bool>().swap(scriptbpmap);
     bAbort = false;
 }
 
@@ -594,6 +693,7 @@ bool scriptbptoggle(int line)
         newbp.line = line;
         scriptbplist.push_back(newbp);
     }
+    scriptbpupdate();
     return true;
 }
 
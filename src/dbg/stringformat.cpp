@@ -5,6 +5,7 @@
 #include "disasm_fast.h"
 #include "disasm_helper.h"
 #include "formatfunctions.h"
+#include "expressionparser.h"
 
 enum class ValueType
 {
@@ -19,79 +20,83 @@ enum class ValueType
     Instruction
 };
 
-static String printValue(FormatValueType value, ValueType type)
+static String printValue(duint valuint, ValueType type)
 {
-    duint valuint = 0;
     char string[MAX_STRING_SIZE] = "";
     String result = "???";
-    if(valfromstring(value, &valuint))
+    switch(type)
     {
-        switch(type)
-        {
-        case ValueType::Unknown:
-            break;
+    case ValueType::Unknown:
+        break;
 #ifdef _WIN64
-        case ValueType::SignedDecimal:
-            result = StringUtils::sprintf("%lld", valuint);
-            break;
-        case ValueType::UnsignedDecimal:
-            result = StringUtils::sprintf("%llu", valuint);
-            break;
-        case ValueType::Hex:
-            result = StringUtils::sprintf("%llX", valuint);
-            break;
+    case ValueType::SignedDecimal:
+        result = StringUtils::sprintf("%lld", valuint);
+        break;
+    case ValueType::UnsignedDecimal:
+        result = StringUtils::sprintf("%llu", valuint);
+        break;
+    case ValueType::Hex:
+        result = StringUtils::sprintf("%llX", valuint);
+        break;
 #else //x86
-        case ValueType::SignedDecimal:
-            result = StringUtils::sprintf("%d", valuint);
-            break;
-        case ValueType::UnsignedDecimal:
-            result = StringUtils::sprintf("%u", valuint);
-            break;
-        case ValueType::Hex:
-            result = StringUtils::sprintf("%X", valuint);
-            break;
+    case ValueType::SignedDecimal:
+        result = StringUtils::sprintf("%d", valuint);
+        break;
+    case ValueType::UnsignedDecimal:
+        result = StringUtils::sprintf("%u", valuint);
+        break;
+    case ValueType::Hex:
+        result = StringUtils::sprintf("%X", valuint);
+        break;
 #endif //_WIN64
-        case ValueType::Pointer:
-            result = StringUtils::sprintf("%p", valuint);
-            break;
-        case ValueType::String:
-            if(disasmgetstringatwrapper(valuint, string, false))
-                result = string;
-            break;
-        case ValueType::AddrInfo:
-        {
-            auto symbolic = SymGetSymbolicName(valuint);
-            if(disasmgetstringatwrapper(valuint, string, false))
-                result = string;
-            else if(symbolic.length())
-                result = symbolic;
-            else
-                result.clear();
-        }
+    case ValueType::Pointer:
+        result = StringUtils::sprintf("%p", valuint);
         break;
-        case ValueType::Module:
-        {
-            char mod[MAX_MODULE_SIZE] = "";
-            ModNameFromAddr(valuint, mod, true);
-            result = mod;
-        }
+    case ValueType::String:
+        if(disasmgetstringatwrapper(valuint, string, false))
+            result = string;
         break;
-        case ValueType::Instruction:
-        {
-            BASIC_INSTRUCTION_INFO info;
-            if(!disasmfast(valuint, &info, true))
-                result = "???";
-            else
-                result = info.instruction;
-        }
+    case ValueType::AddrInfo:
+    {
+        auto symbolic = SymGetSymbolicName(valuint);
+        if(disasmgetstringatwrapper(valuint, string, false))
+            result = string;
+        else if(symbolic.length())
+            result = symbolic;
+        else
+            result.clear();
+    }
+    break;
+    case ValueType::Module:
+    {
+        char mod[MAX_MODULE_SIZE] = "";
+        ModNameFromAddr(valuint, mod, true);
+        result = mod;
+    }
+    break;
+    case ValueType::Instruction:
+    {
+        BASIC_INSTRUCTION_INFO info;
+        if(!disasmfast(valuint, &info, true))
+            result = "???";
+        else
+            result = info.instruction;
+    }
+    break;
+    default:
         break;
-        default:
-            break;
-        }
     }
     return result;
 }
 
+static String printValue(FormatValueType value, ValueType type)
+{
+    duint valuint = 0;
+    if(valfromstring(value, &valuint))
+        return printValue(valuint, type);
+    return "???";
+}
+
 static bool typeFromCh(char ch, ValueType & type)
 {
     switch(ch)
@@ -220,16 +225,20 @@ String stringformat(String format, const FormatValueVector & values)
     return output;
 }
 
+static String printComplexValue(duint valuint, const StringList & split)
+{
+    std::vector<char> dest;
+    if(FormatFunctions::Call(dest, split[0], split, valuint))
+        return String(dest.data());
+    return GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "[Formatting Error]"));
+}
+
 static String printComplexValue(FormatValueType value, const String & complexArgs)
 {
     auto split = StringUtils::Split(complexArgs, ';');
     duint valuint;
     if(!split.empty() && valfromstring(value, &valuint))
-    {
-        std::vector<char> dest;
-        if(FormatFunctions::Call(dest, split[0], split, valuint))
-            return String(dest.data());
-    }
+        return printComplexValue(valuint, split);
     return GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "[Formatting Error]"));
 }
 
@@ -293,3 +302,113 @@ String stringformatinline(String format)
         output += "{";
     return output;
 }
+
+StringFormatInline::StringFormatInline(String format)
+{
+    StringUtils::ReplaceAll(format, "\\n", "\n");
+    int len = (int)format.length();
+    String text;
+    String formatString;
+    bool inFormatter = false;
+    for(int i = 0; i < len; i++)
+    {
+        //handle escaped format sequences "{{" and "}}"
+        if(format[i] == '{' && (i + 1 < len && format[i + 1] == '{'))
+        {
+            text += "{";
+            i++;
+            continue;
+        }
+        if(format[i] == '}' && (i + 1 < len && format[i + 1] == '}'))
+        {
+            text += "}";
+            i++;
+            continue;
+        }
+        //handle actual formatting
+        if(format[i] == '{' && !inFormatter) //opening bracket
+        {
+            inFormatter = true;
+            formatString.clear();
+        }
+        else if(format[i] == '}' && inFormatter) //closing bracket
+        {
+            inFormatter = false;
+            if(formatString.length())
+            {
+                addText(text);
+                text.clear();
+                addHole(formatString);
+                formatString.clear();
+            }
+        }
+        else if(inFormatter) //inside brackets
+            formatString += format[i];
+        else //outside brackets
+            text += format[i];
+    }
+    if(inFormatter && formatString.size())
+    {
+        addText(text);
+        text.clear();
+        addHole(formatString);
+    }
+    else if(inFormatter)
+        text += "{";
+    addText(text);
+}
+
+void StringFormatInline::addText(const String & text)
+{
+    if(text.empty())
+        return;
+    if(!mSegments.empty() && mSegments.back().type == -1)
+    {
+        mSegments.back().text += text;
+        return;
+    }
+    Segment segment;
+    segment.type = -1;
+    segment.text = text;
+    mSegments.push_back(segment);
+}
+
+void StringFormatInline::addHole(const String & formatString)
+{
+    auto type = ValueType::Unknown;
+    String complexArgs;
+    auto value = getArgExpressionType(formatString, type, complexArgs);
+    Segment segment;
+    segment.type = int(type);
+    if(!complexArgs.empty())
+    {
+        segment.complexArgs = StringUtils::Split(complexArgs, ';');
+        if(segment.complexArgs.empty())
+            return addText(GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "[Formatting Error]")));
+    }
+    else if(!value || !*value)
+        return addText(GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "[Formatting Error]")));
+    if(*value) //an empty value is 0, like in valfromstring
+        segment.value = std::make_shared<ExpressionParser>(value);
+    mSegments.push_back(segment);
+}
+
+String StringFormatInline::Format() const
+{
+    String output;
+    for(const auto & segment : mSegments)
+    {
+        if(segment.type == -1)
+        {
+            output += segment.text;
+            continue;
+        }
+        duint value = 0;
+        auto valid = !segment.value || segment.value->Calculate(value, valuesignedcalc(), false);
+        if(!segment.complexArgs.empty())
+            output += valid ? printComplexValue(value, segment.complexArgs) : GuiTranslateText(QT_TRANSLATE_NOOP("DBG", "[Formatting Error]"));
+        else
+            output += valid ? printValue(value, ValueType(segment.type)) : "???";
+    }
+    return output;
+}
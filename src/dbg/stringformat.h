@@ -2,6 +2,7 @@
 #define _STRINGFORMAT_H
 
 #include "_global.h"
+#include <memory>
 
 typedef const char* FormatValueType;
 typedef std::vector<FormatValueType> FormatValueVector;
@@ -9,4 +10,31 @@ typedef std::vector<FormatValueType> FormatValueVector;
 String stringformat(String format, const FormatValueVector & values);
 String stringformatinline(String format);
 
+class ExpressionParser;
+
+/**
+\brief A format string for stringformatinline with the {...} holes parsed in advance,
+       for text that is formatted over and over (breakpoint logs).
+*/
+class StringFormatInline
+{
+public:
+    explicit StringFormatInline(String format);
+    String Format() const;
+
+private:
+    struct Segment
+    {
+        String text; //literal text
+        int type; //value type of a hole, -1 for literal text
+        StringList complexArgs; //format function and its arguments
+        std::shared_ptr<ExpressionParser> value;
+    };
+
+    void addText(const String & text);
+    void addHole(const String & formatString);
+
+    std::vector<Segment> mSegments;
+};
+
 #endif //_STRINGFORMAT_H
\ No newline at end of file
@@ -10,15 +10,30 @@
 #include "module.h"
 #include "addrinfo.h"
 #include "dbghelp_safe.h"
+#include "symcache.h"
+#include <unordered_set>
 
 struct SYMBOLCBDATA
 {
     CBSYMBOLENUM cbSymbolEnum;
     void* user;
+    duint cacheBase; //module to add the symbols to in the symbol cache, 0 for none
     std::vector<char> decoratedSymbol;
     std::vector<char> undecoratedSymbol;
 };
 
+static void SymCacheAdd(duint Base, const SYMBOLINFO & Symbol, duint Size)
+{
+    SymbolInfo cached;
+    cached.addr = Symbol.addr;
+    cached.size = Size;
+    cached.decoratedName = Symbol.decoratedSymbol;
+    if(Symbol.undecoratedSymbol)
+        cached.undecoratedName = Symbol.undecoratedSymbol;
+    cached.isImported = Symbol.isImported;
+    SymbolAdd(Base, cached);
+}
+
 BOOL CALLBACK EnumSymbols(PSYMBOL_INFO SymInfo, ULONG SymbolSize, PVOID UserContext)
 {
     SYMBOLCBDATA* cbData = (SYMBOLCBDATA*)UserContext;
@@ -50,6 +65,9 @@ BOOL CALLBACK EnumSymbols(PSYMBOL_INFO SymInfo, ULONG SymbolSize, PVOID UserCont
     // Mark IAT entries as Imports
     curSymbol.isImported = strncmp(curSymbol.decoratedSymbol, "__imp_", 6) == 0;
 
+    if(cbData->cacheBase)
+        SymCacheAdd(cbData->cacheBase, curSymbol, SymInfo->Size);
+
     cbData->cbSymbolEnum(&curSymbol, cbData->user);
     return TRUE;
 }
@@ -75,15 +93,19 @@ void SymEnumImports(duint Base, CBSYMBOLENUM EnumCallback, SYMBOLCBDATA* cbData)
         else if(!strcmp(symbol.decoratedSymbol, symbol.undecoratedSymbol))
             symbol.undecoratedSymbol = nullptr;
 
+        if(cbData->cacheBase)
+            SymCacheAdd(cbData->cacheBase, symbol, sizeof(duint));
+
         EnumCallback(&symbol, cbData->user);
     });
 }
 
-void SymEnum(duint Base, CBSYMBOLENUM EnumCallback, void* UserData)
+static void SymEnum(duint Base, CBSYMBOLENUM EnumCallback, void* UserData, duint CacheBase)
 {
     SYMBOLCBDATA symbolCbData;
     symbolCbData.cbSymbolEnum = EnumCallback;
     symbolCbData.user = UserData;
+    symbolCbData.cacheBase = CacheBase;
     symbolCbData.decoratedSymbol.resize(MAX_SYM_NAME + 1);
     symbolCbData.undecoratedSymbol.resize(MAX_SYM_NAME + 1);
 
@@ -97,14 +119,34 @@ void SymEnum(duint Base, CBSYMBOLENUM EnumCallback, void* UserData)
     symbol.decoratedSymbol = "OptionalHeader.AddressOfEntryPoint";
     symbol.addr = ModEntryFromAddr(Base);
     if(symbol.addr)
+    {
+        if(CacheBase)
+            SymCacheAdd(CacheBase, symbol, 0);
         EnumCallback(&symbol, UserData);
+    }
 
     SymEnumImports(Base, EnumCallback, &symbolCbData);
 }
 
+void SymEnum(duint Base, CBSYMBOLENUM EnumCallback, void* UserData)
+{
+    SymEnum(Base, EnumCallback, UserData, 0);
+}
+
 void SymEnumFromCache(duint Base, CBSYMBOLENUM EnumCallback, void* UserData)
 {
-    SymEnum(Base, EnumCallback, UserData);
+    if(SymbolEnum(Base, EnumCallback, UserData))
+        return;
+
+    // Fill the symbol cache while enumerating the symbols the first time
+    auto size = ModSizeFromAddr(Base);
+    if(!size || !SymbolAddRange(Base, size)) //another thread is filling it
+    {
+        SymEnum(Base, EnumCallback, UserData);
+        return;
+    }
+    SymEnum(Base, EnumCallback, UserData, Base);
+    SymbolFinishRange(Base);
 }
 
 bool SymGetModuleList(std::vector<SYMBOLMODULEINFO>* List)
@@ -202,6 +244,8 @@ void SymDownloadAllSymbols(const char* SymbolStore)
                 continue;
             }
 
+            SymbolDelRange(module.base);
+
             if(!SafeSymUnloadModule64(fdProcessInfo->hProcess, (DWORD64)module.base))
             {
                 dprintf(QT_TRANSLATE_NOOP("DBG", "SymUnloadModule64 (%p) failed!\n"), module.base);
@@ -263,6 +307,14 @@ bool SymAddrFromName(const char* Name, duint* Address)
     if(!_strnicmp(Name, "Ordinal", 7))
         return false;
 
+    // Exact match in the symbols of the cached modules
+    SymbolInfo cached;
+    if(SymbolFromName(Name, cached))
+    {
+        *Address = cached.addr;
+        return true;
+    }
+
     // According to MSDN:
     // Note that the total size of the data is the SizeOfStruct + (MaxNameLen - 1) * sizeof(TCHAR)
     char buffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME * sizeof(char)];
@@ -278,6 +330,49 @@ bool SymAddrFromName(const char* Name, duint* Address)
     return true;
 }
 
+int SymAutoComplete(const char* Search, char** Buffer, int MaxSymbols)
+{
+    if(!Search || !Buffer || MaxSymbols <= 0)
+        return 0;
+
+    std::vector<SymbolInfo> symbols;
+    SymbolFind(Search, MaxSymbols, symbols);
+
+    // Complete to the decorated names, those resolve in expressions
+    int count = 0;
+    std::unordered_set<String> names;
+    for(const auto & symbol : symbols)
+    {
+        if(!names.insert(symbol.decoratedName).second)
+            continue;
+        auto length = symbol.decoratedName.length() + 1;
+        Buffer[count] = (char*)BridgeAlloc(length);
+        memcpy(Buffer[count], symbol.decoratedName.c_str(), length);
+        count++;
+    }
+    return count;
+}
+
+bool SymSearch(duint Base, const char* Search, CBSYMBOLENUM EnumCallback, void* UserData)
+{
+    if(!Search || !EnumCallback || !SymbolCached(Base))
+        return false;
+
+    // Prefix matches first, then the names that contain the text
+    std::vector<SymbolInfo> symbols;
+    SymbolFind(Search, size_t(-1), symbols, Base);
+    SYMBOLINFO symbol;
+    for(auto & cached : symbols)
+    {
+        symbol.addr = cached.addr;
+        symbol.decoratedSymbol = (char*)cached.decoratedName.c_str();
+        symbol.undecoratedSymbol = cached.undecoratedName.empty() ? nullptr : (char*)cached.undecoratedName.c_str();
+        symbol.isImported = cached.isImported;
+        EnumCallback(&symbol, UserData);
+    }
+    return true;
+}
+
 String SymGetSymbolicName(duint Address)
 {
     //
@@ -9,6 +9,8 @@ bool SymGetModuleList(std::vector<SYMBOLMODULEINFO>* List);
 void SymUpdateModuleList();
 void SymDownloadAllSymbols(const char* SymbolStore);
 bool SymAddrFromName(const char* Name, duint* Address);
+int SymAutoComplete(const char* Search, char** Buffer, int MaxSymbols);
+bool SymSearch(duint Base, const char* Search, CBSYMBOLENUM EnumCallback, void* UserData);
 String SymGetSymbolicName(duint Address);
 
 /**
@@ -1,23 +1,164 @@
 #include "symcache.h"
 #include "addrinfo.h"
 #include "threading.h"
+#include "module.h"
+#include <algorithm>
+#include <set>
 
 template<typename T>
 using RangeMap = std::map<Range, T, RangeCompare>;
 
-static RangeMap<RangeMap<SymbolInfo>> symbolRange;
-static std::unordered_map<duint, duint> symbolName;
+#define SYMBOL_NONAME 0xFFFFFFFF //no undecorated name
+#define SYMBOL_UNDECORATED 1 //name reference to the undecorated name of a symbol
+
+struct SymbolNameHash
+{
+    duint hash;
+    unsigned int ref; //symbol index << 1 | SYMBOL_UNDECORATED
+};
+
+/**
+\brief The symbols of a module stored as columns sorted by address. Every name is stored once
+       in an arena of zero-terminated strings and referenced by offset, which keeps the memory
+       close to the size of the names themselves even for PDBs with millions of symbols.
+*/
+struct SymbolModule
+{
+    bool finished;
+    std::vector<duint> addrs;
+    std::vector<duint> sizes;
+    std::vector<unsigned int> decorated; //arena offsets
+    std::vector<unsigned int> undecorated; //arena offsets or SYMBOL_NONAME
+    std::vector<bool> imported;
+    std::vector<char> arena;
+    std::vector<SymbolNameHash> hashes; //sorted on hash (exact lookups)
+    std::vector<unsigned int> names; //name references sorted case-insensitively (prefix lookups)
+    std::unordered_map<duint, unsigned int> intern; //name hash -> arena offset, only while adding
+
+    const char* name(unsigned int ref) const
+    {
+        auto index = ref >> 1;
+        return arena.data() + ((ref & SYMBOL_UNDECORATED) ? undecorated[index] : decorated[index]);
+    }
+
+    unsigned int internName(const String & str)
+    {
+        auto hash = ModHashFromName(str.c_str());
+        auto found = intern.find(hash);
+        if(found != intern.end() && str == arena.data() + found->second)
+            return found->second;
+        auto offset = (unsigned int)arena.size();
+        arena.insert(arena.end(), str.c_str(), str.c_str() + str.length() + 1);
+        if(found == intern.end())
+            intern.insert({ hash, offset });
+        return offset;
+    }
+
+    void fill(size_t index, SymbolInfo & symbol) const
+    {
+        symbol.addr = addrs[index];
+        symbol.size = sizes[index];
+        symbol.decoratedName = arena.data() + decorated[index];
+        if(undecorated[index] != SYMBOL_NONAME)
+            symbol.undecoratedName = arena.data() + undecorated[index];
+        else
+            symbol.undecoratedName.clear();
+        symbol.isImported = imported[index];
+    }
+};
+
+static RangeMap<SymbolModule> symbolModules;
+
+template<class T>
+static void symbolPermute(std::vector<T> & column, const std::vector<unsigned int> & order)
+{
+    std::vector<T> sorted;
+    sorted.reserve(order.size());
+    for(auto index : order)
+        sorted.push_back(column[index]);
+    column.swap(sorted);
+}
+
+static void symbolFinish(SymbolModule & module)
+{
+    // Sort the columns on address (stable, so symbols at the same address keep their order)
+    auto count = (unsigned int)module.addrs.size();
+    std::vector<unsigned int> order(count);
+    for(unsigned int i = 0; i < count; i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&module](unsigned int a, unsigned int b)
+    {
+        return module.addrs[a] < module.addrs[b];
+    });
+    symbolPermute(module.addrs, order);
+    symbolPermute(module.sizes, order);
+    symbolPermute(module.decorated, order);
+    symbolPermute(module.undecorated, order);
+    symbolPermute(module.imported, order);
+
+    // Build the name indices
+    module.hashes.clear();
+    module.names.clear();
+    for(unsigned int i = 0; i < count; i++)
+    {
+        for(unsigned int kind = 0; kind <= SYMBOL_UNDECORATED; kind++)
+        {
+            if(kind == SYMBOL_UNDECORATED && module.undecorated[i] == SYMBOL_NONAME)
+                continue;
+            auto ref = i << 1 | kind;
+            SymbolNameHash entry;
+            entry.hash = ModHashFromName(module.name(ref));
+            entry.ref = ref;
+            module.hashes.push_back(entry);
+            module.names.push_back(ref);
+        }
+    }
+    std::sort(module.hashes.begin(), module.hashes.end(), [](const SymbolNameHash & a, const SymbolNameHash & b)
+    {
+        return a.hash < b.hash;
+    });
+    std::sort(module.names.begin(), module.names.end(), [&module](unsigned int a, unsigned int b)
+    {
+        return _stricmp(module.name(a), module.name(b)) < 0;
+    });
+
+    // Release the slack of the columns and the interning map
+    module.addrs.shrink_to_fit();
+    module.sizes.shrink_to_fit();
+    module.decorated.shrink_to_fit();
+    module.undecorated.shrink_to_fit();
+    module.imported.shrink_to_fit();
+    module.arena.shrink_to_fit();
+    module.hashes.shrink_to_fit();
+    module.names.shrink_to_fit();
+    std::unordered_map<duint, unsigned int>().swap(module.intern);
+    module.finished = true;
+}
+
+static const SymbolModule* symbolModuleFromAddr(duint addr)
+{
+    auto found = symbolModules.find(Range(addr, addr));
+    if(found == symbolModules.end() || !found->second.finished)
+        return nullptr;
+    return &found->second;
+}
 
 bool SymbolFromAddr(duint addr, SymbolInfo & symbol)
 {
     SHARED_ACQUIRE(LockSymbolCache);
-    auto foundR = symbolRange.find(Range(addr, addr));
-    if(foundR == symbolRange.end())
+    auto module = symbolModuleFromAddr(addr);
+    if(!module)
+        return false;
+    // Last symbol that starts at or before the address
+    auto found = std::upper_bound(module->addrs.begin(), module->addrs.end(), addr);
+    if(found == module->addrs.begin())
         return false;
-    auto foundS = foundR->second.find(Range(addr, addr));
-    if(foundS == foundR->second.end())
+    auto index = size_t(found - module->addrs.begin() - 1);
+    auto start = module->addrs[index];
+    auto size = module->sizes[index];
+    if(addr != start && addr - start >= size)
         return false;
-    symbol = foundS->second;
+    module->fill(index, symbol);
     return true;
 }
 
@@ -27,48 +168,173 @@ bool SymbolFromName(const char* name, SymbolInfo & symbol)
         return false;
     auto hash = ModHashFromName(name);
     SHARED_ACQUIRE(LockSymbolCache);
-    auto found = symbolName.find(hash);
-    if(found == symbolName.end())
-        return false;
-    return SymbolFromAddr(found->second, symbol);
+    for(const auto & range : symbolModules)
+    {
+        const auto & module = range.second;
+        if(!module.finished)
+            continue;
+        SymbolNameHash key;
+        key.hash = hash;
+        auto found = std::lower_bound(module.hashes.begin(), module.hashes.end(), key, [](const SymbolNameHash & a, const SymbolNameHash & b)
+        {
+            return a.hash < b.hash;
+        });
+        for(; found != module.hashes.end() && found->hash == hash; ++found)
+        {
+            if(strcmp(module.name(found->ref), name) == 0)
+            {
+                module.fill(found->ref >> 1, symbol);
+                return true;
+            }
+        }
+    }
+    return false;
 }
 
-bool SymbolAdd(const SymbolInfo & symbol)
+bool SymbolAdd(duint base, const SymbolInfo & symbol)
 {
     EXCLUSIVE_ACQUIRE(LockSymbolCache);
-    auto foundR = symbolRange.find(Range(symbol.addr, symbol.addr));
-    if(foundR == symbolRange.end())
-        return false;
-    auto foundS = foundR->second.find(Range(symbol.addr, symbol.addr));
-    if(foundS != foundR->second.end())
+    auto found = symbolModules.find(Range(base, base));
+    if(found == symbolModules.end() || found->second.finished)
         return false;
-    auto dec = symbol.size ? 1 : 0;
-    foundR->second.insert({ Range(symbol.addr, symbol.addr + symbol.size - dec), symbol });
-    auto hash = ModHashFromName(symbol.decoratedName.c_str());
-    symbolName.insert({ hash, symbol.addr });
+    auto & module = found->second;
+    module.addrs.push_back(symbol.addr);
+    module.sizes.push_back(symbol.size);
+    module.decorated.push_back(module.internName(symbol.decoratedName));
+    module.undecorated.push_back(symbol.undecoratedName.empty() ? SYMBOL_NONAME : module.internName(symbol.undecoratedName));
+    module.imported.push_back(symbol.isImported);
     return true;
 }
 
 bool SymbolAddRange(duint start, duint size)
 {
     EXCLUSIVE_ACQUIRE(LockSymbolCache);
-    auto foundR = symbolRange.find(Range(start, start + size - 1));
-    if(foundR != symbolRange.end())
+    auto found = symbolModules.find(Range(start, start + size - 1));
+    if(found != symbolModules.end())
         return false;
-    symbolRange.insert({ Range(start, start + size - 1), RangeMap<SymbolInfo>() });
+    SymbolModule module;
+    module.finished = false;
+    symbolModules.insert({ Range(start, start + size - 1), std::move(module) });
+    return true;
+}
+
+bool SymbolFinishRange(duint start)
+{
+    EXCLUSIVE_ACQUIRE(LockSymbolCache);
+    auto found = symbolModules.find(Range(start, start));
+    if(found == symbolModules.end() || found->second.finished)
+        return false;
+    symbolFinish(found->second);
     return true;
 }
 
 bool SymbolDelRange(duint addr)
 {
     EXCLUSIVE_ACQUIRE(LockSymbolCache);
-    auto foundR = symbolRange.find(Range(addr, addr));
-    if(foundR == symbolRange.end())
+    auto found = symbolModules.find(Range(addr, addr));
+    if(found == symbolModules.end())
         return false;
-    symbolRange.erase(foundR);
+    symbolModules.erase(found);
     return true;
 }
 
+void SymbolClear()
+{
+    EXCLUSIVE_ACQUIRE(LockSymbolCache);
+    symbolModules.clear();
+}
+
+bool SymbolEnum(duint base, CBSYMBOLENUM cbSymbolEnum, void* user)
+{
+    SHARED_ACQUIRE(LockSymbolCache);
+    auto module = symbolModuleFromAddr(base);
+    if(!module)
+        return false;
+    SYMBOLINFO symbol;
+    for(size_t i = 0; i < module->addrs.size(); i++)
+    {
+        symbol.addr = module->addrs[i];
+        symbol.decoratedSymbol = (char*)module->arena.data() + module->decorated[i];
+        symbol.undecoratedSymbol = module->undecorated[i] == SYMBOL_NONAME ? nullptr : (char*)module->arena.data() + module->undecorated[i];
+        symbol.isImported = module->imported[i];
+        cbSymbolEnum(&symbol, user);
+    }
+    return true;
+}
+
+static bool symbolContains(const char* name, const char* text, size_t length)
+{
+    for(; *name; name++)
+        if(tolower((unsigned char)*name) == tolower((unsigned char)*text) && _strnicmp(name, text, length) == 0)
+            return true;
+    return false;
+}
+
+bool SymbolCached(duint base)
+{
+    SHARED_ACQUIRE(LockSymbolCache);
+    return symbolModuleFromAddr(base) != nullptr;
+}
+
+size_t SymbolFind(const char* text, size_t maxResults, std::vector<SymbolInfo> & results, duint base)
+{
+    auto length = strlen(text);
+    auto first = results.size();
+    if(!length)
+        return 0;
+    SHARED_ACQUIRE(LockSymbolCache);
+    std::set<std::pair<duint, size_t>> matched; //module base and symbol index of the prefix matches
+    SymbolInfo symbol;
+    auto skip = [base](const Range & range, const SymbolModule & module)
+    {
+        return !module.finished || (base && (base < range.first || base > range.second));
+    };
+
+    // Prefix matches come first, they are a binary search in the sorted name index
+    for(const auto & range : symbolModules)
+    {
+        const auto & module = range.second;
+        if(skip(range.first, module))
+            continue;
+        auto found = std::lower_bound(module.names.begin(), module.names.end(), text, [&module, length](unsigned int ref, const char* prefix)
+        {
+            return _strnicmp(module.name(ref), prefix, length) < 0;
+        });
+        for(; found != module.names.end() && _strnicmp(module.name(*found), text, length) == 0; ++found)
+        {
+            if(results.size() - first >= maxResults)
+                return results.size() - first;
+            auto index = *found >> 1;
+            if(!matched.insert({ range.first.first, index }).second)
+                continue;
+            module.fill(index, symbol);
+            results.push_back(symbol);
+        }
+    }
+
+    // Then the names that contain the text somewhere else
+    for(const auto & range : symbolModules)
+    {
+        const auto & module = range.second;
+        if(skip(range.first, module))
+            continue;
+        for(size_t i = 0; i < module.addrs.size(); i++)
+        {
+            if(results.size() - first >= maxResults)
+                return results.size() - first;
+            if(matched.count({ range.first.first, i }))
+                continue;
+            if(symbolContains(module.arena.data() + module.decorated[i], text, length) ||
+                    (module.undecorated[i] != SYMBOL_NONAME && symbolContains(module.arena.data() + module.undecorated[i], text, length)))
+            {
+                module.fill(i, symbol);
+                results.push_back(symbol);
+            }
+        }
+    }
+    return results.size() - first;
+}
+
 static RangeMap<RangeMap<LineInfo>> lineRange;
 static std::unordered_map<duint, duint> lineName;
 
@@ -8,6 +8,7 @@ struct SymbolInfo
     duint size;
     String decoratedName;
     String undecoratedName;
+    bool isImported;
 };
 
 struct LineInfo
@@ -20,9 +21,14 @@ struct LineInfo
 
 bool SymbolFromAddr(duint addr, SymbolInfo & symbol);
 bool SymbolFromName(const char* name, SymbolInfo & symbol);
-bool SymbolAdd(const SymbolInfo & symbol);
+bool SymbolAdd(duint base, const SymbolInfo & symbol);
 bool SymbolAddRange(duint start, duint size);
+bool SymbolFinishRange(duint start);
 bool SymbolDelRange(duint addr);
+void SymbolClear();
+bool SymbolEnum(duint base, CBSYMBOLENUM cbSymbolEnum, void* user);
+size_t SymbolFind(const char* text, size_t maxResults, std::vector<SymbolInfo> & results, duint base = 0);
+bool SymbolCached(duint base);
 
 bool LineFromAddr(duint addr, LineInfo & line);
 bool LineFromName(const char* sourceFile, int lineNumber, LineInfo & line);
@@ -0,0 +1,290 @@
+/**
+ @file taskpool.cpp
+
+ @brief Implements a small work-stealing task scheduler.
+ */
+
+#include "taskpool.h"
+#include <deque>
+#include <chrono>
+
+struct TaskItem
+{
+    TASKFUNC func;
+    TaskGroup* group;
+};
+
+struct TaskQueue
+{
+    std::mutex lock;
+    std::deque<TaskItem> items;
+};
+
+struct TaskPool
+{
+    std::vector<std::thread> threads;
+    std::vector<std::thread::id> threadIds;
+    std::vector<std::unique_ptr<TaskQueue>> queues; //queues[0] is shared by the threads outside of the pool
+    std::atomic<size_t> queued; //tasks in all queues
+    std::atomic<size_t> concurrency; //threads allowed to execute tasks, including the caller
+    std::mutex sleepLock;
+    std::condition_variable sleepCondition;
+    bool stop;
+};
+
+static TaskPool* taskPool = nullptr;
+static std::once_flag taskPoolOnce;
+
+static void taskWorkerLoop(size_t index);
+
+static TaskPool & taskPoolGet()
+{
+    std::call_once(taskPoolOnce, []
+    {
+        //one thread per core besides the thread that waits for the work
+        auto count = max(std::thread::hardware_concurrency(), 2u) - 1;
+        auto pool = new TaskPool();
+        pool->queued = 0;
+        pool->concurrency = count + 1;
+        pool->stop = false;
+        for(size_t i = 0; i <= count; i++)
+            pool->queues.emplace_back(new TaskQueue());
+        taskPool = pool;
+        for(size_t i = 1; i <= count; i++)
+            pool->threads.emplace_back(taskWorkerLoop, i);
+        for(auto & thread : pool->threads)
+            pool->threadIds.push_back(thread.get_id());
+    });
+    return *taskPool;
+}
+
+static size_t taskCurrentQueue(const TaskPool & pool)
+{
+    auto id = std::this_thread::get_id();
+    for(size_t i = 0; i < pool.threadIds.size(); i++)
+        if(pool.threadIds[i] == id)
+            return i + 1;
+    return 0;
+}
+
+static void taskPush(TaskPool & pool, TaskItem && item)
+{
+    auto & queue = *pool.queues[taskCurrentQueue(pool)];
+    {
+        std::lock_guard<std::mutex> lock(queue.lock);
+        queue.items.push_back(std::move(item));
+    }
+    pool.queued++;
+    {
+        //a worker could be between checking the predicate and going to sleep
+        std::lock_guard<std::mutex> lock(pool.sleepLock);
+    }
+    pool.sleepCondition.notify_one();
+}
+
+static bool taskPop(TaskPool & pool, size_t self, TaskItem & item)
+{
+    if(!pool.queued)
+        return false;
+
+    //the newest task of our own queue (its data is most likely still in the cache)
+    {
+        auto & queue = *pool.queues[self];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        if(!queue.items.empty())
+        {
+            item = std::move(queue.items.back());
+            queue.items.pop_back();
+            pool.queued--;
+            return true;
+        }
+    }
+
+    //steal the oldest (usually the largest) task of another queue
+    auto count = pool.queues.size();
+    for(size_t i = 1; i < count; i++)
+    {
+        auto & queue = *pool.queues[(self + i) % count];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        if(!queue.items.empty())
+        {
+            item = std::move(queue.items.front());
+            queue.items.pop_front();
+            pool.queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void taskExecute(TaskItem & item)
+{
+    if(!item.group->IsCancelled())
+        item.func();
+    item.func = nullptr; //release the captures before the group can go away
+    item.group->taskDone();
+}
+
+static void taskWorkerLoop(size_t index)
+{
+    auto & pool = *taskPool;
+    TaskItem item;
+    while(true)
+    {
+        if(index < pool.concurrency && taskPop(pool, index, item))
+        {
+            taskExecute(item);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(pool.sleepLock);
+        pool.sleepCondition.wait(lock, [&]
+        {
+            return pool.stop || (pool.queued && index < pool.concurrency);
+        });
+        if(pool.stop)
+            break;
+    }
+}
+
+TaskGroup::TaskGroup()
+    : mPending(0),
+      mCancelled(false)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+    Wait();
+}
+
+void TaskGroup::Run(TASKFUNC task)
+{
+    auto & pool = taskPoolGet();
+    mPending++;
+    TaskItem item;
+    item.func = std::move(task);
+    item.group = this;
+    taskPush(pool, std::move(item));
+}
+
+void TaskGroup::Wait()
+{
+    if(mPending)
+    {
+        auto & pool = taskPoolGet();
+        auto self = taskCurrentQueue(pool);
+        TaskItem item;
+        while(mPending)
+        {
+            //help with the work instead of blocking (the tasks might belong to another group)
+            if(taskPop(pool, self, item))
+            {
+                taskExecute(item);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mLock);
+            mDone.wait_for(lock, std::chrono::milliseconds(1), [this]
+            {
+                return mPending == 0;
+            });
+        }
+    }
+    //the last task might still be notifying (even when nothing was pending anymore on entry)
+    std::lock_guard<std::mutex> lock(mLock);
+}
+
+void TaskGroup::Cancel()
+{
+    mCancelled = true;
+}
+
+bool TaskGroup::IsCancelled() const
+{
+    return mCancelled;
+}
+
+void TaskGroup::taskDone()
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    if(--mPending == 0)
+        mDone.notify_all();
+}
+
+bool TaskParallelFor(size_t first, size_t last, const TASKFORFUNC & body, TaskGroup* group, const CBTASKPROGRESS & progress)
+{
+    if(first >= last)
+        return true;
+    TaskGroup localGroup;
+    auto & tasks = group ? *group : localGroup;
+    auto count = last - first;
+    auto grain = max(size_t(1), count / (TaskConcurrency() * 8));
+    std::atomic<size_t> done(0);
+    std::atomic<int> lastPercent(0);
+    std::function<void(size_t, size_t)> runRange;
+    runRange = [&](size_t begin, size_t end)
+    {
+        //split off the upper halves for idle threads to steal and keep the lower half
+        while(end - begin > grain)
+        {
+            auto middle = begin + (end - begin) / 2;
+            tasks.Run([&runRange, middle, end]
+            {
+                runRange(middle, end);
+            });
+            end = middle;
+        }
+        for(auto i = begin; i < end && !tasks.IsCancelled(); i++)
+            body(i);
+        if(progress)
+        {
+            auto percent = int((done += end - begin) * 100 / count);
+            auto previous = lastPercent.load();
+            if(percent > previous && lastPercent.compare_exchange_strong(previous, percent))
+                progress(percent);
+        }
+    };
+    runRange(first, last);
+    tasks.Wait();
+    return !tasks.IsCancelled();
+}
+
+size_t TaskWorkerCount()
+{
+    return taskPoolGet().threads.size();
+}
+
+size_t TaskWorkerIndex()
+{
+    return taskCurrentQueue(taskPoolGet());
+}
+
+size_t TaskConcurrency()
+{
+    return taskPoolGet().concurrency;
+}
+
+void TaskSetConcurrency(size_t count)
+{
+    auto & pool = taskPoolGet();
+    if(!count || count > pool.threads.size() + 1)
+        count = pool.threads.size() + 1;
+    {
+        std::lock_guard<std::mutex> lock(pool.sleepLock);
+        pool.concurrency = count;
+    }
+    pool.sleepCondition.notify_all();
+}
+
+void TaskPoolStop()
+{
+    if(!taskPool)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(taskPool->sleepLock);
+        taskPool->stop = true;
+    }
+    taskPool->sleepCondition.notify_all();
+    for(auto & thread : taskPool->threads)
+        thread.join();
+    taskPool->threads.clear();
+}
@@ -0,0 +1,99 @@
+#ifndef _TASKPOOL_H
+#define _TASKPOOL_H
+
+#include "_global.h"
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include <unordered_map>
+
+struct TaskItem;
+
+typedef std::function<void()> TASKFUNC;
+typedef std::function<void(size_t)> TASKFORFUNC;
+typedef std::function<void(int)> CBTASKPROGRESS; //percent, called from whichever thread completes the work
+
+/**
+\brief A set of tasks executed by the task pool that can be joined and cancelled together.
+       Every pool thread has its own deque of tasks: new tasks are pushed and popped at the back
+       by the owner and idle threads steal the oldest tasks from the front of the other deques.
+       A thread waiting for a group executes pending tasks instead of blocking, so groups can be nested.
+*/
+class TaskGroup
+{
+public:
+    TaskGroup();
+    ~TaskGroup(); //waits for the remaining tasks
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup & operator=(const TaskGroup &) = delete;
+
+    void Run(TASKFUNC task); //fork
+    void Wait(); //join
+    void Cancel(); //tasks that did not start yet are skipped
+    bool IsCancelled() const;
+
+private:
+    friend void taskExecute(TaskItem & item);
+    void taskDone();
+
+    std::atomic<size_t> mPending;
+    std::atomic<bool> mCancelled;
+    std::mutex mLock;
+    std::condition_variable mDone;
+};
+
+/**
+\brief Calls body(i) for every i in [first, last) on the task pool, the calling thread takes part in the work.
+       The range is split in halves on demand so idle threads can steal the remaining work, which keeps the
+       threads busy when the cost of the iterations varies. Cancelling the group stops handing out iterations.
+\param group Optional group to run the iterations in (for cancellation), it is waited for before returning.
+\param progress Optional progress callback, called with an increasing percentage of completed iterations.
+\return false if the group was cancelled.
+*/
+bool TaskParallelFor(size_t first, size_t last, const TASKFORFUNC & body, TaskGroup* group = nullptr, const CBTASKPROGRESS & progress = nullptr);
+
+size_t TaskWorkerCount(); //number of pool threads (not counting the threads that wait for a group)
+size_t TaskWorkerIndex(); //1-based index of the calling pool thread, 0 for any other thread
+size_t TaskConcurrency();
+void TaskSetConcurrency(size_t count); //limit the number of threads executing tasks (including the caller), 0 to use all of them
+void TaskPoolStop();
+
+/**
+\brief One instance of T per thread executing tasks (per-worker scratch buffers, decoders, ...).
+*/
+template<class T>
+class TaskLocal
+{
+public:
+    TaskLocal()
+        : mSlots(TaskWorkerCount() + 1)
+    {
+    }
+
+    T & Local()
+    {
+        auto index = TaskWorkerIndex();
+        if(index) //pool threads only touch their own slot
+        {
+            auto & slot = mSlots[index];
+            if(!slot)
+                slot.reset(new T());
+            return *slot;
+        }
+        std::lock_guard<std::mutex> lock(mLock);
+        auto & slot = mOther[std::this_thread::get_id()];
+        if(!slot)
+            slot.reset(new T());
+        return *slot;
+    }
+
+private:
+    std::vector<std::unique_ptr<T>> mSlots;
+    std::mutex mLock;
+    std::unordered_map<std::thread::id, std::unique_ptr<T>> mOther;
+};
+
+#endif //_TASKPOOL_H
@@ -73,6 +73,9 @@ enum SectionLock
     LockTypeManager,
     LockModuleHashes,
     LockFormatFunctions,
+    LockContextSnapshot,
+    LockDisasmIndex,
+    LockCommands,
 
     // Number of elements in this enumeration. Must always be the last index.
     LockLast
@@ -18,6 +18,7 @@
 #include "TraceRecord.h"
 #include "plugin_loader.h"
 #include "exception.h"
+#include "contextsnapshot.h"
 
 static bool dosignedcalc = false;
 
@@ -588,7 +589,7 @@ bool valflagfromstring(duint eflags, const char* string)
 */
 bool setflag(const char* string, bool set)
 {
-    duint eflags = GetContextDataEx(hActiveThread, UE_CFLAGS);
+    duint eflags = ContextSnapshotGetRegister(UE_CFLAGS);
     duint xorval = 0;
     duint flag = 0;
     if(scmp(string, "cf"))
@@ -625,7 +626,7 @@ bool setflag(const char* string, bool set)
         xorval = flag;
     else if(set)
         xorval = flag;
-    return SetContextDataEx(hActiveThread, UE_CFLAGS, eflags ^ xorval);
+    return ContextSnapshotSetRegister(UE_CFLAGS, eflags ^ xorval);
 }
 
 /**
@@ -640,68 +641,68 @@ duint getregister(int* size, const char* string)
         *size = 4;
     if(scmp(string, "eax"))
     {
-        return GetContextDataEx(hActiveThread, UE_EAX);
+        return ContextSnapshotGetRegister(UE_EAX);
     }
     if(scmp(string, "ebx"))
     {
-        return GetContextDataEx(hActiveThread, UE_EBX);
+        return ContextSnapshotGetRegister(UE_EBX);
     }
     if(scmp(string, "ecx"))
     {
-        return GetContextDataEx(hActiveThread, UE_ECX);
+        return ContextSnapshotGetRegister(UE_ECX);
     }
     if(scmp(string, "edx"))
     {
-        return GetContextDataEx(hActiveThread, UE_EDX);
+        return ContextSnapshotGetRegister(UE_EDX);
     }
     if(scmp(string, "edi"))
     {
-        return GetContextDataEx(hActiveThread, UE_EDI);
+        return ContextSnapshotGetRegister(UE_EDI);
     }
     if(scmp(string, "esi"))
     {
-        return GetContextDataEx(hActiveThread, UE_ESI);
+        return ContextSnapshotGetRegister(UE_ESI);
     }
     if(scmp(string, "ebp"))
     {
-        return GetContextDataEx(hActiveThread, UE_EBP);
+        return ContextSnapshotGetRegister(UE_EBP);
     }
     if(scmp(string, "esp"))
     {
-        return GetContextDataEx(hActiveThread, UE_ESP);
+        return ContextSnapshotGetRegister(UE_ESP);
     }
     if(scmp(string, "eip"))
     {
-        return GetContextDataEx(hActiveThread, UE_EIP);
+        return ContextSnapshotGetRegister(UE_EIP);
     }
     if(scmp(string, "eflags"))
     {
-        return GetContextDataEx(hActiveThread, UE_EFLAGS);
+        return ContextSnapshotGetRegister(UE_EFLAGS);
     }
 
     if(scmp(string, "gs"))
     {
-        return GetContextDataEx(hActiveThread, UE_SEG_GS);
+        return ContextSnapshotGetRegister(UE_SEG_GS);
     }
     if(scmp(string, "fs"))
     {
-        return GetContextDataEx(hActiveThread, UE_SEG_FS);
+        return ContextSnapshotGetRegister(UE_SEG_FS);
     }
     if(scmp(string, "es"))
     {
-        return GetContextDataEx(hActiveThread, UE_SEG_ES);
+        return ContextSnapshotGetRegister(UE_SEG_ES);
     }
     if(scmp(string, "ds"))
     {
-        return GetContextDataEx(hActiveThread, UE_SEG_DS);
+        return ContextSnapshotGetRegister(UE_SEG_DS);
     }
     if(scmp(string, "cs"))
     {
-        return GetContextDataEx(hActiveThread, UE_SEG_CS);
+        return ContextSnapshotGetRegister(UE_SEG_CS);
     }
     if(scmp(string, "ss"))
     {
-        return GetContextDataEx(hActiveThread, UE_SEG_SS);
+        return ContextSnapshotGetRegister(UE_SEG_SS);
     }
 
     if(scmp(string, "lasterror"))
@@ -715,47 +716,47 @@ duint getregister(int* size, const char* string)
         *size = 2;
     if(scmp(string, "ax"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EAX);
+        duint val = ContextSnapshotGetRegister(UE_EAX);
         return val & 0xFFFF;
     }
     if(scmp(string, "bx"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EBX);
+        duint val = ContextSnapshotGetRegister(UE_EBX);
         return val & 0xFFFF;
     }
     if(scmp(string, "cx"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_ECX);
+        duint val = ContextSnapshotGetRegister(UE_ECX);
         return val & 0xFFFF;
     }
     if(scmp(string, "dx"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EDX);
+        duint val = ContextSnapshotGetRegister(UE_EDX);
         return val & 0xFFFF;
     }
     if(scmp(string, "si"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_ESI);
+        duint val = ContextSnapshotGetRegister(UE_ESI);
         return val & 0xFFFF;
     }
     if(scmp(string, "di"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EDI);
+        duint val = ContextSnapshotGetRegister(UE_EDI);
         return val & 0xFFFF;
     }
     if(scmp(string, "bp"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EBP);
+        duint val = ContextSnapshotGetRegister(UE_EBP);
         return val & 0xFFFF;
     }
     if(scmp(string, "sp"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_ESP);
+        duint val = ContextSnapshotGetRegister(UE_ESP);
         return val & 0xFFFF;
     }
     if(scmp(string, "ip"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EIP);
+        duint val = ContextSnapshotGetRegister(UE_EIP);
         return val & 0xFFFF;
     }
 
@@ -763,92 +764,92 @@ duint getregister(int* size, const char* string)
         *size = 1;
     if(scmp(string, "ah"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EAX);
+        duint val = ContextSnapshotGetRegister(UE_EAX);
         return (val >> 8) & 0xFF;
     }
     if(scmp(string, "al"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EAX);
+        duint val = ContextSnapshotGetRegister(UE_EAX);
         return val & 0xFF;
     }
     if(scmp(string, "bh"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EBX);
+        duint val = ContextSnapshotGetRegister(UE_EBX);
         return (val >> 8) & 0xFF;
     }
     if(scmp(string, "bl"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EBX);
+        duint val = ContextSnapshotGetRegister(UE_EBX);
         return val & 0xFF;
     }
     if(scmp(string, "ch"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_ECX);
+        duint val = ContextSnapshotGetRegister(UE_ECX);
         return (val >> 8) & 0xFF;
     }
     if(scmp(string, "cl"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_ECX);
+        duint val = ContextSnapshotGetRegister(UE_ECX);
         return val & 0xFF;
     }
     if(scmp(string, "dh"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EDX);
+        duint val = ContextSnapshotGetRegister(UE_EDX);
         return (val >> 8) & 0xFF;
     }
     if(scmp(string, "dl"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EDX);
+        duint val = ContextSnapshotGetRegister(UE_EDX);
         return val & 0xFF;
     }
     if(scmp(string, "sih"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_ESI);
+        duint val = ContextSnapshotGetRegister(UE_ESI);
         return (val >> 8) & 0xFF;
     }
     if(scmp(string, "sil"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_ESI);
+        duint val = ContextSnapshotGetRegister(UE_ESI);
         return val & 0xFF;
     }
     if(scmp(string, "dih"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EDI);
+        duint val = ContextSnapshotGetRegister(UE_EDI);
         return (val >> 8) & 0xFF;
     }
     if(scmp(string, "dil"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EDI);
+        duint val = ContextSnapshotGetRegister(UE_EDI);
         return val & 0xFF;
     }
     if(scmp(string, "bph"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EBP);
+        duint val = ContextSnapshotGetRegister(UE_EBP);
         return (val >> 8) & 0xFF;
     }
     if(scmp(string, "bpl"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EBP);
+        duint val = ContextSnapshotGetRegister(UE_EBP);
         return val & 0xFF;
     }
     if(scmp(string, "sph"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_ESP);
+        duint val = ContextSnapshotGetRegister(UE_ESP);
         return (val >> 8) & 0xFF;
     }
     if(scmp(string, "spl"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_ESP);
+        duint val = ContextSnapshotGetRegister(UE_ESP);
         return val & 0xFF;
     }
     if(scmp(string, "iph"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EIP);
+        duint val = ContextSnapshotGetRegister(UE_EIP);
         return (val >> 8) & 0xFF;
     }
     if(scmp(string, "ipl"))
     {
-        duint val = GetContextDataEx(hActiveThread, UE_EIP);
+        duint val = ContextSnapshotGetRegister(UE_EIP);
         return val & 0xFF;
     }
 
@@ -856,96 +857,96 @@ duint getregister(int* size, const char* string)
         *size = sizeof(duint);
     if(scmp(string, "dr0"))
     {
-        return GetContextDataEx(hActiveThread, UE_DR0);
+        return ContextSnapshotGetRegister(UE_DR0);
     }
     if(scmp(string, "dr1"))
     {
-        return GetContextDataEx(hActiveThread, UE_DR1);
+        return ContextSnapshotGetRegister(UE_DR1);
     }
     if(scmp(string, "dr2"))
     {
-        return GetContextDataEx(hActiveThread, UE_DR2);
+        return ContextSnapshotGetRegister(UE_DR2);
     }
     if(scmp(string, "dr3"))
     {
-        return GetContextDataEx(hActiveThread, UE_DR3);
+        return ContextSnapshotGetRegister(UE_DR3);
     }
     if(scmp(string, "dr6") || scmp(string, "dr4"))
     {
-        return GetContextDataEx(hActiveThread, UE_DR6);
+        return ContextSnapshotGetRegister(UE_DR6);
     }
     if(scmp(string, "dr7") || scmp(string, "dr5"))
     {
-        return GetContextDataEx(hActiveThread, UE_DR7);
+        return ContextSnapshotGetRegister(UE_DR7);
     }
 
     if(scmp(string, "cax"))
     {
 #ifdef _WIN64
-        return GetContextDataEx(hActiveThread, UE_RAX);
+        return ContextSnapshotGetRegister(UE_RAX);
 #else
-        return GetContextDataEx(hActiveThread, UE_EAX);
+        return ContextSnapshotGetRegister(UE_EAX);
 #endif //_WIN64
     }
     if(scmp(string, "cbx"))
     {
 #ifdef _WIN64
-        return GetContextDataEx(hActiveThread, UE_RBX);
+        return ContextSnapshotGetRegister(UE_RBX);
 #else
-        return GetContextDataEx(hActiveThread, UE_EBX);
+        return ContextSnapshotGetRegister(UE_EBX);
 #endif //_WIN64
     }
     if(scmp(string, "ccx"))
     {
 #ifdef _WIN64
-        return GetContextDataEx(hActiveThread, UE_RCX);
+        return ContextSnapshotGetRegister(UE_RCX);
 #else
-        return GetContextDataEx(hActiveThread, UE_ECX);
+        return ContextSnapshotGetRegister(UE_ECX);
 #endif //_WIN64
     }
     if(scmp(string, "cdx"))
     {
 #ifdef _WIN64
-        return GetContextDataEx(hActiveThread, UE_RDX);
+        return ContextSnapshotGetRegister(UE_RDX);
 #else
-        return GetContextDataEx(hActiveThread, UE_EDX);
+        return ContextSnapshotGetRegister(UE_EDX);
 #endif //_WIN64
     }
     if(scmp(string, "csi"))
     {
 #ifdef _WIN64
-        return GetContextDataEx(hActiveThread, UE_RSI);
+        return ContextSnapshotGetRegister(UE_RSI);
 #else
-        return GetContextDataEx(hActiveThread, UE_ESI);
+        return ContextSnapshotGetRegister(UE_ESI);
 #endif //_WIN64
     }
     if(scmp(string, "cdi"))
     {
 #ifdef _WIN64
-        return GetContextDataEx(hActiveThread, UE_RDI);
+        return ContextSnapshotGetRegister(UE_RDI);
 #else
-        return GetContextDataEx(hActiveThread, UE_EDI);
+        return ContextSnapshotGetRegister(UE_EDI);
 #endif //_WIN64
     }
     if(scmp(string, "cip"))
     {
-        return GetContextDataEx(hActiveThread, UE_CIP);
+        return ContextSnapshotGetRegister(UE_CIP);
     }
     if(scmp(string, "csp"))
     {
-        return GetContextDataEx(hActiveThread, UE_CSP);
+        return ContextSnapshotGetRegister(UE_CSP);
     }
     if(scmp(string, "cbp"))
     {
 #ifdef _WIN64
-        return GetContextDataEx(hActiveThread, UE_RBP);
+        return ContextSnapshotGetRegister(UE_RBP);
 #else
-        return GetContextDataEx(hActiveThread, UE_EBP);
+        return ContextSnapshotGetRegister(UE_EBP);
 #endif //_WIN64
     }
     if(scmp(string, "cflags"))
     {
-        return GetContextDataEx(hActiveThread, UE_CFLAGS);
+        return ContextSnapshotGetRegister(UE_CFLAGS);
     }
 
 #ifdef _WIN64
@@ -953,180 +954,180 @@ duint getregister(int* size, const char* string)
         *size = 8;
     if(scmp(string, "rax"))
     {
-        return GetContextDataEx(hActiveThread, UE_RAX);
+        return ContextSnapshotGetRegister(UE_RAX);
     }
     if(scmp(string, "rbx"))
     {
-        return GetContextDataEx(hActiveThread, UE_RBX);
+        return ContextSnapshotGetRegister(UE_RBX);
     }
     if(scmp(string, "rcx"))
     {
-        return GetContextDataEx(hActiveThread, UE_RCX);
+        return ContextSnapshotGetRegister(UE_RCX);
     }
     if(scmp(string, "rdx"))
     {
-        return GetContextDataEx(hActiveThread, UE_RDX);
+        return ContextSnapshotGetRegister(UE_RDX);
     }
     if(scmp(string, "rdi"))
     {
-        return GetContextDataEx(hActiveThread, UE_RDI);
+        return ContextSnapshotGetRegister(UE_RDI);
     }
     if(scmp(string, "rsi"))
     {
-        return GetContextDataEx(hActiveThread, UE_RSI);
+        return ContextSnapshotGetRegister(UE_RSI);
     }
     if(scmp(string, "rbp"))
     {
-        return GetContextDataEx(hActiveThread, UE_RBP);
+        return ContextSnapshotGetRegister(UE_RBP);
     }
     if(scmp(string, "rsp"))
     {
-        return GetContextDataEx(hActiveThread, UE_RSP);
+        return ContextSnapshotGetRegister(UE_RSP);
     }
     if(scmp(string, "rip"))
     {
-        return GetContextDataEx(hActiveThread, UE_RIP);
+        return ContextSnapshotGetRegister(UE_RIP);
     }
     if(scmp(string, "rflags"))
     {
-        return GetContextDataEx(hActiveThread, UE_RFLAGS);
+        return ContextSnapshotGetRegister(UE_RFLAGS);
     }
     if(scmp(string, "r8"))
     {
-        return GetContextDataEx(hActiveThread, UE_R8);
+        return ContextSnapshotGetRegister(UE_R8);
     }
     if(scmp(string, "r9"))
     {
-        return GetContextDataEx(hActiveThread, UE_R9);
+        return ContextSnapshotGetRegister(UE_R9);
     }
     if(scmp(string, "r10"))
     {
-        return GetContextDataEx(hActiveThread, UE_R10);
+        return ContextSnapshotGetRegister(UE_R10);
     }
     if(scmp(string, "r11"))
     {
-        return GetContextDataEx(hActiveThread, UE_R11);
+        return ContextSnapshotGetRegister(UE_R11);
     }
     if(scmp(string, "r12"))
     {
-        return GetContextDataEx(hActiveThread, UE_R12);
+        return ContextSnapshotGetRegister(UE_R12);
     }
     if(scmp(string, "r13"))
     {
-        return GetContextDataEx(hActiveThread, UE_R13);
+        return ContextSnapshotGetRegister(UE_R13);
     }
     if(scmp(string, "r14"))
     {
-        return GetContextDataEx(hActiveThread, UE_R14);
+        return ContextSnapshotGetRegister(UE_R14);
     }
     if(scmp(string, "r15"))
     {
-        return GetContextDataEx(hActiveThread, UE_R15);
+        return ContextSnapshotGetRegister(UE_R15);
     }
 
     if(size)
         *size = 4;
     if(scmp(string, "r8d"))
     {
-        return GetContextDataEx(hActiveThread, UE_R8) & 0xFFFFFFFF;
+        return ContextSnapshotGetRegister(UE_R8) & 0xFFFFFFFF;
     }
     if(scmp(string, "r9d"))
     {
-        return GetContextDataEx(hActiveThread, UE_R9) & 0xFFFFFFFF;
+        return ContextSnapshotGetRegister(UE_R9) & 0xFFFFFFFF;
     }
     if(scmp(string, "r10d"))
     {
-        return GetContextDataEx(hActiveThread, UE_R10) & 0xFFFFFFFF;
+        return ContextSnapshotGetRegister(UE_R10) & 0xFFFFFFFF;
     }
     if(scmp(string, "r11d"))
     {
-        return GetContextDataEx(hActiveThread, UE_R11) & 0xFFFFFFFF;
+        return ContextSnapshotGetRegister(UE_R11) & 0xFFFFFFFF;
     }
     if(scmp(string, "r12d"))
     {
-        return GetContextDataEx(hActiveThread, UE_R12) & 0xFFFFFFFF;
+        return ContextSnapshotGetRegister(UE_R12) & 0xFFFFFFFF;
     }
     if(scmp(string, "r13d"))
     {
-        return GetContextDataEx(hActiveThread, UE_R13) & 0xFFFFFFFF;
+        return ContextSnapshotGetRegister(UE_R13) & 0xFFFFFFFF;
     }
     if(scmp(string, "r14d"))
     {
-        return GetContextDataEx(hActiveThread, UE_R14) & 0xFFFFFFFF;
+        return ContextSnapshotGetRegister(UE_R14) & 0xFFFFFFFF;
     }
     if(scmp(string, "r15d"))
     {
-        return GetContextDataEx(hActiveThread, UE_R15) & 0xFFFFFFFF;
+        return ContextSnapshotGetRegister(UE_R15) & 0xFFFFFFFF;
     }
 
     if(size)
         *size = 2;
     if(scmp(string, "r8w"))
     {
-        return GetContextDataEx(hActiveThread, UE_R8) & 0xFFFF;
+        return ContextSnapshotGetRegister(UE_R8) & 0xFFFF;
     }
     if(scmp(string, "r9w"))
     {
-        return GetContextDataEx(hActiveThread, UE_R9) & 0xFFFF;
+        return ContextSnapshotGetRegister(UE_R9) & 0xFFFF;
     }
     if(scmp(string, "r10w"))
     {
-        return GetContextDataEx(hActiveThread, UE_R10) & 0xFFFF;
+        return ContextSnapshotGetRegister(UE_R10) & 0xFFFF;
     }
     if(scmp(string, "r11w"))
     {
-        return GetContextDataEx(hActiveThread, UE_R11) & 0xFFFF;
+        return ContextSnapshotGetRegister(UE_R11) & 0xFFFF;
     }
     if(scmp(string, "r12w"))
     {
-        return GetContextDataEx(hActiveThread, UE_R12) & 0xFFFF;
+        return ContextSnapshotGetRegister(UE_R12) & 0xFFFF;
     }
     if(scmp(string, "r13w"))
     {
-        return GetContextDataEx(hActiveThread, UE_R13) & 0xFFFF;
+        return ContextSnapshotGetRegister(UE_R13) & 0xFFFF;
     }
     if(scmp(string, "r14w"))
     {
-        return GetContextDataEx(hActiveThread, UE_R14) & 0xFFFF;
+        return ContextSnapshotGetRegister(UE_R14) & 0xFFFF;
     }
     if(scmp(string, "r15w"))
     {
-        return GetContextDataEx(hActiveThread, UE_R15) & 0xFFFF;
+        return ContextSnapshotGetRegister(UE_R15) & 0xFFFF;
     }
 
     if(size)
         *size = 1;
     if(scmp(string, "r8b"))
     {
-        return GetContextDataEx(hActiveThread, UE_R8) & 0xFF;
+        return ContextSnapshotGetRegister(UE_R8) & 0xFF;
     }
     if(scmp(string, "r9b"))
     {
-        return GetContextDataEx(hActiveThread, UE_R9) & 0xFF;
+        return ContextSnapshotGetRegister(UE_R9) & 0xFF;
     }
     if(scmp(string, "r10b"))
     {
-        return GetContextDataEx(hActiveThread, UE_R10) & 0xFF;
+        return ContextSnapshotGetRegister(UE_R10) & 0xFF;
     }
     if(scmp(string, "r11b"))
     {
-        return GetContextDataEx(hActiveThread, UE_R11) & 0xFF;
+        return ContextSnapshotGetRegister(UE_R11) & 0xFF;
     }
     if(scmp(string, "r12b"))
     {
-        return GetContextDataEx(hActiveThread, UE_R12) & 0xFF;
+        return ContextSnapshotGetRegister(UE_R12) & 0xFF;
     }
     if(scmp(string, "r13b"))
     {
-        return GetContextDataEx(hActiveThread, UE_R13) & 0xFF;
+        return ContextSnapshotGetRegister(UE_R13) & 0xFF;
     }
     if(scmp(string, "r14b"))
     {
-        return GetContextDataEx(hActiveThread, UE_R14) & 0xFF;
+        return ContextSnapshotGetRegister(UE_R14) & 0xFF;
     }
     if(scmp(string, "r15b"))
     {
-        return GetContextDataEx(hActiveThread, UE_R15) & 0xFF;
+        return ContextSnapshotGetRegister(UE_R15) & 0xFF;
     }
 #endif //_WIN64
 
@@ -1135,6 +1136,152 @@ duint getregister(int* size, const char* string)
     return 0;
 }
 
+#define REGISTER_SLOT_ENTRY(name, field, shift, mask, size) { name, { (unsigned short)offsetof(TITAN_ENGINE_CONTEXT_t, field), (unsigned char)sizeof(TITAN_ENGINE_CONTEXT_t::field), shift, mask, size } }
+//Initialized when the DLL is loaded, a function-local static would not be thread safe with VS2013.
+static const std::unordered_map<String, REGISTER_SLOT> registerSlots =
+{
+    REGISTER_SLOT_ENTRY("eax", cax, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("ebx", cbx, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("ecx", ccx, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("edx", cdx, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("edi", cdi, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("esi", csi, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("ebp", cbp, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("esp", csp, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("eip", cip, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("eflags", eflags, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("gs", gs, 0, 0xFFFF, 4),
+    REGISTER_SLOT_ENTRY("fs", fs, 0, 0xFFFF, 4),
+    REGISTER_SLOT_ENTRY("es", es, 0, 0xFFFF, 4),
+    REGISTER_SLOT_ENTRY("ds", ds, 0, 0xFFFF, 4),
+    REGISTER_SLOT_ENTRY("cs", cs, 0, 0xFFFF, 4),
+    REGISTER_SLOT_ENTRY("ss", ss, 0, 0xFFFF, 4),
+    REGISTER_SLOT_ENTRY("ax", cax, 0, 0xFFFF, 2),
+    REGISTER_SLOT_ENTRY("bx", cbx, 0, 0xFFFF, 2),
+    REGISTER_SLOT_ENTRY("cx", ccx, 0, 0xFFFF, 2),
+    REGISTER_SLOT_ENTRY("dx", cdx, 0, 0xFFFF, 2),
+    REGISTER_SLOT_ENTRY("si", csi, 0, 0xFFFF, 2),
+    REGISTER_SLOT_ENTRY("di", cdi, 0, 0xFFFF, 2),
+    REGISTER_SLOT_ENTRY("bp", cbp, 0, 0xFFFF, 2),
+    REGISTER_SLOT_ENTRY("sp", csp, 0, 0xFFFF, 2),
+    REGISTER_SLOT_ENTRY("ip", cip, 0, 0xFFFF, 2),
+    REGISTER_SLOT_ENTRY("ah", cax, 8, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("al", cax, 0, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("bh", cbx, 8, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("bl", cbx, 0, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("ch", ccx, 8, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("cl", ccx, 0, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("dh", cdx, 8, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("dl", cdx, 0, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("sih", csi, 8, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("sil", csi, 0, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("dih", cdi, 8, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("dil", cdi, 0, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("bph", cbp, 8, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("bpl", cbp, 0, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("sph", csp, 8, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("spl", csp, 0, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("iph", cip, 8, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("ipl", cip, 0, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("dr0", dr0, 0, duint(-1), sizeof(duint)),
+    REGISTER_SLOT_ENTRY("dr1", dr1, 0, duint(-1), sizeof(duint)),
+    REGISTER_SLOT_ENTRY("dr2", dr2, 0, duint(-1), sizeof(duint)),
+    REGISTER_SLOT_ENTRY("dr3", dr3, 0, duint(-1), sizeof(duint)),
+    REGISTER_SLOT_ENTRY("dr4", dr6, 0, duint(-1), sizeof(duint)),
+    REGISTER_SLOT_ENTRY("dr5", dr7, 0, duint(-1), sizeof(duint)),
+    REGISTER_SLOT_ENTRY("dr6", dr6, 0, duint(-1), sizeof(duint)),
+    REGISTER_SLOT_ENTRY("dr7", dr7, 0, duint(-1), sizeof(duint)),
+    REGISTER_SLOT_ENTRY("cax", cax, 0, duint(-1), sizeof(duint)),
+    REGISTER_SLOT_ENTRY("cbx", cbx, 0, duint(-1), sizeof(duint)),
+    REGISTER_SLOT_ENTRY("ccx", ccx, 0, duint(-1), sizeof(duint)),
+    REGISTER_SLOT_ENTRY("cdx", cdx, 0, duint(-1), sizeof(duint)),
+    REGISTER_SLOT_ENTRY("csi", csi, 0, duint(-1), sizeof(duint)),
+    REGISTER_SLOT_ENTRY("cdi", cdi, 0, duint(-1), sizeof(duint)),
+    REGISTER_SLOT_ENTRY("cip", cip, 0, duint(-1), sizeof(duint)),
+    REGISTER_SLOT_ENTRY("csp", csp, 0, duint(-1), sizeof(duint)),
+    REGISTER_SLOT_ENTRY("cbp", cbp, 0, duint(-1), sizeof(duint)),
+    REGISTER_SLOT_ENTRY("cflags", eflags, 0, duint(-1), sizeof(duint)),
+#ifdef _WIN64
+    REGISTER_SLOT_ENTRY("rax", cax, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("rbx", cbx, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("rcx", ccx, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("rdx", cdx, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("rdi", cdi, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("rsi", csi, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("rbp", cbp, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("rsp", csp, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("rip", cip, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("rflags", eflags, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("r8", r8, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("r9", r9, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("r10", r10, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("r11", r11, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("r12", r12, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("r13", r13, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("r14", r14, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("r15", r15, 0, duint(-1), 8),
+    REGISTER_SLOT_ENTRY("r8d", r8, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("r9d", r9, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("r10d", r10, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("r11d", r11, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("r12d", r12, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("r13d", r13, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("r14d", r14, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("r15d", r15, 0, 0xFFFFFFFF, 4),
+    REGISTER_SLOT_ENTRY("r8w", r8, 0, 0xFFFF, 2),
+    REGISTER_SLOT_ENTRY("r9w", r9, 0, 0xFFFF, 2),
+    REGISTER_SLOT_ENTRY("r10w", r10, 0, 0xFFFF, 2),
+    REGISTER_SLOT_ENTRY("r11w", r11, 0, 0xFFFF, 2),
+    REGISTER_SLOT_ENTRY("r12w", r12, 0, 0xFFFF, 2),
+    REGISTER_SLOT_ENTRY("r13w", r13, 0, 0xFFFF, 2),
+    REGISTER_SLOT_ENTRY("r14w", r14, 0, 0xFFFF, 2),
+    REGISTER_SLOT_ENTRY("r15w", r15, 0, 0xFFFF, 2),
+    REGISTER_SLOT_ENTRY("r8b", r8, 0, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("r9b", r9, 0, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("r10b", r10, 0, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("r11b", r11, 0, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("r12b", r12, 0, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("r13b", r13, 0, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("r14b", r14, 0, 0xFF, 1),
+    REGISTER_SLOT_ENTRY("r15b", r15, 0, 0xFF, 1),
+#endif //_WIN64
+};
+#undef REGISTER_SLOT_ENTRY
+
+/**
+\brief Gets the location of a register in the thread context, compiled expressions read registers from a single context.
+\param string The name of the register.
+\param [out] slot The location, mask and size of the register.
+\return true if the register can be read from TITAN_ENGINE_CONTEXT_t, false otherwise (registers like lasterror need getregister).
+*/
+bool valregisterslot(const char* string, REGISTER_SLOT & slot)
+{
+    auto found = registerSlots.find(StringUtils::ToLower(string));
+    if(found == registerSlots.end())
+        return false;
+    slot = found->second;
+    return true;
+}
+
+/**
+\brief Gets the EFLAGS bit of a flag name (without the '_' prefix).
+\param string The name of the flag.
+\param [out] mask The bit of the flag.
+\return true if the flag exists, false otherwise.
+*/
+bool valflagmask(const char* string, duint & mask)
+{
+    for(int i = 0; i < 22; i++)
+    {
+        if(valflagfromstring(duint(1) << i, string))
+        {
+            mask = duint(1) << i;
+            return true;
+        }
+    }
+    return false;
+}
+
 /**
 \brief Sets a register value based on the register name.
 \param string The name of the register to set.
@@ -1144,247 +1291,247 @@ duint getregister(int* size, const char* string)
 bool setregister(const char* string, duint value)
 {
     if(scmp(string, "eax"))
-        return SetContextDataEx(hActiveThread, UE_EAX, value & 0xFFFFFFFF);
+        return ContextSnapshotSetRegister(UE_EAX, value & 0xFFFFFFFF);
     if(scmp(string, "ebx"))
-        return SetContextDataEx(hActiveThread, UE_EBX, value & 0xFFFFFFFF);
+        return ContextSnapshotSetRegister(UE_EBX, value & 0xFFFFFFFF);
     if(scmp(string, "ecx"))
-        return SetContextDataEx(hActiveThread, UE_ECX, value & 0xFFFFFFFF);
+        return ContextSnapshotSetRegister(UE_ECX, value & 0xFFFFFFFF);
     if(scmp(string, "edx"))
-        return SetContextDataEx(hActiveThread, UE_EDX, value & 0xFFFFFFFF);
+        return ContextSnapshotSetRegister(UE_EDX, value & 0xFFFFFFFF);
     if(scmp(string, "edi"))
-        return SetContextDataEx(hActiveThread, UE_EDI, value & 0xFFFFFFFF);
+        return ContextSnapshotSetRegister(UE_EDI, value & 0xFFFFFFFF);
     if(scmp(string, "esi"))
-        return SetContextDataEx(hActiveThread, UE_ESI, value & 0xFFFFFFFF);
+        return ContextSnapshotSetRegister(UE_ESI, value & 0xFFFFFFFF);
     if(scmp(string, "ebp"))
-        return SetContextDataEx(hActiveThread, UE_EBP, value & 0xFFFFFFFF);
+        return ContextSnapshotSetRegister(UE_EBP, value & 0xFFFFFFFF);
     if(scmp(string, "esp"))
-        return SetContextDataEx(hActiveThread, UE_ESP, value & 0xFFFFFFFF);
+        return ContextSnapshotSetRegister(UE_ESP, value & 0xFFFFFFFF);
     if(scmp(string, "eip"))
-        return SetContextDataEx(hActiveThread, UE_EIP, value & 0xFFFFFFFF);
+        return ContextSnapshotSetRegister(UE_EIP, value & 0xFFFFFFFF);
     if(scmp(string, "eflags"))
-        return SetContextDataEx(hActiveThread, UE_EFLAGS, value & 0xFFFFFFFF);
+        return ContextSnapshotSetRegister(UE_EFLAGS, value & 0xFFFFFFFF);
 
     if(scmp(string, "lasterror"))
         return MemWrite((duint)GetTEBLocation(hActiveThread) + ArchValue(0x34, 0x68), &value, 4);
 
     if(scmp(string, "gs"))
-        return SetContextDataEx(hActiveThread, UE_SEG_GS, value & 0xFFFF);
+        return ContextSnapshotSetRegister(UE_SEG_GS, value & 0xFFFF);
     if(scmp(string, "fs"))
-        return SetContextDataEx(hActiveThread, UE_SEG_FS, value & 0xFFFF);
+        return ContextSnapshotSetRegister(UE_SEG_FS, value & 0xFFFF);
     if(scmp(string, "es"))
-        return SetContextDataEx(hActiveThread, UE_SEG_ES, value & 0xFFFF);
+        return ContextSnapshotSetRegister(UE_SEG_ES, value & 0xFFFF);
     if(scmp(string, "ds"))
-        return SetContextDataEx(hActiveThread, UE_SEG_DS, value & 0xFFFF);
+        return ContextSnapshotSetRegister(UE_SEG_DS, value & 0xFFFF);
     if(scmp(string, "cs"))
-        return SetContextDataEx(hActiveThread, UE_SEG_CS, value & 0xFFFF);
+        return ContextSnapshotSetRegister(UE_SEG_CS, value & 0xFFFF);
     if(scmp(string, "ss"))
-        return SetContextDataEx(hActiveThread, UE_SEG_SS, value & 0xFFFF);
+        return ContextSnapshotSetRegister(UE_SEG_SS, value & 0xFFFF);
 
     if(scmp(string, "ax"))
-        return SetContextDataEx(hActiveThread, UE_EAX, (value & 0xFFFF) | (GetContextDataEx(hActiveThread, UE_EAX) & 0xFFFF0000));
+        return ContextSnapshotSetRegister(UE_EAX, (value & 0xFFFF) | (ContextSnapshotGetRegister(UE_EAX) & 0xFFFF0000));
     if(scmp(string, "bx"))
-        return SetContextDataEx(hActiveThread, UE_EBX, (value & 0xFFFF) | (GetContextDataEx(hActiveThread, UE_EBX) & 0xFFFF0000));
+        return ContextSnapshotSetRegister(UE_EBX, (value & 0xFFFF) | (ContextSnapshotGetRegister(UE_EBX) & 0xFFFF0000));
     if(scmp(string, "cx"))
-        return SetContextDataEx(hActiveThread, UE_ECX, (value & 0xFFFF) | (GetContextDataEx(hActiveThread, UE_ECX) & 0xFFFF0000));
+        return ContextSnapshotSetRegister(UE_ECX, (value & 0xFFFF) | (ContextSnapshotGetRegister(UE_ECX) & 0xFFFF0000));
     if(scmp(string, "dx"))
-        return SetContextDataEx(hActiveThread, UE_EDX, (value & 0xFFFF) | (GetContextDataEx(hActiveThread, UE_EDX) & 0xFFFF0000));
+        return ContextSnapshotSetRegister(UE_EDX, (value & 0xFFFF) | (ContextSnapshotGetRegister(UE_EDX) & 0xFFFF0000));
     if(scmp(string, "si"))
-        return SetContextDataEx(hActiveThread, UE_ESI, (value & 0xFFFF) | (GetContextDataEx(hActiveThread, UE_ESI) & 0xFFFF0000));
+        return ContextSnapshotSetRegister(UE_ESI, (value & 0xFFFF) | (ContextSnapshotGetRegister(UE_ESI) & 0xFFFF0000));
     if(scmp(string, "di"))
-        return SetContextDataEx(hActiveThread, UE_EDI, (value & 0xFFFF) | (GetContextDataEx(hActiveThread, UE_EDI) & 0xFFFF0000));
+        return ContextSnapshotSetRegister(UE_EDI, (value & 0xFFFF) | (ContextSnapshotGetRegister(UE_EDI) & 0xFFFF0000));
     if(scmp(string, "bp"))
-        return SetContextDataEx(hActiveThread, UE_EBP, (value & 0xFFFF) | (GetContextDataEx(hActiveThread, UE_EBP) & 0xFFFF0000));
+        return ContextSnapshotSetRegister(UE_EBP, (value & 0xFFFF) | (ContextSnapshotGetRegister(UE_EBP) & 0xFFFF0000));
     if(scmp(string, "sp"))
-        return SetContextDataEx(hActiveThread, UE_ESP, (value & 0xFFFF) | (GetContextDataEx(hActiveThread, UE_ESP) & 0xFFFF0000));
+        return ContextSnapshotSetRegister(UE_ESP, (value & 0xFFFF) | (ContextSnapshotGetRegister(UE_ESP) & 0xFFFF0000));
     if(scmp(string, "ip"))
-        return SetContextDataEx(hActiveThread, UE_EIP, (value & 0xFFFF) | (GetContextDataEx(hActiveThread, UE_EIP) & 0xFFFF0000));
+        return ContextSnapshotSetRegister(UE_EIP, (value & 0xFFFF) | (ContextSnapshotGetRegister(UE_EIP) & 0xFFFF0000));
 
     if(scmp(string, "ah"))
-        return SetContextDataEx(hActiveThread, UE_EAX, ((value & 0xFF) << 8) | (GetContextDataEx(hActiveThread, UE_EAX) & 0xFFFF00FF));
+        return ContextSnapshotSetRegister(UE_EAX, ((value & 0xFF) << 8) | (ContextSnapshotGetRegister(UE_EAX) & 0xFFFF00FF));
     if(scmp(string, "al"))
-        return SetContextDataEx(hActiveThread, UE_EAX, (value & 0xFF) | (GetContextDataEx(hActiveThread, UE_EAX) & 0xFFFFFF00));
+        return ContextSnapshotSetRegister(UE_EAX, (value & 0xFF) | (ContextSnapshotGetRegister(UE_EAX) & 0xFFFFFF00));
     if(scmp(string, "bh"))
-        return SetContextDataEx(hActiveThread, UE_EBX, ((value & 0xFF) << 8) | (GetContextDataEx(hActiveThread, UE_EBX) & 0xFFFF00FF));
+        return ContextSnapshotSetRegister(UE_EBX, ((value & 0xFF) << 8) | (ContextSnapshotGetRegister(UE_EBX) & 0xFFFF00FF));
     if(scmp(string, "bl"))
-        return SetContextDataEx(hActiveThread, UE_EBX, (value & 0xFF) | (GetContextDataEx(hActiveThread, UE_EBX) & 0xFFFFFF00));
+        return ContextSnapshotSetRegister(UE_EBX, (value & 0xFF) | (ContextSnapshotGetRegister(UE_EBX) & 0xFFFFFF00));
     if(scmp(string, "ch"))
-        return SetContextDataEx(hActiveThread, UE_ECX, ((value & 0xFF) << 8) | (GetContextDataEx(hActiveThread, UE_ECX) & 0xFFFF00FF));
+        return ContextSnapshotSetRegister(UE_ECX, ((value & 0xFF) << 8) | (ContextSnapshotGetRegister(UE_ECX) & 0xFFFF00FF));
     if(scmp(string, "cl"))
-        return SetContextDataEx(hActiveThread, UE_ECX, (value & 0xFF) | (GetContextDataEx(hActiveThread, UE_ECX) & 0xFFFFFF00));
+        return ContextSnapshotSetRegister(UE_ECX, (value & 0xFF) | (ContextSnapshotGetRegister(UE_ECX) & 0xFFFFFF00));
     if(scmp(string, "dh"))
-        return SetContextDataEx(hActiveThread, UE_EDX, ((value & 0xFF) << 8) | (GetContextDataEx(hActiveThread, UE_EDX) & 0xFFFF00FF));
+        return ContextSnapshotSetRegister(UE_EDX, ((value & 0xFF) << 8) | (ContextSnapshotGetRegister(UE_EDX) & 0xFFFF00FF));
     if(scmp(string, "dl"))
-        return SetContextDataEx(hActiveThread, UE_EDX, (value & 0xFF) | (GetContextDataEx(hActiveThread, UE_EDX) & 0xFFFFFF00));
+        return ContextSnapshotSetRegister(UE_EDX, (value & 0xFF) | (ContextSnapshotGetRegister(UE_EDX) & 0xFFFFFF00));
     if(scmp(string, "sih"))
-        return SetContextDataEx(hActiveThread, UE_ESI, ((value & 0xFF) << 8) | (GetContextDataEx(hActiveThread, UE_ESI) & 0xFFFF00FF));
+        return ContextSnapshotSetRegister(UE_ESI, ((value & 0xFF) << 8) | (ContextSnapshotGetRegister(UE_ESI) & 0xFFFF00FF));
     if(scmp(string, "sil"))
-        return SetContextDataEx(hActiveThread, UE_ESI, (value & 0xFF) | (GetContextDataEx(hActiveThread, UE_ESI) & 0xFFFFFF00));
+        return ContextSnapshotSetRegister(UE_ESI, (value & 0xFF) | (ContextSnapshotGetRegister(UE_ESI) & 0xFFFFFF00));
     if(scmp(string, "dih"))
-        return SetContextDataEx(hActiveThread, UE_EDI, ((value & 0xFF) << 8) | (GetContextDataEx(hActiveThread, UE_EDI) & 0xFFFF00FF));
+        return ContextSnapshotSetRegister(UE_EDI, ((value & 0xFF) << 8) | (ContextSnapshotGetRegister(UE_EDI) & 0xFFFF00FF));
     if(scmp(string, "dil"))
-        return SetContextDataEx(hActiveThread, UE_EDI, (value & 0xFF) | (GetContextDataEx(hActiveThread, UE_EDI) & 0xFFFFFF00));
+        return ContextSnapshotSetRegister(UE_EDI, (value & 0xFF) | (ContextSnapshotGetRegister(UE_EDI) & 0xFFFFFF00));
     if(scmp(string, "bph"))
-        return SetContextDataEx(hActiveThread, UE_EBP, ((value & 0xFF) << 8) | (GetContextDataEx(hActiveThread, UE_EBP) & 0xFFFF00FF));
+        return ContextSnapshotSetRegister(UE_EBP, ((value & 0xFF) << 8) | (ContextSnapshotGetRegister(UE_EBP) & 0xFFFF00FF));
     if(scmp(string, "bpl"))
-        return SetContextDataEx(hActiveThread, UE_EBP, (value & 0xFF) | (GetContextDataEx(hActiveThread, UE_EBP) & 0xFFFFFF00));
+        return ContextSnapshotSetRegister(UE_EBP, (value & 0xFF) | (ContextSnapshotGetRegister(UE_EBP) & 0xFFFFFF00));
     if(scmp(string, "sph"))
-        return SetContextDataEx(hActiveThread, UE_ESP, ((value & 0xFF) << 8) | (GetContextDataEx(hActiveThread, UE_ESP) & 0xFFFF00FF));
+        return ContextSnapshotSetRegister(UE_ESP, ((value & 0xFF) << 8) | (ContextSnapshotGetRegister(UE_ESP) & 0xFFFF00FF));
     if(scmp(string, "spl"))
-        return SetContextDataEx(hActiveThread, UE_ESP, (value & 0xFF) | (GetContextDataEx(hActiveThread, UE_ESP) & 0xFFFFFF00));
+        return ContextSnapshotSetRegister(UE_ESP, (value & 0xFF) | (ContextSnapshotGetRegister(UE_ESP) & 0xFFFFFF00));
     if(scmp(string, "iph"))
-        return SetContextDataEx(hActiveThread, UE_EIP, ((value & 0xFF) << 8) | (GetContextDataEx(hActiveThread, UE_EIP) & 0xFFFF00FF));
+        return ContextSnapshotSetRegister(UE_EIP, ((value & 0xFF) << 8) | (ContextSnapshotGetRegister(UE_EIP) & 0xFFFF00FF));
     if(scmp(string, "ipl"))
-        return SetContextDataEx(hActiveThread, UE_EIP, (value & 0xFF) | (GetContextDataEx(hActiveThread, UE_EIP) & 0xFFFFFF00));
+        return ContextSnapshotSetRegister(UE_EIP, (value & 0xFF) | (ContextSnapshotGetRegister(UE_EIP) & 0xFFFFFF00));
 
     if(scmp(string, "dr0"))
-        return SetContextDataEx(hActiveThread, UE_DR0, value);
+        return ContextSnapshotSetRegister(UE_DR0, value);
     if(scmp(string, "dr1"))
-        return SetContextDataEx(hActiveThread, UE_DR1, value);
+        return ContextSnapshotSetRegister(UE_DR1, value);
     if(scmp(string, "dr2"))
-        return SetContextDataEx(hActiveThread, UE_DR2, value);
+        return ContextSnapshotSetRegister(UE_DR2, value);
     if(scmp(string, "dr3"))
-        return SetContextDataEx(hActiveThread, UE_DR3, value);
+        return ContextSnapshotSetRegister(UE_DR3, value);
     if(scmp(string, "dr6") || scmp(string, "dr4"))
-        return SetContextDataEx(hActiveThread, UE_DR6, value);
+        return ContextSnapshotSetRegister(UE_DR6, value);
     if(scmp(string, "dr7") || scmp(string, "dr5"))
-        return SetContextDataEx(hActiveThread, UE_DR7, value);
+        return ContextSnapshotSetRegister(UE_DR7, value);
 
     if(scmp(string, "cax"))
 #ifdef _WIN64
-        return SetContextDataEx(hActiveThread, UE_RAX, value);
+        return ContextSnapshotSetRegister(UE_RAX, value);
 #else
-        return SetContextDataEx(hActiveThread, UE_EAX, value);
+        return ContextSnapshotSetRegister(UE_EAX, value);
 #endif //_WIN64
     if(scmp(string, "cbx"))
 #ifdef _WIN64
-        return SetContextDataEx(hActiveThread, UE_RBX, value);
+        return ContextSnapshotSetRegister(UE_RBX, value);
 #else
-        return SetContextDataEx(hActiveThread, UE_EBX, value);
+        return ContextSnapshotSetRegister(UE_EBX, value);
 #endif //_WIN64
     if(scmp(string, "ccx"))
 #ifdef _WIN64
-        return SetContextDataEx(hActiveThread, UE_RCX, value);
+        return ContextSnapshotSetRegister(UE_RCX, value);
 #else
-        return SetContextDataEx(hActiveThread, UE_ECX, value);
+        return ContextSnapshotSetRegister(UE_ECX, value);
 #endif //_WIN64
     if(scmp(string, "cdx"))
 #ifdef _WIN64
-        return SetContextDataEx(hActiveThread, UE_RDX, value);
+        return ContextSnapshotSetRegister(UE_RDX, value);
 #else
-        return SetContextDataEx(hActiveThread, UE_EDX, value);
+        return ContextSnapshotSetRegister(UE_EDX, value);
 #endif //_WIN64
     if(scmp(string, "csi"))
 #ifdef _WIN64
-        return SetContextDataEx(hActiveThread, UE_RSI, value);
+        return ContextSnapshotSetRegister(UE_RSI, value);
 #else
-        return SetContextDataEx(hActiveThread, UE_ESI, value);
+        return ContextSnapshotSetRegister(UE_ESI, value);
 #endif //_WIN64
     if(scmp(string, "cdi"))
 #ifdef _WIN64
-        return SetContextDataEx(hActiveThread, UE_RDI, value);
+        return ContextSnapshotSetRegister(UE_RDI, value);
 #else
-        return SetContextDataEx(hActiveThread, UE_EDI, value);
+        return ContextSnapshotSetRegister(UE_EDI, value);
 #endif //_WIN64
     if(scmp(string, "cip"))
-        return SetContextDataEx(hActiveThread, UE_CIP, value);
+        return ContextSnapshotSetRegister(UE_CIP, value);
     if(scmp(string, "csp"))
-        return SetContextDataEx(hActiveThread, UE_CSP, value);
+        return ContextSnapshotSetRegister(UE_CSP, value);
     if(scmp(string, "cbp"))
 #ifdef _WIN64
-        return SetContextDataEx(hActiveThread, UE_RBP, value);
+        return ContextSnapshotSetRegister(UE_RBP, value);
 #else
-        return SetContextDataEx(hActiveThread, UE_EBP, value);
+        return ContextSnapshotSetRegister(UE_EBP, value);
 #endif //_WIN64
     if(scmp(string, "cflags"))
-        return SetContextDataEx(hActiveThread, UE_CFLAGS, value);
+        return ContextSnapshotSetRegister(UE_CFLAGS, value);
 
 #ifdef _WIN64
     if(scmp(string, "rax"))
-        return SetContextDataEx(hActiveThread, UE_RAX, value);
+        return ContextSnapshotSetRegister(UE_RAX, value);
     if(scmp(string, "rbx"))
-        return SetContextDataEx(hActiveThread, UE_RBX, value);
+        return ContextSnapshotSetRegister(UE_RBX, value);
     if(scmp(string, "rcx"))
-        return SetContextDataEx(hActiveThread, UE_RCX, value);
+        return ContextSnapshotSetRegister(UE_RCX, value);
     if(scmp(string, "rdx"))
-        return SetContextDataEx(hActiveThread, UE_RDX, value);
+        return ContextSnapshotSetRegister(UE_RDX, value);
     if(scmp(string, "rdi"))
-        return SetContextDataEx(hActiveThread, UE_RDI, value);
+        return ContextSnapshotSetRegister(UE_RDI, value);
     if(scmp(string, "rsi"))
-        return SetContextDataEx(hActiveThread, UE_RSI, value);
+        return ContextSnapshotSetRegister(UE_RSI, value);
     if(scmp(string, "rbp"))
-        return SetContextDataEx(hActiveThread, UE_RBP, value);
+        return ContextSnapshotSetRegister(UE_RBP, value);
     if(scmp(string, "rsp"))
-        return SetContextDataEx(hActiveThread, UE_RSP, value);
+        return ContextSnapshotSetRegister(UE_RSP, value);
     if(scmp(string, "rip"))
-        return SetContextDataEx(hActiveThread, UE_RIP, value);
+        return ContextSnapshotSetRegister(UE_RIP, value);
     if(scmp(string, "rflags"))
-        return SetContextDataEx(hActiveThread, UE_RFLAGS, value);
+        return ContextSnapshotSetRegister(UE_RFLAGS, value);
     if(scmp(string, "r8"))
-        return SetContextDataEx(hActiveThread, UE_R8, value);
+        return ContextSnapshotSetRegister(UE_R8, value);
     if(scmp(string, "r9"))
-        return SetContextDataEx(hActiveThread, UE_R9, value);
+        return ContextSnapshotSetRegister(UE_R9, value);
     if(scmp(string, "r10"))
-        return SetContextDataEx(hActiveThread, UE_R10, value);
+        return ContextSnapshotSetRegister(UE_R10, value);
     if(scmp(string, "r11"))
-        return SetContextDataEx(hActiveThread, UE_R11, value);
+        return ContextSnapshotSetRegister(UE_R11, value);
     if(scmp(string, "r12"))
-        return SetContextDataEx(hActiveThread, UE_R12, value);
+        return ContextSnapshotSetRegister(UE_R12, value);
     if(scmp(string, "r13"))
-        return SetContextDataEx(hActiveThread, UE_R13, value);
+        return ContextSnapshotSetRegister(UE_R13, value);
     if(scmp(string, "r14"))
-        return SetContextDataEx(hActiveThread, UE_R14, value);
+        return ContextSnapshotSetRegister(UE_R14, value);
     if(scmp(string, "r15"))
-        return SetContextDataEx(hActiveThread, UE_R15, value);
+        return ContextSnapshotSetRegister(UE_R15, value);
 
     if(scmp(string, "r8d"))
-        return SetContextDataEx(hActiveThread, UE_R8, (value & 0xFFFFFFFF) | (GetContextDataEx(hActiveThread, UE_R8) & 0xFFFFFFFF00000000));
+        return ContextSnapshotSetRegister(UE_R8, (value & 0xFFFFFFFF) | (ContextSnapshotGetRegister(UE_R8) & 0xFFFFFFFF00000000));
     if(scmp(string, "r9d"))
-        return SetContextDataEx(hActiveThread, UE_R9, (value & 0xFFFFFFFF) | (GetContextDataEx(hActiveThread, UE_R9) & 0xFFFFFFFF00000000));
+        return ContextSnapshotSetRegister(UE_R9, (value & 0xFFFFFFFF) | (ContextSnapshotGetRegister(UE_R9) & 0xFFFFFFFF00000000));
     if(scmp(string, "r10d"))
-        return SetContextDataEx(hActiveThread, UE_R10, (value & 0xFFFFFFFF) | (GetContextDataEx(hActiveThread, UE_R10) & 0xFFFFFFFF00000000));
+        return ContextSnapshotSetRegister(UE_R10, (value & 0xFFFFFFFF) | (ContextSnapshotGetRegister(UE_R10) & 0xFFFFFFFF00000000));
     if(scmp(string, "r11d"))
-        return SetContextDataEx(hActiveThread, UE_R11, (value & 0xFFFFFFFF) | (GetContextDataEx(hActiveThread, UE_R11) & 0xFFFFFFFF00000000));
+        return ContextSnapshotSetRegister(UE_R11, (value & 0xFFFFFFFF) | (ContextSnapshotGetRegister(UE_R11) & 0xFFFFFFFF00000000));
     if(scmp(string, "r12d"))
-        return SetContextDataEx(hActiveThread, UE_R12, (value & 0xFFFFFFFF) | (GetContextDataEx(hActiveThread, UE_R12) & 0xFFFFFFFF00000000));
+        return ContextSnapshotSetRegister(UE_R12, (value & 0xFFFFFFFF) | (ContextSnapshotGetRegister(UE_R12) & 0xFFFFFFFF00000000));
     if(scmp(string, "r13d"))
-        return SetContextDataEx(hActiveThread, UE_R13, (value & 0xFFFFFFFF) | (GetContextDataEx(hActiveThread, UE_R13) & 0xFFFFFFFF00000000));
+        return ContextSnapshotSetRegister(UE_R13, (value & 0xFFFFFFFF) | (ContextSnapshotGetRegister(UE_R13) & 0xFFFFFFFF00000000));
     if(scmp(string, "r14d"))
-        return SetContextDataEx(hActiveThread, UE_R14, (value & 0xFFFFFFFF) | (GetContextDataEx(hActiveThread, UE_R14) & 0xFFFFFFFF00000000));
+        return ContextSnapshotSetRegister(UE_R14, (value & 0xFFFFFFFF) | (ContextSnapshotGetRegister(UE_R14) & 0xFFFFFFFF00000000));
     if(scmp(string, "r15d"))
-        return SetContextDataEx(hActiveThread, UE_R15, (value & 0xFFFFFFFF) | (GetContextDataEx(hActiveThread, UE_R15) & 0xFFFFFFFF00000000));
+        return ContextSnapshotSetRegister(UE_R15, (value & 0xFFFFFFFF) | (ContextSnapshotGetRegister(UE_R15) & 0xFFFFFFFF00000000));
 
     if(scmp(string, "r8w"))
-        return SetContextDataEx(hActiveThread, UE_R8, (value & 0xFFFF) | (GetContextDataEx(hActiveThread, UE_R8) & 0xFFFFFFFFFFFF0000));
+        return ContextSnapshotSetRegister(UE_R8, (value & 0xFFFF) | (ContextSnapshotGetRegister(UE_R8) & 0xFFFFFFFFFFFF0000));
     if(scmp(string, "r9w"))
-        return SetContextDataEx(hActiveThread, UE_R9, (value & 0xFFFF) | (GetContextDataEx(hActiveThread, UE_R9) & 0xFFFFFFFFFFFF0000));
+        return ContextSnapshotSetRegister(UE_R9, (value & 0xFFFF) | (ContextSnapshotGetRegister(UE_R9) & 0xFFFFFFFFFFFF0000));
     if(scmp(string, "r10w"))
-        return SetContextDataEx(hActiveThread, UE_R10, (value & 0xFFFF) | (GetContextDataEx(hActiveThread, UE_R10) & 0xFFFFFFFFFFFF0000));
+        return ContextSnapshotSetRegister(UE_R10, (value & 0xFFFF) | (ContextSnapshotGetRegister(UE_R10) & 0xFFFFFFFFFFFF0000));
     if(scmp(string, "r11w"))
-        return SetContextDataEx(hActiveThread, UE_R11, (value & 0xFFFF) | (GetContextDataEx(hActiveThread, UE_R11) & 0xFFFFFFFFFFFF0000));
+        return ContextSnapshotSetRegister(UE_R11, (value & 0xFFFF) | (ContextSnapshotGetRegister(UE_R11) & 0xFFFFFFFFFFFF0000));
     if(scmp(string, "r12w"))
-        return SetContextDataEx(hActiveThread, UE_R12, (value & 0xFFFF) | (GetContextDataEx(hActiveThread, UE_R12) & 0xFFFFFFFFFFFF0000));
+        return ContextSnapshotSetRegister(UE_R12, (value & 0xFFFF) | (ContextSnapshotGetRegister(UE_R12) & 0xFFFFFFFFFFFF0000));
     if(scmp(string, "r13w"))
-        return SetContextDataEx(hActiveThread, UE_R13, (value & 0xFFFF) | (GetContextDataEx(hActiveThread, UE_R13) & 0xFFFFFFFFFFFF0000));
+        return ContextSnapshotSetRegister(UE_R13, (value & 0xFFFF) | (ContextSnapshotGetRegister(UE_R13) & 0xFFFFFFFFFFFF0000));
     if(scmp(string, "r14w"))
-        return SetContextDataEx(hActiveThread, UE_R14, (value & 0xFFFF) | (GetContextDataEx(hActiveThread, UE_R14) & 0xFFFFFFFFFFFF0000));
+        return ContextSnapshotSetRegister(UE_R14, (value & 0xFFFF) | (ContextSnapshotGetRegister(UE_R14) & 0xFFFFFFFFFFFF0000));
     if(scmp(string, "r15w"))
-        return SetContextDataEx(hActiveThread, UE_R15, (value & 0xFFFF) | (GetContextDataEx(hActiveThread, UE_R15) & 0xFFFFFFFFFFFF0000));
+        return ContextSnapshotSetRegister(UE_R15, (value & 0xFFFF) | (ContextSnapshotGetRegister(UE_R15) & 0xFFFFFFFFFFFF0000));
     if(scmp(string, "r8b"))
-        return SetContextDataEx(hActiveThread, UE_R8, (value & 0xFF) | (GetContextDataEx(hActiveThread, UE_R8) & 0xFFFFFFFFFFFFFF00));
+        return ContextSnapshotSetRegister(UE_R8, (value & 0xFF) | (ContextSnapshotGetRegister(UE_R8) & 0xFFFFFFFFFFFFFF00));
     if(scmp(string, "r9b"))
-        return SetContextDataEx(hActiveThread, UE_R9, (value & 0xFF) | (GetContextDataEx(hActiveThread, UE_R9) & 0xFFFFFFFFFFFFFF00));
+        return ContextSnapshotSetRegister(UE_R9, (value & 0xFF) | (ContextSnapshotGetRegister(UE_R9) & 0xFFFFFFFFFFFFFF00));
     if(scmp(string, "r10b"))
-        return SetContextDataEx(hActiveThread, UE_R10, (value & 0xFF) | (GetContextDataEx(hActiveThread, UE_R10) & 0xFFFFFFFFFFFFFF00));
+        return ContextSnapshotSetRegister(UE_R10, (value & 0xFF) | (ContextSnapshotGetRegister(UE_R10) & 0xFFFFFFFFFFFFFF00));
     if(scmp(string, "r11b"))
-        return SetContextDataEx(hActiveThread, UE_R11, (value & 0xFF) | (GetContextDataEx(hActiveThread, UE_R11) & 0xFFFFFFFFFFFFFF00));
+        return ContextSnapshotSetRegister(UE_R11, (value & 0xFF) | (ContextSnapshotGetRegister(UE_R11) & 0xFFFFFFFFFFFFFF00));
     if(scmp(string, "r12b"))
-        return SetContextDataEx(hActiveThread, UE_R12, (value & 0xFF) | (GetContextDataEx(hActiveThread, UE_R12) & 0xFFFFFFFFFFFFFF00));
+        return ContextSnapshotSetRegister(UE_R12, (value & 0xFF) | (ContextSnapshotGetRegister(UE_R12) & 0xFFFFFFFFFFFFFF00));
     if(scmp(string, "r13b"))
-        return SetContextDataEx(hActiveThread, UE_R13, (value & 0xFF) | (GetContextDataEx(hActiveThread, UE_R13) & 0xFFFFFFFFFFFFFF00));
+        return ContextSnapshotSetRegister(UE_R13, (value & 0xFF) | (ContextSnapshotGetRegister(UE_R13) & 0xFFFFFFFFFFFFFF00));
     if(scmp(string, "r14b"))
-        return SetContextDataEx(hActiveThread, UE_R14, (value & 0xFF) | (GetContextDataEx(hActiveThread, UE_R14) & 0xFFFFFFFFFFFFFF00));
+        return ContextSnapshotSetRegister(UE_R14, (value & 0xFF) | (ContextSnapshotGetRegister(UE_R14) & 0xFFFFFFFFFFFFFF00));
     if(scmp(string, "r15b"))
-        return SetContextDataEx(hActiveThread, UE_R15, (value & 0xFF) | (GetContextDataEx(hActiveThread, UE_R15) & 0xFFFFFFFFFFFFFF00));
+        return ContextSnapshotSetRegister(UE_R15, (value & 0xFF) | (ContextSnapshotGetRegister(UE_R15) & 0xFFFFFFFFFFFFFF00));
 #endif // _WIN64
 
     return false;
@@ -1681,6 +1828,21 @@ static bool isdigitduint(char digit)
 #endif //_WIN64
 }
 
+/**
+\brief Converts a decimal (.123) or hexadecimal (0x123, x123, 123) number the same way valfromstring_noexpr does.
+\param string The string to convert.
+\param [out] value The number.
+\return true if the string is a valid number, false otherwise.
+*/
+bool valnumberfromstring(const char* string, duint & value)
+{
+    if(isdecnumber(string))
+        return convertNumber(string + 1, value, 10);
+    if(ishexnumber(string))
+        return convertNumber(string + (*string == 'x' ? 1 : 0), value, 16);
+    return false;
+}
+
 /**
 \brief Gets a value from a string. This function can parse expressions, memory locations, registers, flags, API names, labels, symbols and variables.
 \param string The string to parse.
@@ -1872,7 +2034,7 @@ bool valfromstring_noexpr(const char* string, duint* value, bool silent, bool ba
                 *isvar = true;
             return true;
         }
-        duint eflags = GetContextDataEx(hActiveThread, UE_CFLAGS);
+        duint eflags = ContextSnapshotGetRegister(UE_CFLAGS);
         if(valflagfromstring(eflags, string + 1))
             *value = 1;
         else
@@ -2038,23 +2200,23 @@ static void setfpuvalue(const char* string, duint value)
     {
         if(_strnicmp(string + STRLEN_USING_SIZEOF(MxCsr_PRE_FIELD_STRING), "RC", (int)strlen("RC")) == 0)
         {
-            flags = GetContextDataEx(hActiveThread, UE_MXCSR);
+            flags = ContextSnapshotGetRegister(UE_MXCSR);
             int i = 3;
             i <<= 13;
             flags &= ~i;
             value <<= 13;
             flags |= value;
-            SetContextDataEx(hActiveThread, UE_MXCSR, flags);
+            ContextSnapshotSetRegister(UE_MXCSR, flags);
         }
         else
         {
-            flags = GetContextDataEx(hActiveThread, UE_MXCSR);
+            flags = ContextSnapshotGetRegister(UE_MXCSR);
             flag = getmxcsrflagfromstring(string + STRLEN_USING_SIZEOF(MxCsr_PRE_FIELD_STRING));
             if(flags & flag && !set)
                 xorval = flag;
             else if(set)
                 xorval = flag;
-            SetContextDataEx(hActiveThread, UE_MXCSR, flags ^ xorval);
+            ContextSnapshotSetRegister(UE_MXCSR, flags ^ xorval);
         }
     }
     else if(startsWith(x87TW_PRE_FIELD_STRING, string))
@@ -2067,7 +2229,7 @@ static void setfpuvalue(const char* string, duint value)
         if(i > 7)
             return;
 
-        flags = GetContextDataEx(hActiveThread, UE_X87_TAGWORD);
+        flags = ContextSnapshotGetRegister(UE_X87_TAGWORD);
 
         flag = 3;
         flag <<= i * 2;
@@ -2079,80 +2241,80 @@ static void setfpuvalue(const char* string, duint value)
 
         flags |= flag;
 
-        SetContextDataEx(hActiveThread, UE_X87_TAGWORD, (unsigned short) flags);
+        ContextSnapshotSetRegister(UE_X87_TAGWORD, (unsigned short) flags);
 
     }
     else if(startsWith(x87SW_PRE_FIELD_STRING, string))
     {
         if(_strnicmp(string + STRLEN_USING_SIZEOF(x87SW_PRE_FIELD_STRING), "TOP", (int)strlen("TOP")) == 0)
         {
-            flags = GetContextDataEx(hActiveThread, UE_X87_STATUSWORD);
+            flags = ContextSnapshotGetRegister(UE_X87_STATUSWORD);
             int i = 7;
             i <<= 11;
             flags &= ~i;
             value <<= 11;
             flags |= value;
-            SetContextDataEx(hActiveThread, UE_X87_STATUSWORD, flags);
+            ContextSnapshotSetRegister(UE_X87_STATUSWORD, flags);
         }
         else
         {
-            flags = GetContextDataEx(hActiveThread, UE_X87_STATUSWORD);
+            flags = ContextSnapshotGetRegister(UE_X87_STATUSWORD);
             flag = getx87statuswordflagfromstring(string + STRLEN_USING_SIZEOF(x87SW_PRE_FIELD_STRING));
             if(flags & flag && !set)
                 xorval = flag;
             else if(set)
                 xorval = flag;
-            SetContextDataEx(hActiveThread, UE_X87_STATUSWORD, flags ^ xorval);
+            ContextSnapshotSetRegister(UE_X87_STATUSWORD, flags ^ xorval);
         }
     }
     else if(startsWith(x87CW_PRE_FIELD_STRING, string))
     {
         if(_strnicmp(string + STRLEN_USING_SIZEOF(x87CW_PRE_FIELD_STRING), "RC", (int)strlen("RC")) == 0)
         {
-            flags = GetContextDataEx(hActiveThread, UE_X87_CONTROLWORD);
+            flags = ContextSnapshotGetRegister(UE_X87_CONTROLWORD);
             int i = 3;
             i <<= 10;
             flags &= ~i;
             value <<= 10;
             flags |= value;
-            SetContextDataEx(hActiveThread, UE_X87_CONTROLWORD, flags);
+            ContextSnapshotSetRegister(UE_X87_CONTROLWORD, flags);
         }
         else if(_strnicmp(string + STRLEN_USING_SIZEOF(x87CW_PRE_FIELD_STRING), "PC", (int)strlen("PC")) == 0)
         {
-            flags = GetContextDataEx(hActiveThread, UE_X87_CONTROLWORD);
+            flags = ContextSnapshotGetRegister(UE_X87_CONTROLWORD);
             int i = 3;
             i <<= 8;
             flags &= ~i;
             value <<= 8;
             flags |= value;
-            SetContextDataEx(hActiveThread, UE_X87_CONTROLWORD, flags);
+            ContextSnapshotSetRegister(UE_X87_CONTROLWORD, flags);
         }
         else
         {
-            flags = GetContextDataEx(hActiveThread, UE_X87_CONTROLWORD);
+            flags = ContextSnapshotGetRegister(UE_X87_CONTROLWORD);
             flag = getx87controlwordflagfromstring(string + STRLEN_USING_SIZEOF(x87CW_PRE_FIELD_STRING));
             if(flags & flag && !set)
                 xorval = flag;
             else if(set)
                 xorval = flag;
-            SetContextDataEx(hActiveThread, UE_X87_CONTROLWORD, flags ^ xorval);
+            ContextSnapshotSetRegister(UE_X87_CONTROLWORD, flags ^ xorval);
         }
     }
     else if(_strnicmp(string, "x87TagWord", (int)strlen(string)) == 0)
     {
-        SetContextDataEx(hActiveThread, UE_X87_TAGWORD, (unsigned short) value);
+        ContextSnapshotSetRegister(UE_X87_TAGWORD, (unsigned short) value);
     }
     else if(_strnicmp(string, "x87StatusWord", (int)strlen(string)) == 0)
     {
-        SetContextDataEx(hActiveThread, UE_X87_STATUSWORD, (unsigned short) value);
+        ContextSnapshotSetRegister(UE_X87_STATUSWORD, (unsigned short) value);
     }
     else if(_strnicmp(string, "x87ControlWord", (int)strlen(string)) == 0)
     {
-        SetContextDataEx(hActiveThread, UE_X87_CONTROLWORD, (unsigned short) value);
+        ContextSnapshotSetRegister(UE_X87_CONTROLWORD, (unsigned short) value);
     }
     else if(_strnicmp(string, "MxCsr", (int)strlen(string)) == 0)
     {
-        SetContextDataEx(hActiveThread, UE_MXCSR, value);
+        ContextSnapshotSetRegister(UE_MXCSR, value);
     }
     else if(startsWith(x8780BITFPU_PRE_FIELD_STRING, string))
     {
@@ -2198,7 +2360,7 @@ static void setfpuvalue(const char* string, duint value)
             break;
         }
         if(found)
-            SetContextDataEx(hActiveThread, registerindex, value);
+            ContextSnapshotSetRegister(registerindex, value);
     }
     else if(startsWith(MMX_PRE_FIELD_STRING, string))
     {
@@ -2244,7 +2406,7 @@ static void setfpuvalue(const char* string, duint value)
             break;
         }
         if(found)
-            SetContextDataEx(hActiveThread, registerindex, value);
+            ContextSnapshotSetRegister(registerindex, value);
     }
     else if(startsWith(XMM_PRE_FIELD_STRING, string))
     {
@@ -2322,7 +2484,7 @@ static void setfpuvalue(const char* string, duint value)
             break;
         }
         if(found)
-            SetContextDataEx(hActiveThread, registerindex, value);
+            ContextSnapshotSetRegister(registerindex, value);
     }
     else if(startsWith(YMM_PRE_FIELD_STRING, string))
     {
@@ -2401,7 +2563,7 @@ static void setfpuvalue(const char* string, duint value)
             break;
         }
         if(found)
-            SetContextDataEx(hActiveThread, registerindex, value);
+            ContextSnapshotSetRegister(registerindex, value);
     }
 }
 
@@ -2558,13 +2720,13 @@ bool valtostring(const char* string, duint value, bool silent)
         _strlwr_s(regName(), regName.size());
         if(strstr(regName(), "ip"))
         {
-            auto cip = GetContextDataEx(hActiveThread, UE_CIP);
+            auto cip = ContextSnapshotGetRegister(UE_CIP);
             _dbg_dbgtraceexecute(cip);
             DebugUpdateGuiAsync(cip, false); //update disassembly + register view
         }
         else if(strstr(regName(), "sp")) //update stack
         {
-            duint csp = GetContextDataEx(hActiveThread, UE_CSP);
+            duint csp = ContextSnapshotGetRegister(UE_CSP);
             DebugUpdateStack(csp, csp);
             GuiUpdateRegisterView();
         }
@@ -3,6 +3,16 @@
 
 #include "_global.h"
 
+//structures
+struct REGISTER_SLOT
+{
+    unsigned short offset; //offset of the register in TITAN_ENGINE_CONTEXT_t
+    unsigned char fieldsize; //size of the field in TITAN_ENGINE_CONTEXT_t
+    unsigned char shift;
+    duint mask;
+    int size; //value size as returned by getregister
+};
+
 //functions
 bool valuesignedcalc();
 void valuesetsignedcalc(bool a);
@@ -25,5 +35,8 @@ duint valvatofileoffset(duint va);
 bool setregister(const char* string, duint value);
 bool setflag(const char* string, bool set);
 duint getregister(int* size, const char* string);
+bool valregisterslot(const char* string, REGISTER_SLOT & slot);
+bool valflagmask(const char* string, duint & mask);
+bool valnumberfromstring(const char* string, duint & value);
 
 #endif // _VALUE_H
@@ -7,12 +7,18 @@
 #include "variable.h"
 #include "threading.h"
 #include <map>
+#include <atomic>
 
 /**
 \brief The container that stores all variables.
 */
 std::map<String, VAR, CaseInsensitiveCompare> variables;
 
+/**
+\brief Incremented when a variable is created, deleted or changes its value type.
+*/
+static std::atomic<duint> vargenerationcounter(0);
+
 /**
 \brief Sets a variable with a value.
 \param [in,out] Var The variable to set the value of. The previous value will be freed. Cannot be null.
@@ -23,6 +29,8 @@ void varsetvalue(VAR* Var, VAR_VALUE* Value)
     // VAR_STRING needs to be freed before destroying it
     if(Var->value.type == VAR_STRING)
         delete Var->value.u.data;
+    if(Var->value.type != Value->type)
+        vargenerationcounter++;
 
     // Replace all information in the struct
     memcpy(&Var->value, Value, sizeof(VAR_VALUE));
@@ -112,6 +120,7 @@ void varfree()
 
     // Now clear all vector elements
     variables.clear();
+    vargenerationcounter++;
 }
 
 /**
@@ -156,6 +165,7 @@ bool varnew(const char* Name, duint Value, VAR_TYPE Type)
         var.value.type = VAR_UINT;
         var.value.u.value = Value;
         variables.insert(std::make_pair(name_, var));
+        vargenerationcounter++;
     }
     return true;
 }
@@ -327,6 +337,7 @@ bool vardel(const char* Name, bool DelSystem)
         if(found->first == NameString || found->second.alias == NameString)
         {
             found = variables.erase(found); // Invalidate iterators
+            vargenerationcounter++;
         }
         else
             found++;
@@ -393,3 +404,12 @@ bool varenum(VAR* List, size_t* Size)
 
     return true;
 }
+
+/**
+\brief Gets the variable generation. Compiled expressions use it to notice new variables that shadow registers or numbers.
+\return The generation, it changes when a variable is created, deleted or changes its value type.
+*/
+duint vargeneration()
+{
+    return vargenerationcounter.load();
+}
@@ -60,5 +60,6 @@ bool varset(const char* Name, const char* Value, bool ReadOnly);
 bool vardel(const char* Name, bool DelSystem);
 bool vargettype(const char* Name, VAR_TYPE* Type = nullptr, VAR_VALUE_TYPE* ValueType = nullptr);
 bool varenum(VAR* List, size_t* Size);
+duint vargeneration();
 
 #endif // _VARIABLE_H
@@ -27,6 +27,7 @@
 #include "formatfunctions.h"
 #include "yara/yara.h"
 #include "dbghelp_safe.h"
+#include "taskpool.h"
 
 static MESSAGE_STACK* gMsgStack = 0;
 static HANDLE hCommandLoopThread = 0;
@@ -268,6 +269,7 @@ static void registercommands()
     dbgcmdnew("find", cbInstrFind, true); //find a pattern
     dbgcmdnew("findall", cbInstrFindAll, true); //find all patterns
     dbgcmdnew("findallmem,findmemall", cbInstrFindAllMem, true); //memory map pattern find
+    dbgcmdnew("findallmemmulti,findmemallmulti", cbInstrFindAllMemMulti, true); //memory map pattern find (multiple patterns in one pass)
     dbgcmdnew("findasm,asmfind", cbInstrFindAsm, true); //find instruction
     dbgcmdnew("reffind,findref,ref", cbInstrRefFind, true); //find references to a value
     dbgcmdnew("reffindrange,findrefrange,refrange", cbInstrRefFindRange, true);
@@ -320,6 +322,7 @@ static void registercommands()
     dbgcmdnew("analyse_nukem,analyze_nukem,anal_nukem", cbInstrAnalyseNukem, true); //secret analysis command #2
     dbgcmdnew("analxrefs,analx", cbInstrAnalxrefs, true); //analyze xrefs
     dbgcmdnew("analrecur,analr", cbInstrAnalrecur, true); //analyze a single function
+    dbgcmdnew("analmod,analmodule", cbInstrAnalmod, true); //analyze all functions of a module
     dbgcmdnew("analadv", cbInstrAnalyseadv, true); //analyze xref,function and data
     dbgcmdnew("traceexecute", cbInstrTraceexecute, true); //execute trace record on address TODO: undocumented
 
@@ -395,6 +398,8 @@ static void registercommands()
     dbgcmdnew("EnableLog,LogEnable", cbInstrEnableLog, false); //enable log
     dbgcmdnew("DisableLog,LogDisable", cbInstrDisableLog, false); //disable log
     dbgcmdnew("ClearLog,cls,lc,lclr", cbClearLog, false); //clear the log
+    dbgcmdnew("LogRedirect", cbInstrLogRedirect, false); //redirect the log to a file
+    dbgcmdnew("LogStats", cbInstrLogStats, false); //log pipeline statistics
     dbgcmdnew("AddFavouriteTool", cbInstrAddFavTool, false); //add favourite tool
     dbgcmdnew("AddFavouriteCommand", cbInstrAddFavCmd, false); //add favourite command
     dbgcmdnew("AddFavouriteToolShortcut,SetFavouriteToolShortcut", cbInstrSetFavToolShortcut, false); //set favourite tool shortcut
@@ -426,6 +431,13 @@ static void registercommands()
 
     //undocumented
     dbgcmdnew("bench", cbDebugBenchmark, true); //benchmark test (readmem etc)
+    dbgcmdnew("benchpattern", cbDebugBenchmarkPattern, false); //benchmark the pattern search engines on synthetic buffers
+    dbgcmdnew("benchmapchanges", cbDebugBenchmarkMapChanges, true); //benchmark GetList copies against the change journal
+    dbgcmdnew("benchlinear", cbDebugBenchmarkLinear, false); //benchmark the linear pass on synthetic code with the task pool
+    dbgcmdnew("benchmodlookup", cbDebugBenchmarkModuleLookup, false); //benchmark the module lookups on synthetic modules
+    dbgcmdnew("benchbphit", cbDebugBenchmarkBreakpointHit, true); //benchmark the breakpoint hit path with parsed and compiled conditions/log/command
+    dbgcmdnew("benchcmd", cbDebugBenchmarkCommands, false); //benchmark the command dispatch of a scripted loop
+    dbgcmdnew("contextstats", cbDebugContextStats, false); //show (or reset) how many thread context fetches the debug events cost
     dbgcmdnew("dprintf", cbPrintf, false); //printf
     dbgcmdnew("setstr,strset", cbInstrSetstr, false); //set a string variable
     dbgcmdnew("getstr,strget", cbInstrGetstr, false); //get a string variable
@@ -788,6 +800,7 @@ extern "C" DLL_EXPORT void _dbg_dbgexitsignal()
     SafeDbghelpDeinitialize();
     dputs(QT_TRANSLATE_NOOP("DBG", "Cleaning up debugger threads..."));
     dbgstop();
+    TaskPoolStop();
     dputs(QT_TRANSLATE_NOOP("DBG", "Saving notes..."));
     char* text = nullptr;
     GuiGetGlobalNotes(&text);
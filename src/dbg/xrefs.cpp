@@ -94,6 +94,7 @@ bool XrefAdd(duint Address, duint From)
         found->second.references.insert({ xrefRecord.addr, xrefRecord });
         found->second.type = max(found->second.type, xrefRecord.type);
     }
+    xrefs.MarkChanged(key);
     return true;
 }
 
@@ -153,6 +154,11 @@ void XrefCacheLoad(JSON Root)
     xrefs.CacheLoad(Root);
 }
 
+duint XrefCacheGeneration()
+{
+    return xrefs.Generation();
+}
+
 void XrefClear()
 {
     xrefs.Clear();
@@ -12,6 +12,7 @@ bool XrefDeleteAll(duint Address);
 void XrefDelRange(duint Start, duint End);
 void XrefCacheSave(JSON Root);
 void XrefCacheLoad(JSON Root);
+duint XrefCacheGeneration();
 void XrefClear();
 
 #endif // _FUNCTION_H
\ No newline at end of file
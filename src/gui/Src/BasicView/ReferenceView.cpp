@@ -2,6 +2,7 @@
 #include <QMessageBox>
 #include <QLabel>
 #include <QTabWidget>
+#include <QTimer>
 #include "ReferenceView.h"
 #include "Configuration.h"
 #include "Bridge.h"
@@ -48,6 +49,12 @@ ReferenceView::ReferenceView(bool sourceView, QWidget* parent) : SearchListView(
         // Add the progress bar and label to the main layout
         layout()->addWidget(progressWidget);
     }
+    // Rows added in bulk are appended and repainted at most every 100ms
+    mPendingRowsTimer = new QTimer(this);
+    mPendingRowsTimer->setSingleShot(true);
+    mPendingRowsTimer->setInterval(100);
+    connect(mPendingRowsTimer, SIGNAL(timeout()), this, SLOT(pendingRowsTimerSlot()));
+
     connect(this, SIGNAL(listContextMenuSignal(QMenu*)), this, SLOT(referenceContextMenu(QMenu*)));
     connect(this, SIGNAL(enterPressedSignal()), this, SLOT(followGenericAddress()));
 
@@ -100,6 +107,7 @@ void ReferenceView::connectBridge()
     connect(Bridge::getBridge(), SIGNAL(referenceAddColumnAt(int, QString)), this, SLOT(addColumnAt(int, QString)));
     connect(Bridge::getBridge(), SIGNAL(referenceSetRowCount(dsint)), this, SLOT(setRowCount(dsint)));
     connect(Bridge::getBridge(), SIGNAL(referenceSetCellContent(int, int, QString)), this, SLOT(setCellContent(int, int, QString)));
+    connect(Bridge::getBridge(), SIGNAL(referenceAddRows(int, QStringList)), this, SLOT(addRows(int, QStringList)));
     connect(Bridge::getBridge(), SIGNAL(referenceReloadData()), this, SLOT(reloadData()));
     connect(Bridge::getBridge(), SIGNAL(referenceSetSingleSelection(int, bool)), this, SLOT(setSingleSelection(int, bool)));
     connect(Bridge::getBridge(), SIGNAL(referenceSetProgress(int)), this, SLOT(referenceSetProgressSlot(int)));
@@ -115,6 +123,7 @@ void ReferenceView::disconnectBridge()
     disconnect(Bridge::getBridge(), SIGNAL(referenceAddColumnAt(int, QString)), this, SLOT(addColumnAt(int, QString)));
     disconnect(Bridge::getBridge(), SIGNAL(referenceSetRowCount(dsint)), this, SLOT(setRowCount(dsint)));
     disconnect(Bridge::getBridge(), SIGNAL(referenceSetCellContent(int, int, QString)), this, SLOT(setCellContent(int, int, QString)));
+    disconnect(Bridge::getBridge(), SIGNAL(referenceAddRows(int, QStringList)), this, SLOT(addRows(int, QStringList)));
     disconnect(Bridge::getBridge(), SIGNAL(referenceReloadData()), this, SLOT(reloadData()));
     disconnect(Bridge::getBridge(), SIGNAL(referenceSetSingleSelection(int, bool)), this, SLOT(setSingleSelection(int, bool)));
     disconnect(Bridge::getBridge(), SIGNAL(referenceSetProgress(int)), mSearchTotalProgress, SLOT(setValue(int)));
@@ -167,6 +176,7 @@ void ReferenceView::addColumnAt(int width, QString title)
 
 void ReferenceView::setRowCount(dsint count)
 {
+    appendPendingRows();
     if(!mList->getRowCount() && count) //from zero to N rows
         searchSelectionChanged(0);
     emit mCountTotalLabel->setText(QString("%1").arg(count));
@@ -176,10 +186,39 @@ void ReferenceView::setRowCount(dsint count)
 
 void ReferenceView::setCellContent(int r, int c, QString s)
 {
+    appendPendingRows();
     mSearchBox->setText("");
     mList->setCellContent(r, c, s);
 }
 
+void ReferenceView::addRows(int cols, QStringList cells)
+{
+    mPendingRows.append(qMakePair(cols, cells));
+    if(!mPendingRowsTimer->isActive())
+        mPendingRowsTimer->start();
+}
+
+void ReferenceView::appendPendingRows()
+{
+    if(mPendingRows.isEmpty())
+        return;
+    bool wasEmpty = !mList->getRowCount();
+    for(const auto & chunk : mPendingRows)
+        mList->appendRows(chunk.first, chunk.second);
+    mPendingRows.clear();
+    mPendingRowsTimer->stop();
+    mSearchBox->setText("");
+    if(wasEmpty && mList->getRowCount()) //from zero to N rows
+        searchSelectionChanged(0);
+    mCountTotalLabel->setText(QString("%1").arg(mList->getRowCount()));
+}
+
+void ReferenceView::pendingRowsTimerSlot()
+{
+    appendPendingRows();
+    mList->reloadData();
+}
+
 void ReferenceView::addCommand(QString title, QString command)
 {
     mCommnadTitles.append(title);
@@ -188,6 +227,7 @@ void ReferenceView::addCommand(QString title, QString command)
 
 void ReferenceView::reloadData()
 {
+    appendPendingRows();
     mSearchBox->setText("");
     mList->reloadData();
     mList->setFocus();
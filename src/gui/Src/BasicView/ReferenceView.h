@@ -6,6 +6,7 @@
 #include "SearchListView.h"
 
 class QTabWidget;
+class QTimer;
 
 class ReferenceView : public SearchListView
 {
@@ -21,6 +22,7 @@ public slots:
     void addColumnAt(int width, QString title);
     void setRowCount(dsint count);
     void setCellContent(int r, int c, QString s);
+    void addRows(int cols, QStringList cells);
     void addCommand(QString title, QString command);
     void reloadData();
     void setSingleSelection(int index, bool scroll);
@@ -46,6 +48,7 @@ signals:
 
 private slots:
     void referenceExecCommand();
+    void pendingRowsTimerSlot();
 
 private:
     QProgressBar* mSearchTotalProgress;
@@ -63,6 +66,8 @@ private:
     QVector<QString> mCommnadTitles;
     QVector<QString> mCommands;
     QTabWidget* mParent;
+    QList<QPair<int, QStringList>> mPendingRows;
+    QTimer* mPendingRowsTimer;
 
     enum BPSetAction
     {
@@ -74,6 +79,7 @@ private:
 
     void setBreakpointAt(int row, BPSetAction action);
     dsint apiAddressFromString(const QString & s);
+    void appendPendingRows();
 
     void mouseReleaseEvent(QMouseEvent* event);
 };
@@ -190,14 +190,19 @@ void SearchListView::searchTextChanged(const QString & arg1)
     mSearchList->setRowCount(0);
     int rows = mList->getRowCount();
     int columns = mList->getColumnCount();
-    for(int i = 0, j = 0; i < rows; i++)
+    bool provided = arg1.length() && mRegexCheckbox->checkState() == Qt::Unchecked && mSearchProvider && mSearchProvider(arg1, mSearchList);
+    if(!provided)
     {
-        if(findTextInList(mList, arg1, i, mSearchStartCol, false))
+        mSearchList->setRowCount(0);
+        for(int i = 0, j = 0; i < rows; i++)
         {
-            mSearchList->setRowCount(j + 1);
-            for(int k = 0; k < columns; k++)
-                mSearchList->setCellContent(j, k, mList->getCellContent(i, k));
-            j++;
+            if(findTextInList(mList, arg1, i, mSearchStartCol, false))
+            {
+                mSearchList->setRowCount(j + 1);
+                for(int k = 0; k < columns; k++)
+                    mSearchList->setCellContent(j, k, mList->getCellContent(i, k));
+                j++;
+            }
         }
     }
 
@@ -237,6 +242,11 @@ void SearchListView::searchTextChanged(const QString & arg1)
     LoadPrevListLayout(mPrevList);
 }
 
+void SearchListView::setSearchProvider(std::function<bool(const QString & text, SearchListViewTable* list)> provider)
+{
+    mSearchProvider = provider;
+}
+
 void SearchListView::refreshSearchList()
 {
     searchTextChanged(mSearchBox->text());
@@ -7,6 +7,7 @@
 #include "SearchListViewTable.h"
 #include "MenuBuilder.h"
 #include "ActionHelpers.h"
+#include <functional>
 
 namespace Ui
 {
@@ -32,6 +33,8 @@ public:
     void refreshSearchList();
 
     bool isSearchBoxLocked();
+    //The provider fills the search list for a (non-regex) search text, returns false to filter the rows of mList instead
+    void setSearchProvider(std::function<bool(const QString & text, SearchListViewTable* list)> provider);
 
 private slots:
     void searchTextChanged(const QString & arg1);
@@ -53,6 +56,7 @@ private:
     QCheckBox* mRegexCheckbox;
     QCheckBox* mLockCheckbox;
     QAction* mSearchAction;
+    std::function<bool(const QString & text, SearchListViewTable* list)> mSearchProvider;
 
     void LoadPrevListLayout(SearchListViewTable* mPrevList);
 };
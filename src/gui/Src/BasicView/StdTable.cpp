@@ -461,6 +461,29 @@ void StdTable::setCellContent(int r, int c, QString s)
         mData[r][c].text = s;
 }
 
+/**
+ * @brief StdTable::appendRows Appends a block of rows in one go.
+ * @param cols The number of cells per row.
+ * @param cells The cells, stored column by column.
+ */
+void StdTable::appendRows(int cols, const QStringList & cells)
+{
+    if(cols <= 0)
+        return;
+    int rows = cells.size() / cols;
+    int columnCount = getColumnCount();
+    int copyCols = qMin(cols, columnCount);
+    mData.reserve(mData.size() + rows);
+    for(int r = 0; r < rows; r++)
+    {
+        std::vector<CellData> row(columnCount);
+        for(int c = 0; c < copyCols; c++)
+            row[c].text = cells.at(c * rows + r);
+        mData.push_back(std::move(row));
+    }
+    AbstractTableView::setRowCount(int(mData.size()));
+}
+
 QString StdTable::getCellContent(int r, int c)
 {
     if(isValidIndex(r, c))
@@ -42,6 +42,7 @@ public:
     void setRowCount(int count);
     void deleteAllColumns();
     void setCellContent(int r, int c, QString s);
+    void appendRows(int cols, const QStringList & cells);
     QString getCellContent(int r, int c);
     void setCellUserdata(int r, int c, duint userdata);
     duint getCellUserdata(int r, int c);
@@ -836,6 +836,25 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
         emit updateTraceBrowser();
         break;
 
+    case GUI_REF_ADDROWS:
+    {
+        //copy the packed cells before returning, the view appends them in a single queued call
+        REFROWSINFO* info = (REFROWSINFO*)param1;
+        if(info->rows <= 0 || info->cols <= 0)
+            break;
+        QStringList cells;
+        cells.reserve(info->rows * info->cols);
+        const char* cell = info->cells;
+        for(int i = 0; i < info->rows * info->cols; i++)
+        {
+            auto len = strlen(cell);
+            cells.append(QString::fromUtf8(cell, int(len)));
+            cell += len + 1;
+        }
+        emit referenceAddRows(info->cols, cells);
+    }
+    break;
+
     }
 
     return nullptr;
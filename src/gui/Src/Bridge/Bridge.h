@@ -69,6 +69,7 @@ signals:
     void referenceAddColumnAt(int width, QString title);
     void referenceSetRowCount(dsint count);
     void referenceSetCellContent(int r, int c, QString s);
+    void referenceAddRows(int cols, QStringList cells);
     void referenceAddCommand(QString title, QString command);
     void referenceReloadData();
     void referenceSetSingleSelection(int index, bool scroll);
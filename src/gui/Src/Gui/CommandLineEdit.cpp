@@ -145,6 +145,7 @@ void CommandLineEdit::autoCompleteUpdate(const QString text)
 
         // User supplied callback
         GUISCRIPTCOMPLETER complete = mScriptInfo[mCurrentScriptIndex].completeCommand;
+        mCompleter->setCompletionMode(QCompleter::PopupCompletion);
 
         if(complete)
         {
@@ -177,7 +178,27 @@ void CommandLineEdit::autoCompleteUpdate(const QString text)
         {
             // Native auto-completion
             if(mCurrentScriptIndex == 0)
-                mCompleterModel->setStringList(mDefaultCompletions);
+            {
+                // Complete the last argument to a symbol name (prefix matches first, then names containing it)
+                int argument = qMax(text.lastIndexOf(QChar(' ')), text.lastIndexOf(QChar(','))) + 1;
+                QString search = text.mid(argument).trimmed();
+                if(argument > 0 && search.length() >= 2 && DbgIsDebugging())
+                {
+                    char* symbolList[32];
+                    int symbolCount = DbgFunctions()->SymAutoComplete(search.toUtf8().constData(), symbolList, _countof(symbolList));
+                    QStringList stringList;
+                    for(int i = 0; i < symbolCount; i++)
+                    {
+                        stringList.append(text.left(argument) + QString::fromUtf8(symbolList[i]));
+                        BridgeFree(symbolList[i]);
+                    }
+                    // The matches do not all start with the text, show them as they are
+                    mCompleter->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+                    mCompleterModel->setStringList(stringList);
+                }
+                else
+                    mCompleterModel->setStringList(mDefaultCompletions);
+            }
         }
 
         // Restore index
@@ -2,43 +2,46 @@
 #include "Configuration.h"
 #include "Bridge.h"
 #include "BrowseDialog.h"
+#include "RichTextPainter.h"
+#include "CachedFontMetrics.h"
+#include "LogRedirectThread.h"
 #include <QRegularExpression>
 #include <QDesktopServices>
 #include <QClipboard>
 #include <QTimer>
 
 /**
- * @brief LogView::LogView The constructor constructs a rich text browser
+ * @brief LogView::LogView The constructor constructs a virtual table that only renders the visible lines of the log buffer
  * @param parent The parent
  */
-LogView::LogView(QWidget* parent) : QTextBrowser(parent), logRedirection(NULL)
+LogView::LogView(QWidget* parent) : AbstractTableView(parent), logRedirection(NULL), logChanged(false), droppedLines(0), flushLog(false)
 {
-    updateStyle();
-    this->setUndoRedoEnabled(false);
-    this->setReadOnly(true);
-    this->setOpenExternalLinks(false);
-    this->setOpenLinks(false);
+    selectionStart = -1;
+    selectionEnd = -1;
+    selecting = false;
+    setShowHeader(false);
+    setDrawDebugOnly(false);
+    addColumnAt(0, "", false);
     this->setLoggingEnabled(true);
     autoScroll = true;
 
     flushTimer = new QTimer(this);
-    flushTimer->setInterval(500);
+    flushTimer->setInterval(100);
     connect(flushTimer, SIGNAL(timeout()), this, SLOT(flushTimerSlot()));
     connect(Bridge::getBridge(), SIGNAL(close()), flushTimer, SLOT(stop()));
 
-    connect(Config(), SIGNAL(colorsUpdated()), this, SLOT(updateStyle()));
-    connect(Config(), SIGNAL(fontsUpdated()), this, SLOT(updateStyle()));
     connect(Bridge::getBridge(), SIGNAL(addMsgToLog(QByteArray)), this, SLOT(addMsgToLogSlot(QByteArray)));
     connect(Bridge::getBridge(), SIGNAL(clearLog()), this, SLOT(clearLogSlot()));
     connect(Bridge::getBridge(), SIGNAL(setLogEnabled(bool)), this, SLOT(setLoggingEnabled(bool)));
     connect(Bridge::getBridge(), SIGNAL(flushLog()), this, SLOT(flushLogSlot()));
-    connect(this, SIGNAL(anchorClicked(QUrl)), this, SLOT(onAnchorClicked(QUrl)));
 
     duint setting;
     if(BridgeSettingGetUint("Misc", "Utf16LogRedirect", &setting))
         utf16Redirect = !!setting;
 
     setupContextMenu();
+
+    Initialize();
 }
 
 /**
@@ -46,18 +49,24 @@ LogView::LogView(QWidget* parent) : QTextBrowser(parent), logRedirection(NULL)
  */
 LogView::~LogView()
 {
-    if(logRedirection != NULL)
-        fclose(logRedirection);
+    delete logRedirection; //flushes and closes the file
     logRedirection = NULL;
 }
 
-void LogView::updateStyle()
+void LogView::updateColors()
 {
-    setFont(ConfigFont("Log"));
-    setStyleSheet(QString("QTextEdit { color: %1; background-color: %2 }").arg(ConfigColor("AbstractTableViewTextColor").name(), ConfigColor("AbstractTableViewBackgroundColor").name()));
-    QColor LogLinkBackgroundColor = ConfigColor("LogLinkBackgroundColor");
+    AbstractTableView::updateColors();
+    linkColor = ConfigColor("LogLinkColor");
+    linkBackgroundColor = ConfigColor("LogLinkBackgroundColor");
+    updateViewport();
+}
 
-    this->document()->setDefaultStyleSheet(QString("a {color: %1; background-color: %2 }").arg(ConfigColor("LogLinkColor").name(), LogLinkBackgroundColor == Qt::transparent ? "transparent" : LogLinkBackgroundColor.name()));
+void LogView::updateFonts()
+{
+    setFont(ConfigFont("Log"));
+    invalidateCachedFont();
+    logChanged = true; //the column width depends on the font
+    reloadData();
 }
 
 template<class T> static QAction* setupAction(const QIcon & icon, const QString & text, LogView* this_object, T slot)
@@ -105,6 +114,7 @@ void LogView::setupContextMenu()
 void LogView::refreshShortcutsSlot()
 {
     actionCopy->setShortcut(ConfigShortcut("ActionCopy"));
+    actionSelectAll->setShortcut(QKeySequence::SelectAll);
     actionToggleLogging->setShortcut(ConfigShortcut("ActionToggleLogging"));
     actionRedirectLog->setShortcut(ConfigShortcut("ActionRedirectLog"));
 }
@@ -139,18 +149,18 @@ void LogView::showEvent(QShowEvent* event)
 {
     flushTimerSlot();
     flushTimer->start();
-    QTextBrowser::showEvent(event);
+    AbstractTableView::showEvent(event);
 }
 
 void LogView::hideEvent(QHideEvent* event)
 {
     flushTimer->stop();
-    QTextBrowser::hideEvent(event);
+    AbstractTableView::hideEvent(event);
 }
 
 /**
- * @brief linkify Add hyperlink HTML to the message where applicable.
- * @param msg The message passed by reference.
+ * @brief LogView::findLinks Find the addresses in a line that are shown as hyperlinks. This only happens for the lines that are painted or clicked.
+ * @param text The text of the line.
  * Url format:
  * x64dbg:// localhost                                                                                          /  address64 # address
  * ^fixed    ^host(probably will be changed to PID + Host when remote debugging and child debugging are supported) ^token      ^parameter
@@ -160,13 +170,167 @@ static QRegularExpression addressRegExp("([0-9A-Fa-f]{16})");
 #else //x86
 static QRegularExpression addressRegExp("([0-9A-Fa-f]{8})");
 #endif //_WIN64
-static void linkify(QString & msg)
+QList<LogView::Link> LogView::findLinks(const QString & text)
+{
+    QList<Link> links;
+    auto matches = addressRegExp.globalMatch(text);
+    while(matches.hasNext())
+    {
+        auto match = matches.next();
+        Link link;
+        link.start = match.capturedStart();
+        link.length = match.capturedLength();
+        links.append(link);
+    }
+    return links;
+}
+
+QString LogView::rowText(dsint row)
+{
+    QString text = logBuffer.lineText(row);
+    text.replace(QChar('\t'), QString("    "));
+    return text;
+}
+
+/**
+ * @brief LogView::linkAt Find the hyperlink under a position in the viewport.
+ * @param pos The position.
+ * @param link The url of the hyperlink.
+ * @return true if there is a hyperlink at the position.
+ */
+bool LogView::linkAt(const QPoint & pos, QUrl & link)
 {
+    int y = transY(pos.y());
+    if(y < 0)
+        return false;
+    dsint row = getTableOffset() + getIndexOffsetFromY(y);
+    if(row >= getRowCount())
+        return false;
+    int x = pos.x() + horizontalScrollBar()->value() - 4;
+    QString text = rowText(row);
+    for(const auto & found : findLinks(text))
+    {
+        int start = mFontMetrics->width(text.left(found.start));
+        int end = start + mFontMetrics->width(text.mid(found.start, found.length));
+        if(x >= start && x < end)
+        {
 #ifdef _WIN64
-    msg.replace(addressRegExp, "<a href=\"x64dbg://localhost/address64#\\1\">\\1</a>");
+            link = QUrl(QString("x64dbg://localhost/address64#%1").arg(text.mid(found.start, found.length)));
 #else //x86
-    msg.replace(addressRegExp, "<a href=\"x64dbg://localhost/address32#\\1\">\\1</a>");
+            link = QUrl(QString("x64dbg://localhost/address32#%1").arg(text.mid(found.start, found.length)));
 #endif //_WIN64
+            return true;
+        }
+    }
+    return false;
+}
+
+QString LogView::paintContent(QPainter* painter, dsint rowBase, int rowOffset, int col, int x, int y, int w, int h)
+{
+    Q_UNUSED(col);
+    dsint row = rowBase + rowOffset;
+    if(selectionStart != -1 && row >= std::min(selectionStart, selectionEnd) && row <= std::max(selectionStart, selectionEnd))
+        painter->fillRect(QRect(x, y, w, h), QBrush(selectionColor));
+
+    QString text = rowText(row);
+    RichTextPainter::List richText;
+    RichTextPainter::CustomRichText_t plain;
+    plain.flags = RichTextPainter::FlagColor;
+    plain.textColor = textColor;
+    plain.highlight = false;
+    RichTextPainter::CustomRichText_t link;
+    link.flags = RichTextPainter::FlagAll;
+    link.textColor = linkColor;
+    link.textBackground = linkBackgroundColor;
+    link.highlight = true;
+    link.highlightColor = linkColor;
+    link.highlightWidth = 1;
+    int last = 0;
+    for(const auto & found : findLinks(text))
+    {
+        if(found.start > last)
+        {
+            plain.text = text.mid(last, found.start - last);
+            richText.push_back(plain);
+        }
+        link.text = text.mid(found.start, found.length);
+        richText.push_back(link);
+        last = found.start + found.length;
+    }
+    if(last < text.length())
+    {
+        plain.text = text.mid(last);
+        richText.push_back(plain);
+    }
+    RichTextPainter::paintRichText(painter, x + 4, y, w - 4, h, 0, richText, mFontMetrics);
+    return QString();
+}
+
+void LogView::mouseMoveEvent(QMouseEvent* event)
+{
+    if(selecting)
+    {
+        int y = transY(event->y());
+        if(y < 0)
+            verticalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepSub);
+        else if(y > getTableHeight())
+            verticalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepAdd);
+        dsint row = getTableOffset() + getIndexOffsetFromY(std::max(y, 0));
+        if(row >= getRowCount())
+            row = getRowCount() - 1;
+        if(row >= 0)
+            selectionEnd = row;
+        updateViewport();
+        return;
+    }
+    QUrl link;
+    if(linkAt(event->pos(), link))
+        setCursor(Qt::PointingHandCursor);
+    else
+        unsetCursor();
+    AbstractTableView::mouseMoveEvent(event);
+}
+
+void LogView::mousePressEvent(QMouseEvent* event)
+{
+    if(event->button() == Qt::LeftButton && getGuiState() == AbstractTableView::NoState)
+    {
+        bool extend = (event->modifiers() & Qt::ShiftModifier) != 0;
+        QUrl link;
+        if(!extend && linkAt(event->pos(), link))
+        {
+            onAnchorClicked(link);
+            return;
+        }
+        dsint row = getTableOffset() + getIndexOffsetFromY(transY(event->y()));
+        if(row < getRowCount())
+        {
+            if(!extend || selectionStart == -1)
+                selectionStart = row;
+            selectionEnd = row;
+            selecting = true;
+            updateViewport();
+            return;
+        }
+    }
+    AbstractTableView::mousePressEvent(event);
+}
+
+void LogView::mouseReleaseEvent(QMouseEvent* event)
+{
+    if(event->button() == Qt::LeftButton)
+        selecting = false;
+    AbstractTableView::mouseReleaseEvent(event);
+}
+
+void LogView::keyPressEvent(QKeyEvent* event)
+{
+    if(!event->modifiers() && event->key() == Qt::Key_Home)
+        verticalScrollBar()->triggerAction(QAbstractSlider::SliderToMinimum);
+    else if(!event->modifiers() && event->key() == Qt::Key_End)
+        verticalScrollBar()->triggerAction(QAbstractSlider::SliderToMaximum);
+    else
+        AbstractTableView::keyPressEvent(event);
 }
 
 /**
@@ -182,81 +346,14 @@ void LogView::addMsgToLogSlot(QByteArray msg)
      * - No carriage return (http://utf8everywhere.org/#faq.crlf).
      */
 
-    // fix Unix-style line endings.
-    // redirect the log
-    QString msgUtf16;
-    bool redirectError = false;
+    auto length = strlen(msg.constData()); //the bridge includes the terminator
     if(logRedirection != NULL)
-    {
-        if(utf16Redirect)
-        {
-            msgUtf16 = QString::fromUtf8(msg);
-            msgUtf16.replace("\n", "\r\n");
-            if(!fwrite(msgUtf16.utf16(), msgUtf16.length(), 2, logRedirection))
-            {
-                fclose(logRedirection);
-                logRedirection = NULL;
-                redirectError = true;
-            }
-        }
-        else
-        {
-            const char* data;
-            std::string temp;
-            size_t offset = 0;
-            size_t buffersize = 0;
-            if(strstr(msg.constData(), "\r\n") != nullptr) // Don't replace "\r\n" to "\n" if there is none
-            {
-                temp = msg.constData();
-                while(true)
-                {
-                    size_t index = temp.find("\r\n", offset);
-                    if(index == std::string::npos)
-                        break;
-                    temp.erase(index);
-                    offset = index;
-                }
-                data = temp.c_str();
-                buffersize = temp.size();
-            }
-            else
-            {
-                data = msg.constData();
-                buffersize = strlen(msg);
-            }
-            if(!fwrite(data, buffersize, 1, logRedirection))
-            {
-                fclose(logRedirection);
-                logRedirection = NULL;
-                redirectError = true;
-            }
-            if(loggingEnabled)
-                msgUtf16 = QString::fromUtf8(data, int(buffersize));
-        }
-    }
-    else
-        msgUtf16 = QString::fromUtf8(msg);
+        logRedirection->write(QByteArray(msg.constData(), int(length)));
     if(!loggingEnabled)
         return;
-    msgUtf16 = msgUtf16.toHtmlEscaped();
-    msgUtf16.replace(QChar(' '), QString("&nbsp;"));
-    if(logRedirection)
-    {
-        if(utf16Redirect)
-            msgUtf16.replace(QString("\r\n"), QString("<br/>\n"));
-        else
-            msgUtf16.replace(QChar('\n'), QString("<br/>\n"));
-    }
-    else
-    {
-        msgUtf16.replace(QChar('\n'), QString("<br/>\n"));
-        msgUtf16.replace(QString("\r\n"), QString("<br/>\n"));
-    }
-    linkify(msgUtf16);
-    if(redirectError)
-        msgUtf16.append(tr("fwrite() failed (GetLastError()= %1 ). Log redirection stopped.\n").arg(GetLastError()));
 
-    logBuffer.append(msgUtf16);
+    droppedLines += logBuffer.append(msg.constData(), length);
+    logChanged = true;
     if(flushLog)
     {
         flushTimerSlot();
@@ -301,14 +398,21 @@ void LogView::onAnchorClicked(const QUrl & link)
 
 void LogView::clearLogSlot()
 {
-    this->clear();
+    logBuffer.clear();
+    logChanged = false;
+    droppedLines = 0;
+    selectionStart = -1;
+    selectionEnd = -1;
+    setRowCount(0);
+    setTableOffset(0);
+    reloadData();
 }
 
 void LogView::redirectLogSlot()
 {
     if(logRedirection != NULL)
     {
-        fclose(logRedirection);
+        delete logRedirection;
         logRedirection = NULL;
     }
     else
@@ -316,22 +420,34 @@ void LogView::redirectLogSlot()
         BrowseDialog browse(this, tr("Redirect log to file"), tr("Enter the file to which you want to redirect log messages."), tr("Log files (*.txt);;All files (*.*)"), QCoreApplication::applicationDirPath(), true);
         if(browse.exec() == QDialog::Accepted)
         {
-            logRedirection = _wfopen(browse.path.toStdWString().c_str(), L"ab");
-            if(logRedirection == NULL)
+            FILE* file = _wfopen(browse.path.toStdWString().c_str(), L"ab");
+            if(file == NULL)
                 GuiAddLogMessage(tr("_wfopen() failed. Log will not be redirected to %1.\n").arg(browse.path).toUtf8().constData());
             else
             {
-                if(utf16Redirect && ftell(logRedirection) == 0)
+                if(utf16Redirect && ftell(file) == 0)
                 {
                     unsigned short BOM = 0xfeff;
-                    fwrite(&BOM, 2, 1, logRedirection);
+                    fwrite(&BOM, 2, 1, file);
                 }
+                logRedirection = new LogRedirectThread(file, utf16Redirect, this);
+                connect(logRedirection, SIGNAL(writeFailed(unsigned int)), this, SLOT(redirectErrorSlot(unsigned int)), Qt::QueuedConnection);
+                logRedirection->start();
                 GuiAddLogMessage(tr("Log will be redirected to %1.\n").arg(browse.path).toUtf8().constData());
             }
         }
     }
 }
 
+void LogView::redirectErrorSlot(unsigned int lastError)
+{
+    if(sender() != logRedirection) //redirection was already stopped
+        return;
+    delete logRedirection;
+    logRedirection = NULL;
+    addMsgToLogSlot(tr("fwrite() failed (GetLastError()= %1 ). Log redirection stopped.\n").arg(lastError).toUtf8());
+}
+
 void LogView::setLoggingEnabled(bool enabled)
 {
     if(enabled)
@@ -371,7 +487,11 @@ void LogView::saveSlot()
     }
     else
     {
-        savedLog.write(this->document()->toPlainText().toUtf8().constData());
+        for(qint64 i = 0; i < logBuffer.lineCount(); i++)
+        {
+            savedLog.write(logBuffer.line(i));
+            savedLog.write("\n");
+        }
         savedLog.close();
         GuiAddLogMessage(tr("Log have been saved as %1\n").arg(fileName).toUtf8().constData());
     }
@@ -388,7 +508,7 @@ void LogView::copyToGlobalNotes()
     emit Bridge::getBridge()->getGlobalNotes(&NotesBuffer);
     QString Notes = QString::fromUtf8(NotesBuffer);
     BridgeFree(NotesBuffer);
-    Notes.append(this->textCursor().selectedText());
+    Notes.append(selectedText());
     emit Bridge::getBridge()->setGlobalNotes(Notes);
 }
 
@@ -398,7 +518,7 @@ void LogView::copyToDebuggeeNotes()
     emit Bridge::getBridge()->getDebuggeeNotes(&NotesBuffer);
     QString Notes = QString::fromUtf8(NotesBuffer);
     BridgeFree(NotesBuffer);
-    Notes.append(this->textCursor().selectedText());
+    Notes.append(selectedText());
     emit Bridge::getBridge()->setDebuggeeNotes(Notes);
 }
 
@@ -414,24 +534,63 @@ void LogView::pasteSlot()
 
 void LogView::flushTimerSlot()
 {
-    if(logBuffer.isEmpty())
+    if(!logChanged)
         return;
-    setUpdatesEnabled(false);
-    static unsigned char counter = 100;
-    counter--;
-    if(counter == 0)
+    logChanged = false;
+
+    //keep the selection and the visible lines in place when old lines were dropped
+    if(droppedLines)
     {
-        if(document()->characterCount() > 1024 * 1024 * 100) //limit the log to ~100mb
-            clear();
-        counter = 100;
+        if(selectionStart != -1 && std::max(selectionStart, selectionEnd) < droppedLines)
+        {
+            //all selected lines were dropped
+            selectionStart = -1;
+            selectionEnd = -1;
+        }
+        else if(selectionStart != -1)
+        {
+            selectionStart = std::max(selectionStart - droppedLines, dsint(0));
+            selectionEnd = std::max(selectionEnd - droppedLines, dsint(0));
+        }
+        if(!autoScroll)
+            setTableOffset(std::max(getTableOffset() - droppedLines, dsint(0)));
+        droppedLines = 0;
     }
-    QTextCursor cursor = textCursor();
-    cursor.movePosition(QTextCursor::End);
-    cursor.insertHtml(logBuffer);
+
+    setRowCount(logBuffer.lineCount());
+    setColumnWidth(0, 8 + mFontMetrics->width(QChar(' ')) * logBuffer.longestLine());
     if(autoScroll)
-        moveCursor(QTextCursor::End);
-    setUpdatesEnabled(true);
-    logBuffer.clear();
+        setTableOffset(getRowCount());
+    reloadData();
+}
+
+QString LogView::selectedText()
+{
+    QString text;
+    if(selectionStart == -1)
+        return text;
+    auto first = std::min(selectionStart, selectionEnd);
+    auto last = std::min(std::max(selectionStart, selectionEnd), getRowCount() - 1);
+    for(auto i = first; i <= last; i++)
+    {
+        text.append(logBuffer.lineText(i));
+        text.append("\r\n");
+    }
+    return text;
+}
+
+void LogView::copy()
+{
+    Bridge::CopyToClipboard(selectedText());
+}
+
+void LogView::selectAll()
+{
+    if(!getRowCount())
+        return;
+    selectionStart = 0;
+    selectionEnd = getRowCount() - 1;
+    updateViewport();
 }
 
 void LogView::flushLogSlot()
@@ -1,10 +1,13 @@
 #ifndef LOGVIEW_H
 #define LOGVIEW_H
 
-#include <QTextBrowser>
-#include <cstdio>
+#include "AbstractTableView.h"
+#include "LogBuffer.h"
+#include <QUrl>
 
-class LogView : public QTextBrowser
+class LogRedirectThread;
+
+class LogView : public AbstractTableView
 {
     Q_OBJECT
 public:
@@ -15,11 +18,22 @@ public:
     void showEvent(QShowEvent* event) override;
     void hideEvent(QHideEvent* event) override;
 
+    // Configuration
+    void updateColors() override;
+    void updateFonts() override;
+
+    // Reimplemented Functions
+    QString paintContent(QPainter* painter, dsint rowBase, int rowOffset, int col, int x, int y, int w, int h) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseReleaseEvent(QMouseEvent* event) override;
+    void keyPressEvent(QKeyEvent* event) override;
+
 public slots:
     void refreshShortcutsSlot();
-    void updateStyle();
     void addMsgToLogSlot(QByteArray msg);
     void redirectLogSlot();
+    void redirectErrorSlot(unsigned int lastError);
     void setLoggingEnabled(bool enabled);
     void autoScrollSlot();
     void copyToGlobalNotes();
@@ -28,6 +42,8 @@ public slots:
     bool getLoggingEnabled();
     void onAnchorClicked(const QUrl & link);
 
+    void copy();
+    void selectAll();
     void clearLogSlot();
     void saveSlot();
     void toggleLoggingSlot();
@@ -35,6 +51,17 @@ public slots:
     void flushLogSlot();
 
 private:
+    struct Link
+    {
+        int start;
+        int length;
+    };
+
+    QString selectedText();
+    QString rowText(dsint row);
+    QList<Link> findLinks(const QString & text);
+    bool linkAt(const QPoint & pos, QUrl & link);
+
     bool loggingEnabled;
     bool autoScroll;
     bool utf16Redirect = false;
@@ -51,10 +78,18 @@ private:
     QAction* actionCopyToGlobalNotes;
     QAction* actionCopyToDebuggeeNotes;
 
-    FILE* logRedirection;
-    QString logBuffer;
+    LogRedirectThread* logRedirection;
+    LogBuffer logBuffer;
+    bool logChanged; //lines were added since the last flush
+    dsint droppedLines; //lines dropped from the start of the buffer since the last flush
     QTimer* flushTimer;
     bool flushLog;
+
+    dsint selectionStart; //-1 when nothing is selected
+    dsint selectionEnd;
+    bool selecting;
+    QColor linkColor;
+    QColor linkBackgroundColor;
 };
 
 #endif // LOGVIEW_H
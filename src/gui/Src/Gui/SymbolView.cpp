@@ -25,6 +25,10 @@ SymbolView::SymbolView(QWidget* parent) : QWidget(parent), ui(new Ui::SymbolView
     // Create reference view
     mSearchListView = new SearchListView(true, this, true);
     mSearchListView->mSearchStartCol = 1;
+    mSearchListView->setSearchProvider([this](const QString & text, SearchListViewTable * list)
+    {
+        return searchSymbols(text, list);
+    });
 
     // Create module list
     mModuleList = new SearchListView(true, this);
@@ -320,6 +324,27 @@ void SymbolView::cbSymbolEnum(SYMBOLINFO* symbol, void* user)
     }
 }
 
+// Search the selected modules in the symbol cache of the debugger instead of filtering the rows
+bool SymbolView::searchSymbols(const QString & text, SearchListViewTable* list)
+{
+    // The symbol cache only matches names, text that also matches the Type column is left to the row filter
+    if(tr("Import").contains(text, Qt::CaseInsensitive) || tr("Export").contains(text, Qt::CaseInsensitive))
+        return false;
+    auto search = text.toUtf8();
+    for(auto index : mModuleList->mCurList->getSelection())
+    {
+        QString mod = mModuleList->mCurList->getCellContent(index, 1);
+        if(!mModuleBaseList.count(mod))
+            continue;
+        if(!DbgFunctions()->SymSearch(mModuleBaseList[mod], search.constData(), cbSymbolEnum, list))
+        {
+            list->setRowCount(0);
+            return false;
+        }
+    }
+    return true;
+}
+
 void SymbolView::moduleSelectionChanged(int index)
 {
     Q_UNUSED(index);
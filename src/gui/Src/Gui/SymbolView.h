@@ -6,6 +6,7 @@
 
 class QMenu;
 class SearchListView;
+class SearchListViewTable;
 class QVBoxLayout;
 
 namespace Ui
@@ -91,6 +92,7 @@ private:
     QAction* mFreeLib;
 
     static void cbSymbolEnum(SYMBOLINFO* symbol, void* user);
+    bool searchSymbols(const QString & text, SearchListViewTable* list);
 };
 
 #endif // SYMBOLVIEW_H
@@ -1,18 +1,37 @@
 #include "TraceFileReaderInternal.h"
+#include "dbg/TraceFileFormat.h"
+#include "dbg/lz4/lz4.h"
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QThread>
+#include <QBuffer>
+#include <algorithm>
+#include <thread>
+#include "Configuration.h"
 
 TraceFileReader::TraceFileReader(QObject* parent) : QObject(parent)
 {
+    version = TRACE_FILE_VERSION_RAW;
     length = 0;
     progress = 0;
     error = true;
     parser = nullptr;
+    mappedFile = nullptr;
+    mappedSize = 0;
     lastAccessedPage = nullptr;
     lastAccessedIndexOffset = 0;
+    lastPageNumber = size_t(-1);
     hashValue = 0;
     EXEPath.clear();
+    pageCache = new TraceFilePageCache(size_t(Config()->getUint("Gui", "TracePageCacheSize")) * 1024 * 1024);
+    prefetcher = new TraceFilePrefetcher(this);
+}
+
+TraceFileReader::~TraceFileReader()
+{
+    prefetcher->stop();
+    unmapFile();
+    delete pageCache;
 }
 
 bool TraceFileReader::Open(const QString & fileName)
@@ -49,10 +68,16 @@ void TraceFileReader::Close()
         parser->requestInterruption();
         parser->wait();
     }
+    prefetcher->cancel();
+    pageCache->clear();
+    lastAccessedPage = nullptr;
+    lastPageNumber = size_t(-1);
+    unmapFile();
     traceFile.close();
     progress.store(0);
     length = 0;
     fileIndex.clear();
+    pageSummary.clear();
     hashValue = 0;
     EXEPath.clear();
     error = false;
@@ -61,7 +86,10 @@ void TraceFileReader::Close()
 void TraceFileReader::parseFinishedSlot()
 {
     if(!error)
+    {
+        mapFile();
         progress.store(100);
+    }
     else
         progress.store(0);
     delete parser;
@@ -164,89 +192,151 @@ TraceFilePage* TraceFileReader::getPage(unsigned long long index, unsigned long
             return lastAccessedPage;
         }
     }
-    const auto cache = pages.find(Range(index, index));
-    if(cache != pages.cend())
-    {
-        if(cache->first.first >= index && cache->first.second <= index)
-        {
-            if(lastAccessedPage)
-                GetSystemTimes(nullptr, nullptr, &lastAccessedPage->lastAccessed);
-            lastAccessedPage = &cache->second;
-            lastAccessedIndexOffset = cache->first.first;
-            GetSystemTimes(nullptr, nullptr, &lastAccessedPage->lastAccessed);
-            *base = lastAccessedIndexOffset;
-            return lastAccessedPage;
-        }
-    }
-    else if(index >= Length()) //Out of bound
+    if(index >= Length()) //Out of bound
         return nullptr;
-    //page in
-    if(pages.size() >= 2048) //TODO: trim resident pages based on system memory usage, instead of a hard limit.
+    //binary search fileIndex to get the page containing index
+    auto fileOffset = std::upper_bound(fileIndex.begin(), fileIndex.end(), index, [](unsigned long long index, const std::pair<unsigned long long, Range> & page)
     {
-        FILETIME pageOutTime = pages.begin()->second.lastAccessed;
-        Range pageOutIndex = pages.begin()->first;
-        for(auto i : pages)
-        {
-            if(pageOutTime.dwHighDateTime < i.second.lastAccessed.dwHighDateTime || (pageOutTime.dwHighDateTime == i.second.lastAccessed.dwHighDateTime && pageOutTime.dwLowDateTime < i.second.lastAccessed.dwLowDateTime))
-            {
-                pageOutTime = i.second.lastAccessed;
-                pageOutIndex = i.first;
-            }
-        }
-        pages.erase(pageOutIndex);
+        return index < page.first;
+    });
+    if(fileOffset == fileIndex.begin())
+    {
+        GuiAddLogMessage("PAGEFAULT1\r\n"); //debug
+        return nullptr; //???
     }
-    //binary search fileIndex to get file offset, push a TraceFilePage into cache and return it.
-    size_t start = 0;
-    size_t end = fileIndex.size() - 1;
-    size_t middle = (start + end) / 2;
-    std::pair<unsigned long long, Range>* fileOffset;
-    while(true)
+    --fileOffset;
+    if(index >= fileOffset->first + fileOffset->second.second)
     {
-        if(start == end || start == end - 1)
-        {
-            if(fileIndex[end].first <= index)
-                fileOffset = &fileIndex[end];
-            else
-                fileOffset = &fileIndex[start];
-            break;
-        }
-        if(fileIndex[middle].first > index)
-            end = middle;
-        else if(fileIndex[middle].first == index)
-        {
-            fileOffset = &fileIndex[middle];
-            break;
-        }
-        else
-            start = middle;
-        middle = (start + end) / 2;
+        GuiAddLogMessage("PAGEFAULT1\r\n"); //debug
+        return nullptr; //???
     }
+    size_t pageNumber = fileOffset - fileIndex.begin();
+    lastAccessedPage = nullptr; //inserting into the cache can evict it
+
+    //a page finished by the prefetcher in the meantime goes into the cache
+    unsigned long long prefetchedIndex;
+    auto prefetched = prefetcher->takeFinished(&prefetchedIndex);
+    if(prefetched && !prefetched->IsError())
+        pageCache->insert(prefetchedIndex, std::move(*prefetched));
 
-    if(fileOffset->second.second + fileOffset->first >= index && fileOffset->first <= index)
+    TraceFilePage* page = pageCache->find(fileOffset->first);
+    if(page == nullptr)
     {
-        pages.insert(std::make_pair(Range(fileOffset->first, fileOffset->first + fileOffset->second.second - 1), TraceFilePage(this, fileOffset->second.first, fileOffset->second.second)));
-        const auto newPage = pages.find(Range(index, index));
-        if(newPage != pages.cend())
-        {
-            if(lastAccessedPage)
-                GetSystemTimes(nullptr, nullptr, &lastAccessedPage->lastAccessed);
-            lastAccessedPage = &newPage->second;
-            lastAccessedIndexOffset = newPage->first.first;
-            GetSystemTimes(nullptr, nullptr, &lastAccessedPage->lastAccessed);
-            *base = lastAccessedIndexOffset;
-            return lastAccessedPage;
-        }
+        //page in
+        prefetched = prefetcher->take(fileOffset->first);
+        if(prefetched)
+            page = pageCache->insert(fileOffset->first, std::move(*prefetched));
+        else
+            page = pageCache->insert(fileOffset->first, TraceFilePage(this, fileOffset->second.first, fileOffset->second.second));
+        if(page->IsError())
+            error = true;
         else
         {
-            GuiAddLogMessage("PAGEFAULT2\r\n"); //debug
-            return nullptr; //???
+            if(pageSummary.size() < fileIndex.size())
+                pageSummary.resize(fileIndex.size());
+            if(!pageSummary[pageNumber].valid)
+                page->Summarize(pageSummary[pageNumber]);
         }
     }
-    else
+    if(index - fileOffset->first >= page->Length())
     {
-        GuiAddLogMessage("PAGEFAULT1\r\n"); //debug
+        GuiAddLogMessage("PAGEFAULT2\r\n"); //debug
         return nullptr; //???
     }
+
+    //decode the next page in the scrolling direction before it is needed
+    if(lastPageNumber != size_t(-1))
+    {
+        if(pageNumber == lastPageNumber + 1 && pageNumber + 1 < fileIndex.size())
+            prefetchPage(pageNumber + 1);
+        else if(pageNumber + 1 == lastPageNumber && pageNumber > 0)
+            prefetchPage(pageNumber - 1);
+    }
+    lastPageNumber = pageNumber;
+    lastAccessedPage = page;
+    lastAccessedIndexOffset = fileOffset->first;
+    *base = lastAccessedIndexOffset;
+    return lastAccessedPage;
+}
+
+size_t TraceFileReader::PageCount()
+{
+    return fileIndex.size();
+}
+
+bool TraceFileReader::ForEachPage(const PageFilter & filter, const PageCallback & callback)
+{
+    if(pageSummary.size() < fileIndex.size())
+        pageSummary.resize(fileIndex.size());
+    std::atomic<size_t> nextPage(0);
+    std::atomic<bool> failed(false);
+    auto worker = [&]()
+    {
+        while(true)
+        {
+            size_t pageNumber = nextPage++;
+            if(pageNumber >= fileIndex.size())
+                break;
+            //every worker writes only to the summaries of its own pages
+            TraceFilePageSummary & summary = pageSummary[pageNumber];
+            if(summary.valid && !filter(summary))
+                continue;
+            const auto & entry = fileIndex[pageNumber];
+            TraceFilePage page(this, entry.second.first, entry.second.second);
+            if(page.IsError())
+            {
+                failed = true;
+                continue;
+            }
+            if(!summary.valid)
+            {
+                page.Summarize(summary);
+                if(!filter(summary))
+                    continue;
+            }
+            callback(pageNumber, entry.first, page);
+        }
+    };
+    //QFile is not thread safe, without a mapping the pages are decoded on this thread
+    size_t threadCount = mappedFile ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+    threadCount = std::min(threadCount, fileIndex.size());
+    std::vector<std::thread> workers;
+    for(size_t i = 1; i < threadCount; i++)
+        workers.emplace_back(worker);
+    worker();
+    for(auto & thread : workers)
+        thread.join();
+    return !failed;
+}
+
+void TraceFileReader::prefetchPage(size_t pageNumber)
+{
+    if(!mappedFile)
+        return;
+    const auto & page = fileIndex[pageNumber];
+    if(!pageCache->contains(page.first))
+        prefetcher->request(page.first, page.second.first, page.second.second);
+}
+
+void TraceFileReader::mapFile()
+{
+    unmapFile();
+    mappedSize = traceFile.size();
+    if(mappedSize != 0)
+        mappedFile = traceFile.map(0, mappedSize);
+    if(!mappedFile)
+        mappedSize = 0;
+}
+
+void TraceFileReader::unmapFile()
+{
+    if(mappedFile)
+    {
+        prefetcher->cancel(); //the prefetcher reads from the mapping
+        traceFile.unmap(mappedFile);
+        mappedFile = nullptr;
+    }
+    mappedSize = 0;
 }
 
 //Parser
@@ -284,10 +374,20 @@ void TraceFileParser::readFileHeader(TraceFileReader* that)
     if(ver == jsonRoot.constEnd())
         throw std::wstring(L"Unspecified");
     QJsonValue verVal = ver.value();
-    if(verVal.toInt(0) != 1)
+    that->version = verVal.toInt(0);
+    if(that->version == TRACE_FILE_VERSION_RAW)
+    {
+        if(!checkKey(jsonRoot, "compression", ""))
+            throw std::wstring(L"Compression not supported");
+    }
+    else if(that->version == TRACE_FILE_VERSION_LZ4)
+    {
+        if(!checkKey(jsonRoot, "compression", "lz4"))
+            throw std::wstring(L"Compression not supported");
+    }
+    else
         throw std::wstring(L"Version not supported");
     checkKey(jsonRoot, "arch", ArchValue("x86", "x64"));
-    checkKey(jsonRoot, "compression", "");
     const auto hashAlgorithmObj = jsonRoot.find("hashAlgorithm");
     if(hashAlgorithmObj != jsonRoot.constEnd())
     {
@@ -319,6 +419,79 @@ void TraceFileParser::readFileHeader(TraceFileReader* that)
     }
 }
 
+//Returns the offset of the seek index, or the file size if the file has no footer (yet)
+static quint64 traceDataEnd(QFile & traceFile, TraceFooter* footer)
+{
+    quint64 size = traceFile.size();
+    if(size >= sizeof(TraceFooter) && traceFile.seek(size - sizeof(TraceFooter)) && traceFile.read((char*)footer, sizeof(TraceFooter)) == sizeof(TraceFooter))
+    {
+        if(footer->magic == TRACE_FOOTER_MAGIC && footer->indexOffset + quint64(footer->entryCount) * sizeof(TraceIndexEntry) + sizeof(TraceFooter) == size)
+            return footer->indexOffset;
+    }
+    footer->entryCount = 0;
+    return size;
+}
+
+//Load the seek index written when the trace was closed, returns false if there is no usable index
+bool TraceFileParser::readFrameIndex(TraceFileReader* that)
+{
+    TraceFooter footer;
+    traceDataEnd(that->traceFile, &footer);
+    if(footer.entryCount == 0 || !that->traceFile.seek(footer.indexOffset))
+        return false;
+    std::vector<TraceIndexEntry> entries(footer.entryCount);
+    qint64 indexSize = entries.size() * sizeof(TraceIndexEntry);
+    if(that->traceFile.read((char*)entries.data(), indexSize) != indexSize)
+        return false;
+    unsigned long long index = 0;
+    for(const auto & entry : entries)
+    {
+        if(entry.firstRecord != index || entry.recordCount == 0 || entry.fileOffset + sizeof(TraceFrameHeader) + entry.compressedSize > footer.indexOffset)
+        {
+            that->fileIndex.clear();
+            return false;
+        }
+        that->fileIndex.push_back(std::make_pair(index, TraceFileReader::Range(entry.fileOffset, entry.recordCount)));
+        index += entry.recordCount;
+    }
+    that->length = index;
+    return true;
+}
+
+//Walk the frame headers from the current file position, every frame is a page
+void TraceFileParser::readFrames(TraceFileReader* that, unsigned long long index, QThread* thread)
+{
+    TraceFooter footer;
+    quint64 position = that->traceFile.pos();
+    quint64 dataEnd = traceDataEnd(that->traceFile, &footer);
+    while(position + sizeof(TraceFrameHeader) <= dataEnd)
+    {
+        TraceFrameHeader frame;
+        if(!that->traceFile.seek(position) || that->traceFile.read((char*)&frame, sizeof(frame)) != sizeof(frame))
+            throw std::wstring(L"Read frame header failed");
+        quint64 frameEnd = position + sizeof(frame) + frame.compressedSize;
+        if(frame.compressedSize == 0 && frame.uncompressedSize == 0 && frame.recordCount == 0) //zeroed tail of a continued trace
+            break;
+        if(frame.recordCount == 0 || frame.compressedSize > TRACE_MAX_FRAME_SIZE || frame.uncompressedSize > TRACE_MAX_FRAME_SIZE)
+            throw std::wstring(L"Corrupted frame header");
+        if(frameEnd > dataEnd) //frame is still being written
+            break;
+        that->fileIndex.push_back(std::make_pair(index, TraceFileReader::Range(position, frame.recordCount)));
+        index += frame.recordCount;
+        position = frameEnd;
+        //Update progress
+        if(thread)
+        {
+            that->progress.store(position * 100 / that->traceFile.size());
+            if(thread->isInterruptionRequested() && position < dataEnd) //Cancel loading
+                throw std::wstring(L"Canceled");
+        }
+    }
+    //Leave the file at the first incomplete frame, new frames are picked up from there
+    that->traceFile.seek(position);
+    that->length = index;
+}
+
 static bool readBlock(QFile & traceFile)
 {
     if(!traceFile.isReadable())
@@ -372,6 +545,19 @@ void TraceFileParser::run()
         readFileHeader(that);
         //Update progress
         that->progress.store(that->traceFile.pos() * 100 / that->traceFile.size());
+        if(that->version == TRACE_FILE_VERSION_LZ4)
+        {
+            //Compressed file: use the seek index if the trace was closed, otherwise walk the frames
+            quint64 dataStart = that->traceFile.pos();
+            if(!readFrameIndex(that))
+            {
+                that->traceFile.seek(dataStart);
+                readFrames(that, 0, this);
+            }
+            that->error = false;
+            that->traceFile.moveToThread(that->thread());
+            return;
+        }
         //Process file content
         while(!that->traceFile.atEnd())
         {
@@ -413,25 +599,33 @@ void TraceFileReader::purgeLastPage()
     unsigned long long index = 0;
     unsigned long long lastIndex = 0;
     bool isBlockExist = false;
+    //The file has grown, the mapping and the prefetched page are stale
+    unmapFile();
     if(length > 0)
     {
         index = fileIndex.back().first;
-        const auto lastpage = pages.find(Range(index, index));
-        if(lastpage != pages.cend())
-        {
-            //Purge last accessed page
-            if(index == lastAccessedIndexOffset)
-                lastAccessedPage = nullptr;
-            //Remove last page from page cache
-            pages.erase(lastpage);
-        }
+        //Purge last accessed page
+        if(index == lastAccessedIndexOffset)
+            lastAccessedPage = nullptr;
+        //Remove last page from page cache
+        pageCache->erase(index);
         //Seek start of last page
         traceFile.seek(fileIndex.back().second.first);
         //Remove last page from file index cache
         fileIndex.pop_back();
+        if(pageSummary.size() > fileIndex.size())
+            pageSummary.resize(fileIndex.size());
     }
     try
     {
+        if(version == TRACE_FILE_VERSION_LZ4)
+        {
+            //Re-read the frames from the last page, new frames may have been appended
+            TraceFileParser::readFrames(this, index, nullptr);
+            error = false;
+            mapFile();
+            return;
+        }
         while(!traceFile.atEnd())
         {
             quint64 blockStart = traceFile.pos();
@@ -450,6 +644,7 @@ void TraceFileReader::purgeLastPage()
             fileIndex.back().second.second = index - (lastIndex - 1);
         error = false;
         length = index;
+        mapFile();
     }
     catch(std::wstring & errReason)
     {
@@ -474,30 +669,73 @@ TraceFilePage::TraceFilePage(TraceFileReader* parent, unsigned long long fileOff
     size_t memOperandOffset = 0;
     mParent = parent;
     length = 0;
-    GetSystemTimes(nullptr, nullptr, &lastAccessed); //system user time, no GetTickCount64() for XP compatibility.
+    error = false;
     memset(&registers, 0, sizeof(registers));
     try
     {
-        if(mParent->traceFile.seek(fileOffset) == false)
+        //Memory mapped file: parse straight from the mapping, the QBuffer does not copy the data
+        QIODevice* device = &mParent->traceFile;
+        QByteArray fileData;
+        QBuffer fileBuffer(&fileData);
+        if(mParent->mappedFile)
+        {
+            if(fileOffset >= mParent->mappedSize)
+                throw std::exception();
+            fileData = QByteArray::fromRawData((const char*)mParent->mappedFile + fileOffset, int(qMin<unsigned long long>(mParent->mappedSize - fileOffset, INT_MAX)));
+            fileBuffer.open(QIODevice::ReadOnly);
+            device = &fileBuffer;
+        }
+        else if(mParent->traceFile.seek(fileOffset) == false)
             throw std::exception();
+        //Compressed files: decompress the whole frame and parse the records from memory
+        QByteArray frameData;
+        QBuffer frameBuffer(&frameData);
+        if(mParent->version == TRACE_FILE_VERSION_LZ4)
+        {
+            TraceFrameHeader frame;
+            if(device->read((char*)&frame, sizeof(frame)) != sizeof(frame))
+                throw std::exception();
+            if(frame.compressedSize > TRACE_MAX_FRAME_SIZE || frame.uncompressedSize > TRACE_MAX_FRAME_SIZE)
+                throw std::exception();
+            QByteArray compressed;
+            const char* compressedData;
+            if(mParent->mappedFile)
+            {
+                if(fileOffset + sizeof(frame) + frame.compressedSize > mParent->mappedSize)
+                    throw std::exception();
+                compressedData = (const char*)mParent->mappedFile + fileOffset + sizeof(frame);
+            }
+            else
+            {
+                compressed = mParent->traceFile.read(frame.compressedSize);
+                if(compressed.size() != int(frame.compressedSize))
+                    throw std::exception();
+                compressedData = compressed.constData();
+            }
+            frameData.resize(frame.uncompressedSize);
+            if(LZ4_decompress_safe(compressedData, frameData.data(), int(frame.compressedSize), frameData.size()) != frameData.size())
+                throw std::exception();
+            frameBuffer.open(QIODevice::ReadOnly);
+            device = &frameBuffer;
+        }
         //Process file content
-        while(!mParent->traceFile.atEnd() && length < maxLength)
+        while(!device->atEnd() && length < maxLength)
         {
-            if(!mParent->traceFile.isReadable())
+            if(!device->isReadable())
                 throw std::exception();
             unsigned char blockType;
             unsigned char changedCountFlags[3]; //reg changed count, mem accessed count, flags
-            mParent->traceFile.read((char*)&blockType, 1);
+            device->read((char*)&blockType, 1);
             if(blockType == 0)
             {
-                if(mParent->traceFile.read((char*)&changedCountFlags, 3) != 3)
+                if(device->read((char*)&changedCountFlags, 3) != 3)
                     throw std::exception();
                 if(changedCountFlags[2] & 0x80) //Thread Id
-                    mParent->traceFile.read((char*)&lastThreadId, 4);
+                    device->read((char*)&lastThreadId, 4);
                 threadId.push_back(lastThreadId);
                 if((changedCountFlags[2] & 0x0F) > 0) //Opcode
                 {
-                    QByteArray opcode = mParent->traceFile.read(changedCountFlags[2] & 0x0F);
+                    QByteArray opcode = device->read(changedCountFlags[2] & 0x0F);
                     if(opcode.isEmpty())
                         throw std::exception();
                     opcodeOffset.push_back(opcodes.size());
@@ -511,9 +749,9 @@ TraceFilePage::TraceFilePage(TraceFileReader* parent, unsigned long long fileOff
                     int lastPosition = -1;
                     if(changedCountFlags[0] > _countof(regwords)) //Bad count?
                         throw std::exception();
-                    if(mParent->traceFile.read((char*)changed, changedCountFlags[0]) != changedCountFlags[0])
+                    if(device->read((char*)changed, changedCountFlags[0]) != changedCountFlags[0])
                         throw std::exception();
-                    if(mParent->traceFile.read((char*)regContent, changedCountFlags[0] * sizeof(duint)) != changedCountFlags[0] * sizeof(duint))
+                    if(device->read((char*)regContent, changedCountFlags[0] * sizeof(duint)) != changedCountFlags[0] * sizeof(duint))
                     {
                         throw std::exception();
                     }
@@ -534,20 +772,20 @@ TraceFilePage::TraceFilePage(TraceFileReader* parent, unsigned long long fileOff
                     QByteArray memflags;
                     if(changedCountFlags[1] > _countof(memAddress)) //too many memory operands?
                         throw std::exception();
-                    memflags = mParent->traceFile.read(changedCountFlags[1]);
+                    memflags = device->read(changedCountFlags[1]);
                     if(memflags.length() < changedCountFlags[1])
                         throw std::exception();
                     memoryOperandOffset.push_back(memOperandOffset);
                     memOperandOffset += changedCountFlags[1];
-                    if(mParent->traceFile.read((char*)memAddress, sizeof(duint) * changedCountFlags[1]) != sizeof(duint) * changedCountFlags[1])
+                    if(device->read((char*)memAddress, sizeof(duint) * changedCountFlags[1]) != sizeof(duint) * changedCountFlags[1])
                         throw std::exception();
-                    if(mParent->traceFile.read((char*)memOldContent, sizeof(duint) * changedCountFlags[1]) != sizeof(duint) * changedCountFlags[1])
+                    if(device->read((char*)memOldContent, sizeof(duint) * changedCountFlags[1]) != sizeof(duint) * changedCountFlags[1])
                         throw std::exception();
                     for(unsigned char i = 0; i < changedCountFlags[1]; i++)
                     {
                         if((memflags[i] & 1) == 0)
                         {
-                            if(mParent->traceFile.read((char*)&memNewContent[i], sizeof(duint)) != sizeof(duint))
+                            if(device->read((char*)&memNewContent[i], sizeof(duint)) != sizeof(duint))
                                 throw std::exception();
                         }
                         else
@@ -572,7 +810,7 @@ TraceFilePage::TraceFilePage(TraceFileReader* parent, unsigned long long fileOff
     }
     catch(const std::exception &)
     {
-        mParent->error = true;
+        error = true;
     }
 }
 
@@ -581,7 +819,54 @@ unsigned long long TraceFilePage::Length() const
     return length;
 }
 
-REGDUMP TraceFilePage::Registers(unsigned long long index) const
+size_t TraceFilePage::MemoryUsage() const
+{
+    return sizeof(*this) + mRegisters.capacity() * sizeof(REGDUMP) + opcodes.capacity() + opcodeOffset.capacity() * sizeof(size_t) + opcodeSize.capacity()
+           + memoryOperandOffset.capacity() * sizeof(size_t) + memoryFlags.capacity() + (memoryAddress.capacity() + oldMemory.capacity() + newMemory.capacity()) * sizeof(duint)
+           + threadId.capacity() * sizeof(DWORD);
+}
+
+bool TraceFilePage::IsError() const
+{
+    return error;
+}
+
+void TraceFilePage::Summarize(TraceFilePageSummary & summary) const
+{
+    static duint REGISTERCONTEXT::* const summaryRegisters[TRACE_SUMMARY_REGISTERS] =
+    {
+        &REGISTERCONTEXT::cax, &REGISTERCONTEXT::cbx, &REGISTERCONTEXT::ccx, &REGISTERCONTEXT::cdx,
+        &REGISTERCONTEXT::csp, &REGISTERCONTEXT::cbp, &REGISTERCONTEXT::csi, &REGISTERCONTEXT::cdi,
+        &REGISTERCONTEXT::cip
+    };
+    for(int i = 0; i < TRACE_SUMMARY_REGISTERS; i++)
+    {
+        summary.regMin[i] = duint(-1);
+        summary.regMax[i] = 0;
+    }
+    for(const auto & registers : mRegisters)
+    {
+        for(int i = 0; i < TRACE_SUMMARY_REGISTERS; i++)
+        {
+            duint value = registers.regcontext.*summaryRegisters[i];
+            summary.regMin[i] = std::min(summary.regMin[i], value);
+            summary.regMax[i] = std::max(summary.regMax[i], value);
+        }
+    }
+    summary.hasMemory = !memoryAddress.empty();
+    summary.memAddressMin = summary.memValueMin = duint(-1);
+    summary.memAddressMax = summary.memValueMax = 0;
+    for(size_t i = 0; i < memoryAddress.size(); i++)
+    {
+        summary.memAddressMin = std::min(summary.memAddressMin, memoryAddress[i]);
+        summary.memAddressMax = std::max(summary.memAddressMax, memoryAddress[i]);
+        summary.memValueMin = std::min(summary.memValueMin, std::min(oldMemory[i], newMemory[i]));
+        summary.memValueMax = std::max(summary.memValueMax, std::max(oldMemory[i], newMemory[i]));
+    }
+    summary.valid = true;
+}
+
+const REGDUMP & TraceFilePage::Registers(unsigned long long index) const
 {
     return mRegisters.at(index);
 }
@@ -618,3 +903,160 @@ void TraceFilePage::MemoryAccessInfo(unsigned long long index, duint* address, d
         isValid[i] = true; // proposed flag
     }
 }
+
+//TraceFilePageCache
+TraceFilePageCache::TraceFilePageCache(size_t budget)
+{
+    memoryUsage = 0;
+    this->budget = budget;
+}
+
+TraceFilePage* TraceFilePageCache::find(unsigned long long index)
+{
+    auto found = lookup.find(index);
+    if(found == lookup.end())
+        return nullptr;
+    pages.splice(pages.begin(), pages, found->second);
+    return &found->second->second;
+}
+
+bool TraceFilePageCache::contains(unsigned long long index) const
+{
+    return lookup.count(index) != 0;
+}
+
+TraceFilePage* TraceFilePageCache::insert(unsigned long long index, TraceFilePage && page)
+{
+    erase(index);
+    pages.emplace_front(index, std::move(page));
+    lookup[index] = pages.begin();
+    memoryUsage += pages.front().second.MemoryUsage();
+    //evict the least recently used pages, the new page is always kept
+    while(memoryUsage > budget && pages.size() > 1)
+    {
+        auto & last = pages.back();
+        memoryUsage -= last.second.MemoryUsage();
+        lookup.erase(last.first);
+        pages.pop_back();
+    }
+    return &pages.front().second;
+}
+
+void TraceFilePageCache::erase(unsigned long long index)
+{
+    auto found = lookup.find(index);
+    if(found == lookup.end())
+        return;
+    memoryUsage -= found->second->second.MemoryUsage();
+    pages.erase(found->second);
+    lookup.erase(found);
+}
+
+void TraceFilePageCache::clear()
+{
+    pages.clear();
+    lookup.clear();
+    memoryUsage = 0;
+}
+
+size_t TraceFilePageCache::MemoryUsage() const
+{
+    return memoryUsage;
+}
+
+//TraceFilePrefetcher
+TraceFilePrefetcher::TraceFilePrefetcher(TraceFileReader* parent) : QThread(parent)
+{
+    state = Idle;
+    stopping = false;
+    pageIndex = 0;
+    pageFileOffset = 0;
+    pageMaxLength = 0;
+}
+
+void TraceFilePrefetcher::request(unsigned long long index, unsigned long long fileOffset, unsigned long long maxLength)
+{
+    QMutexLocker lock(&mutex);
+    if(state == Running || (state == Finished && pageIndex == index))
+        return; //one page at a time, the reader decodes it synchronously if the prefetcher is busy
+    page.reset();
+    pageIndex = index;
+    pageFileOffset = fileOffset;
+    pageMaxLength = maxLength;
+    state = Pending;
+    if(!isRunning())
+        start(QThread::LowPriority);
+    wake.wakeOne();
+}
+
+std::unique_ptr<TraceFilePage> TraceFilePrefetcher::take(unsigned long long index)
+{
+    QMutexLocker lock(&mutex);
+    if(state == Idle || pageIndex != index)
+        return nullptr;
+    if(state == Pending) //not started yet, decoding it on the calling thread is faster
+    {
+        state = Idle;
+        return nullptr;
+    }
+    while(state == Running)
+        done.wait(&mutex);
+    state = Idle;
+    if(page && page->IsError())
+        page.reset();
+    return std::move(page);
+}
+
+std::unique_ptr<TraceFilePage> TraceFilePrefetcher::takeFinished(unsigned long long* index)
+{
+    QMutexLocker lock(&mutex);
+    if(state != Finished)
+        return nullptr;
+    state = Idle;
+    *index = pageIndex;
+    return std::move(page);
+}
+
+void TraceFilePrefetcher::cancel()
+{
+    QMutexLocker lock(&mutex);
+    while(state == Running)
+        done.wait(&mutex);
+    state = Idle;
+    page.reset();
+}
+
+void TraceFilePrefetcher::stop()
+{
+    {
+        QMutexLocker lock(&mutex);
+        stopping = true;
+        wake.wakeOne();
+    }
+    wait();
+}
+
+void TraceFilePrefetcher::run()
+{
+    TraceFileReader* that = dynamic_cast<TraceFileReader*>(parent());
+    if(that == NULL)
+        return;
+    QMutexLocker lock(&mutex);
+    while(!stopping)
+    {
+        if(state != Pending)
+        {
+            wake.wait(&mutex);
+            continue;
+        }
+        state = Running;
+        auto fileOffset = pageFileOffset;
+        auto maxLength = pageMaxLength;
+        lock.unlock();
+        std::unique_ptr<TraceFilePage> decoded(new TraceFilePage(that, fileOffset, maxLength));
+        lock.relock();
+        page = std::move(decoded);
+        state = Finished;
+        done.wakeAll();
+    }
+}
@@ -4,17 +4,35 @@
 #include "Bridge.h"
 #include <QFile>
 #include <atomic>
+#include <functional>
 
 class TraceFileParser;
 class TraceFilePage;
+class TraceFilePageCache;
+class TraceFilePrefetcher;
 
 #define MAX_MEMORY_OPERANDS 32
+#define TRACE_SUMMARY_REGISTERS 9 //cax, cbx, ccx, cdx, csp, cbp, csi, cdi, cip
+
+//Value ranges of a page, a search can skip the page when the value it looks for is outside of them
+struct TraceFilePageSummary
+{
+    bool valid;
+    bool hasMemory;
+    duint regMin[TRACE_SUMMARY_REGISTERS];
+    duint regMax[TRACE_SUMMARY_REGISTERS];
+    duint memAddressMin;
+    duint memAddressMax;
+    duint memValueMin; //old and new memory content
+    duint memValueMax;
+};
 
 class TraceFileReader : public QObject
 {
     Q_OBJECT
 public:
     TraceFileReader(QObject* parent = NULL);
+    ~TraceFileReader();
     bool Open(const QString & fileName);
     void Close();
     bool isError();
@@ -32,6 +50,14 @@ public:
 
     void purgeLastPage();
 
+    //Decodes every page that passes the filter once, on all cores if the file is memory mapped. The filter is called with
+    //the page summary before (if it is known) and after decoding, the callback for every page that passed the filter.
+    //Both are called concurrently for different pages. Returns false if a page could not be decoded.
+    typedef std::function<bool(const TraceFilePageSummary & summary)> PageFilter;
+    typedef std::function<void(size_t pageNumber, unsigned long long base, const TraceFilePage & page)> PageCallback;
+    size_t PageCount();
+    bool ForEachPage(const PageFilter & filter, const PageCallback & callback);
+
 signals:
     void parseFinished();
 
@@ -40,29 +66,32 @@ public slots:
 
 private:
     typedef std::pair<unsigned long long, unsigned long long> Range;
-    struct RangeCompare //from addrinfo.h
-    {
-        bool operator()(const Range & a, const Range & b) const //a before b?
-        {
-            return a.second < b.first;
-        }
-    };
 
     QFile traceFile;
+    uchar* mappedFile; //nullptr if the file could not be mapped (no address space left?), pages are read with QFile then
+    unsigned long long mappedSize;
+    int version; //TRACE_FILE_VERSION_RAW or TRACE_FILE_VERSION_LZ4
     unsigned long long length;
     duint hashValue;
     QString EXEPath;
-    std::vector<std::pair<unsigned long long, Range>> fileIndex; //index;<file offset;length>
+    std::vector<std::pair<unsigned long long, Range>> fileIndex; //index;<file offset;length>, file offset of the frame header for compressed files
+    std::vector<TraceFilePageSummary> pageSummary; //same order as fileIndex, filled when a page is decoded
     std::atomic<int> progress;
     bool error;
     TraceFilePage* lastAccessedPage;
     unsigned long long lastAccessedIndexOffset;
+    size_t lastPageNumber; //position in fileIndex of the last accessed page, used to detect the scrolling direction
     friend class TraceFileParser;
     friend class TraceFilePage;
+    friend class TraceFilePrefetcher;
 
     TraceFileParser* parser;
-    std::map<Range, TraceFilePage, RangeCompare> pages;
+    TraceFilePageCache* pageCache;
+    TraceFilePrefetcher* prefetcher;
     TraceFilePage* getPage(unsigned long long index, unsigned long long* base);
+    void prefetchPage(size_t pageNumber);
+    void mapFile();
+    void unmapFile();
 };
 
 #endif //TRACEFILEREADER_H
@@ -1,5 +1,10 @@
 #pragma once
 #include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <list>
+#include <memory>
+#include <unordered_map>
 #include "TraceFileReader.h"
 
 class TraceFileParser : public QThread
@@ -8,6 +13,8 @@ class TraceFileParser : public QThread
     friend class TraceFileReader;
     TraceFileParser(TraceFileReader* parent) : QThread(parent) {}
     static void readFileHeader(TraceFileReader* that);
+    static bool readFrameIndex(TraceFileReader* that);
+    static void readFrames(TraceFileReader* that, unsigned long long index, QThread* thread);
     void run();
 };
 
@@ -16,14 +23,15 @@ class TraceFilePage
 public:
     TraceFilePage(TraceFileReader* parent, unsigned long long fileOffset, unsigned long long maxLength);
     unsigned long long Length() const;
-    REGDUMP Registers(unsigned long long index) const;
+    size_t MemoryUsage() const;
+    bool IsError() const;
+    void Summarize(TraceFilePageSummary & summary) const;
+    const REGDUMP & Registers(unsigned long long index) const;
     void OpCode(unsigned long long index, unsigned char* buffer, int* opcodeSize) const;
     DWORD ThreadId(unsigned long long index) const;
     int MemoryAccessCount(unsigned long long index) const;
     void MemoryAccessInfo(unsigned long long index, duint* address, duint* oldMemory, duint* newMemory, bool* isValid) const;
 
-    FILETIME lastAccessed; //system user time
-
 private:
     friend class TraceFileReader;
     TraceFileReader* mParent;
@@ -38,4 +46,57 @@ private:
     std::vector<duint> newMemory;
     std::vector<DWORD> threadId;
     unsigned long long length;
+    bool error; //set when the page could not be decoded, the reader reports it (pages can be decoded on the prefetch thread)
+};
+
+//Decoded pages, indexed by the index of their first instruction. The least recently used pages are evicted when
+//the memory used by the decoded pages exceeds the budget. Lookup, insertion and eviction are O(1).
+class TraceFilePageCache
+{
+public:
+    explicit TraceFilePageCache(size_t budget);
+    TraceFilePage* find(unsigned long long index); //marks the page as most recently used
+    bool contains(unsigned long long index) const;
+    TraceFilePage* insert(unsigned long long index, TraceFilePage && page); //may evict other pages
+    void erase(unsigned long long index);
+    void clear();
+    size_t MemoryUsage() const;
+
+private:
+    typedef std::list<std::pair<unsigned long long, TraceFilePage>> PageList;
+    PageList pages; //most recently used first
+    std::unordered_map<unsigned long long, PageList::iterator> lookup;
+    size_t memoryUsage;
+    size_t budget;
+};
+
+//Decodes one page ahead in the scrolling direction. Only used when the trace file is memory mapped, QFile is not thread safe.
+class TraceFilePrefetcher : public QThread
+{
+    Q_OBJECT
+    friend class TraceFileReader;
+    TraceFilePrefetcher(TraceFileReader* parent);
+    void request(unsigned long long index, unsigned long long fileOffset, unsigned long long maxLength);
+    std::unique_ptr<TraceFilePage> take(unsigned long long index); //returns the page if it was prefetched, waits if it is being decoded
+    std::unique_ptr<TraceFilePage> takeFinished(unsigned long long* index); //returns a finished page, if any
+    void cancel(); //drops the pending request and waits for the running one
+    void stop();
+    void run();
+
+    enum State
+    {
+        Idle,
+        Pending,
+        Running,
+        Finished
+    };
+    QMutex mutex;
+    QWaitCondition wake;
+    QWaitCondition done;
+    State state;
+    bool stopping;
+    unsigned long long pageIndex;
+    unsigned long long pageFileOffset;
+    unsigned long long pageMaxLength;
+    std::unique_ptr<TraceFilePage> page;
 };
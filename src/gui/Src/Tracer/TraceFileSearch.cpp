@@ -1,4 +1,4 @@
-#include "TraceFileReader.h"
+#include "TraceFileReaderInternal.h"
 #include "TraceFileSearch.h"
 #include "capstone_wrapper.h"
 
@@ -7,6 +7,28 @@ static bool inRange(duint value, duint start, duint end)
     return value >= start && value <= end;
 }
 
+static bool rangeOverlaps(duint min, duint max, duint start, duint end)
+{
+    return min <= end && max >= start;
+}
+
+struct TraceSearchHit
+{
+    unsigned long long index;
+    duint cip;
+    unsigned char opcode[16];
+    int opcodeSize;
+};
+
+static TraceSearchHit makeHit(const TraceFilePage & page, unsigned long long base, unsigned long long offset)
+{
+    TraceSearchHit hit;
+    hit.index = base + offset;
+    hit.cip = page.Registers(offset).regcontext.cip;
+    page.OpCode(offset, hit.opcode, &hit.opcodeSize);
+    return hit;
+}
+
 static QString getIndexText(TraceFileReader* file, duint index)
 {
     QString indexString;
@@ -24,10 +46,37 @@ static QString getIndexText(TraceFileReader* file, duint index)
     return indexString;
 }
 
-int TraceFileSearchConstantRange(TraceFileReader* file, duint start, duint end)
+//Pages are searched in parallel, the hits of every page are collected separately and added to the reference view in trace order
+static int populateReferences(TraceFileReader* file, const std::vector<std::vector<TraceSearchHit>> & pageHits)
 {
     int count = 0;
+    for(const auto & hits : pageHits)
+        count += int(hits.size());
+    GuiReferenceSetRowCount(count);
     Capstone cp;
+    int row = 0;
+    for(const auto & hits : pageHits)
+    {
+        for(const auto & hit : hits)
+        {
+            GuiReferenceSetCellContent(row, 0, ToPtrString(hit.cip).toUtf8().constData());
+            GuiReferenceSetCellContent(row, 1, getIndexText(file, hit.index).toUtf8().constData());
+            cp.Disassemble(hit.cip, hit.opcode, hit.opcodeSize);
+            GuiReferenceSetCellContent(row, 2, cp.InstructionText(true).c_str());
+            row++;
+        }
+    }
+    return count;
+}
+
+//The hits of the pages that could be read are still shown
+static void reportUnreadablePages()
+{
+    GuiAddLogMessage(QCoreApplication::translate("TraceFileSearch", "Some pages of the trace could not be read, the search results are incomplete.\r\n").toUtf8().constData());
+}
+
+int TraceFileSearchConstantRange(TraceFileReader* file, duint start, duint end)
+{
     QString title;
     if(start == end)
         title = QCoreApplication::translate("TraceFileSearch", "Constant: %1").arg(ToPtrString(start));
@@ -39,97 +88,100 @@ int TraceFileSearchConstantRange(TraceFileReader* file, duint start, duint end)
     GuiReferenceAddColumn(100, QCoreApplication::translate("TraceFileSearch", "Disassembly").toUtf8().constData());
     GuiReferenceSetRowCount(0);
 
-    for(unsigned long long index = 0; index < file->Length(); index++)
+    std::vector<std::vector<TraceSearchHit>> pageHits(file->PageCount());
+    bool readable = file->ForEachPage([start, end](const TraceFilePageSummary & summary)
+    {
+        for(int i = 0; i < TRACE_SUMMARY_REGISTERS; i++)
+            if(rangeOverlaps(summary.regMin[i], summary.regMax[i], start, end))
+                return true;
+        return summary.hasMemory && (rangeOverlaps(summary.memAddressMin, summary.memAddressMax, start, end) || rangeOverlaps(summary.memValueMin, summary.memValueMax, start, end));
+    }, [start, end, &pageHits](size_t pageNumber, unsigned long long base, const TraceFilePage & page)
     {
-        bool found = false;
-        //Registers
-#define FINDREG(fieldName) found |= inRange(file->Registers(index).regcontext.##fieldName, start, end)
-        FINDREG(cax);
-        FINDREG(cbx);
-        FINDREG(ccx);
-        FINDREG(cdx);
-        FINDREG(csp);
-        FINDREG(cbp);
-        FINDREG(csi);
-        FINDREG(cdi);
-        FINDREG(cip);
-        //Memory
-        duint memAddr[MAX_MEMORY_OPERANDS];
-        duint memOldContent[MAX_MEMORY_OPERANDS];
-        duint memNewContent[MAX_MEMORY_OPERANDS];
-        bool isValid[MAX_MEMORY_OPERANDS];
-        int memAccessCount = file->MemoryAccessCount(index);
-        if(memAccessCount > 0)
+        auto & hits = pageHits[pageNumber];
+        for(unsigned long long index = 0; index < page.Length(); index++)
         {
-            file->MemoryAccessInfo(index, memAddr, memOldContent, memNewContent, isValid);
-            for(size_t i = 0; i < memAccessCount; i++)
+            bool found = false;
+            //Registers
+            const REGDUMP & registers = page.Registers(index);
+#define FINDREG(fieldName) found |= inRange(registers.regcontext.fieldName, start, end)
+            FINDREG(cax);
+            FINDREG(cbx);
+            FINDREG(ccx);
+            FINDREG(cdx);
+            FINDREG(csp);
+            FINDREG(cbp);
+            FINDREG(csi);
+            FINDREG(cdi);
+            FINDREG(cip);
+#undef FINDREG
+            //Memory
+            duint memAddr[MAX_MEMORY_OPERANDS];
+            duint memOldContent[MAX_MEMORY_OPERANDS];
+            duint memNewContent[MAX_MEMORY_OPERANDS];
+            bool isValid[MAX_MEMORY_OPERANDS];
+            int memAccessCount = page.MemoryAccessCount(index);
+            if(memAccessCount > 0)
             {
-                found |= inRange(memAddr[i], start, end);
-                found |= inRange(memOldContent[i], start, end);
-                found |= inRange(memNewContent[i], start, end);
+                page.MemoryAccessInfo(index, memAddr, memOldContent, memNewContent, isValid);
+                for(size_t i = 0; i < memAccessCount; i++)
+                {
+                    found |= inRange(memAddr[i], start, end);
+                    found |= inRange(memOldContent[i], start, end);
+                    found |= inRange(memNewContent[i], start, end);
+                }
             }
+            //Constants: TO DO
+            if(found)
+                hits.push_back(makeHit(page, base, index));
         }
-        //Constants: TO DO
-        //Populate reference view
-        if(found)
-        {
-            GuiReferenceSetRowCount(count + 1);
-            GuiReferenceSetCellContent(count, 0, ToPtrString(file->Registers(index).regcontext.cip).toUtf8().constData());
-            GuiReferenceSetCellContent(count, 1, getIndexText(file, index).toUtf8().constData());
-            unsigned char opcode[16];
-            int opcodeSize = 0;
-            file->OpCode(index, opcode, &opcodeSize);
-            cp.Disassemble(file->Registers(index).regcontext.cip, opcode, opcodeSize);
-            GuiReferenceSetCellContent(count, 2, cp.InstructionText(true).c_str());
-            //GuiReferenceSetCurrentTaskProgress; GuiReferenceSetProgress
-            count++;
-        }
-    }
-    return count;
+    });
+    if(!readable)
+        reportUnreadablePages();
+    //Populate reference view
+    return populateReferences(file, pageHits);
 }
 
 int TraceFileSearchMemReference(TraceFileReader* file, duint address)
 {
-    int count = 0;
-    Capstone cp;
     GuiReferenceInitialize(QCoreApplication::translate("TraceFileSearch", "Reference").toUtf8().constData());
     GuiReferenceAddColumn(sizeof(duint) * 2, QCoreApplication::translate("TraceFileSearch", "Address").toUtf8().constData());
     GuiReferenceAddColumn(sizeof(duint) * 2, QCoreApplication::translate("TraceFileSearch", "Index").toUtf8().constData());
     GuiReferenceAddColumn(100, QCoreApplication::translate("TraceFileSearch", "Disassembly").toUtf8().constData());
     GuiReferenceSetRowCount(0);
 
-    for(unsigned long long index = 0; index < file->Length(); index++)
+    duint start = address;
+    duint end = address + sizeof(duint) - 1;
+    std::vector<std::vector<TraceSearchHit>> pageHits(file->PageCount());
+    bool readable = file->ForEachPage([start, end](const TraceFilePageSummary & summary)
+    {
+        return summary.hasMemory && rangeOverlaps(summary.memAddressMin, summary.memAddressMax, start, end);
+    }, [start, end, &pageHits](size_t pageNumber, unsigned long long base, const TraceFilePage & page)
     {
-        bool found = false;
-        //Memory
-        duint memAddr[MAX_MEMORY_OPERANDS];
-        duint memOldContent[MAX_MEMORY_OPERANDS];
-        duint memNewContent[MAX_MEMORY_OPERANDS];
-        bool isValid[MAX_MEMORY_OPERANDS];
-        int memAccessCount = file->MemoryAccessCount(index);
-        if(memAccessCount > 0)
+        auto & hits = pageHits[pageNumber];
+        for(unsigned long long index = 0; index < page.Length(); index++)
         {
-            file->MemoryAccessInfo(index, memAddr, memOldContent, memNewContent, isValid);
-            for(size_t i = 0; i < memAccessCount; i++)
+            bool found = false;
+            //Memory
+            duint memAddr[MAX_MEMORY_OPERANDS];
+            duint memOldContent[MAX_MEMORY_OPERANDS];
+            duint memNewContent[MAX_MEMORY_OPERANDS];
+            bool isValid[MAX_MEMORY_OPERANDS];
+            int memAccessCount = page.MemoryAccessCount(index);
+            if(memAccessCount > 0)
             {
-                found |= inRange(memAddr[i], address, address + sizeof(duint) - 1);
-            }
-            //Constants: TO DO
-            //Populate reference view
-            if(found)
-            {
-                GuiReferenceSetRowCount(count + 1);
-                GuiReferenceSetCellContent(count, 0, ToPtrString(file->Registers(index).regcontext.cip).toUtf8().constData());
-                GuiReferenceSetCellContent(count, 1, getIndexText(file, index).toUtf8().constData());
-                unsigned char opcode[16];
-                int opcodeSize = 0;
-                file->OpCode(index, opcode, &opcodeSize);
-                cp.Disassemble(file->Registers(index).regcontext.cip, opcode, opcodeSize);
-                GuiReferenceSetCellContent(count, 2, cp.InstructionText(true).c_str());
-                //GuiReferenceSetCurrentTaskProgress; GuiReferenceSetProgress
-                count++;
+                page.MemoryAccessInfo(index, memAddr, memOldContent, memNewContent, isValid);
+                for(size_t i = 0; i < memAccessCount; i++)
+                {
+                    found |= inRange(memAddr[i], start, end);
+                }
+                //Constants: TO DO
+                if(found)
+                    hits.push_back(makeHit(page, base, index));
             }
         }
-    }
-    return count;
+    });
+    if(!readable)
+        reportUnreadablePages();
+    //Populate reference view
+    return populateReferences(file, pageHits);
 }
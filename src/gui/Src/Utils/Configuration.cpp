@@ -312,6 +312,7 @@ Configuration::Configuration() : QObject(), noMoreMsgbox(false)
     AbstractTableView::setupColumnConfigDefaultValue(guiUint, "Module", 4);
     AbstractTableView::setupColumnConfigDefaultValue(guiUint, "Symbol", 4);
     guiUint.insert("SIMDRegistersDisplayMode", 0);
+    guiUint.insert("TracePageCacheSize", 256); //MB of decoded trace pages kept in memory
     addWindowPosConfig(guiUint, "AssembleDialog");
     addWindowPosConfig(guiUint, "AttachDialog");
     addWindowPosConfig(guiUint, "GotoDialog");
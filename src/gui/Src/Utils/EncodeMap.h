@@ -72,16 +72,14 @@ public:
         }
     }
 
-    bool inBufferRange(duint addr) const
+    bool inRegion(duint addr) const
     {
-        return addr >= mBase && addr < mBase + mBufferSize;
+        return mBase && addr >= mBase && addr < mBase + mSize;
     }
 
 protected:
     duint mBase;
     duint mSize;
-    byte* mBuffer;
-    duint mBufferSize;
 };
 
 #endif // ENCODEMAP_H
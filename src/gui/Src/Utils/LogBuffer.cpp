@@ -0,0 +1,137 @@
+#include "LogBuffer.h"
+#include <algorithm>
+
+//Width of the text in characters like LogView::rowText paints it, a tab is expanded to 4 spaces
+static int textWidth(const char* data, int size)
+{
+    int width = 0;
+    for(int i = 0; i < size; i++)
+    {
+        auto ch = (unsigned char)data[i];
+        if(ch == '\t')
+            width += 4;
+        else if(ch != '\r' && ch != '\n' && (ch & 0xC0) != 0x80) //UTF-8 continuation bytes are part of the previous character
+            width++;
+    }
+    return width;
+}
+
+LogBuffer::LogBuffer(size_t maxSize)
+    : mMaxSize(maxSize)
+{
+    clear();
+}
+
+qint64 LogBuffer::append(const char* data, size_t size)
+{
+    auto end = data + size;
+    while(data < end)
+    {
+        auto chunk = mChunks.empty() ? nullptr : mChunks.back().get();
+        if(!mLineOpen) //start a new line, lines never span multiple chunks
+        {
+            if(!chunk || chunk->data.size() >= ChunkSize)
+            {
+                auto newChunk = new Chunk();
+                newChunk->firstLine = chunk ? chunk->firstLine + qint64(chunk->lines.size()) : mDropped;
+                newChunk->data.reserve(ChunkSize);
+                newChunk->longestLine = 0;
+                mChunks.emplace_back(newChunk);
+                chunk = newChunk;
+            }
+            chunk->lines.push_back(chunk->data.size());
+            mLineOpen = true;
+            mLineLength = 0;
+        }
+        auto newline = (const char*)memchr(data, '\n', end - data);
+        auto next = newline ? newline + 1 : end;
+        auto length = int(next - data);
+        chunk->data.append(data, length);
+        mSize += length;
+        mLineLength += textWidth(data, length);
+        chunk->longestLine = std::max(chunk->longestLine, mLineLength);
+        mLongestLine = std::max(mLongestLine, mLineLength);
+        if(newline)
+            mLineOpen = false;
+        data = next;
+    }
+
+    //drop the oldest chunks, the chunk that is being written to stays
+    qint64 dropped = 0;
+    while(mSize > mMaxSize && mChunks.size() > 1)
+    {
+        const auto & front = mChunks.front();
+        mSize -= front->data.size();
+        dropped += front->lines.size();
+        mChunks.pop_front();
+    }
+    mDropped += dropped;
+    if(dropped)
+    {
+        //the longest line might have been dropped
+        mLongestLine = 0;
+        for(const auto & chunk : mChunks)
+            mLongestLine = std::max(mLongestLine, chunk->longestLine);
+    }
+    return dropped;
+}
+
+void LogBuffer::clear()
+{
+    mChunks.clear();
+    mDropped = 0;
+    mSize = 0;
+    mLineOpen = false;
+    mLineLength = 0;
+    mLongestLine = 0;
+}
+
+qint64 LogBuffer::lineCount() const
+{
+    if(mChunks.empty())
+        return 0;
+    const auto & back = mChunks.back();
+    return back->firstLine + qint64(back->lines.size()) - mDropped;
+}
+
+const LogBuffer::Chunk* LogBuffer::findChunk(qint64 index, size_t & line) const
+{
+    if(index < 0 || index >= lineCount())
+        return nullptr;
+    auto absolute = mDropped + index;
+    auto found = std::upper_bound(mChunks.begin(), mChunks.end(), absolute, [](qint64 value, const std::unique_ptr<Chunk> & chunk)
+    {
+        return value < chunk->firstLine;
+    });
+    const auto & chunk = *(found - 1);
+    line = size_t(absolute - chunk->firstLine);
+    return chunk.get();
+}
+
+QByteArray LogBuffer::line(qint64 index) const
+{
+    size_t line;
+    auto chunk = findChunk(index, line);
+    if(!chunk)
+        return QByteArray();
+    auto start = chunk->lines[line];
+    auto end = line + 1 < chunk->lines.size() ? chunk->lines[line + 1] : chunk->data.size();
+    while(end > start && (chunk->data[end - 1] == '\n' || chunk->data[end - 1] == '\r'))
+        end--;
+    return QByteArray(chunk->data.constData() + start, end - start);
+}
+
+QString LogBuffer::lineText(qint64 index) const
+{
+    return QString::fromUtf8(line(index));
+}
+
+size_t LogBuffer::size() const
+{
+    return mSize;
+}
+
+int LogBuffer::longestLine() const
+{
+    return mLongestLine;
+}
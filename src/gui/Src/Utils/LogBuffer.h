@@ -0,0 +1,54 @@
+#ifndef LOGBUFFER_H
+#define LOGBUFFER_H
+
+#include <QByteArray>
+#include <QString>
+#include <deque>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief The LogBuffer class stores the log as raw UTF-8 lines in a list of chunks with a line offset index.
+ * When the buffer grows over its maximum size the oldest chunks are dropped, so the memory use is bounded.
+ * Lines are numbered from the oldest line still in the buffer.
+ */
+class LogBuffer
+{
+public:
+    explicit LogBuffer(size_t maxSize = 64 * 1024 * 1024);
+
+    qint64 append(const char* data, size_t size); //returns the number of lines dropped from the start
+    void clear();
+
+    qint64 lineCount() const;
+    QByteArray line(qint64 index) const; //without the line ending
+    QString lineText(qint64 index) const;
+    size_t size() const;
+    int longestLine() const; //in characters as the view paints them (tabs expanded), used to size the view
+
+private:
+    enum
+    {
+        ChunkSize = 64 * 1024
+    };
+
+    struct Chunk
+    {
+        qint64 firstLine; //number of the first line in the chunk since the last clear
+        QByteArray data;
+        std::vector<int> lines; //start offsets in data
+        int longestLine; //in characters, see longestLine()
+    };
+
+    const Chunk* findChunk(qint64 index, size_t & line) const;
+
+    std::deque<std::unique_ptr<Chunk>> mChunks;
+    qint64 mDropped; //lines dropped since the last clear
+    size_t mSize;
+    size_t mMaxSize;
+    bool mLineOpen; //the last line did not end with a newline yet
+    int mLineLength; //of the last line, in characters
+    int mLongestLine;
+};
+
+#endif // LOGBUFFER_H
@@ -0,0 +1,68 @@
+#include "LogRedirectThread.h"
+#include <QString>
+#include <Windows.h>
+
+LogRedirectThread::LogRedirectThread(FILE* file, bool utf16, QObject* parent) : QThread(parent)
+{
+    mFile = file;
+    mUtf16 = utf16;
+    mStop = false;
+}
+
+LogRedirectThread::~LogRedirectThread()
+{
+    {
+        QMutexLocker lock(&mLock);
+        mStop = true;
+        mCondition.wakeOne();
+    }
+    wait(); //write what is left in the queue
+    fclose(mFile);
+}
+
+void LogRedirectThread::write(const QByteArray & msg)
+{
+    QMutexLocker lock(&mLock);
+    mQueue.append(msg);
+    mCondition.wakeOne();
+}
+
+void LogRedirectThread::run()
+{
+    QByteArray data;
+    while(true)
+    {
+        bool stop;
+        {
+            QMutexLocker lock(&mLock);
+            while(mQueue.isEmpty() && !mStop)
+                mCondition.wait(&mLock);
+            data.swap(mQueue);
+            stop = mStop;
+        }
+        if(!data.isEmpty())
+        {
+            bool ok;
+            if(mUtf16)
+            {
+                QString msgUtf16 = QString::fromUtf8(data);
+                msgUtf16.replace("\r\n", "\n");
+                msgUtf16.replace("\n", "\r\n");
+                ok = fwrite(msgUtf16.utf16(), msgUtf16.length(), 2, mFile) != 0;
+            }
+            else
+            {
+                data.replace("\r\n", "\n");
+                ok = fwrite(data.constData(), data.size(), 1, mFile) != 0;
+            }
+            data.clear();
+            if(!ok)
+            {
+                emit writeFailed(GetLastError());
+                break;
+            }
+        }
+        if(stop)
+            break;
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef LOGREDIRECTTHREAD_H
+#define LOGREDIRECTTHREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <cstdio>
+
+/**
+ * @brief The LogRedirectThread class writes the redirected log to a file, so a slow disk doesn't block the GUI.
+ * The thread owns the file and closes it when it is destroyed.
+ */
+class LogRedirectThread : public QThread
+{
+    Q_OBJECT
+public:
+    explicit LogRedirectThread(FILE* file, bool utf16, QObject* parent = 0);
+    ~LogRedirectThread();
+    void write(const QByteArray & msg); //UTF-8
+
+signals:
+    void writeFailed(unsigned int lastError);
+
+private:
+    void run();
+    FILE* mFile;
+    bool mUtf16;
+    QMutex mLock;
+    QWaitCondition mCondition;
+    QByteArray mQueue;
+    bool mStop;
+};
+
+#endif // LOGREDIRECTTHREAD_H
@@ -145,6 +145,8 @@ SOURCES += \
     Src/Utils/MainWindowCloseThread.cpp \
     Src/Gui/TimeWastedCounter.cpp \
     Src/Utils/FlickerThread.cpp \
+    Src/Utils/LogBuffer.cpp \
+    Src/Utils/LogRedirectThread.cpp \
     Src/QEntropyView/QEntropyView.cpp \
     Src/Gui/EntropyDialog.cpp \
     Src/Gui/NotesManager.cpp \
@@ -263,6 +265,8 @@ HEADERS += \
     Src/Utils/MainWindowCloseThread.h \
     Src/Gui/TimeWastedCounter.h \
     Src/Utils/FlickerThread.h \
+    Src/Utils/LogBuffer.h \
+    Src/Utils/LogRedirectThread.h \
     Src/QEntropyView/Entropy.h \
     Src/QEntropyView/QEntropyView.h \
     Src/Gui/EntropyDialog.h \
@@ -365,6 +369,7 @@ LIBS += -luser32 -ladvapi32 -lwinmm -lshell32
     LIBS += -L"$$PWD/../capstone_wrapper/bin/x32$${DIR_SUFFIX}" -lcapstone_wrapper
     LIBS += -L"$$PWD/Src/ThirdPartyLibs/snowman" -lsnowman_x86
     LIBS += -L"$$PWD/Src/ThirdPartyLibs/ldconvert" -lldconvert_x86
+    LIBS += -L"$$PWD/../dbg/lz4" -llz4_x86
     LIBS += -L"$${X64_BIN_DIR}" -lx32bridge
 } else {
     # Windows x64 (64bit) specific build
@@ -373,5 +378,6 @@ LIBS += -luser32 -ladvapi32 -lwinmm -lshell32
     LIBS += -L"$$PWD/../capstone_wrapper/bin/x64$${DIR_SUFFIX}" -lcapstone_wrapper
     LIBS += -L"$$PWD/Src/ThirdPartyLibs/snowman" -lsnowman_x64
     LIBS += -L"$$PWD/Src/ThirdPartyLibs/ldconvert" -lldconvert_x64
+    LIBS += -L"$$PWD/../dbg/lz4" -llz4_x64
     LIBS += -L"$${X64_BIN_DIR}" -lx64bridge
 }
@@ -151,6 +151,8 @@ SOURCES += \
     gui/Src/Utils/Configuration.cpp \
     gui/Src/Utils/EncodeMap.cpp \
     gui/Src/Utils/FlickerThread.cpp \
+    gui/Src/Utils/LogBuffer.cpp \
+    gui/Src/Utils/LogRedirectThread.cpp \
     gui/Src/Utils/HexValidator.cpp \
     gui/Src/Utils/LongLongValidator.cpp \
     gui/Src/Utils/MainWindowCloseThread.cpp \
@@ -382,6 +384,8 @@ HEADERS += \
     gui/Src/Utils/Configuration.h \
     gui/Src/Utils/EncodeMap.h \
     gui/Src/Utils/FlickerThread.h \
+    gui/Src/Utils/LogBuffer.h \
+    gui/Src/Utils/LogRedirectThread.h \
     gui/Src/Utils/HexValidator.h \
     gui/Src/Utils/LongLongValidator.h \
     gui/Src/Utils/MainWindowCloseThread.h \